@@ -188,6 +188,9 @@ alignas(4) static constexpr char Modules[] PROGMEM_STRING_ATTR =
 #if SENSOR_SUPPORT
     "SENSOR "
 #endif
+#if SENSOR_SUPPORT && SENSOR_HISTORY_SUPPORT
+    "SENSOR_HISTORY "
+#endif
 #if SPIFFS_SUPPORT
     "SPIFFS "
 #endif
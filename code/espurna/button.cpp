@@ -118,6 +118,8 @@ PROGMEM_STRING(MqttRetain, "btnMqttRetain");
 
 [[gnu::unused]] PROGMEM_STRING(TerminalCommand, "btnTermCmd");
 
+[[gnu::unused]] PROGMEM_STRING(LightScene, "btnScene");
+
 } // namespace
 } // namespace keys
 
@@ -189,6 +191,8 @@ PROGMEM_STRING(Custom, "custom");
 
 PROGMEM_STRING(TerminalCommand, "term-cmd");
 
+[[gnu::unused]] PROGMEM_STRING(LightScene, "light-scene");
+
 static constexpr Enumeration<ButtonAction> ButtonActionOptions[] PROGMEM {
     {ButtonAction::None, None},
 #if RELAY_SUPPORT
@@ -215,6 +219,9 @@ static constexpr Enumeration<ButtonAction> ButtonActionOptions[] PROGMEM {
 #if TERMINAL_SUPPORT
     {ButtonAction::TerminalCommand, TerminalCommand},
 #endif
+#if LIGHT_PROVIDER != LIGHT_PROVIDER_NONE
+    {ButtonAction::LightScene, LightScene},
+#endif
 };
 
 } // namespace
@@ -645,7 +652,7 @@ T indexedThenGlobal(const String& prefix, size_t index, T defaultValue) {
 
     const auto global = espurna::settings::get(prefix);
     if (global) {
-        return espurna::settings::internal::convert<T>(indexed.ref());
+        return espurna::settings::internal::convert<T>(global.ref());
     }
 
     return defaultValue;
@@ -756,6 +763,12 @@ String terminalCommand(size_t index) {
 }
 #endif
 
+#if LIGHT_PROVIDER != LIGHT_PROVIDER_NONE
+size_t lightScene(size_t index) {
+    return getSetting({keys::LightScene, index}, size_t{ 0 });
+}
+#endif
+
 } // namespace
 
 namespace query {
@@ -793,6 +806,10 @@ ID_VALUE(mqttSendAllEvents, settings::mqttSendAllEvents)
 ID_VALUE(mqttRetain, settings::mqttRetain)
 #endif
 
+#if LIGHT_PROVIDER != LIGHT_PROVIDER_NONE
+ID_VALUE(lightScene, settings::lightScene)
+#endif
+
 #undef ID_VALUE
 
 } // namespace
@@ -827,6 +844,9 @@ static constexpr espurna::settings::query::IndexedSetting IndexedSettings[] PROG
 #if TERMINAL_SUPPORT
     {keys::TerminalCommand, settings::terminalCommand},
 #endif
+#if LIGHT_PROVIDER != LIGHT_PROVIDER_NONE
+    {keys::LightScene, internal::lightScene},
+#endif
 };
 
 bool checkSamePrefix(StringView key) {
@@ -1206,6 +1226,12 @@ void buttonEvent(size_t id, ButtonEvent event) {
 #endif
         break;
 
+    case ButtonAction::LightScene:
+#if LIGHT_PROVIDER != LIGHT_PROVIDER_NONE
+        lightSceneRecall(espurna::button::settings::lightScene(id));
+#endif
+        break;
+
     case ButtonAction::DisplayOn:
 #if THERMOSTAT_DISPLAY_SUPPORT
         displayOn();
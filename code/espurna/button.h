@@ -49,6 +49,7 @@ enum class ButtonAction {
     FanMedium,
     FanHigh,
     TerminalCommand,
+    LightScene,
 };
 
 using ButtonEventHandler = void(*)(size_t id, ButtonEvent event);
@@ -215,6 +215,12 @@
                                                 // If not defined the firmware will use a number based
                                                 // on the number of available sectors
 
+#ifndef EEPROM_BACKEND
+#define EEPROM_BACKEND              EEPROM_BACKEND_ROTATE   // EEPROM_BACKEND_ROTATE (default, whole sector is written on every commit)
+                                                            // EEPROM_BACKEND_JOURNAL (only the modified data is appended to the sector,
+                                                            // which is only erased when full. Non-empty data has to fit into a single sector)
+#endif
+
 #ifndef SAVE_CRASH_ENABLED
 #define SAVE_CRASH_ENABLED          1           // Save stack trace to EEPROM by default
                                                 // Depends on DEBUG_SUPPORT == 1
@@ -351,6 +357,10 @@
 #define HEARTBEAT_REPORT_BSSID       0
 #endif
 
+#ifndef HEARTBEAT_REPORT_QUEUE
+#define HEARTBEAT_REPORT_QUEUE       0
+#endif
+
 //------------------------------------------------------------------------------
 // Load average
 //------------------------------------------------------------------------------
@@ -1067,6 +1077,33 @@
 #define MQTT_QUEUE_MAX_SIZE         20              // Size of the MQTT queue when MQTT_JSON is enabled
 #endif
 
+#ifndef MQTT_JSON_MAX_SIZE
+#define MQTT_JSON_MAX_SIZE          1024            // Send grouped messages before the JSON payload grows larger than this many bytes
+                                                    // (not counting the MQTT_ENQUEUE_... properties below)
+#endif
+
+#ifndef MQTT_TOPIC_CACHE_SIZE
+#define MQTT_TOPIC_CACHE_SIZE       16              // Keep up to this many complete topics, instead of re-creating them on every publish or subscription
+                                                    // (every topic uses ~80-100 bytes of heap, 0 to disable)
+#endif
+
+#ifndef MQTT_OFFLINE_QUEUE_SIZE
+#define MQTT_OFFLINE_QUEUE_SIZE     16              // Keep up to this many messages while disconnected, sent after the connection is established
+                                                    // (0 to disable and drop every message published while disconnected)
+#endif
+
+#ifndef MQTT_OFFLINE_QUEUE_BYTES
+#define MQTT_OFFLINE_QUEUE_BYTES    2048            // ...and only as long as their topics and payloads fit into this many bytes
+#endif
+
+#ifndef MQTT_OFFLINE_DRAIN_INTERVAL
+#define MQTT_OFFLINE_DRAIN_INTERVAL 100             // After connecting, send queued messages in small groups every N ms...
+#endif
+
+#ifndef MQTT_OFFLINE_DRAIN_COUNT
+#define MQTT_OFFLINE_DRAIN_COUNT    4               // ...and this many messages at a time
+#endif
+
 #ifndef MQTT_BUFFER_MAX_SIZE
 #define MQTT_BUFFER_MAX_SIZE        1024            // Size of the MQTT payload buffer for MQTT_MESSAGE_EVENT. Large messages will only be available via MQTT_MESSAGE_RAW_EVENT.
                                                     // Note: When using MQTT_LIBRARY_PUBSUBCLIENT, MQTT_MAX_PACKET_SIZE should not be more than this value.
@@ -1134,6 +1171,17 @@
 #define SETTINGS_AUTOSAVE       1           // Autosave settings or force manual commit
 #endif
 
+#ifndef SETTINGS_INDEX
+#define SETTINGS_INDEX          0           // Keep an in-RAM index of key hashes and their storage offsets
+                                            // Speeds up lookups, at the cost of 4 bytes of RAM per key
+#endif
+
+#ifndef SETTINGS_SORTED_INDEX
+#define SETTINGS_SORTED_INDEX   1           // Keep storage offsets of every key, sorted by key
+                                            // Speeds up prefix searches and sorted key lists, at the cost of 2 bytes of RAM per key
+                                            // Without SETTINGS_INDEX, lookups also use binary search on this list
+#endif
+
 // -----------------------------------------------------------------------------
 // LIGHT
 // -----------------------------------------------------------------------------
@@ -1216,6 +1264,10 @@
 #define LIGHT_USE_GAMMA         0           // Use gamma correction for color channels
 #endif
 
+#ifndef LIGHT_GAMMA_EXPONENT
+#define LIGHT_GAMMA_EXPONENT    2.2         // Gamma correction curve, output is input to the power of this value
+#endif
+
 #ifndef LIGHT_USE_RGB
 #define LIGHT_USE_RGB           0           // Use RGB color selector (1=> RGB, 0=> HSV)
 #endif
@@ -1238,6 +1290,17 @@
 #define LIGHT_TRANSITION_TIME   500         // Time in millis from color to color
 #endif
 
+#ifndef LIGHT_TRANSITION_EASING
+#define LIGHT_TRANSITION_EASING 0           // Shape of the transition curve
+                                            // 0 - linear
+                                            // 1 - slow start and end (ease in-out)
+                                            // 2 - perceptual, linear change of the perceived brightness
+#endif
+
+#ifndef LIGHT_SCENES_MAX
+#define LIGHT_SCENES_MAX        8           // Maximum number of stored light scenes
+#endif
+
 // -----------------------------------------------------------------------------
 // DOMOTICZ
 // -----------------------------------------------------------------------------
@@ -20,6 +20,10 @@
 #define SENSOR_READ_MAX_INTERVAL            3600            // Maximum read interval
 #endif
 
+#ifndef SENSOR_READ_BUDGET
+#define SENSOR_READ_BUDGET                  50              // Max time (ms) spent reading sensors in a single loop, rest are postponed
+#endif
+
 #ifndef SENSOR_INIT_INTERVAL
 #define SENSOR_INIT_INTERVAL                10              // Try to re-init non-ready sensors every 10s
 #endif
@@ -45,6 +49,22 @@
 #define SENSOR_POWER_CHECK_STATUS           1               // If set to 1 the reported power/current/energy will be 0 if the relay[0] is OFF
 #endif
 
+#ifndef SENSOR_HISTORY_SUPPORT
+#define SENSOR_HISTORY_SUPPORT              0               // Keep min, avg and max of the latest readings of every magnitude in memory
+#endif
+
+#ifndef SENSOR_HISTORY_MINUTES
+#define SENSOR_HISTORY_MINUTES              30              // Number of 1 minute intervals
+#endif
+
+#ifndef SENSOR_HISTORY_QUARTERS
+#define SENSOR_HISTORY_QUARTERS             16              // Number of 15 minute intervals
+#endif
+
+#ifndef SENSOR_HISTORY_HOURS
+#define SENSOR_HISTORY_HOURS                24              // Number of 1 hour intervals
+#endif
+
 #ifndef SENSOR_REAL_TIME_VALUES
 #define SENSOR_REAL_TIME_VALUES             0               // Show filtered/median values by default (0 => median, 1 => real time)
 #endif
@@ -52,9 +72,18 @@
 #ifndef SENSOR_SAVE_EVERY
 #define SENSOR_SAVE_EVERY                   0               // Save accumulating values to EEPROM (atm only energy)
                                                             // A 0 means do not save and it's the default value
-                                                            // A number different from 0 means it should store the value in EEPROM
-                                                            // after these many reports
-                                                            // Warning: this might wear out flash fast!
+                                                            // A number different from 0 means values are kept in RTC memory
+                                                            // and written to EEPROM according to the settings below
+#endif
+
+#ifndef SENSOR_SAVE_INTERVAL
+#define SENSOR_SAVE_INTERVAL                3600            // Write accumulating values to EEPROM at most once per this many seconds
+                                                            // A 0 means only save on reset or when the delta below is exceeded
+#endif
+
+#ifndef SENSOR_SAVE_DELTA
+#define SENSOR_SAVE_DELTA                   100             // Write accumulating values to EEPROM as soon as any of them changes
+                                                            // by this many Wh since the last write. A 0 disables this check
 #endif
 
 #ifndef SENSOR_PUBLISH_ADDRESSES
@@ -449,11 +478,15 @@
 //------------------------------------------------------------------------------
 
 #ifndef EMON_MAX_SAMPLES
-#define EMON_MAX_SAMPLES                1000        // Max number of samples to get
+#define EMON_MAX_SAMPLES                1000        // Max number of samples to get between readings
 #endif
 
 #ifndef EMON_MAX_TIME
-#define EMON_MAX_TIME                   250         // Max time in ms to sample
+#define EMON_MAX_TIME                   250         // Max time in ms to sample (when blocking, during initialization)
+#endif
+
+#ifndef EMON_TICK_TIME
+#define EMON_TICK_TIME                  1000        // Max time in us to sample on every loop
 #endif
 
 #ifndef EMON_FILTER_SPEED
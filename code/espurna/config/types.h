@@ -13,6 +13,13 @@
 #define GPIO_TYPE_HARDWARE      GpioType::Hardware
 #define GPIO_TYPE_MCP23S08      GpioType::Mcp23s08
 
+//------------------------------------------------------------------------------
+// EEPROM
+//------------------------------------------------------------------------------
+
+#define EEPROM_BACKEND_ROTATE       0
+#define EEPROM_BACKEND_JOURNAL      1
+
 //------------------------------------------------------------------------------
 // BUTTONS
 //------------------------------------------------------------------------------
@@ -35,6 +42,7 @@
 #define BUTTON_ACTION_FAN_MEDIUM          ButtonAction::FanMedium
 #define BUTTON_ACTION_FAN_HIGH            ButtonAction::FanHigh
 #define BUTTON_ACTION_TERMINAL_COMMAND    ButtonAction::TerminalCommand
+#define BUTTON_ACTION_LIGHT_SCENE         ButtonAction::LightScene
 
 // Deprecated: legacy mapping, changed to action from above
 #define BUTTON_MODE_NONE              BUTTON_ACTION_NONE
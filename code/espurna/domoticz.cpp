@@ -399,10 +399,11 @@ void send(unsigned char index, const espurna::sensor::Value& value) {
     // https://github.com/domoticz/domoticz/blob/6027b1d9e3b6588a901de42d82f3a6baf1374cd1/hardware/I2C.cpp#L1092-L1193
     // For now, just send invalid value. Consider simplifying sampling function and adding it here, with custom sampling time (3 hours, 6 hours, 12 hours etc.)
     if (MAGNITUDE_PRESSURE == value.type) {
-        mqtt::send(idx, 0, (value.repr + F(";-1")).c_str());
+        mqtt::send(idx, 0, (value.repr() + F(";-1")).c_str());
     // Special case to allow us to use it with switches directly
     } else if (MAGNITUDE_DIGITAL == value.type) {
-        mqtt::send(idx, (*value.repr.c_str() == '1') ? 1 : 0, value.repr.c_str());
+        const auto repr = value.repr();
+        mqtt::send(idx, (*repr.c_str() == '1') ? 1 : 0, repr.c_str());
     // https://www.domoticz.com/wiki/Domoticz_API/JSON_URL's#Humidity
     // nvalue contains HUM (relative humidity)
     // svalue contains HUM_STAT, one of consts below
@@ -422,7 +423,7 @@ void send(unsigned char index, const espurna::sensor::Value& value) {
         mqtt::send(idx, static_cast<int>(value.value));
     // Otherwise, send char string aka formatted float (nvalue is only for integers)
     } else {
-        mqtt::send(idx, 0, value.repr.c_str());
+        mqtt::send(idx, 0, value.repr().c_str());
     }
 }
 
@@ -9,139 +9,255 @@
 #include "BaseFilter.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <utility>
 #include <vector>
 
+// Values are stored in a fixed ring buffer, in the order they were received.
+// Lower half of the values is tracked by a max-heap and upper half by a min-heap,
+// so the median is always at the top of either one or both of them.
+// Heaps store ring buffer positions, and every position remembers where it is in the heap.
+// Replacing the oldest value takes O(log n), and nothing is allocated outside of resize()
 class MedianFilter : public BaseFilter {
 public:
+    using Position = uint16_t;
+
     void update(double value) override {
-        // Inserted value is always with the last index
         if (!_size) {
             return;
         }
 
-        const auto size = _values.size();
-        auto pending =
-            Value{
-                .value = value,
-                .index = size,
-            };
-
-        // Special case for initial state
-        if (!_values.size()) {
-            _values.push_back(pending);
+        if (_count < _size) {
+            const auto position = _wrap(_head + _count);
+            _values[position] = value;
+            _insert(position);
+            ++_count;
             return;
         }
 
-        // Pop first element by index, shift everything else down
-        if (_values.size() == _size) {
-            const auto it = std::find_if(
-                _values.begin(),
-                _values.end(),
-                [&](const Value& value) {
-                    return value.index == 0;
-                });
+        // oldest value is replaced by the new one, in place
+        const auto position = _head;
+        _erase(position);
+        _values[position] = value;
+        _insert(position);
 
-            _values.erase(it);
-            for (auto& entry : _values) {
-                --entry.index;
-            }
-
-            pending.index -= 1;
-        }
-
-        // Defensively sort the values vector
-        const auto upper = std::upper_bound(
-            _values.begin(), _values.end(), pending,
-            [](const Value& lhs, const Value& rhs) {
-                return lhs.value < rhs.value;
-            });
-        _values.insert(upper, pending);
+        _head = _wrap(_head + 1);
     }
 
     double value() const override {
-        // Special case when early report triggers value read
-        if (_values.size() == 1) {
-            return _values.front().value;
-        } else if (_values.size() == 2) {
-            return (_values.front().value + _values.back().value) / 2.0;
-        // Otherwise, pick out the middle section and average it
-        } else if (0 == (_values.size() % 2)) {
-            const auto lhs = _values.begin() + ((_values.size() / 2) - 1);
-            const auto rhs = std::next(lhs);
+        if (!_count) {
+            return 0.0;
+        }
 
-            return ((*lhs).value + (*rhs).value) / 2.0;
+        // Pick out the middle section and average it
+        if (0 == (_count % 2)) {
+            return (_values[_low.front()] + _values[_high.front()]) / 2.0;
         }
 
         // ...or, use the middle element as-is
-        const auto it = _values.begin() + (_values.size() / 2);
-        return (*it).value;
+        return _values[_low.front()];
     }
 
     bool available() const override {
-        return _values.size() > 0;
+        return _count > 0;
     }
 
     bool ready() const override {
         return (_size > 0)
-            && (_values.size() == _size);
+            && (_count == _size);
     }
 
+    // Only the latest values are preserved when the buffer becomes smaller
     void resize(size_t size) override {
-        _resize(size);
+        if (size > MaxSize) {
+            size = MaxSize;
+        }
+
+        if (size == _size) {
+            return;
+        }
+
+        std::vector<double> values;
+        values.reserve(size);
+
+        const auto count = std::min(_count, size);
+        for (size_t index = _count - count; index < _count; ++index) {
+            values.push_back(_values[_wrap(_head + index)]);
+        }
+
+        _values = std::move(values);
+        _values.resize(size);
+
+        _index = std::vector<Position>(size, 0);
+
+        // either heap may temporarily hold an extra element before balancing
+        _low.clear();
+        _low.reserve((size / 2) + 2);
+
+        _high.clear();
+        _high.reserve((size / 2) + 1);
+
+        if (!size) {
+            _values.shrink_to_fit();
+            _index.shrink_to_fit();
+            _low.shrink_to_fit();
+            _high.shrink_to_fit();
+        }
+
+        _size = size;
+        _head = 0;
+        _count = 0;
+
+        for (size_t position = 0; position < count; ++position) {
+            _insert(position);
+            ++_count;
+        }
     }
 
     void reset() override {
-        _values.clear();
+        _low.clear();
+        _high.clear();
+        _head = 0;
+        _count = 0;
     }
 
 private:
-    void _resize(size_t size) {
-        if (!size) {
-            _values.clear();
-            _values.shrink_to_fit();
-        } else if ((size < _size) && _values.size()) {
-            _reset_offset(_size - size);
-        } else if (size > _size) {
-            _values.reserve(size);
+    // top bit of the index marks the heap that holds the position
+    static constexpr Position High { 0x8000 };
+    static constexpr size_t MaxSize { High };
+
+    size_t _wrap(size_t position) const {
+        return position % _size;
+    }
+
+    // Heap helpers, Compare(lhs, rhs) returns true when lhs should be closer to the top
+    // (std::*_heap algorithms can't be used, since the index needs to be kept in sync)
+    struct Lower {
+        bool operator()(double lhs, double rhs) const {
+            return lhs > rhs;
         }
+    };
 
-        _size = size;
+    struct Upper {
+        bool operator()(double lhs, double rhs) const {
+            return lhs < rhs;
+        }
+    };
+
+    void _place(std::vector<Position>& heap, Position flag, size_t at, Position position) {
+        heap[at] = position;
+        _index[position] = static_cast<Position>(at) | flag;
     }
 
-    void _reset_offset(size_t offset) {
-        const auto it = std::remove_if(
-            _values.begin(),
-            _values.end(),
-            [&](Value& value) {
-                const auto remove = value.index < offset;
-                if (!remove) {
-                    value.index -= offset;
-                }
+    template <typename Compare>
+    size_t _sift_up(std::vector<Position>& heap, Position flag, size_t at, Compare compare) {
+        const auto position = heap[at];
+        while (at > 0) {
+            const auto parent = (at - 1) / 2;
+            if (!compare(_values[position], _values[heap[parent]])) {
+                break;
+            }
 
-                return remove;
-            });
+            _place(heap, flag, at, heap[parent]);
+            at = parent;
+        }
 
-        if (it != _values.end()) {
-            _values.erase(it, _values.end());
-            _values.shrink_to_fit();
+        _place(heap, flag, at, position);
+        return at;
+    }
+
+    template <typename Compare>
+    void _sift_down(std::vector<Position>& heap, Position flag, size_t at, Compare compare) {
+        const auto position = heap[at];
+        const auto size = heap.size();
+
+        for (;;) {
+            auto child = (at * 2) + 1;
+            if (child >= size) {
+                break;
+            }
+
+            if (((child + 1) < size) && compare(_values[heap[child + 1]], _values[heap[child]])) {
+                ++child;
+            }
+
+            if (!compare(_values[heap[child]], _values[position])) {
+                break;
+            }
+
+            _place(heap, flag, at, heap[child]);
+            at = child;
         }
+
+        _place(heap, flag, at, position);
     }
 
-    void _reset(size_t size) {
-        _values.clear();
-        _resize(size);
+    template <typename Compare>
+    void _push(std::vector<Position>& heap, Position flag, Position position, Compare compare) {
+        heap.push_back(position);
+        _sift_up(heap, flag, heap.size() - 1, compare);
     }
 
-    void _reset() {
-        _reset(_size);
+    template <typename Compare>
+    Position _pop(std::vector<Position>& heap, Position flag, Compare compare) {
+        const auto out = heap.front();
+        _remove(heap, flag, 0, compare);
+        return out;
     }
 
-    // Track input index, since '_values' is sorted by 'value'
-    struct Value {
-        double value;
-        size_t index;
-    };
+    template <typename Compare>
+    void _remove(std::vector<Position>& heap, Position flag, size_t at, Compare compare) {
+        const auto last = heap.size() - 1;
+        if (at != last) {
+            _place(heap, flag, at, heap[last]);
+            heap.pop_back();
+            if (_sift_up(heap, flag, at, compare) == at) {
+                _sift_down(heap, flag, at, compare);
+            }
+        } else {
+            heap.pop_back();
+        }
+    }
+
+    // Lower heap is allowed to have one more element than the upper one
+    void _balance() {
+        if (_low.size() > (_high.size() + 1)) {
+            _push(_high, High, _pop(_low, 0, Lower{}), Upper{});
+        } else if (_high.size() > _low.size()) {
+            _push(_low, 0, _pop(_high, High, Upper{}), Lower{});
+        }
+    }
+
+    void _insert(Position position) {
+        if (_low.empty() || (_values[position] <= _values[_low.front()])) {
+            _push(_low, 0, position, Lower{});
+        } else {
+            _push(_high, High, position, Upper{});
+        }
+
+        _balance();
+    }
+
+    void _erase(Position position) {
+        const auto index = _index[position];
+        const auto at = index & ~High;
+
+        if (index & High) {
+            _remove(_high, High, at, Upper{});
+        } else {
+            _remove(_low, 0, at, Lower{});
+        }
+
+        _balance();
+    }
+
+    std::vector<double> _values {};
+    std::vector<Position> _index {};
+
+    std::vector<Position> _low {};
+    std::vector<Position> _high {};
 
-    std::vector<Value> _values {};
     size_t _size { 0 };
+    size_t _head { 0 };
+    size_t _count { 0 };
 };
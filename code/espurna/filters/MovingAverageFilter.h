@@ -8,10 +8,13 @@
 
 #include "BaseFilter.h"
 
-#include <cstdio>
+#include <algorithm>
 #include <vector>
 #include <numeric>
 
+// Values are stored in a fixed ring buffer, sum is updated with every value instead of
+// being re-calculated on every read. To avoid accumulating floating point errors, sum is
+// re-calculated once after the whole buffer is replaced
 class MovingAverageFilter : public BaseFilter {
 public:
     void update(double value) override {
@@ -19,52 +22,76 @@ public:
             return;
         }
 
-        if (_size == _values.size()) {
-            _values.erase(_values.begin());
+        if (_count < _size) {
+            _values[(_head + _count) % _size] = value;
+            _sum += value;
+            ++_count;
+            return;
         }
 
-        _values.push_back(value);
+        _sum += value - _values[_head];
+        _values[_head] = value;
+
+        _head = (_head + 1) % _size;
+        if (!_head) {
+            _sum = std::accumulate(_values.begin(), _values.end(), 0.0);
+        }
     }
 
     bool available() const override {
-        return _values.size() > 0;
+        return _count > 0;
     }
 
     bool ready() const override {
         return (_size > 0)
-            && (_values.size() == _size);
+            && (_count == _size);
     }
 
     double value() const override {
-        if (!_values.size()) {
+        if (!_count) {
             return 0.0;
         }
 
-        return std::accumulate(_values.begin(), _values.end(), 0.0)
-             / _values.size();
+        return _sum / _count;
     }
 
+    // Only the latest values are preserved when the buffer becomes smaller
     void resize(size_t size) override {
+        if (size == _size) {
+            return;
+        }
+
+        std::vector<double> values;
+        values.reserve(size);
+
+        const auto count = std::min(_count, size);
+        for (size_t index = _count - count; index < _count; ++index) {
+            values.push_back(_values[(_head + index) % _size]);
+        }
+
+        values.resize(size);
         if (!size) {
-            _values.clear();
-            _values.shrink_to_fit();
-        } else if (size < _size) {
-            _values.erase(
-                _values.begin(),
-                _values.begin() + (_size - size));
-            _values.shrink_to_fit();
-        } else if (size > _size) {
-            _values.reserve(size);
+            values.shrink_to_fit();
         }
 
+        _values = std::move(values);
         _size = size;
+        _head = 0;
+        _count = count;
+        _sum = std::accumulate(_values.begin(), _values.begin() + _count, 0.0);
     }
 
     void reset() override {
-        _values.clear();
+        _head = 0;
+        _count = 0;
+        _sum = 0.0;
     }
 
 private:
     std::vector<double> _values {};
+    double _sum { 0.0 };
+
     size_t _size { 0 };
+    size_t _head { 0 };
+    size_t _count { 0 };
 };
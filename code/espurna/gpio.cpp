@@ -277,6 +277,20 @@ void set(uint8_t pin, bool status) {
     reg_write(status ? GpioOutputSet : GpioOutputClear, (1 << pin));
 }
 
+// set and clear every masked pin at the same time, at most a single write for each register
+inline void write(uint32_t, uint32_t) __attribute__((always_inline));
+void write(uint32_t mask, uint32_t values) {
+    const auto set = mask & values;
+    if (set) {
+        reg_write(GpioOutputSet, set);
+    }
+
+    const auto clear = mask & ~values;
+    if (clear) {
+        reg_write(GpioOutputClear, clear);
+    }
+}
+
 inline bool get(uint8_t) __attribute__((always_inline));
 bool get(uint8_t pin) {
     return reg_read(GpioInput) & (1 << pin);
@@ -617,6 +631,14 @@ public:
         return std::make_unique<GpioPin>(pin);
     }
 
+    void write(uint32_t mask, uint32_t values) override {
+        if (mask & (1 << 16)) {
+            peripherals::rtc::gpio16_set((values & (1 << 16)) != 0);
+        }
+
+        peripherals::pin::write(mask & 0xffff, values);
+    }
+
 private:
     using Mask = std::bitset<Pins>;
 
@@ -869,6 +891,18 @@ String BasePin::description() const {
     return buffer;
 }
 
+void GpioBase::write(uint32_t mask, uint32_t values) {
+    const auto size = std::min(pins(), size_t{32});
+    for (size_t index = 0; index < size; ++index) {
+        if (mask & (1ul << index)) {
+            auto ptr = pin(index);
+            if (ptr) {
+                ptr->digitalWrite((values & (1ul << index)) ? HIGH : LOW);
+            }
+        }
+    }
+}
+
 GpioBase& hardwareGpio() {
     static espurna::gpio::Hardware gpio;
     return gpio;
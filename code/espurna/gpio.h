@@ -55,6 +55,10 @@ public:
     virtual void lock(unsigned char index, bool value) = 0;
     virtual bool valid(unsigned char index) const = 0;
     virtual BasePinPtr pin(unsigned char index) = 0;
+
+    // Change every pin in the mask at once, pin N is the Nth bit of both mask and values
+    // By default, same as calling digitalWrite() on every pin separately
+    virtual void write(uint32_t mask, uint32_t values);
 };
 
 GpioBase* gpioBase(GpioType);
@@ -26,6 +26,8 @@ Copyright (C) 2019-2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com
 
 #include "libs/fs_math.h"
 
+#include "light_transition.ipp"
+
 #if LIGHT_PROVIDER == LIGHT_PROVIDER_MY92XX
 #include <my92xx.h>
 #endif
@@ -85,6 +87,10 @@ constexpr bool gamma() {
     return 1 == LIGHT_USE_GAMMA;
 }
 
+constexpr float gammaExponent() {
+    return LIGHT_GAMMA_EXPONENT;
+}
+
 constexpr bool transition() {
     return 1 == LIGHT_USE_TRANSITIONS;
 }
@@ -97,6 +103,10 @@ constexpr espurna::duration::Milliseconds transitionStep() {
     return espurna::duration::Milliseconds(LIGHT_TRANSITION_STEP);
 }
 
+constexpr Easing transitionEasing() {
+    return static_cast<Easing>(LIGHT_TRANSITION_EASING);
+}
+
 constexpr bool save() {
     return 1 == LIGHT_SAVE_ENABLED;
 }
@@ -315,6 +325,10 @@ bool gamma() {
     return getSetting("useGamma", build::gamma());
 }
 
+float gammaExponent() {
+    return getSetting("ltGamma", build::gammaExponent());
+}
+
 bool transition() {
     return getSetting("useTransitions", build::transition());
 }
@@ -335,6 +349,10 @@ espurna::duration::Milliseconds transitionStep() {
     return getSetting("ltStep", build::transitionStep());
 }
 
+Easing transitionEasing() {
+    return getSetting("ltEasing", build::transitionEasing());
+}
+
 void transitionStep(espurna::duration::Milliseconds value) {
     setSetting("ltStep", value.count());
 }
@@ -347,6 +365,72 @@ espurna::duration::Milliseconds saveDelay() {
     return getSetting("ltSaveDelay", build::saveDelay());
 }
 
+String sceneName(size_t id) {
+    return getSetting({"ltScnName", id});
+}
+
+// Empty name removes the key, instead of keeping the one from the previously saved scene
+void sceneName(espurna::settings::Transaction& transaction, size_t id, const String& value) {
+    auto key = espurna::settings::Key(F("ltScnName"), id).value();
+    if (value.length()) {
+        transaction.set(std::move(key), value);
+    } else {
+        transaction.del(std::move(key));
+    }
+}
+
+String sceneChannels(size_t id) {
+    return getSetting({"ltScnCh", id});
+}
+
+void sceneChannels(espurna::settings::Transaction& transaction, size_t id, const String& value) {
+    transaction.set(espurna::settings::Key(F("ltScnCh"), id).value(), value);
+}
+
+long sceneBrightness(size_t id) {
+    return getSetting({"ltScnBri", id}, espurna::light::BrightnessMax);
+}
+
+void sceneBrightness(espurna::settings::Transaction& transaction, size_t id, long value) {
+    transaction.set(espurna::settings::Key(F("ltScnBri"), id).value(), espurna::settings::internal::serialize(value));
+}
+
+espurna::light::Mireds sceneMireds(size_t id) {
+    return getSetting(
+        {"ltScnMired", id},
+        espurna::light::Mireds{
+            .value = espurna::light::MiredsDefault
+        });
+}
+
+void sceneMireds(espurna::settings::Transaction& transaction, size_t id, espurna::light::Mireds value) {
+    transaction.set(espurna::settings::Key(F("ltScnMired"), id).value(), espurna::settings::internal::serialize(value.value));
+}
+
+bool sceneState(size_t id) {
+    return getSetting({"ltScnState", id}, true);
+}
+
+void sceneState(espurna::settings::Transaction& transaction, size_t id, bool value) {
+    transaction.set(espurna::settings::Key(F("ltScnState"), id).value(), espurna::settings::internal::serialize(value));
+}
+
+espurna::duration::Milliseconds sceneTime(size_t id) {
+    return getSetting({"ltScnTime", id}, transitionTime());
+}
+
+void sceneTime(espurna::settings::Transaction& transaction, size_t id, espurna::duration::Milliseconds value) {
+    transaction.set(espurna::settings::Key(F("ltScnTime"), id).value(), espurna::settings::internal::serialize(value.count()));
+}
+
+espurna::duration::Milliseconds sceneStep(size_t id) {
+    return getSetting({"ltScnStep", id}, transitionStep());
+}
+
+void sceneStep(espurna::settings::Transaction& transaction, size_t id, espurna::duration::Milliseconds value) {
+    transaction.set(espurna::settings::Key(F("ltScnStep"), id).value(), espurna::settings::internal::serialize(value.count()));
+}
+
 } // namespace settings
 } // namespace
 } // namespace light
@@ -372,6 +456,26 @@ public:
 
 namespace {
 
+static_assert((espurna::light::ValueMax - espurna::light::ValueMin) != 0, "");
+static_assert((espurna::light::OutputMax - espurna::light::OutputMin) != 0, "");
+
+// Channel input is scaled up to the output range before any processing happens,
+// so that brightness and white balance are not truncated to the 8bit input range
+long _lightOutputValue(long value) {
+    return (value - espurna::light::ValueMin)
+        * (espurna::light::OutputMax - espurna::light::OutputMin)
+        / (espurna::light::ValueMax - espurna::light::ValueMin)
+        + espurna::light::OutputMin;
+}
+
+// Reported values still use the input range
+long _lightReportValue(long value) {
+    constexpr auto Input = espurna::light::ValueMax - espurna::light::ValueMin;
+    constexpr auto Output = espurna::light::OutputMax - espurna::light::OutputMin;
+    return ((value - espurna::light::OutputMin) * Input + (Output / 2)) / Output
+        + espurna::light::ValueMin;
+}
+
 template <typename T>
 long _lightChainedValue(long input, const T& process) {
     return process(input);
@@ -398,32 +502,33 @@ struct LightChannel {
     }
 
     void apply() {
-        value = inputValue;
+        value = _lightOutputValue(inputValue);
     }
 
     template <typename T>
     void apply(const T& process) {
-        value = std::clamp(process(inputValue), espurna::light::ValueMin, espurna::light::ValueMax);
+        value = std::clamp(process(_lightOutputValue(inputValue)),
+            espurna::light::OutputMin, espurna::light::OutputMax);
     }
 
     template <typename T, typename... Args>
     void apply(const T& process, Args&&... args) {
         value = std::clamp(
-            _lightChainedValue(process(inputValue), std::forward<Args>(args)...),
-            espurna::light::ValueMin, espurna::light::ValueMax);
+            _lightChainedValue(process(_lightOutputValue(inputValue)), std::forward<Args>(args)...),
+            espurna::light::OutputMin, espurna::light::OutputMax);
     }
 
-    bool inverse { false };                // re-map the value from [ValueMin:ValueMax] to [ValueMax:ValueMin]
+    bool inverse { false };                // re-map the value from [OutputMin:OutputMax] to [OutputMax:OutputMin]
     bool gamma { false };                  // apply gamma correction to the target value
 
     // TODO: remove in favour of global control, since relays are no longer bound to a single channel?
     bool state { true };                   // is the channel ON
 
     long inputValue { espurna::light::ValueMin };   // raw, without the brightness
-    long value { espurna::light::ValueMin };        // normalized, including brightness
-    long target { espurna::light::ValueMin };       // resulting value that will be given to the provider
+    long value { espurna::light::OutputMin };       // normalized, including brightness. Output range
+    long target { espurna::light::OutputMin };      // resulting value that will be given to the provider, before gamma and inverse
 
-    float current { espurna::light::ValueMin };     // interim between input and target, used by the transition handler
+    long current { espurna::light::OutputMin };     // interim output between the previous and the current target, used by the transition handler
 };
 
 using LightChannels = std::vector<LightChannel>;
@@ -572,7 +677,7 @@ struct Mapping {
 private:
     static long get(LightChannel* ptr) {
         if (ptr) {
-            return ptr->target;
+            return _lightReportValue(ptr->target);
         }
 
         return espurna::light::ValueMin;
@@ -598,6 +703,22 @@ light::Mireds convert(const String& value) {
     return light::Mireds{ .value = convert<long>(value) };
 }
 
+template <>
+light::Easing convert(const String& value) {
+    PROGMEM_STRING(Linear, "linear");
+    PROGMEM_STRING(InOut, "in-out");
+    PROGMEM_STRING(Perceptual, "perceptual");
+
+    using Options = std::array<espurna::settings::options::Enumeration<light::Easing>, 3>;
+    static constexpr Options options {
+        {{light::Easing::Linear, Linear},
+         {light::Easing::InOut, InOut},
+         {light::Easing::Perceptual, Perceptual}}
+    };
+
+    return convert(options, value, espurna::light::build::transitionEasing());
+}
+
 #if LIGHT_PROVIDER == LIGHT_PROVIDER_MY92XX
 template <>
 my92xx_model_t convert(const String& value) {
@@ -683,6 +804,7 @@ bool _light_use_rgb = false;
 bool _light_use_white = false;
 bool _light_use_cct = false;
 bool _light_use_gamma = false;
+float _light_gamma_exponent { espurna::light::build::gammaExponent() };
 
 bool _light_state = false;
 
@@ -881,11 +1003,12 @@ void _lightValuesWithBrightnessExceptWhite(LightChannels& channels) {
 
 // Reset inputValue directly in the expression
 // Ignores all previous values, should only be used at the beginning
+// Value is expected to be in the input range, factors are scaled to the output range directly
 
 struct LightResetInput {
     LightResetInput() = delete;
     explicit LightResetInput(long value) :
-        _value(value)
+        _value(_lightOutputValue(value))
     {}
 
     long operator()(long) const {
@@ -894,15 +1017,22 @@ struct LightResetInput {
 
     // 0.0 is the 'coldest', 1.0 is the 'warmest'
     static LightResetInput forWarm(float factor) {
-        return LightResetInput(factor * espurna::light::ValueMax);
+        return LightResetInput(Output{}, factor);
     }
 
     // opposite value of `forWarm` for the given factor
     static LightResetInput forCold(float factor) {
-        return LightResetInput((1.0f - factor) * espurna::light::ValueMax);
+        return LightResetInput(Output{}, 1.0f - factor);
     }
 
 private:
+    struct Output {
+    };
+
+    LightResetInput(Output, float factor) :
+        _value(std::lround(factor * espurna::light::OutputMax))
+    {}
+
     long _value;
 };
 
@@ -971,7 +1101,7 @@ struct LightRgbWithoutWhite {
     {}
 
     long operator()(long input) const {
-        return std::lround(static_cast<float>(input - _common.inputMin) * _factor);
+        return std::lround(static_cast<float>(input - _lightOutputValue(_common.inputMin)) * _factor);
     }
 
     template <typename... Args>
@@ -1566,103 +1696,49 @@ void _lightAdjustMireds(espurna::StringView payload) {
 
 namespace {
 
-// Gamma Correction lookup table (8 bit, ~2.2)
-// TODO: input value modifier, instead of a transition-only thing?
-// TODO: calculate on the fly instead of limiting this to an 8bit value?
-
-static constexpr long LightGammaMin { 0 };
-static constexpr long LightGammaMax { 255 };
-
-long _lightGammaValue(size_t index) {
-    static const std::array<uint8_t, 256> Gamma PROGMEM {
-        0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
-        1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,
-        3,   3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,
-        6,   7,   7,   7,   7,   8,   8,   8,   9,   9,   9,   10,  10,  11,  11,  11,
-        12,  12,  13,  13,  14,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,
-        19,  20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,
-        29,  30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,
-        41,  42,  43,  43,  44,  45,  46,  47,  48,  49,  50,  50,  51,  52,  53,  54,
-        55,  56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  71,
-        72,  73,  74,  75,  76,  77,  78,  80,  81,  82,  83,  84,  86,  87,  88,  89,
-        91,  92,  93,  94,  96,  97,  98,  100, 101, 102, 104, 105, 106, 108, 109, 110,
-        112, 113, 115, 116, 118, 119, 121, 122, 123, 125, 126, 128, 130, 131, 133, 134,
-        136, 137, 139, 140, 142, 144, 145, 147, 149, 150, 152, 154, 155, 157, 159, 160,
-        162, 164, 166, 167, 169, 171, 173, 175, 176, 178, 180, 182, 184, 186, 187, 189,
-        191, 193, 195, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
-        223, 225, 227, 229, 231, 233, 235, 238, 240, 242, 244, 246, 248, 251, 253, 255
-    };
-
-    if (index < Gamma.size()) {
-        return pgm_read_byte(&Gamma[index]);
-    }
-
-    return 0;
-}
-
+// Gamma correction is calculated directly in the output range, instead of using a 8bit lookup table
+// Only happens when channel target changes, so there's no need to keep the whole curve in memory
 long _lightGammaMap(long value) {
-    static_assert(espurna::light::ValueMin >= 0, "");
-    static_assert(espurna::light::ValueMax >= 0, "");
+    constexpr auto Output = static_cast<double>(espurna::light::OutputMax - espurna::light::OutputMin);
 
-    constexpr auto Divisor = (espurna::light::ValueMax - espurna::light::ValueMin);
-    if (Divisor != 0l) {
-        const long Scaled {
-            (value - espurna::light::ValueMin) * (LightGammaMax - LightGammaMin) / Divisor + LightGammaMin };
-        return _lightGammaValue(static_cast<size_t>(Scaled));
+    const auto ratio = static_cast<double>(value - espurna::light::OutputMin) / Output;
+    if (ratio <= 0.0) {
+        return espurna::light::OutputMin;
     }
 
-    return espurna::light::ValueMin;
+    return std::lround(fs_pow(ratio, _light_gamma_exponent) * Output) + espurna::light::OutputMin;
 }
 
 class LightTransitionHandler {
 public:
-    // internal calculations are done in floats, so hard-limit target & step time to a certain value
-    // that can be representend precisely when casting milliseconds times back and forth
-    static constexpr espurna::duration::Milliseconds TimeMin { 10 };
-    static constexpr espurna::duration::Milliseconds TimeMax { 1ul << 24ul };
-
-    struct Transition {
-        float& value;
-        long target;
-        float step;
-        size_t count;
-    };
+    using TimeSource = espurna::time::CoreClock;
+    using Duration = espurna::duration::Milliseconds;
+    using Engine = espurna::light::transition::Engine<Duration>;
 
-    using Transitions = std::vector<Transition>;
+    // step time only controls how often provider is updated, output values depend on the elapsed time
+    // hard-limit both, so the fixed-point progress calculation never overflows
+    static constexpr Duration TimeMin { 10 };
+    static constexpr Duration TimeMax { 1ul << 24ul };
 
     LightTransitionHandler() = delete;
 
-    LightTransitionHandler(LightChannels& channels, LightTransition transition, bool state) :
+    LightTransitionHandler(LightChannels& channels, LightTransition transition, espurna::light::Easing easing, bool state) :
+        _engine(espurna::light::OutputMin, espurna::light::OutputMax),
         _transition(clamp(transition)),
+        _start(TimeSource::now()),
         _state(state)
     {
-        prepare(channels, transition, state);
+        prepare(channels, easing, state);
     }
 
     template <typename StateFunc, typename ValueFunc, typename UpdateFunc>
     bool run(StateFunc&& state, ValueFunc&& value, UpdateFunc&& update) {
-        bool next { false };
-
         if (!_state_notified && _state) {
             _state_notified = true;
             state(_state);
         }
 
-        for (size_t index = 0; index < _prepared.size(); ++index) {
-            auto& transition = _prepared[index];
-            if (!transition.count) {
-                continue;
-            }
-
-            if (--transition.count) {
-                transition.value += transition.step;
-                next = true;
-            } else {
-                transition.value = transition.target;
-            }
-
-            value(index, transition.value);
-        }
+        const auto next = _engine.run(TimeSource::now() - _start, value);
 
         if (!_state_notified && !next && !_state) {
             _state_notified = true;
@@ -1674,19 +1750,19 @@ public:
         return next;
     }
 
-    const Transitions& prepared() const {
-        return _prepared;
+    const Engine::Channels& prepared() const {
+        return _engine.channels();
     }
 
     bool state() const {
         return _state;
     }
 
-    espurna::duration::Milliseconds time() const {
+    Duration time() const {
         return _transition.time;
     }
 
-    espurna::duration::Milliseconds step() const {
+    Duration step() const {
         return _transition.step;
     }
 
@@ -1696,81 +1772,44 @@ private:
         _transition.step = TimeMin;
     }
 
-    void prepare(LightChannels& channels, LightTransition transition, bool state) {
+    void prepare(LightChannels& channels, espurna::light::Easing easing, bool state) {
         // generate a single transitions list for all the channels that had changed
         // after that, provider loop will run() the list and assign intermediate target value(s)
-        bool delayed { false };
+        const auto duration = isImmediate(_transition)
+            ? Duration::zero()
+            : _transition.time;
+
         for (auto& channel : channels) {
-            if (prepare(channel, transition, state)) {
-                delayed = true;
-            }
+            _engine.push(channel.current, prepare(channel, state), duration, easing);
         }
 
         // target values are already assigned, next provider loop will apply them
-        if (!delayed) {
+        if (!_engine.gradual()) {
             minimalTime();
         }
     }
 
-    bool prepare(LightChannel& channel, const LightTransition& transition, bool state) {
+    static long prepare(LightChannel& channel, bool state) {
         long target = (state && channel.state)
             ? channel.value
-            : espurna::light::ValueMin;
+            : espurna::light::OutputMin;
 
         channel.target = target;
+
         if (channel.gamma) {
             target = _lightGammaMap(target);
         }
 
         if (channel.inverse) {
-            target = espurna::light::ValueMax - target;
-        }
-
-        const float Diff { static_cast<float>(target) - channel.current };
-        if (!isImmediate(transition, Diff)) {
-            pushGradual(transition, channel.current, target, Diff);
-            return true;
-        }
-
-        pushImmediate(channel.current, target, Diff);
-        return false;
-    }
-
-    void push(float& current, long target, float diff, size_t count) {
-        _prepared.push_back(
-            Transition{
-                .value = current,
-                .target = target,
-                .step = diff,
-                .count = count,
-            });
-    }
-
-    void pushImmediate(float& current, long target, float diff) {
-        push(current, target, diff, 1);
-    }
-
-    void pushGradual(const LightTransition& transition, float& current, long target, float diff) {
-        const auto TotalTime = static_cast<float>(transition.time.count());
-        const auto StepTime = static_cast<float>(transition.step.count());
-
-        constexpr float BaseStep { 1.0f };
-        const float Diff { std::abs(diff) };
-        const float Every { TotalTime / Diff };
-
-        float step { (diff > 0.0f) ? BaseStep : -BaseStep };
-        if (Every < StepTime) {
-            step *= (StepTime / Every);
+            target = espurna::light::OutputMax - target;
         }
 
-        const float Count { std::floor(Diff / std::abs(step)) };
-        push(current, target, step, static_cast<size_t>(Count));
+        return target;
     }
 
-    static bool isImmediate(const LightTransition& transition, float diff) {
+    static bool isImmediate(const LightTransition& transition) {
         return !transition.time.count()
-            || (transition.step >= transition.time)
-            || (std::abs(diff) <= std::numeric_limits<float>::epsilon());
+            || (transition.step >= transition.time);
     }
 
     static LightTransition clamp(LightTransition value) {
@@ -1780,10 +1819,11 @@ private:
         return out;
     }
 
-    Transitions _prepared;
+    Engine _engine;
     bool _state_notified { false };
 
     LightTransition _transition;
+    TimeSource::time_point _start;
     bool _state;
 };
 
@@ -1901,12 +1941,15 @@ std::unique_ptr<LightTransitionHandler> _light_transition;
 auto _light_transition_time = espurna::light::build::transitionTime();
 auto _light_transition_step = espurna::light::build::transitionStep();
 bool _light_use_transitions = false;
+auto _light_transition_easing = espurna::light::build::transitionEasing();
 
-static_assert((espurna::light::ValueMax - espurna::light::ValueMin) != 0, "");
-
+// Transitions run in the output range, every provider converts the value into its own range right here
 template <typename T>
-constexpr T _lightValueMap(long value, T min, T max) {
-    return (value - espurna::light::ValueMin) * (max - min) / (espurna::light::ValueMax - espurna::light::ValueMin) + min;
+T _lightOutputMap(long value, T min, T max) {
+    const auto output = std::clamp(value,
+        espurna::light::OutputMin, espurna::light::OutputMax);
+    return static_cast<T>(output - espurna::light::OutputMin) * (max - min)
+        / static_cast<T>(espurna::light::OutputMax - espurna::light::OutputMin) + min;
 }
 
 #if LIGHT_PROVIDER == LIGHT_PROVIDER_DIMMER
@@ -1925,8 +1968,8 @@ void _lightProviderHandleState(bool) {
 // using two external values which are then used in integer divison
 // TODO: actually check call speed?
 // TODO: any difference between __fixsfsi and lround?
-void _lightProviderHandleValue(size_t channel, float value) {
-    pwmDuty(channel, _lightValueMap(value, _light_pwm_min, _light_pwm_max));
+void _lightProviderHandleValue(size_t channel, long value) {
+    pwmDuty(channel, _lightOutputMap(value, _light_pwm_min, _light_pwm_max));
 }
 
 void _lightProviderHandleUpdate() {
@@ -1956,10 +1999,10 @@ constexpr unsigned int _my92xx_value_min = 0;
 constexpr unsigned int _my92xx_value_max =
         _lightMy92xxValueMax(espurna::light::build::my92xxCommand());
 
-void _lightProviderHandleValue(size_t channel, float value) {
+void _lightProviderHandleValue(size_t channel, long value) {
     _my92xx->setChannel(
         _light_my92xx_channel_map[channel],
-        _lightValueMap(value, _my92xx_value_min, _my92xx_value_max));
+        _lightOutputMap(value, _my92xx_value_min, _my92xx_value_max));
 }
 
 void _lightProviderHandleUpdate() {
@@ -1976,8 +2019,13 @@ void _lightProviderHandleState(bool state) {
     _light_provider->state(state);
 }
 
-void _lightProviderHandleValue(size_t channel, float value) {
-    _light_provider->channel(channel, value);
+// Custom providers still expect the input range, but fractional values are preserved
+void _lightProviderHandleValue(size_t channel, long value) {
+    constexpr auto Scale =
+        static_cast<float>(espurna::light::ValueMax - espurna::light::ValueMin)
+        / static_cast<float>(espurna::light::OutputMax - espurna::light::OutputMin);
+    _light_provider->channel(channel,
+        static_cast<float>(value - espurna::light::OutputMin) * Scale + espurna::light::ValueMin);
 }
 
 void _lightProviderHandleUpdate() {
@@ -2193,6 +2241,223 @@ bool _lightTryParseChannel(espurna::StringView value, size_t& id) {
 
 } // namespace
 
+// -----------------------------------------------------------------------------
+// SCENES
+// -----------------------------------------------------------------------------
+
+namespace {
+
+// Complete input state of the light, same as the one stored in the settings and the RTCMEM
+// Output values are prepared when scenes are loaded, so recall only needs to copy them back
+struct LightScene {
+    LightValues inputs{};
+    LightValues values{};
+    long brightness { espurna::light::BrightnessMax };
+    espurna::light::Mireds mireds { espurna::light::MiredsDefault };
+    LightTransition transition{};
+    bool state { true };
+};
+
+using LightScenes = std::vector<LightScene>;
+LightScenes _light_scenes;
+
+constexpr size_t LightSceneNone { espurna::light::ScenesMax };
+
+size_t _light_scene_pending { LightSceneNone };
+size_t _light_scene_last { LightSceneNone };
+
+bool _lightSceneMatches(const LightScene& scene, const LightChannels& channels) {
+    for (size_t index = 0; index < channels.size(); ++index) {
+        if (channels[index].inputValue != scene.inputs[index]) {
+            return false;
+        }
+    }
+
+    return (_light_brightness.value() == scene.brightness)
+        && (_light_temperature.mireds().value == scene.mireds.value);
+}
+
+// Recalled scene values are used as-is, unless something else had changed the inputs before the update
+void _lightProcessInputValues(LightChannels& channels) {
+    const auto id = _light_scene_pending;
+    _light_scene_pending = LightSceneNone;
+
+    if ((id < _light_scenes.size()) && _lightSceneMatches(_light_scenes[id], channels)) {
+        const auto& values = _light_scenes[id].values;
+        for (size_t index = 0; index < channels.size(); ++index) {
+            channels[index].value = values[index];
+        }
+
+        _light_scene_last = id;
+        return;
+    }
+
+    _light_process_input_values(channels);
+
+    if ((_light_scene_last < _light_scenes.size())
+        && !_lightSceneMatches(_light_scenes[_light_scene_last], channels))
+    {
+        _light_scene_last = LightSceneNone;
+    }
+}
+
+// Processing functions depend on the global brightness and temperature, which are restored afterwards
+void _lightScenesPrepare() {
+    const auto brightness = _light_brightness;
+    const auto temperature = _light_temperature;
+
+    auto channels = _light_channels;
+    for (auto& scene : _light_scenes) {
+        for (size_t index = 0; index < channels.size(); ++index) {
+            channels[index] = scene.inputs[index];
+            scene.inputs[index] = channels[index].inputValue;
+        }
+
+        _light_brightness = scene.brightness;
+        scene.brightness = _light_brightness.value();
+
+        _light_temperature = scene.mireds;
+        scene.mireds = _light_temperature.mireds();
+
+        _light_process_input_values(channels);
+        for (size_t index = 0; index < channels.size(); ++index) {
+            scene.values[index] = channels[index].value;
+        }
+    }
+
+    _light_brightness = brightness;
+    _light_temperature = temperature;
+}
+
+LightScene _lightSceneFromSettings(size_t id, espurna::StringView channels) {
+    LightScene out;
+
+    auto it = out.inputs.begin();
+    auto split = espurna::SplitStringView(channels, ',');
+    while (split.next() && (it != out.inputs.end())) {
+        const auto result = parseUnsigned(split.current(), 10);
+        if (!result.ok) {
+            break;
+        }
+
+        (*it) = result.value;
+        ++it;
+    }
+
+    out.brightness = espurna::light::settings::sceneBrightness(id);
+    out.mireds = espurna::light::settings::sceneMireds(id);
+    out.transition = LightTransition{
+        .time = espurna::light::settings::sceneTime(id),
+        .step = espurna::light::settings::sceneStep(id),
+    };
+    out.state = espurna::light::settings::sceneState(id);
+
+    return out;
+}
+
+// Scenes are stored sequentially, loading stops at the first one without any channel values
+void _lightScenesConfigure() {
+    _light_scene_pending = LightSceneNone;
+    _light_scene_last = LightSceneNone;
+
+    _light_scenes.clear();
+    for (size_t id = 0; id < espurna::light::ScenesMax; ++id) {
+        const auto channels = espurna::light::settings::sceneChannels(id);
+        if (!channels.length()) {
+            break;
+        }
+
+        _light_scenes.push_back(_lightSceneFromSettings(id, channels));
+    }
+
+    _lightScenesPrepare();
+}
+
+bool _lightSceneRecall(size_t id, int report, bool save) {
+    if (id >= _light_scenes.size()) {
+        return false;
+    }
+
+    const auto& scene = _light_scenes[id];
+    for (size_t index = 0; index < _light_channels.size(); ++index) {
+        _light_channels[index].inputValue = scene.inputs[index];
+    }
+
+    _light_brightness = scene.brightness;
+    _light_temperature = scene.mireds;
+    lightState(scene.state);
+
+    _light_scene_pending = id;
+    lightUpdate(scene.transition, report, save);
+
+    return true;
+}
+
+bool _lightSceneRecall(size_t id) {
+    return _lightSceneRecall(id, espurna::light::Report::Default, _light_save);
+}
+
+bool _lightSceneRecall(espurna::StringView payload, int report, bool save) {
+    const auto result = parseUnsigned(payload, 10);
+    return result.ok && _lightSceneRecall(result.value, report, save);
+}
+
+// Scene is either replaced or appended to the end of the list, there could be no gaps between them
+bool _lightSceneSave(size_t id, espurna::StringView name) {
+    if ((id > _light_scenes.size()) || (id >= espurna::light::ScenesMax)) {
+        return false;
+    }
+
+    LightScene scene;
+
+    String channels;
+    for (size_t index = 0; index < _light_channels.size(); ++index) {
+        scene.inputs[index] = _light_channels[index].inputValue;
+        if (index) {
+            channels += ',';
+        }
+        channels += String(scene.inputs[index], 10);
+    }
+
+    scene.brightness = _light_brightness.value();
+    scene.mireds = _light_temperature.mireds();
+    scene.transition = lightTransition();
+    scene.state = _light_state;
+
+    // every key is written at once, storage is only committed a single time
+    espurna::settings::Transaction transaction;
+
+    using namespace espurna::light::settings;
+    sceneChannels(transaction, id, channels);
+    sceneBrightness(transaction, id, scene.brightness);
+    sceneMireds(transaction, id, scene.mireds);
+    sceneTime(transaction, id, scene.transition.time);
+    sceneStep(transaction, id, scene.transition.step);
+    sceneState(transaction, id, scene.state);
+    sceneName(transaction, id, name.toString());
+
+    transaction.commit();
+
+    if (id < _light_scenes.size()) {
+        _light_scenes[id] = scene;
+    } else {
+        _light_scenes.push_back(scene);
+    }
+
+    _lightScenesPrepare();
+    _light_scene_last = id;
+
+    return true;
+}
+
+String _lightScenePayload() {
+    return (_light_scene_last < _light_scenes.size())
+        ? String(_light_scene_last, 10)
+        : String();
+}
+
+} // namespace
+
 // -----------------------------------------------------------------------------
 // MQTT
 // -----------------------------------------------------------------------------
@@ -2249,6 +2514,7 @@ void _lightMqttCallback(unsigned int type, espurna::StringView topic, espurna::S
     if (type == MQTT_CONNECT_EVENT) {
 
         mqttSubscribe(MQTT_TOPIC_TRANSITION);
+        mqttSubscribe(MQTT_TOPIC_SCENE);
 
         mqttSubscribe(MQTT_TOPIC_CHANNEL "/+");
         mqttSubscribe(MQTT_TOPIC_BRIGHTNESS);
@@ -2270,80 +2536,85 @@ void _lightMqttCallback(unsigned int type, espurna::StringView topic, espurna::S
         }
     }
 
+    // Group color
     if (type == MQTT_MESSAGE_EVENT) {
-        // Group color
         if ((mqtt_group_color.length() > 0) && (topic == mqtt_group_color)) {
             _lightFromCommaSeparatedPayload(payload);
             _lightUpdateFromMqttGroup();
-            return;
         }
+    }
+}
 
-        // Match topic
-        auto t = mqttMagnitude(topic);
-
-        // Color temperature in mireds
-        if (t.equals(MQTT_TOPIC_MIRED)) {
-            _lightAdjustMireds(payload);
-            _lightUpdateFromMqtt();
-            return;
-        }
+// Everything else is handled by the routes below
 
-        // Color temperature in kelvins
-        if (t.equals(MQTT_TOPIC_KELVIN)) {
-            _lightAdjustKelvin(payload);
-            _lightUpdateFromMqtt();
-            return;
-        }
+// Color temperature in mireds
+void _lightMqttMireds(const espurna::mqtt::Match&, espurna::StringView payload) {
+    _lightAdjustMireds(payload);
+    _lightUpdateFromMqtt();
+}
 
-        // Color
-        if (t.equals(MQTT_TOPIC_COLOR_RGB) || t.equals(MQTT_TOPIC_COLOR_HEX)) {
-            _lightFromRgbPayload(payload);
-            _lightUpdateFromMqtt();
-            return;
-        }
+// Color temperature in kelvins
+void _lightMqttKelvin(const espurna::mqtt::Match&, espurna::StringView payload) {
+    _lightAdjustKelvin(payload);
+    _lightUpdateFromMqtt();
+}
 
-        if (t.equals(MQTT_TOPIC_COLOR_HSV)) {
-            _lightFromHsvPayload(payload);
-            _lightUpdateFromMqtt();
-            return;
-        }
+// Color
+void _lightMqttRgb(const espurna::mqtt::Match&, espurna::StringView payload) {
+    _lightFromRgbPayload(payload);
+    _lightUpdateFromMqtt();
+}
 
-        // Transition setting (persist)
-        if (t.equals(MQTT_TOPIC_TRANSITION)) {
-            _lightApiTransition(payload);
-            return;
-        }
+void _lightMqttHsv(const espurna::mqtt::Match&, espurna::StringView payload) {
+    _lightFromHsvPayload(payload);
+    _lightUpdateFromMqtt();
+}
 
-        // Brightness
-        if (t.equals(MQTT_TOPIC_BRIGHTNESS)) {
-            _lightAdjustBrightness(payload);
-            _lightUpdateFromMqtt();
-            return;
-        }
+// Transition setting (persist)
+void _lightMqttTransition(const espurna::mqtt::Match&, espurna::StringView payload) {
+    _lightApiTransition(payload);
+}
 
-        // Channel
-        if (t.startsWith(MQTT_TOPIC_CHANNEL)) {
-            size_t id;
-            if (_lightTryParseChannel(t, id)) {
-                _lightAdjustChannel(id, payload);
-                _lightUpdateFromMqtt();
-            }
-            return;
-        }
+// Scene recall, by index
+void _lightMqttScene(const espurna::mqtt::Match&, espurna::StringView payload) {
+    _lightSceneRecall(payload, _lightMqttReportMask(), _light_save);
+}
 
-        // Global
-        if (t.equals(MQTT_TOPIC_LIGHT)) {
-            _lightParsePayload(payload);
-            _lightUpdateFromMqtt();
-        }
+// Brightness
+void _lightMqttBrightness(const espurna::mqtt::Match&, espurna::StringView payload) {
+    _lightAdjustBrightness(payload);
+    _lightUpdateFromMqtt();
+}
 
+// Channel
+void _lightMqttChannel(const espurna::mqtt::Match& match, espurna::StringView payload) {
+    size_t id;
+    if (_lightTryParseChannel(match[0], id)) {
+        _lightAdjustChannel(id, payload);
+        _lightUpdateFromMqtt();
     }
+}
 
+// Global
+void _lightMqttLight(const espurna::mqtt::Match&, espurna::StringView payload) {
+    _lightParsePayload(payload);
+    _lightUpdateFromMqtt();
 }
 
 void _lightMqttSetup() {
     mqttHeartbeat(_lightMqttHeartbeat);
     mqttRegister(_lightMqttCallback);
+
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_MIRED), _lightMqttMireds);
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_KELVIN), _lightMqttKelvin);
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_COLOR_RGB), _lightMqttRgb);
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_COLOR_HEX), _lightMqttRgb);
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_COLOR_HSV), _lightMqttHsv);
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_TRANSITION), _lightMqttTransition);
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_SCENE), _lightMqttScene);
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_BRIGHTNESS), _lightMqttBrightness);
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_CHANNEL "/+"), _lightMqttChannel);
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_LIGHT), _lightMqttLight);
 }
 
 } // namespace
@@ -2362,7 +2633,7 @@ void lightMQTT() {
     }
 
     for (size_t channel = 0; channel < _light_channels.size(); ++channel) {
-        mqttSend(MQTT_TOPIC_CHANNEL, channel, String(_light_channels[channel].target, 10).c_str());
+        mqttSend(MQTT_TOPIC_CHANNEL, channel, String(_lightReportValue(_light_channels[channel].target), 10).c_str());
     }
 
     mqttSend(MQTT_TOPIC_BRIGHTNESS, _light_brightness.toString().c_str());
@@ -2488,7 +2759,7 @@ void _lightApiSetup() {
     apiRegister(F(MQTT_TOPIC_CHANNEL "/+"),
         [](ApiRequest& request) {
             return _lightApiTryHandle(request, [&](size_t id) {
-                request.send(String(_light_channels[id].target));
+                request.send(String(_lightReportValue(_light_channels[id].target)));
                 return true;
             });
         },
@@ -2512,6 +2783,17 @@ void _lightApiSetup() {
             return true;
         }
     );
+
+    apiRegister(F(MQTT_TOPIC_SCENE),
+        [](ApiRequest& request) {
+            request.send(_lightScenePayload());
+            return true;
+        },
+        [](ApiRequest& request) {
+            return _lightSceneRecall(request.param(F("value")),
+                espurna::light::Report::Default, _light_save);
+        }
+    );
 }
 
 } // namespace
@@ -2587,12 +2869,14 @@ void _lightWebSocketOnConnected(JsonObject& root) {
     root["useCCT"] = _light_use_cct;
     root["useColor"] = _light_use_color;
     root["useGamma"] = _light_use_gamma;
+    root["ltGamma"] = _light_gamma_exponent;
     root["useRGB"] = _light_use_rgb;
     root["useTransitions"] = _light_use_transitions;
     root["ltSave"] = _light_save;
     root["ltSaveDelay"] = _light_save_delay.count();
     root["ltTime"] = _light_transition_time.count();
     root["ltStep"] = _light_transition_step.count();
+    root["ltEasing"] = static_cast<int>(_light_transition_easing);
 }
 
 void _lightWebSocketOnAction(uint32_t client_id, const char* action, JsonObject& data) {
@@ -2816,13 +3100,13 @@ static void _lightCommandChannel(::terminal::CommandContext&& ctx) {
     }
 
     auto description = [&](size_t channel) {
-        ctx.output.printf_P(PSTR("#%zu (%s) input:%ld value:%ld target:%ld current:%s\n"),
+        ctx.output.printf_P(PSTR("#%zu (%s) input:%ld value:%ld target:%ld current:%ld\n"),
                 channel,
                 _lightDesc(Channels, channel),
                 _light_channels[channel].inputValue,
                 _light_channels[channel].value,
                 _light_channels[channel].target,
-                String(_light_channels[channel].current, 2).c_str());
+                _light_channels[channel].current);
     };
 
     if (ctx.argv.size() > 2) {
@@ -2906,6 +3190,51 @@ static void _lightCommandMired(::terminal::CommandContext&& ctx) {
     terminalOK(ctx);
 }
 
+PROGMEM_STRING(LightCommandScene, "LIGHT.SCENE");
+
+static void _lightCommandScene(::terminal::CommandContext&& ctx) {
+    if (ctx.argv.size() > 1) {
+        if (!_lightSceneRecall(ctx.argv[1], espurna::light::Report::Default, _light_save)) {
+            terminalError(ctx, F("Invalid scene ID"));
+            return;
+        }
+
+        terminalOK(ctx);
+        return;
+    }
+
+    for (size_t id = 0; id < _light_scenes.size(); ++id) {
+        const auto& scene = _light_scenes[id];
+        ctx.output.printf_P(PSTR("%c#%zu \"%s\" brightness:%ld mireds:%ld state:%s time:%u (ms)\n"),
+            (id == _light_scene_last) ? '*' : ' ', id,
+            espurna::light::settings::sceneName(id).c_str(),
+            scene.brightness, scene.mireds.value,
+            scene.state ? PSTR("ON") : PSTR("OFF"),
+            scene.transition.time.count());
+    }
+
+    terminalOK(ctx);
+}
+
+PROGMEM_STRING(LightCommandSceneSave, "LIGHT.SCENE.SAVE");
+
+static void _lightCommandSceneSave(::terminal::CommandContext&& ctx) {
+    if (ctx.argv.size() < 2) {
+        terminalError(ctx, F("LIGHT.SCENE.SAVE <ID> [<NAME>]"));
+        return;
+    }
+
+    const auto result = parseUnsigned(ctx.argv[1], 10);
+    if (!result.ok || !_lightSceneSave(result.value,
+            (ctx.argv.size() > 2) ? espurna::StringView(ctx.argv[2]) : espurna::StringView()))
+    {
+        terminalError(ctx, F("Invalid scene ID"));
+        return;
+    }
+
+    terminalOK(ctx);
+}
+
 static constexpr ::terminal::Command Commands[] PROGMEM {
     {LightCommandNotify, _lightCommandNotify},
     {LightCommand, _lightCommand},
@@ -2915,6 +3244,8 @@ static constexpr ::terminal::Command Commands[] PROGMEM {
     {LightCommandHsv, _lightCommandHsv},
     {LightCommandKelvin, _lightCommandKelvin},
     {LightCommandMired, _lightCommandMired},
+    {LightCommandScene, _lightCommandScene},
+    {LightCommandSceneSave, _lightCommandSceneSave},
 };
 
 void _lightInitCommands() {
@@ -2928,6 +3259,18 @@ size_t lightChannels() {
     return _light_channels.size();
 }
 
+size_t lightScenes() {
+    return _light_scenes.size();
+}
+
+bool lightSceneRecall(size_t id) {
+    return _lightSceneRecall(id);
+}
+
+bool lightSceneSave(size_t id) {
+    return _lightSceneSave(id, espurna::StringView());
+}
+
 bool lightHasWhite() {
     return _light_has_cold_white || _light_has_warm_white;
 }
@@ -3021,10 +3364,9 @@ void _lightUpdateDebug(const LightTransitionHandler& handler) {
     }
 
     for (auto& transition : handler.prepared()) {
-        if (transition.count > 1) {
-            DEBUG_MSG_P(PSTR("[LIGHT] Transition from %s to %ld (step %s, %u times)\n"),
-                    String(transition.value, 2).c_str(), transition.target,
-                    String(transition.step, 2).c_str(), transition.count);
+        if (transition.duration.count()) {
+            DEBUG_MSG_P(PSTR("[LIGHT] Transition from %ld to %ld in %u (ms)\n"),
+                    transition.from, transition.target, transition.duration.count());
         }
     }
 }
@@ -3084,7 +3426,7 @@ void _lightUpdate() {
     }
 
     LightValuesObserver observer(_light_channels);
-    _light_process_input_values(_light_channels);
+    _lightProcessInputValues(_light_channels);
 
     if (!_light_state_changed && !observer.changed()) {
         _light_update.cancel();
@@ -3095,7 +3437,8 @@ void _lightUpdate() {
     _light_update.run([](LightTransition transition, int report, bool save) {
         // Channel output values will be set by the handler class and the specified provider
         // We either set the values immediately or schedule an ongoing transition
-        _light_transition = std::make_unique<LightTransitionHandler>(_light_channels, transition, _light_state);
+        _light_transition = std::make_unique<LightTransitionHandler>(
+            _light_channels, transition, _light_transition_easing, _light_state);
         _light_provider_update.start(_light_transition->step());
         _lightUpdateDebug(*_light_transition);
 
@@ -3422,11 +3765,17 @@ void _lightConfigure() {
     _light_use_transitions = espurna::light::settings::transition();
     _light_transition_time = espurna::light::settings::transitionTime();
     _light_transition_step = espurna::light::settings::transitionStep();
+    _light_transition_easing = espurna::light::settings::transitionEasing();
 
     _light_save = espurna::light::settings::save();
     _light_save_delay = espurna::light::settings::saveDelay();
 
     _light_use_gamma = espurna::light::settings::gamma();
+
+    const auto gamma_exponent = espurna::light::settings::gammaExponent();
+    _light_gamma_exponent = (gamma_exponent > 0.0f)
+        ? gamma_exponent
+        : espurna::light::build::gammaExponent();
     for (size_t index = 0; index < Channels; ++index) {
 #if LIGHT_PROVIDER == LIGHT_PROVIDER_MY92XX
         _light_my92xx_channel_map[index] = espurna::light::settings::my92xxChannel(index);
@@ -3453,6 +3802,8 @@ void _lightConfigure() {
     if (!_light_update && (last_process_input_values != process_input_values)) {
         lightUpdate(false);
     }
+
+    _lightScenesConfigure();
 }
 
 void _lightSleepSetup() {
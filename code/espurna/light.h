@@ -18,20 +18,25 @@
 #define MQTT_TOPIC_MIRED            "mired"
 #define MQTT_TOPIC_KELVIN           "kelvin"
 #define MQTT_TOPIC_TRANSITION       "transition"
+#define MQTT_TOPIC_SCENE            "scene"
 
 namespace espurna {
 namespace light {
 
 constexpr size_t ChannelsMax { 5 };
+constexpr size_t ScenesMax { LIGHT_SCENES_MAX };
 
 constexpr long ValueStep { LIGHT_STEP };
 
-// TODO: separate internal and external scaling?
-// TODO: allow wider value range than just 8bit?
-
 constexpr long ValueMin { LIGHT_MIN_VALUE };
 constexpr long ValueMax { LIGHT_MAX_VALUE };
 
+// Internal 16bit range of the channel value. Inputs are scaled up to it before brightness and the
+// rest of processing, gamma and inverse are applied in it as well. Transitions always step through it,
+// and providers convert it into their native range
+constexpr long OutputMin { 0 };
+constexpr long OutputMax { 0xffff };
+
 constexpr long BrightnessMin { LIGHT_MIN_BRIGHTNESS };
 constexpr long BrightnessMax { LIGHT_MAX_BRIGHTNESS };
 
@@ -196,6 +201,12 @@ espurna::duration::Milliseconds lightTransitionStep();
 void lightTransition(espurna::duration::Milliseconds time, espurna::duration::Milliseconds step);
 void lightTransition(LightTransition);
 
+// Scenes are complete light states stored in settings, with output values already prepared
+// Recall replaces current channel inputs, brightness, temperature and state, and then uses scene transition
+size_t lightScenes();
+bool lightSceneRecall(size_t id);
+bool lightSceneSave(size_t id);
+
 // Light internals are forced to be sequential. In case some actions need to happen
 // right after transition / channel state / state changes, it will call these functions
 using LightSequenceCallbacks = std::forward_list<espurna::Callback>;
@@ -0,0 +1,208 @@
+/*
+
+Part of the LIGHT MODULE
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace espurna {
+namespace light {
+namespace {
+
+// Shape of the curve between the current and the target channel output
+enum class Easing {
+    Linear,
+    InOut,
+    Perceptual,
+};
+
+namespace transition {
+
+// Progress and curve values are fixed-point fractions of the Scale
+// Everything is integer math, ESP8266 has no FPU and float ops are emulated
+using Fixed = uint32_t;
+
+constexpr int Shift { 15 };
+constexpr Fixed Scale { Fixed{1} << Shift };
+
+// Elapsed time as a fraction of the duration, zero duration is always complete
+template <typename T>
+Fixed progress(T elapsed, T duration) {
+    if (!duration || (elapsed >= duration)) {
+        return Scale;
+    }
+
+    return static_cast<Fixed>((static_cast<uint64_t>(elapsed) << Shift) / duration);
+}
+
+// Smoothstep, 3x^2 - 2x^3. Polynomial is calculated before truncating, so the result never decreases
+Fixed ease_in_out(Fixed x) {
+    const auto square = static_cast<uint64_t>(x) * x;
+    return static_cast<Fixed>((square * (3 * Scale - 2 * x)) >> (2 * Shift));
+}
+
+// Perceived lightness is roughly the cube root of the luminance (CIE L*)
+// Value is searched bit by bit, this only happens once per channel when the transition starts
+Fixed root(long value, long min, long max) {
+    if (value <= min) {
+        return 0;
+    }
+
+    if (value >= max) {
+        return Scale;
+    }
+
+    const auto range = static_cast<uint64_t>(max - min);
+    const auto target = static_cast<uint64_t>(value - min) << (3 * Shift);
+
+    Fixed out { 0 };
+    for (Fixed bit = Scale >> 1; bit; bit >>= 1) {
+        const uint64_t next = out | bit;
+        if ((next * next * next * range) <= target) {
+            out |= bit;
+        }
+    }
+
+    return out;
+}
+
+long cube(Fixed value, long min, long max) {
+    const uint64_t root = value;
+    const auto range = static_cast<uint64_t>(max - min);
+    return static_cast<long>((root * root * root * range) >> (3 * Shift)) + min;
+}
+
+long lerp(long from, long to, Fixed x) {
+    return from + static_cast<long>(
+        (static_cast<int64_t>(to - from) * static_cast<int64_t>(x)) >> Shift);
+}
+
+// Interpolates every pushed value separately, each one with its own duration and curve
+// Output only depends on the elapsed time, so a late run() does not stretch the transition
+template <typename Duration>
+class Engine {
+public:
+    struct Channel {
+        long& value;
+        long from;
+        long target;
+        Duration duration;
+        Easing easing;
+        Fixed from_root;
+        Fixed target_root;
+        bool done;
+    };
+
+    using Channels = std::vector<Channel>;
+
+    Engine(long min, long max) :
+        _min(min),
+        _max(max)
+    {}
+
+    void push(long& value, long target, Duration duration, Easing easing) {
+        const bool immediate = !duration.count() || (value == target);
+        if (immediate) {
+            duration = Duration::zero();
+        }
+
+        const bool perceptual = !immediate && (easing == Easing::Perceptual);
+
+        _channels.push_back(
+            Channel{
+                .value = value,
+                .from = value,
+                .target = target,
+                .duration = duration,
+                .easing = easing,
+                .from_root = perceptual ? root(value, _min, _max) : 0,
+                .target_root = perceptual ? root(target, _min, _max) : 0,
+                .done = false,
+            });
+    }
+
+    // Whether any of the channels needs more than one run()
+    bool gradual() const {
+        for (const auto& channel : _channels) {
+            if (channel.duration.count()) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    const Channels& channels() const {
+        return _channels;
+    }
+
+    // Callback receives the channel index and the updated value, only when it changes
+    // Returns 'true' when some of the channels have not reached their target yet
+    template <typename T>
+    bool run(Duration elapsed, T&& callback) {
+        bool next { false };
+
+        for (size_t index = 0; index < _channels.size(); ++index) {
+            auto& channel = _channels[index];
+            if (channel.done) {
+                continue;
+            }
+
+            const auto x = progress(elapsed.count(), channel.duration.count());
+
+            long value = channel.target;
+            if (x < Scale) {
+                value = interpolate(channel, x);
+                next = true;
+            } else {
+                channel.done = true;
+            }
+
+            if ((value != channel.value) || channel.done) {
+                channel.value = value;
+                callback(index, value);
+            }
+        }
+
+        return next;
+    }
+
+private:
+    long interpolate(const Channel& channel, Fixed x) const {
+        long out { channel.target };
+
+        switch (channel.easing) {
+        case Easing::Linear:
+            out = lerp(channel.from, channel.target, x);
+            break;
+
+        case Easing::InOut:
+            out = lerp(channel.from, channel.target, ease_in_out(x));
+            break;
+
+        case Easing::Perceptual:
+            out = cube(
+                lerp(channel.from_root, channel.target_root, x), _min, _max);
+            break;
+        }
+
+        // rounding of the cube root may slightly overshoot either of the ends
+        return (channel.from < channel.target)
+            ? std::clamp(out, channel.from, channel.target)
+            : std::clamp(out, channel.target, channel.from);
+    }
+
+    Channels _channels;
+    long _min;
+    long _max;
+};
+
+} // namespace transition
+} // namespace
+} // namespace light
+} // namespace espurna
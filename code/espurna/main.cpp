@@ -322,6 +322,9 @@ void setup() {
     #if SENSOR_SUPPORT
         sensorSetup();
     #endif
+    #if SENSOR_SUPPORT && SENSOR_HISTORY_SUPPORT
+        sensorHistorySetup();
+    #endif
     #if INFLUXDB_SUPPORT
         idbSetup();
     #endif
@@ -142,6 +142,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #if SENSOR_SUPPORT
 #include "sensor.h"
+#if SENSOR_HISTORY_SUPPORT
+#include "sensor_history.h"
+#endif
 #endif
 
 #if SSDP_SUPPORT
@@ -77,6 +77,18 @@ public:
         return std::make_unique<McpGpioPin>(index);
     }
 
+    // single OLAT read-modify-write for every pin in the mask
+    void write(uint32_t mask, uint32_t values) override {
+        const auto pins = static_cast<uint8_t>(mask);
+        if (!pins) {
+            return;
+        }
+
+        auto data = MCP23S08ReadRegister(OLAT);
+        data = (data & ~pins) | (values & pins);
+        MCP23S08WriteRegister(OLAT, data);
+    }
+
 private:
     Mask _lock;
 };
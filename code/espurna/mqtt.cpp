@@ -26,6 +26,10 @@ Updated secure client support by Niek van der Maas < mail at niekvandermaas dot
 #include "libs/SecureClientHelpers.h"
 
 #include "mqtt_common.ipp"
+#include "mqtt_batch.ipp"
+#include "mqtt_json.ipp"
+#include "mqtt_queue.ipp"
+#include "mqtt_topics.ipp"
 
 #if MQTT_LIBRARY == MQTT_LIBRARY_ASYNCMQTTCLIENT
 #include <ESPAsyncTCP.h>
@@ -94,6 +98,7 @@ String _mqtt_payload_online;
 String _mqtt_payload_offline;
 
 std::forward_list<MqttCallback> _mqtt_callbacks;
+espurna::mqtt::Router<MqttRouteHandler> _mqtt_routes;
 
 } // namespace
 
@@ -222,6 +227,33 @@ constexpr bool json() {
 }
 
 static constexpr auto JsonDelay = espurna::duration::Milliseconds(MQTT_JSON_DELAY);
+
+constexpr size_t jsonSize() {
+    return MQTT_JSON_MAX_SIZE;
+}
+
+constexpr size_t queueSize() {
+    return MQTT_QUEUE_MAX_SIZE;
+}
+
+constexpr size_t topicCacheSize() {
+    return MQTT_TOPIC_CACHE_SIZE;
+}
+
+constexpr size_t offlineSize() {
+    return MQTT_OFFLINE_QUEUE_SIZE;
+}
+
+constexpr size_t offlineBytes() {
+    return MQTT_OFFLINE_QUEUE_BYTES;
+}
+
+static constexpr auto OfflineDrainInterval = espurna::duration::Milliseconds(MQTT_OFFLINE_DRAIN_INTERVAL);
+
+constexpr size_t offlineDrainCount() {
+    return MQTT_OFFLINE_DRAIN_COUNT;
+}
+
 STRING_VIEW_INLINE(TopicJson, MQTT_TOPIC_JSON);
 
 constexpr espurna::duration::Milliseconds skipTime() {
@@ -574,6 +606,10 @@ bool _mqtt_forward { false };
 bool _mqtt_subscribe_settings { false };
 String _mqtt_settings_topic;
 
+// Retained settings usually arrive all at once, right after connecting.
+// Gather everything received during this loop iteration and apply it as a single change
+espurna::settings::Transaction _mqtt_settings_transaction;
+
 String _mqtt_setter;
 String _mqtt_getter;
 
@@ -739,47 +775,12 @@ void _mqttApplyWill(String topic) {
         mqtt::settings::payloadOffline());
 }
 
-// Creates a proper MQTT topic for the given 'magnitude'
-static String _mqttTopicWith(const String& topic, String magnitude, const String& suffix, const String& wildcard) {
-    String out;
-    out.reserve(magnitude.length()
-        + topic.length()
-        + suffix.length());
-
-    out += topic;
-    out += suffix;
-
-    out.replace(wildcard, magnitude);
-
-    return out;
-}
-
 static String _mqttTopicFilter() {
     return _mqtt_settings.topic + _mqtt_setter;
 }
 
-// When magnitude is a status topic aka getter
-static String _mqttTopicGetter(const String& topic, String magnitude) {
-    return _mqttTopicWith(topic, std::move(magnitude), _mqtt_getter, Wildcard.toString());
-}
-
-static String _mqttTopicGetter(String magnitude) {
-    return _mqttTopicGetter(_mqtt_settings.topic, std::move(magnitude));
-}
-
-// When magnitude is an input topic aka setter
-static String _mqttTopicSetter(const String& topic, String magnitude) {
-    return _mqttTopicWith(topic, std::move(magnitude), _mqtt_setter, Wildcard.toString());
-}
-
-static String _mqttTopicSetter(String magnitude) {
-    return _mqttTopicSetter(_mqtt_settings.topic, std::move(magnitude));
-}
-
-// When magnitude is indexed, append its index to the topic
-static String _mqttTopicIndexed(String topic, size_t index) {
-    return topic + '/' + String(index, 10);
-}
+// Same as above, but only updated when settings change
+String _mqtt_topic_filter;
 
 void _mqttApplySettingsTopic(String topic) {
     if (!espurna::mqtt::is_valid_topic_filter(topic)
@@ -801,58 +802,18 @@ void _mqttApplySettingsTopic(String topic) {
 
 namespace {
 
-struct MqttPayload {
-    MqttPayload() = delete;
-
-    MqttPayload(const MqttPayload&) = default;
-    MqttPayload& operator=(const MqttPayload&) = default;
-
-    // TODO: replace String implementation with Core v3 (or just use newer Core)
-    //       2.7.x still has basic Arduino String move ctor that is not noexcept
-    MqttPayload(MqttPayload&& other) noexcept :
-        _topic(std::move(other._topic)),
-        _message(std::move(other._message))
-    {}
-
-    MqttPayload& operator=(MqttPayload&& other) noexcept {
-        _topic = std::move(other._topic);
-        _message = std::move(other._message);
-        return *this;
-    }
-
-    template <typename Topic, typename Message>
-    MqttPayload(Topic&& topic, Message&& message) :
-        _topic(std::forward<Topic>(topic)),
-        _message(std::forward<Message>(message))
-    {}
+espurna::mqtt::Batch _mqtt_batch;
+espurna::mqtt::TopicCache _mqtt_topics(mqtt::build::topicCacheSize());
+size_t _mqtt_batch_depth { 0ul };
 
-    const String& topic() const {
-        return _topic;
-    }
-
-    const String& message() const {
-        return _message;
-    }
-
-    MqttPayload& operator=(const String& other) {
-        _message = other;
-        return *this;
-    }
-
-    MqttPayload& operator=(String&& other) noexcept {
-        _message = std::move(other);
-        return *this;
-    }
-
-private:
-    String _topic;
-    String _message;
-};
-
-size_t _mqtt_json_payload_count { 0ul };
-std::forward_list<MqttPayload> _mqtt_json_payload;
+espurna::mqtt::JsonAggregator _mqtt_json_payload(
+    mqtt::build::queueSize(), mqtt::build::jsonSize());
 espurna::timer::SystemTimer _mqtt_json_payload_flush;
 
+espurna::mqtt::OfflineQueue _mqtt_offline(
+    mqtt::build::offlineSize(), mqtt::build::offlineBytes());
+espurna::PolledFlag<espurna::time::CoreClock> _mqtt_offline_drain;
+
 bool _mqtt_json_enabled { mqtt::build::json() };
 String _mqtt_json_topic;
 
@@ -1127,10 +1088,15 @@ void _mqttConfigureImpl(bool reschedule) {
 
         if (!_mqtt_enabled) {
             _mqtt_settings.reconnect = true;
+            _mqtt_offline.clear();
             return;
         }
     }
 
+    // Queued messages use the complete topic, which is no longer valid after changing either of these
+    const auto root = _mqtt_settings.topic;
+    const auto getter = _mqtt_getter;
+
     // Placeholder strings that can be used within configured topics
     auto placeholders = make_placeholders();
 
@@ -1145,6 +1111,17 @@ void _mqttConfigureImpl(bool reschedule) {
     // Avoid re-publishing received data when getter and setter are the same
     _mqttApplySetting(_mqtt_forward, !_mqtt_setter.equals(_mqtt_getter));
 
+    if ((root != _mqtt_settings.topic) || (getter != _mqtt_getter)) {
+        _mqtt_offline.clear();
+    }
+
+    // Batched messages use the same getter topic, but do not re-create it every time
+    _mqtt_batch.pattern(_mqtt_settings.topic, _mqtt_getter);
+    _mqtt_topic_filter = _mqttTopicFilter();
+
+    // Previously created topics are no longer valid
+    _mqtt_topics.pattern(_mqtt_settings.topic, _mqtt_getter, _mqtt_setter);
+
     // Last will aka status topic. Should happen *after* topic updates
     {
         auto will = mqtt::settings::topicWill();
@@ -1398,6 +1375,9 @@ static void _mqttCommand(::terminal::CommandContext&& ctx) {
         }
     }
 
+    ctx.output.printf_P(PSTR("offline queue %u message(s) (%u bytes), %u dropped\n"),
+        _mqtt_offline.size(), _mqtt_offline.bytes(), _mqtt_offline.drops());
+
     settingsDump(ctx, mqtt::settings::query::Settings);
     terminalOK(ctx);
 }
@@ -1448,17 +1428,18 @@ espurna::StringView _mqttMagnitude(const String& filter, espurna::StringView top
     return espurna::mqtt::match_wildcard(filter, topic, WildcardCharacter);
 }
 
-void _mqttCallback(unsigned int type, espurna::StringView topic, espurna::StringView payload) {
+void _mqttCallback(unsigned int type, espurna::StringView, espurna::StringView) {
     if (type == MQTT_CONNECT_EVENT) {
         mqttSubscribe(MQTT_TOPIC_ACTION);
     }
+}
 
-    if (type == MQTT_MESSAGE_EVENT) {
-        auto t = mqttMagnitude(topic);
-        if (t.equals(MQTT_TOPIC_ACTION)) {
-            rpcHandleAction(payload);
-        }
-    }
+void _mqttActionRoute(const espurna::mqtt::Match&, espurna::StringView payload) {
+    rpcHandleAction(payload);
+}
+
+void _mqttSettingsCommit() {
+    _mqtt_settings_transaction.commit();
 }
 
 void _mqttSettingsCallback(unsigned int type, espurna::StringView topic, espurna::StringView payload) {
@@ -1482,7 +1463,59 @@ void _mqttSettingsCallback(unsigned int type, espurna::StringView topic, espurna
             return;
         }
 
-        setSetting(key.toString(), payload.toString());
+        _mqtt_settings_transaction.set(key.toString(), payload.toString());
+        espurnaRegisterOnceUnique(_mqttSettingsCommit);
+    }
+}
+
+uint16_t _mqttPublish(const char* topic, const char* message, bool retain, int qos) {
+    if (_mqtt.connected()) {
+        const unsigned int packetId {
+#if MQTT_LIBRARY == MQTT_LIBRARY_ASYNCMQTTCLIENT
+            _mqtt.publish(topic, qos, retain, message)
+#elif MQTT_LIBRARY == MQTT_LIBRARY_ARDUINOMQTT
+            _mqtt.publish(topic, message, retain, qos)
+#elif MQTT_LIBRARY == MQTT_LIBRARY_PUBSUBCLIENT
+            _mqtt.publish(topic, message, retain)
+#endif
+        };
+
+#if DEBUG_SUPPORT
+        {
+            const size_t len = strlen(message);
+
+            auto begin = message;
+            auto end = message + len;
+
+            if ((len > mqtt::build::MessageLogMax) || (end != std::find(begin, end, '\n'))) {
+                DEBUG_MSG_P(PSTR("[MQTT] Sending %s => (%u bytes) (PID %u)\n"), topic, len, packetId);
+            } else {
+                DEBUG_MSG_P(PSTR("[MQTT] Sending %s => %s (PID %u)\n"), topic, message, packetId);
+            }
+        }
+#endif
+
+        return packetId;
+    }
+
+    return false;
+}
+
+// Queued messages are sent in small groups, stopping early when the client is no longer able to send
+void _mqttOfflineDrain() {
+    if (_mqtt_offline.empty() || !_mqtt_offline_drain.wait(mqtt::build::OfflineDrainInterval)) {
+        return;
+    }
+
+    _mqtt_offline.drain(mqtt::build::offlineDrainCount(),
+        [](const espurna::mqtt::OfflineQueue::Message& message) {
+            return _mqttPublish(
+                message.topic.c_str(), message.payload.c_str(),
+                message.retain, message.qos) > 0;
+        });
+
+    if (_mqtt_offline.empty()) {
+        DEBUG_MSG_P(PSTR("[MQTT] Sent every queued message\n"));
     }
 }
 
@@ -1565,6 +1598,11 @@ bool _mqttHeartbeat(espurna::heartbeat::Mask mask) {
     if (mask & espurna::heartbeat::Report::Loadavg)
         mqttSend(MQTT_TOPIC_LOADAVG, String(systemLoadAverage()).c_str());
 
+    if (mask & espurna::heartbeat::Report::Queue) {
+        mqttSend(MQTT_TOPIC_QUEUE, String(_mqtt_offline.size(), 10).c_str());
+        mqttSend(MQTT_TOPIC_QUEUE_DROPS, String(_mqtt_offline.drops(), 10).c_str());
+    }
+
     if ((mask & espurna::heartbeat::Report::Vcc) && (ADC_MODE_VALUE == ADC_VCC))
         mqttSend(MQTT_TOPIC_VCC, String(ESP.getVcc()).c_str());
 
@@ -1588,6 +1626,13 @@ void _mqttOnConnect() {
 
     systemHeartbeat(_mqttHeartbeat, _mqtt_heartbeat_mode, _mqtt_heartbeat_interval);
 
+    // Subscriptions go first, queued messages are sent a bit later
+    _mqtt_offline_drain.reset();
+    if (!_mqtt_offline.empty()) {
+        DEBUG_MSG_P(PSTR("[MQTT] %u queued message(s), %u dropped\n"),
+            _mqtt_offline.size(), _mqtt_offline.drops());
+    }
+
     // Notify all subscribers about the connection
     for (const auto callback : _mqtt_callbacks) {
         callback(MQTT_CONNECT_EVENT,
@@ -1691,6 +1736,24 @@ bool _mqttMaybeSkipRetained(espurna::StringView topic) {
     return false;
 }
 
+// Magnitude is extracted once, and only the matching routes are called.
+// Every registered callback still receives the message as-is.
+void _mqttDispatch(espurna::StringView topic, espurna::StringView message) {
+    if (_mqtt_routes.size()) {
+        const auto magnitude = _mqttMagnitude(_mqtt_topic_filter, topic);
+        if (magnitude.length()) {
+            _mqtt_routes.match(magnitude,
+                [&](MqttRouteHandler handler, const espurna::mqtt::Match& match) {
+                    handler(match, message);
+                });
+        }
+    }
+
+    for (const auto callback : _mqtt_callbacks) {
+        callback(MQTT_MESSAGE_EVENT, topic, message);
+    }
+}
+
 #if MQTT_LIBRARY == MQTT_LIBRARY_ASYNCMQTTCLIENT
 
 // MQTT Broker can sometimes send messages in bulk. Even when message size is less than MQTT_BUFFER_MAX_SIZE, we *could*
@@ -1733,9 +1796,7 @@ void _mqttOnMessageAsync(char* raw_topic, char* raw_payload, AsyncMqttClientMess
     }
 
     auto message = espurna::StringView{ &buffer[0], &buffer[total] };
-    for (const auto callback : _mqtt_callbacks) {
-        callback(MQTT_MESSAGE_EVENT, topic, message);
-    }
+    _mqttDispatch(topic, message);
 }
 
 #else
@@ -1760,9 +1821,7 @@ void _mqttOnMessage(char* raw_topic, char* raw_payload, unsigned int len) {
     }
 
     // Call subscribers with the message buffer
-    for (auto& callback : _mqtt_callbacks) {
-        callback(MQTT_MESSAGE_EVENT, topic, message);
-    }
+    _mqttDispatch(topic, message);
 }
 
 #endif // MQTT_LIBRARY == MQTT_LIBRARY_ASYNCMQTTCLIENT
@@ -1775,60 +1834,46 @@ void _mqttOnMessage(char* raw_topic, char* raw_payload, unsigned int len) {
 
 // Return {magnitude} (aka #) part of the topic string
 espurna::StringView mqttMagnitude(espurna::StringView topic) {
-    return _mqttMagnitude(_mqttTopicFilter(), topic);
+    return _mqttMagnitude(_mqtt_topic_filter, topic);
 }
 
 String mqttTopic(const String& magnitude) {
-    return _mqttTopicGetter(magnitude);
+    return _mqtt_topics.getter(magnitude);
 }
 
 String mqttTopic(const String& magnitude, size_t index) {
-    return _mqttTopicGetter(_mqttTopicIndexed(magnitude, index));
+    return _mqtt_topics.getter(magnitude, index);
 }
 
 String mqttTopicSetter(const String& magnitude) {
-    return _mqttTopicSetter(magnitude);
+    return _mqtt_topics.setter(magnitude);
 }
 
 String mqttTopicSetter(const String& magnitude, size_t index) {
-    return _mqttTopicSetter(_mqttTopicIndexed(magnitude, index));
+    return _mqtt_topics.setter(magnitude, index);
 }
 
 // -----------------------------------------------------------------------------
 
-uint16_t mqttSendRaw(const char* topic, const char* message, bool retain, int qos) {
-    if (_mqtt.connected()) {
-        const unsigned int packetId {
-#if MQTT_LIBRARY == MQTT_LIBRARY_ASYNCMQTTCLIENT
-            _mqtt.publish(topic, qos, retain, message)
-#elif MQTT_LIBRARY == MQTT_LIBRARY_ARDUINOMQTT
-            _mqtt.publish(topic, message, retain, qos)
-#elif MQTT_LIBRARY == MQTT_LIBRARY_PUBSUBCLIENT
-            _mqtt.publish(topic, message, retain)
-#endif
-        };
-
-#if DEBUG_SUPPORT
-        {
-            const size_t len = strlen(message);
-
-            auto begin = message;
-            auto end = message + len;
-
-            if ((len > mqtt::build::MessageLogMax) || (end != std::find(begin, end, '\n'))) {
-                DEBUG_MSG_P(PSTR("[MQTT] Sending %s => (%u bytes) (PID %u)\n"), topic, len, packetId);
-            } else {
-                DEBUG_MSG_P(PSTR("[MQTT] Sending %s => %s (PID %u)\n"), topic, message, packetId);
-            }
-        }
-#endif
+// Only used for the generic value topics, where the packet id is never tracked.
+// Message is queued while disconnected, or while the older messages with the same topic
+// are still waiting in the queue. Otherwise, this one would be sent before them
+bool _mqttSendOrQueue(const char* topic, const char* message, bool retain) {
+    if (_mqtt.connected() && !_mqtt_offline.contains(topic)) {
+        return _mqttPublish(topic, message, retain, _mqtt_settings.qos) > 0;
+    }
 
-        return packetId;
+    if (_mqtt_enabled) {
+        return _mqtt_offline.push(topic, message, retain, _mqtt_settings.qos);
     }
 
     return false;
 }
 
+uint16_t mqttSendRaw(const char* topic, const char* message, bool retain, int qos) {
+    return _mqttPublish(topic, message, retain, qos);
+}
+
 uint16_t mqttSendRaw(const char* topic, const char* message, bool retain) {
     return mqttSendRaw(topic, message, retain, _mqtt_settings.qos);
 }
@@ -1844,7 +1889,7 @@ bool mqttSend(const char* topic, const char* message, bool force, bool retain) {
         return true;
     }
 
-    return mqttSendRaw(mqttTopic(topic).c_str(), message, retain) > 0;
+    return _mqttSendOrQueue(_mqtt_topics.getter(topic).c_str(), message, retain);
 }
 
 bool mqttSend(const char* topic, const char* message, bool force) {
@@ -1856,15 +1901,19 @@ bool mqttSend(const char* topic, const char* message) {
 }
 
 bool mqttSend(const char* topic, unsigned int index, const char* message, bool force, bool retain) {
-    const size_t TopicLen { strlen(topic) };
-    String out;
-    out.reserve(TopicLen + 5);
+    if (!force && _mqtt_json_enabled) {
+        const size_t TopicLen { strlen(topic) };
+        String out;
+        out.reserve(TopicLen + 5);
 
-    out.concat(topic, TopicLen);
-    out += '/';
-    out += index;
+        out.concat(topic, TopicLen);
+        out += '/';
+        out += index;
 
-    return mqttSend(out.c_str(), message, force, retain);
+        return mqttSend(out.c_str(), message, force, retain);
+    }
+
+    return _mqttSendOrQueue(_mqtt_topics.getter(topic, index).c_str(), message, retain);
 }
 
 bool mqttSend(const char* topic, unsigned int index, const char* message, bool force) {
@@ -1877,85 +1926,129 @@ bool mqttSend(const char* topic, unsigned int index, const char* message) {
 
 // -----------------------------------------------------------------------------
 
-constexpr size_t MqttJsonPayloadBufferSize { 1024ul };
+static void _mqttBatchFlush() {
+    _mqtt_batch.flush(
+        [](const char* topic, const char* payload) {
+            _mqttSendOrQueue(topic, payload, _mqtt_settings.retain);
+        });
+}
 
-void mqttFlush() {
-    if (!_mqtt.connected()) {
+void mqttBatchBegin() {
+    ++_mqtt_batch_depth;
+}
+
+void mqttBatchAdd(espurna::StringView magnitude, espurna::StringView payload) {
+    if (_mqtt_json_enabled) {
+        mqttEnqueue(magnitude, payload);
+        _mqtt_json_payload_flush.once(mqtt::build::JsonDelay, mqttFlush);
         return;
     }
 
+    _mqtt_batch.add(magnitude, payload);
+    if (!_mqtt_batch_depth) {
+        _mqttBatchFlush();
+    }
+}
+
+void mqttBatchEnd() {
+    if (!_mqtt_batch_depth) {
+        return;
+    }
+
+    --_mqtt_batch_depth;
+    if (!_mqtt_batch_depth) {
+        _mqttBatchFlush();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void mqttFlush() {
     if (_mqtt_json_payload.empty()) {
         return;
     }
 
-    DynamicJsonBuffer jsonBuffer(MqttJsonPayloadBufferSize);
-    JsonObject& root = jsonBuffer.createObject();
+    if (!_mqtt_enabled) {
+        _mqtt_json_payload.clear();
+        return;
+    }
 
 #if NTP_SUPPORT && MQTT_ENQUEUE_DATETIME
-    if (ntpSynced()) {
-        root[MQTT_TOPIC_DATETIME] = ntpDateTime();
-    }
+    const auto datetime = ntpSynced()
+        ? ntpDateTime() : String();
 #endif
 #if MQTT_ENQUEUE_MAC
-    root[MQTT_TOPIC_MAC] = WiFi.macAddress();
+    const auto mac = WiFi.macAddress();
 #endif
 #if MQTT_ENQUEUE_HOSTNAME
-    root[MQTT_TOPIC_HOSTNAME] = systemHostname();
+    const auto hostname = systemHostname();
 #endif
 #if MQTT_ENQUEUE_IP
-    root[MQTT_TOPIC_IP] = wifiStaIp().toString();
+    const auto ip = wifiStaIp().toString();
 #endif
 #if MQTT_ENQUEUE_MESSAGE_ID
-    root[MQTT_TOPIC_MESSAGE_ID] = (Rtcmem->mqtt)++;
+    const auto id = String((Rtcmem->mqtt)++, 10);
 #endif
 
-    // ref. https://github.com/xoseperez/espurna/issues/2503
-    // pretend that the message is already a valid json value
-    // when the string looks like a number
-    // ([0-9] with an optional decimal separator [.])
-    for (auto& payload : _mqtt_json_payload) {
-        const char* const topic { payload.topic().c_str() };
-        const char* const message { payload.message().c_str() };
-        if (isNumber(payload.message())) {
-            root[topic] = RawJson(message);
-        } else {
-            root[topic] = message;
+    // Object is written twice, first time only to know the resulting length
+    // Only the output string is allocated here, and it is allocated once
+    const auto serialize = [&](auto& writer) {
+        writer.begin();
+#if NTP_SUPPORT && MQTT_ENQUEUE_DATETIME
+        if (datetime.length()) {
+            writer.member(STRING_VIEW(MQTT_TOPIC_DATETIME), datetime, false);
         }
-    }
+#endif
+#if MQTT_ENQUEUE_MAC
+        writer.member(STRING_VIEW(MQTT_TOPIC_MAC), mac, false);
+#endif
+#if MQTT_ENQUEUE_HOSTNAME
+        writer.member(STRING_VIEW(MQTT_TOPIC_HOSTNAME), hostname, false);
+#endif
+#if MQTT_ENQUEUE_IP
+        writer.member(STRING_VIEW(MQTT_TOPIC_IP), ip, false);
+#endif
+#if MQTT_ENQUEUE_MESSAGE_ID
+        writer.member(STRING_VIEW(MQTT_TOPIC_MESSAGE_ID), id, true);
+#endif
+        _mqtt_json_payload.serialize(writer);
+        writer.end();
+    };
+
+    using espurna::mqtt::JsonLength;
+    using espurna::mqtt::JsonString;
+    using espurna::mqtt::JsonWriter;
+
+    JsonLength length;
+    JsonWriter<JsonLength> measure(length);
+    serialize(measure);
 
     String output;
-    root.printTo(output);
+    output.reserve(length.size);
+
+    JsonString string{output};
+    JsonWriter<JsonString> writer(string);
+    serialize(writer);
 
-    jsonBuffer.clear();
-    _mqtt_json_payload_count = 0;
     _mqtt_json_payload.clear();
 
-    mqttSendRaw(_mqtt_json_topic.c_str(), output.c_str(), false);
+    _mqttSendOrQueue(_mqtt_json_topic.c_str(), output.c_str(), false);
 }
 
 void mqttEnqueue(espurna::StringView topic, espurna::StringView payload) {
-    // Queue is not meant to send message "offline"
-    // We must prevent the queue does not get full while offline
-    if (_mqtt.connected()) {
-        if (_mqtt_json_payload_count >= MQTT_QUEUE_MAX_SIZE) {
-            mqttFlush();
-        }
-
-        const auto it = std::find_if(
-            _mqtt_json_payload.begin(),
-            _mqtt_json_payload.end(),
-            [topic](const MqttPayload& payload) {
-                return topic == payload.topic();
-            });
+    // ref. https://github.com/xoseperez/espurna/issues/2503
+    // pretend that the message is already a valid json value
+    // when the string looks like a number
+    // ([0-9] with an optional decimal separator [.])
+    const auto raw = isNumber(payload);
 
-        if (it != _mqtt_json_payload.end()) {
-            (*it) = payload.toString();
-        } else {
-            _mqtt_json_payload.emplace_front(
-                topic.toString(), payload.toString());
-            ++_mqtt_json_payload_count;
-        }
+    // Either too many topics or too many bytes, send everything that was queued so far
+    // (or move it to the offline queue, when not connected)
+    if (!_mqtt_json_payload.fits(topic, payload, raw)) {
+        mqttFlush();
     }
+
+    _mqtt_json_payload.add(topic, payload, raw);
 }
 
 // -----------------------------------------------------------------------------
@@ -1977,7 +2070,7 @@ uint16_t mqttSubscribeRaw(const char* topic) {
 }
 
 bool mqttSubscribe(const char* topic) {
-    return mqttSubscribeRaw(mqttTopicSetter(topic).c_str(), _mqtt_settings.qos);
+    return mqttSubscribeRaw(_mqtt_topics.setter(topic).c_str(), _mqtt_settings.qos);
 }
 
 uint16_t mqttUnsubscribeRaw(const char* topic) {
@@ -1991,13 +2084,16 @@ uint16_t mqttUnsubscribeRaw(const char* topic) {
 }
 
 bool mqttUnsubscribe(const char* topic) {
-    return mqttUnsubscribeRaw(mqttTopicSetter(topic).c_str());
+    return mqttUnsubscribeRaw(_mqtt_topics.setter(topic).c_str());
 }
 
 // -----------------------------------------------------------------------------
 
 void mqttEnabled(bool status) {
     _mqtt_enabled = status;
+    if (!status) {
+        _mqtt_offline.clear();
+    }
 }
 
 bool mqttEnabled() {
@@ -2028,6 +2124,19 @@ void mqttRegister(MqttCallback callback) {
     _mqtt_callbacks.push_front(callback);
 }
 
+bool mqttRoute(espurna::StringView filter, MqttRouteHandler handler) {
+    // filter is allowed to be in flash, router only works with RAM strings
+    const auto copy = filter.toString();
+
+    const auto out = _mqtt_routes.add(copy, handler);
+    if (!out) {
+        DEBUG_MSG_P(PSTR("[MQTT] Invalid route %.*s\n"),
+            filter.length(), filter.data());
+    }
+
+    return out;
+}
+
 #if MQTT_LIBRARY == MQTT_LIBRARY_ASYNCMQTTCLIENT
 
 /**
@@ -2143,10 +2252,15 @@ void _mqttConnect() {
 
 void mqttLoop() {
 #if MQTT_LIBRARY == MQTT_LIBRARY_ASYNCMQTTCLIENT
-    _mqttConnect();
+    if (_mqtt.connected()) {
+        _mqttOfflineDrain();
+    } else {
+        _mqttConnect();
+    }
 #else
     if (_mqtt.connected()) {
         _mqtt.loop();
+        _mqttOfflineDrain();
     } else {
         if (_mqtt_state != AsyncClientState::Disconnected) {
             _mqttOnDisconnect();
@@ -2270,6 +2384,7 @@ void mqttSetup() {
         });
 
     mqttRegister(_mqttCallback);
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_ACTION), _mqttActionRoute);
     mqttRegister(_mqttSettingsCallback);
 
     #if WEB_SUPPORT
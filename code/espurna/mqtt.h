@@ -10,6 +10,7 @@ Updated secure client support by Niek van der Maas < mail at niekvandermaas dot
 #pragma once
 
 #include "system.h"
+#include "mqtt_router.h"
 
 #include <functional>
 
@@ -18,12 +19,15 @@ Updated secure client support by Niek van der Maas < mail at niekvandermaas dot
 #define MQTT_TOPIC_JSON             "data"
 #define MQTT_TOPIC_ACTION           "action"
 #define MQTT_TOPIC_RELAY            "relay"
+#define MQTT_TOPIC_RELAYS           "relays"
 #define MQTT_TOPIC_LED              "led"
 #define MQTT_TOPIC_LOCK             "lock"
 #define MQTT_TOPIC_BUTTON           "button"
 #define MQTT_TOPIC_IP               "ip"
 #define MQTT_TOPIC_SSID             "ssid"
 #define MQTT_TOPIC_BSSID            "bssid"
+#define MQTT_TOPIC_QUEUE            "queue"
+#define MQTT_TOPIC_QUEUE_DROPS      "queue_drops"
 #define MQTT_TOPIC_VERSION          "version"
 #define MQTT_TOPIC_UPTIME           "uptime"
 #define MQTT_TOPIC_DATETIME         "datetime"
@@ -64,6 +68,12 @@ void mqttHeartbeat(espurna::heartbeat::Callback);
 using MqttCallback = void(*)(unsigned int type, espurna::StringView topic, espurna::StringView payload);
 void mqttRegister(MqttCallback);
 
+// stateless handler of the incoming messages, called only when the topic matches the filter.
+// filter is relative to the root topic and setter, e.g. 'relay/+' matches '<root>/relay/0/set'
+// (subscribing is still up to the module, usually from the MQTT_CONNECT_EVENT callback)
+using MqttRouteHandler = void(*)(const espurna::mqtt::Match&, espurna::StringView payload);
+bool mqttRoute(espurna::StringView filter, MqttRouteHandler);
+
 // stateful callback for ACK'ed messages; should be used when waiting for certain messsage to be PUBlished
 using MqttPidCallback = std::function<void()>;
 void mqttOnPublish(uint16_t pid, MqttPidCallback);
@@ -88,6 +98,8 @@ bool mqttSubscribe(const char * topic);
 uint16_t mqttUnsubscribeRaw(const char * topic);
 bool mqttUnsubscribe(const char * topic);
 
+// While disconnected, message is kept in the offline queue and sent after connecting
+// (unlike mqttSendRaw(), which only publishes when connected and returns the packet id)
 bool mqttSend(const char * topic, const char * message, bool force, bool retain);
 bool mqttSend(const char * topic, const char * message, bool force);
 bool mqttSend(const char * topic, const char * message);
@@ -96,6 +108,13 @@ bool mqttSend(const char * topic, unsigned int index, const char * message, bool
 bool mqttSend(const char * topic, unsigned int index, const char * message, bool force);
 bool mqttSend(const char * topic, unsigned int index, const char * message);
 
+// Messages added between begin and end are published together, right after the last end() call.
+// Topics are the same as with mqttSend(magnitude, ...), strings are expected to be in RAM.
+// When batch was not started, message is published right away
+void mqttBatchBegin();
+void mqttBatchAdd(espurna::StringView magnitude, espurna::StringView payload);
+void mqttBatchEnd();
+
 void mqttSendStatus();
 void mqttFlush();
 
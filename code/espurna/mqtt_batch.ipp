@@ -0,0 +1,96 @@
+/*
+
+Part of the MQTT MODULE
+
+*/
+
+#pragma once
+
+#include "types.h"
+#include "mqtt_common.ipp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace espurna {
+namespace mqtt {
+namespace {
+
+// Collects messages to be published all at once, back to back.
+// Every topic is written directly into the shared buffer using the TopicPattern, next to its payload,
+// e.g. with 'home/#' + '/get' and 'temperature/0' the stored message topic is 'home/temperature/0/get'
+//
+// Buffer keeps its capacity after the flush, so nothing is allocated once it is large enough
+class Batch {
+public:
+    void pattern(StringView topic, StringView suffix) {
+        _pattern = TopicPattern(topic);
+        _pattern.suffix.concat(suffix.data(), suffix.length());
+    }
+
+    void add(StringView magnitude, StringView payload) {
+        _append(_pattern.prefix);
+        if (_pattern.wildcard) {
+            _append(magnitude);
+        }
+        _append(_pattern.suffix);
+        _buffer.push_back('\0');
+
+        _append(payload);
+        _buffer.push_back('\0');
+
+        ++_size;
+    }
+
+    // callback receives null-terminated topic and payload of every message, in the order they were added
+    template <typename T>
+    void flush(T&& callback) {
+        const char* ptr = _buffer.data();
+        const char* const end = ptr + _buffer.size();
+
+        while (ptr != end) {
+            const char* topic = ptr;
+            ptr += std::strlen(ptr) + 1;
+
+            const char* payload = ptr;
+            ptr += std::strlen(ptr) + 1;
+
+            callback(topic, payload);
+        }
+
+        clear();
+    }
+
+    void clear() {
+        _buffer.clear();
+        _size = 0;
+    }
+
+    void reserve(size_t size) {
+        _buffer.reserve(size);
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    size_t capacity() const {
+        return _buffer.capacity();
+    }
+
+private:
+    template <typename T>
+    void _append(const T& value) {
+        _buffer.insert(_buffer.end(), value.begin(), value.end());
+    }
+
+    TopicPattern _pattern;
+
+    std::vector<char> _buffer;
+    size_t _size { 0 };
+};
+
+} // namespace
+} // namespace mqtt
+} // namespace espurna
@@ -9,6 +9,8 @@ Copyright (C) 2024 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
 
 #include "types.h"
 
+#include <algorithm>
+
 namespace espurna {
 namespace mqtt {
 
@@ -269,6 +271,38 @@ char filter_wildcard(StringView filter) {
     return out;
 }
 
+// FNV-1a, for quick topic lookups. Could be continued from the previous result
+constexpr uint32_t TopicHashInit { 2166136261ul };
+
+uint32_t topic_hash(StringView value, uint32_t hash = TopicHashInit) {
+    for (auto it = value.begin(); it != value.end(); ++it) {
+        hash ^= static_cast<uint8_t>(*it);
+        hash *= 16777619ul;
+    }
+
+    return hash;
+}
+
+// Topic is split only once, around the '#' wildcard. Resulting topic is prefix + magnitude + suffix,
+// e.g. with 'home/#/state' and 'relay/0' it is 'home/relay/0/state'. Without the wildcard, magnitude is not used
+struct TopicPattern {
+    TopicPattern() = default;
+
+    explicit TopicPattern(StringView topic) {
+        const auto it = std::find(topic.begin(), topic.end(), '#');
+        wildcard = it != topic.end();
+
+        prefix = StringView(topic.begin(), it).toString();
+        if (wildcard) {
+            suffix = StringView(it + 1, topic.end()).toString();
+        }
+    }
+
+    String prefix;
+    String suffix;
+    bool wildcard { false };
+};
+
 bool is_valid_single_level(StringView value) {
     for (auto it = value.begin(); it != value.end(); ++it) {
         switch (*it) {
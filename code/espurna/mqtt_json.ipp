@@ -0,0 +1,339 @@
+/*
+
+Part of the MQTT MODULE
+
+*/
+
+#pragma once
+
+#include "types.h"
+#include "mqtt_common.ipp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace espurna {
+namespace mqtt {
+namespace {
+
+// Writes JSON object members directly into the output, escaping string values and keys
+// Expected to be used twice - once to calculate the resulting length, and once to write it
+template <typename Output>
+struct JsonWriter {
+    explicit JsonWriter(Output& output) :
+        _output(output)
+    {}
+
+    void begin() {
+        _output.write('{');
+    }
+
+    void end() {
+        _output.write('}');
+    }
+
+    // value is written as-is when raw, e.g. when it already looks like a number
+    void member(StringView key, StringView value, bool raw) {
+        if (_members++) {
+            _output.write(',');
+        }
+
+        _string(key);
+        _output.write(':');
+
+        if (raw) {
+            _output.write(value);
+        } else {
+            _string(value);
+        }
+    }
+
+private:
+    static char _hex(uint8_t value) {
+        return (value < 10)
+            ? ('0' + value)
+            : ('a' + value - 10);
+    }
+
+    void _string(StringView value) {
+        _output.write('"');
+
+        for (auto it = value.begin(); it != value.end(); ++it) {
+            const auto c = static_cast<uint8_t>(*it);
+            switch (c) {
+            case '"':
+            case '\\':
+                _output.write('\\');
+                _output.write(*it);
+                break;
+            case '\b':
+                _output.write(STRING_VIEW("\\b"));
+                break;
+            case '\f':
+                _output.write(STRING_VIEW("\\f"));
+                break;
+            case '\n':
+                _output.write(STRING_VIEW("\\n"));
+                break;
+            case '\r':
+                _output.write(STRING_VIEW("\\r"));
+                break;
+            case '\t':
+                _output.write(STRING_VIEW("\\t"));
+                break;
+            default:
+                if (c < 0x20) {
+                    _output.write(STRING_VIEW("\\u00"));
+                    _output.write(_hex(c >> 4));
+                    _output.write(_hex(c & 0xf));
+                } else {
+                    _output.write(*it);
+                }
+                break;
+            }
+        }
+
+        _output.write('"');
+    }
+
+    Output& _output;
+    size_t _members { 0 };
+};
+
+struct JsonLength {
+    void write(char) {
+        ++size;
+    }
+
+    void write(StringView value) {
+        size += value.length();
+    }
+
+    size_t size { 0 };
+};
+
+struct JsonString {
+    void write(char value) {
+        output.concat(value);
+    }
+
+    void write(StringView value) {
+        output.concat(value.data(), value.length());
+    }
+
+    String& output;
+};
+
+// Groups messages into a single JSON object, where every topic is a key and only the latest payload is kept.
+// Messages are stored back to back in a shared buffer, topic lookup goes through a small open-addressed
+// table of topic hashes instead of comparing every stored topic.
+//
+// Payload is replaced in-place when it fits the previously stored one, otherwise it is appended to the buffer.
+// Buffer and table keep their capacity after clear(), so nothing is allocated once they are large enough
+class JsonAggregator {
+public:
+    // 'size' is the maximum number of unique topics, 'budget' is the maximum number of bytes
+    // used by both the buffer and the serialized object
+    JsonAggregator(size_t size, size_t budget) :
+        _size(std::min(size, Limit)),
+        _budget(std::min(budget, BufferLimit))
+    {}
+
+    // Whether another message can be added without exceeding the budget
+    bool fits(StringView topic, StringView payload, bool raw) const {
+        const auto it = _find(topic, topic_hash(topic));
+        if (it == Empty) {
+            return (_entries.size() < _size)
+                && ((_buffer.size() + topic.length() + payload.length()) <= _budget)
+                && ((_length + _member(topic, payload, raw)) <= _budget);
+        }
+
+        const auto& entry = _entries[it];
+
+        const auto buffer = (payload.length() > entry.capacity)
+            ? payload.length() : 0;
+        const auto length = _length
+            - _member(_topic(entry), _payload(entry), entry.raw)
+            + _member(topic, payload, raw);
+
+        return ((_buffer.size() + buffer) <= _budget)
+            && (length <= _budget);
+    }
+
+    // Budget is not checked, only fails when the table or the buffer are already full
+    bool add(StringView topic, StringView payload, bool raw) {
+        if ((_buffer.size() + topic.length() + payload.length()) > BufferLimit) {
+            return false;
+        }
+
+        const auto hash = topic_hash(topic);
+
+        auto it = _find(topic, hash);
+        if (it == Empty) {
+            if (_entries.size() >= _size) {
+                return false;
+            }
+
+            _reserve();
+
+            Entry entry;
+            entry.hash = hash;
+            entry.key = _buffer.size();
+            entry.topic = topic.length();
+            _buffer.insert(_buffer.end(), topic.begin(), topic.end());
+            entry.value = _buffer.size();
+
+            it = _entries.size();
+            _entries.push_back(entry);
+            _table[_slot(topic, hash)] = it;
+        } else {
+            const auto& entry = _entries[it];
+            _length -= _member(_topic(entry), _payload(entry), entry.raw);
+        }
+
+        auto& entry = _entries[it];
+
+        // payload can grow in-place when it is the last one in the buffer,
+        // otherwise it is moved to the end and the previous one is left unused
+        if (payload.length() > entry.capacity) {
+            if ((entry.value + entry.capacity) != _buffer.size()) {
+                entry.value = _buffer.size();
+            }
+
+            _buffer.resize(entry.value);
+            _buffer.insert(_buffer.end(), payload.begin(), payload.end());
+            entry.capacity = payload.length();
+        } else {
+            std::copy(payload.begin(), payload.end(),
+                _buffer.begin() + entry.value);
+        }
+
+        entry.payload = payload.length();
+        entry.raw = raw;
+
+        _length += _member(topic, payload, raw);
+
+        return true;
+    }
+
+    // Callback receives topic, payload and the 'raw' flag of every entry, in the order they were added
+    template <typename T>
+    void foreach(T&& callback) const {
+        for (const auto& entry : _entries) {
+            callback(_topic(entry), _payload(entry), entry.raw);
+        }
+    }
+
+    template <typename Output>
+    void serialize(JsonWriter<Output>& writer) const {
+        foreach(
+            [&](StringView topic, StringView payload, bool raw) {
+                writer.member(topic, payload, raw);
+            });
+    }
+
+    void clear() {
+        _entries.clear();
+        _buffer.clear();
+        std::fill(_table.begin(), _table.end(), Empty);
+        _length = 0;
+    }
+
+    size_t size() const {
+        return _entries.size();
+    }
+
+    bool empty() const {
+        return _entries.empty();
+    }
+
+    // Serialized length of every stored member, counting one ',' separator for each one
+    size_t length() const {
+        return _length;
+    }
+
+private:
+    static constexpr size_t Limit { UINT8_MAX };
+    static constexpr uint8_t Empty { UINT8_MAX };
+
+    static constexpr size_t BufferLimit { UINT16_MAX };
+
+    struct Entry {
+        uint32_t hash { 0 };
+        uint16_t key { 0 };
+        uint16_t topic { 0 };
+        uint16_t value { 0 };
+        uint16_t payload { 0 };
+        uint16_t capacity { 0 };
+        bool raw { false };
+    };
+
+    static size_t _member(StringView topic, StringView payload, bool raw) {
+        JsonLength length;
+        JsonWriter<JsonLength> writer(length);
+        writer.member(topic, payload, raw);
+
+        return length.size + 1;
+    }
+
+    StringView _topic(const Entry& entry) const {
+        return StringView(_buffer.data() + entry.key, entry.topic);
+    }
+
+    StringView _payload(const Entry& entry) const {
+        return StringView(_buffer.data() + entry.value, entry.payload);
+    }
+
+    // Table is at least twice the size of the entries list, so probing always finds an empty slot
+    void _reserve() {
+        if (!_table.empty()) {
+            return;
+        }
+
+        size_t size { 4 };
+        while (size < (_size * 2)) {
+            size *= 2;
+        }
+
+        _table.resize(size, Empty);
+    }
+
+    // Either the slot of the matching entry, or the first empty one
+    size_t _slot(StringView topic, uint32_t hash) const {
+        const auto mask = _table.size() - 1;
+
+        auto slot = hash & mask;
+        while (_table[slot] != Empty) {
+            const auto& entry = _entries[_table[slot]];
+            if ((entry.hash == hash) && (_topic(entry) == topic)) {
+                break;
+            }
+
+            slot = (slot + 1) & mask;
+        }
+
+        return slot;
+    }
+
+    size_t _find(StringView topic, uint32_t hash) const {
+        if (_table.empty()) {
+            return Empty;
+        }
+
+        return _table[_slot(topic, hash)];
+    }
+
+    size_t _size;
+    size_t _budget;
+
+    std::vector<Entry> _entries;
+    std::vector<uint8_t> _table;
+    std::vector<char> _buffer;
+
+    size_t _length { 0 };
+};
+
+} // namespace
+} // namespace mqtt
+} // namespace espurna
@@ -0,0 +1,162 @@
+/*
+
+Part of the MQTT MODULE
+
+*/
+
+#pragma once
+
+#include "types.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace espurna {
+namespace mqtt {
+namespace {
+
+// Messages that could not be published while disconnected, to be sent after the connection is established.
+// Queue is limited by both the number of messages and the number of bytes used by topics and payloads.
+//
+// Retained messages describe the current state, so the new one replaces any queued message with the same topic.
+// When the queue is full, the oldest message with QoS 0 is dropped first. Messages with a higher QoS
+// are only dropped when there is nothing else left, and the new one is not QoS 0 itself
+class OfflineQueue {
+public:
+    struct Message {
+        String topic;
+        String payload;
+        bool retain;
+        int qos;
+    };
+
+    OfflineQueue(size_t size, size_t bytes) :
+        _size(size),
+        _bytes(bytes)
+    {}
+
+    // Returns false when the message was dropped
+    bool push(StringView topic, StringView payload, bool retain, int qos) {
+        const auto length = topic.length() + payload.length();
+        if (!_size || (length > _bytes)) {
+            ++_drops;
+            return false;
+        }
+
+        if (retain) {
+            erase(topic);
+        }
+
+        while ((_messages.size() >= _size) || ((_used + length) > _bytes)) {
+            auto it = std::find_if(_messages.begin(), _messages.end(),
+                [](const Message& message) {
+                    return message.qos == 0;
+                });
+
+            if (it == _messages.end()) {
+                if (qos == 0) {
+                    ++_drops;
+                    return false;
+                }
+
+                it = _messages.begin();
+            }
+
+            _erase(it);
+            ++_drops;
+        }
+
+        _messages.push_back(
+            Message{topic.toString(), payload.toString(), retain, qos});
+        _used += length;
+
+        return true;
+    }
+
+    // Publish at most 'count' of the oldest messages. Callback receives the message and returns
+    // whether it was sent, stopping the drain otherwise. Returns the number of sent messages
+    template <typename T>
+    size_t drain(size_t count, T&& callback) {
+        size_t out { 0 };
+
+        auto it = _messages.begin();
+        while ((it != _messages.end()) && (out < count)) {
+            if (!callback(*it)) {
+                break;
+            }
+
+            _used -= (*it).topic.length() + (*it).payload.length();
+            ++it;
+            ++out;
+        }
+
+        _messages.erase(_messages.begin(), it);
+
+        return out;
+    }
+
+    // Retained message with the same topic is outdated, when the new state was already published
+    // Returns false when nothing was removed
+    bool erase(StringView topic) {
+        const auto it = std::find_if(_messages.begin(), _messages.end(),
+            [&](const Message& message) {
+                return message.retain && (topic == message.topic);
+            });
+
+        if (it != _messages.end()) {
+            _erase(it);
+            return true;
+        }
+
+        return false;
+    }
+
+    // Any message with the same topic is still waiting to be sent
+    bool contains(StringView topic) const {
+        return std::any_of(_messages.begin(), _messages.end(),
+            [&](const Message& message) {
+                return topic == message.topic;
+            });
+    }
+
+    void clear() {
+        _messages.clear();
+        _used = 0;
+    }
+
+    bool empty() const {
+        return _messages.empty();
+    }
+
+    size_t size() const {
+        return _messages.size();
+    }
+
+    size_t bytes() const {
+        return _used;
+    }
+
+    // Total number of messages that were dropped because the queue was full
+    size_t drops() const {
+        return _drops;
+    }
+
+private:
+    using Messages = std::vector<Message>;
+
+    void _erase(Messages::iterator it) {
+        _used -= (*it).topic.length() + (*it).payload.length();
+        _messages.erase(it);
+    }
+
+    size_t _size;
+    size_t _bytes;
+
+    Messages _messages;
+    size_t _used { 0 };
+    size_t _drops { 0 };
+};
+
+} // namespace
+} // namespace mqtt
+} // namespace espurna
@@ -0,0 +1,232 @@
+/*
+
+Part of the MQTT MODULE
+
+*/
+
+#pragma once
+
+#include "types.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace espurna {
+namespace mqtt {
+
+// Values captured by the '+' and '#' wildcards of the filter, in the same order they appear in it.
+// '#' captures every remaining level including the separators, which might also be empty
+// e.g. 'relay/+' and 'relay/0' => {"0"}, 'light/#' and 'light/color/rgb' => {"color/rgb"}
+struct Match {
+    static constexpr size_t Max { 4 };
+
+    StringView topic;
+    std::array<StringView, Max> values{};
+    size_t size { 0 };
+
+    StringView operator[](size_t index) const {
+        return (index < size) ? values[index] : StringView();
+    }
+};
+
+// Topic filters are split into levels and stored as a tree, where every node is a single level
+// and '+' has its own separate branch. Incoming topic is split only once, and every level is only
+// compared with the nodes that could still match. Handlers are called in the order they were added,
+// when they share the same node. Unlike the MQTT spec, there's no special handling of '$' topics
+template <typename Handler>
+class Router {
+public:
+    // Filter is expected to be a valid MQTT topic filter, with no more than Match::Max wildcards
+    bool add(StringView filter, Handler handler) {
+        if (!filter.length() || (_handlers.size() >= None)) {
+            return false;
+        }
+
+        if (_nodes.empty()) {
+            _nodes.push_back(Node{});
+        }
+
+        size_t wildcards { 0 };
+        uint16_t node { 0 };
+
+        auto it = filter.begin();
+        for (;;) {
+            const auto next = std::find(it, filter.end(), '/');
+            const auto level = StringView(it, next);
+            const auto last = next == filter.end();
+
+            if (_wildcard(level)) {
+                if (++wildcards > Match::Max) {
+                    return false;
+                }
+
+                if (level[0] == '#') {
+                    if (!last) {
+                        return false;
+                    }
+
+                    _nodes[node].hash.push_back(_handler(handler));
+                    return true;
+                }
+
+                node = _plus(node);
+            } else if (!_valid(level)) {
+                return false;
+            } else {
+                node = _child(node, level);
+            }
+
+            if (last) {
+                break;
+            }
+
+            it = next + 1;
+        }
+
+        _nodes[node].handlers.push_back(_handler(handler));
+        return true;
+    }
+
+    // Callback receives every matching handler and the wildcard values
+    // Returns the number of matched handlers
+    template <typename Callback>
+    size_t match(StringView topic, Callback&& callback) const {
+        size_t out { 0 };
+        if (_nodes.empty() || !topic.length()) {
+            return out;
+        }
+
+        Match match;
+        match.topic = topic;
+
+        _match(0, topic.begin(), topic.end(), false, match, callback, out);
+
+        return out;
+    }
+
+    size_t size() const {
+        return _handlers.size();
+    }
+
+    void clear() {
+        _nodes.clear();
+        _handlers.clear();
+    }
+
+private:
+    static constexpr uint16_t None { UINT16_MAX };
+
+    struct Node {
+        String level;
+        uint16_t child { None };
+        uint16_t sibling { None };
+        uint16_t plus { None };
+
+        std::vector<uint16_t> handlers;
+        std::vector<uint16_t> hash;
+    };
+
+    static bool _wildcard(StringView level) {
+        return (level.length() == 1)
+            && ((level[0] == '+') || (level[0] == '#'));
+    }
+
+    static bool _valid(StringView level) {
+        return std::none_of(level.begin(), level.end(),
+            [](char c) {
+                return (c == '+') || (c == '#') || (c == '\0');
+            });
+    }
+
+    uint16_t _handler(Handler handler) {
+        _handlers.push_back(handler);
+        return _handlers.size() - 1;
+    }
+
+    uint16_t _plus(uint16_t node) {
+        if (_nodes[node].plus == None) {
+            _nodes.push_back(Node{});
+            _nodes[node].plus = _nodes.size() - 1;
+        }
+
+        return _nodes[node].plus;
+    }
+
+    uint16_t _child(uint16_t node, StringView level) {
+        uint16_t previous { None };
+        for (auto child = _nodes[node].child; child != None; child = _nodes[child].sibling) {
+            if (level == StringView(_nodes[child].level)) {
+                return child;
+            }
+
+            previous = child;
+        }
+
+        Node out;
+        out.level = level.toString();
+        _nodes.push_back(std::move(out));
+
+        const auto index = static_cast<uint16_t>(_nodes.size() - 1);
+        if (previous != None) {
+            _nodes[previous].sibling = index;
+        } else {
+            _nodes[node].child = index;
+        }
+
+        return index;
+    }
+
+    template <typename Callback>
+    void _call(const std::vector<uint16_t>& handlers, const Match& match, Callback& callback, size_t& out) const {
+        for (const auto handler : handlers) {
+            callback(_handlers[handler], match);
+            ++out;
+        }
+    }
+
+    // 'done' is set when every topic level was already consumed
+    template <typename Callback>
+    void _match(uint16_t index, const char* it, const char* end, bool done, Match& match, Callback& callback, size_t& out) const {
+        const auto& node = _nodes[index];
+
+        // '#' also matches the parent level, e.g. 'light/#' and 'light'
+        if (!node.hash.empty() && (match.size < Match::Max)) {
+            match.values[match.size++] = done
+                ? StringView() : StringView(it, end);
+            _call(node.hash, match, callback, out);
+            --match.size;
+        }
+
+        if (done) {
+            _call(node.handlers, match, callback, out);
+            return;
+        }
+
+        const auto next = std::find(it, end, '/');
+        const auto level = StringView(it, next);
+
+        const auto last = next == end;
+        const auto following = last ? end : (next + 1);
+
+        for (auto child = node.child; child != None; child = _nodes[child].sibling) {
+            if (level == StringView(_nodes[child].level)) {
+                _match(child, following, end, last, match, callback, out);
+                break;
+            }
+        }
+
+        if ((node.plus != None) && (match.size < Match::Max)) {
+            match.values[match.size++] = level;
+            _match(node.plus, following, end, last, match, callback, out);
+            --match.size;
+        }
+    }
+
+    std::vector<Node> _nodes;
+    std::vector<Handler> _handlers;
+};
+
+} // namespace mqtt
+} // namespace espurna
@@ -0,0 +1,151 @@
+/*
+
+Part of the MQTT MODULE
+
+*/
+
+#pragma once
+
+#include "types.h"
+#include "mqtt_common.ipp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace espurna {
+namespace mqtt {
+namespace {
+
+// Complete getter and setter topics for every used magnitude and index, created once and kept until
+// the root topic, getter or setter change. Topics are made from the root TopicPattern,
+// e.g. with 'home/#' and '/set', 'relay' and 0 become 'home/relay/0/set'
+//
+// Only a limited number of topics is kept. When full, the oldest entry is replaced by the new one.
+// Topics are returned as copies, since any entry may be replaced by the next call. Every entry costs
+// roughly 80 to 100 bytes of heap, depending on the length of the topic
+class TopicCache {
+public:
+    static constexpr size_t NoIndex { SIZE_MAX };
+
+    explicit TopicCache(size_t size) :
+        _size(size)
+    {}
+
+    void pattern(StringView topic, StringView getter, StringView setter) {
+        _pattern = TopicPattern(topic);
+
+        _getter = getter.toString();
+        _setter = setter.toString();
+
+        clear();
+    }
+
+    String getter(StringView magnitude, size_t index = NoIndex) {
+        return _get(Kind::Getter, magnitude, index);
+    }
+
+    String setter(StringView magnitude, size_t index = NoIndex) {
+        return _get(Kind::Setter, magnitude, index);
+    }
+
+    void clear() {
+        _entries.clear();
+        _next = 0;
+    }
+
+    size_t size() const {
+        return _entries.size();
+    }
+
+private:
+    enum class Kind : uint8_t {
+        Getter,
+        Setter,
+    };
+
+    struct Entry {
+        uint32_t hash;
+        size_t index;
+        Kind kind;
+        String magnitude;
+        String topic;
+    };
+
+    static uint32_t _hash(Kind kind, StringView magnitude, size_t index) {
+        auto out = topic_hash(magnitude);
+        out = topic_hash(StringView(
+            reinterpret_cast<const char*>(&index), sizeof(index)), out);
+        out ^= static_cast<uint32_t>(kind);
+
+        return out;
+    }
+
+    String _get(Kind kind, StringView magnitude, size_t index) {
+        const auto hash = _hash(kind, magnitude, index);
+
+        for (const auto& entry : _entries) {
+            if ((entry.hash == hash)
+                && (entry.index == index)
+                && (entry.kind == kind)
+                && (magnitude == entry.magnitude))
+            {
+                return entry.topic;
+            }
+        }
+
+        if (!_size) {
+            String out;
+            _make(out, kind, magnitude, index);
+            return out;
+        }
+
+        if (_entries.size() < _size) {
+            _entries.push_back(Entry{});
+            _next = _entries.size() - 1;
+        }
+
+        // Round-robin, replacing entries in the same order they were added
+        auto& entry = _entries[_next];
+        _next = (_next + 1) % _size;
+
+        entry.hash = hash;
+        entry.index = index;
+        entry.kind = kind;
+        entry.magnitude = magnitude.toString();
+        _make(entry.topic, kind, magnitude, index);
+
+        return entry.topic;
+    }
+
+    void _make(String& out, Kind kind, StringView magnitude, size_t index) const {
+        const auto& suffix = (kind == Kind::Getter)
+            ? _getter : _setter;
+
+        out = _pattern.prefix;
+        if (_pattern.wildcard) {
+            out.concat(magnitude.data(), magnitude.length());
+            if (index != NoIndex) {
+                out += '/';
+                out += String(index, 10);
+            }
+        }
+
+        out += _pattern.suffix;
+        out += suffix;
+    }
+
+    size_t _size;
+
+    TopicPattern _pattern;
+
+    String _getter;
+    String _setter;
+
+    std::vector<Entry> _entries;
+    size_t _next { 0 };
+};
+
+} // namespace
+} // namespace mqtt
+} // namespace espurna
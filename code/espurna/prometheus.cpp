@@ -57,9 +57,10 @@ void handler(AsyncWebServerRequest* request) {
         for (size_t index = 0; index < magnitudeCount(); ++index) {
             auto value = magnitudeValue(index);
             if (value) {
-                value.topic.replace("/", "");
+                auto topic = value.topic();
+                topic.replace("/", "");
                 response->printf_P(PSTR("%s %s\n"),
-                    value.topic.c_str(), value.repr.c_str());
+                    topic.c_str(), value.repr().c_str());
             }
         }
     }
@@ -35,6 +35,8 @@ Copyright (C) 2019-2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com
 #include "terminal.h"
 #include "utils.h"
 
+#include "relay_deadlines.ipp"
+
 #include <ArduinoJson.h>
 
 #include <bitset>
@@ -1043,6 +1045,18 @@ PayloadStatus mqttDisconnectionStatus(size_t index) {
 
 #endif
 
+// Needed on every status change. Only read and convert these again after settings change
+namespace cached {
+
+espurna::settings::CachedIndexed<RelayBoot> bootMode { settings::bootMode };
+
+#if MQTT_SUPPORT
+espurna::settings::CachedIndexed<String> mqttTopicPub { settings::mqttTopicPub };
+espurna::settings::CachedIndexed<RelayMqttTopicMode> mqttTopicMode { settings::mqttTopicMode };
+#endif
+
+} // namespace cached
+
 } // namespace
 
 namespace query {
@@ -1325,6 +1339,16 @@ using Relays = std::vector<Relay>;
 Relays _relays;
 size_t _relayDummy { 0ul };
 
+espurna::relay::Deadlines<Relay::TimeSource, RelaysMax> _relay_deadlines;
+
+// Relay is processed when its change delay expires, or on the next loop when there is no delay
+void _relayScheduleChange(size_t id) {
+    const auto& relay = _relays[id];
+    _relay_deadlines.update(id,
+        relay.current_status != relay.target_status,
+        relay.change_start, relay.change_delay);
+}
+
 espurna::duration::Milliseconds _relay_flood_window { espurna::relay::flood::build::window() };
 unsigned long _relay_flood_changes { espurna::relay::flood::build::changes() };
 
@@ -1404,6 +1428,12 @@ void RelayProviderBase::boot(bool) {
 void RelayProviderBase::notify(bool) {
 }
 
+void RelayProviderBase::changeMany(const RelayProviderChange* begin, const RelayProviderChange* end) {
+    for (auto it = begin; it != end; ++it) {
+        (*it).provider->change((*it).status);
+    }
+}
+
 // Direct status notifications
 
 void relayOnStatusNotify(RelayStatusCallback callback) {
@@ -1424,6 +1454,13 @@ struct GpioProvider : public RelayProviderBase {
         _reset_pin(std::move(reset_pin))
     {}
 
+    GpioProvider(GpioBase* base, RelayType type, std::unique_ptr<BasePin>&& pin, std::unique_ptr<BasePin>&& reset_pin) :
+        _base(base),
+        _type(type),
+        _pin(std::move(pin)),
+        _reset_pin(std::move(reset_pin))
+    {}
+
     espurna::StringView id() const override {
         return espurna::relay::settings::options::RelayProviderGpio;
     }
@@ -1474,7 +1511,55 @@ struct GpioProvider : public RelayProviderBase {
         }
     }
 
+    // normal and inverse relays sharing the same gpio base are changed with a single write,
+    // latched ones still need to pulse their pins one by one
+    void changeMany(const RelayProviderChange* begin, const RelayProviderChange* end) override {
+        const auto size = static_cast<size_t>(end - begin);
+        RelayMaskHelper done;
+
+        for (size_t index = 0; index < size; ++index) {
+            if (done[index]) {
+                continue;
+            }
+
+            auto* provider = static_cast<GpioProvider*>(begin[index].provider);
+            if (!provider->_direct()) {
+                provider->change(begin[index].status);
+                continue;
+            }
+
+            uint32_t mask { 0 };
+            uint32_t values { 0 };
+
+            for (size_t other = index; other < size; ++other) {
+                auto* next = static_cast<GpioProvider*>(begin[other].provider);
+                if (!done[other] && next->_direct() && (next->_base == provider->_base)) {
+                    const auto bit = uint32_t{1} << next->_pin->pin();
+                    mask |= bit;
+                    if (next->_level(begin[other].status)) {
+                        values |= bit;
+                    }
+
+                    done.set(other, true);
+                }
+            }
+
+            provider->_base->write(mask, values);
+        }
+    }
+
 private:
+    bool _direct() const {
+        return _base
+            && (_pin->pin() < 32)
+            && ((_type == RelayType::Normal) || (_type == RelayType::Inverse));
+    }
+
+    bool _level(bool status) const {
+        return (_type == RelayType::Inverse) ? !status : status;
+    }
+
+    GpioBase* _base { nullptr };
     RelayType _type { RelayType::Normal };
     std::unique_ptr<BasePin> _pin;
     std::unique_ptr<BasePin> _reset_pin;
@@ -1648,6 +1733,30 @@ public:
         }
     }
 
+    // co-MCU protocol does not have a multi-relay command, but every packet can still be sent as part of a single write
+    void changeMany(const RelayProviderChange* begin, const RelayProviderChange* end) override {
+        if (!_port) {
+            return;
+        }
+
+        uint8_t buffer[RelaysMax * 4];
+        size_t size { 0 };
+
+        for (auto it = begin; it != end; ++it) {
+            const auto id = static_cast<StmProvider*>((*it).provider)->_id;
+            const auto status = static_cast<uint8_t>((*it).status);
+
+            buffer[size++] = 0xA0;
+            buffer[size++] = id + 1;
+            buffer[size++] = status;
+            buffer[size++] = 0xA1 + status + id;
+        }
+
+        _port->flush();
+        _port->write(buffer, size);
+        _port->flush();
+    }
+
 private:
     size_t _id;
     static Stream* _port;
@@ -1697,6 +1806,49 @@ bool _relayHandlePayload(size_t id, espurna::StringView payload) {
     return false;
 }
 
+uint32_t _relayMaskAll() {
+    const auto relays = _relays.size();
+    return (relays < RelaysMax)
+        ? ((uint32_t{1} << relays) - 1)
+        : UINT32_MAX;
+}
+
+RelayMaskHelper _relayMaskTarget() {
+    RelayMaskHelper out;
+    for (size_t id = 0; id < _relays.size(); ++id) {
+        out.set(id, _relays[id].target_status);
+    }
+
+    return out;
+}
+
+// Either '<status>' applied to every relay, or '<mask>,<status>'. Bit N of both is the relay N,
+// values are unsigned numbers and may use 0b, 0o or 0x prefix e.g. '0b11,0b01' or '0xff'
+[[gnu::unused]]
+bool _relayHandleMaskPayload(espurna::StringView payload) {
+    auto mask = _relayMaskAll();
+    auto status = payload;
+
+    const auto it = std::find(payload.begin(), payload.end(), ',');
+    if (it != payload.end()) {
+        const auto parsed = parseUnsigned(espurna::StringView(payload.begin(), it));
+        if (!parsed.ok) {
+            return false;
+        }
+
+        mask &= parsed.value;
+        status = espurna::StringView(it + 1, payload.end());
+    }
+
+    const auto parsed = parseUnsigned(status);
+    if (!parsed.ok) {
+        return false;
+    }
+
+    relayStatusMask(mask, parsed.value);
+    return true;
+}
+
 // Initialize pulse timers after ON or OFF event
 // TODO: integrate with scheduled ON or OFF?
 
@@ -1900,6 +2052,7 @@ void _relaySyncRelaysDelay(size_t first, size_t second) {
         _relays[first].change_delay,
         _relays[second].change_delay
     });
+    _relayScheduleChange(second);
 }
 
 void _relayPrepareUnlock() {
@@ -2035,6 +2188,7 @@ bool _relayStatus(size_t id, bool status, bool report, bool group_report) {
     auto& relay = _relays[id];
 
     if (!_relayStatusCheckLock(relay, status)) {
+        _relayScheduleChange(id);
         relay.report = true;
         relay.group_report = true;
         DEBUG_MSG_P(PSTR("[RELAY] #%u is locked to %s\n"),
@@ -2050,6 +2204,7 @@ bool _relayStatus(size_t id, bool status, bool report, bool group_report) {
             relay.report = false;
             relay.group_report = false;
             relay.change_delay = Relay::Delay::zero();
+            _relay_deadlines.cancel(id);
             changed = true;
         }
 
@@ -2095,6 +2250,7 @@ bool _relayStatus(size_t id, bool status, bool report, bool group_report) {
         relay.report = report;
         relay.group_report = group_report;
 
+        _relayScheduleChange(id);
         _relaySync(id);
         changed = true;
 
@@ -2107,8 +2263,53 @@ bool _relayStatus(size_t id, bool status, bool report, bool group_report) {
     return changed;
 }
 
+// Sync mode and interlock delays are only evaluated once, after every relay in the mask was changed
+// Sync target is the first changed relay, preferring the one turned ON so 'One' modes would keep it
+bool _relayStatusMask(uint32_t mask, uint32_t status, bool report, bool group_report) {
+    const auto relays = _relays.size();
+
+    size_t target { RelaysMax };
+    bool changed { false };
+
+    {
+        auto lock = espurna::ReentryLock{ _relay_sync_reent };
+        for (size_t id = 0; id < relays; ++id) {
+            const auto bit = uint32_t{1} << id;
+            if ((mask & bit) == 0) {
+                continue;
+            }
+
+            const bool value = (status & bit) != 0;
+            if (_relayStatus(id, value, report, group_report)) {
+                changed = true;
+                if ((target == RelaysMax) || (value && !_relays[target].target_status)) {
+                    target = id;
+                }
+            }
+        }
+    }
+
+    if (target != RelaysMax) {
+        _relaySync(target);
+    }
+
+    return changed;
+}
+
 } // namespace
 
+bool relayStatusMask(uint32_t mask, uint32_t status, bool report, bool group_report) {
+    return _relayStatusMask(mask, status, report, group_report);
+}
+
+bool relayStatusMask(uint32_t mask, uint32_t status) {
+#if MQTT_SUPPORT
+    return relayStatusMask(mask, status, mqttForward(), true);
+#else
+    return relayStatusMask(mask, status, false, true);
+#endif
+}
+
 bool relayStatus(size_t id, bool status, bool report, bool group_report) {
     if (id < _relays.size()) {
         return _relayStatus(id, status, report, group_report);
@@ -2176,7 +2377,7 @@ void _relaySave() {
 }
 
 void _relayScheduleSave(size_t id) {
-    switch (espurna::relay::settings::bootMode(id)) {
+    switch (espurna::relay::settings::cached::bootMode(id)) {
     case RelayBoot::Same:
     case RelayBoot::Toggle:
         _relay_save_timer.persist();
@@ -2322,6 +2523,7 @@ void _relayBoot(size_t index, const RelayMaskHelper& mask) {
         : relay.delay_off;
 
     relay.provider->boot(status);
+    _relayScheduleChange(index);
 }
 
 void _relayBootAll() {
@@ -2531,6 +2733,16 @@ void relaySetupAPI() {
         }
     );
 
+    apiRegister(F(MQTT_TOPIC_RELAYS),
+        [](ApiRequest& request) {
+            request.send(_relayMaskTarget().toString());
+            return true;
+        },
+        [](ApiRequest& request) {
+            return _relayHandleMaskPayload(request.param(F("value")));
+        }
+    );
+
     apiRegister(F(MQTT_TOPIC_PULSE "/+"),
         [](ApiRequest& request) {
             return _relayApiTryHandle(request, [&](size_t id) {
@@ -2679,6 +2891,7 @@ private:
 
 void _relayMqttSubscribeBaseTopics() {
     mqttSubscribe(MQTT_TOPIC_RELAY "/+");
+    mqttSubscribe(MQTT_TOPIC_RELAYS);
     mqttSubscribe(MQTT_TOPIC_PULSE "/+");
     mqttSubscribe(MQTT_TOPIC_TIMER "/+");
     mqttSubscribe(MQTT_TOPIC_LOCK "/+");
@@ -2718,14 +2931,14 @@ void _relayMqttSubscribeCustomTopics() {
 }
 
 void _relayMqttPublishCustomTopic(size_t id) {
-    const auto topic = espurna::relay::settings::mqttTopicPub(id);
+    const auto& topic = espurna::relay::settings::cached::mqttTopicPub(id);
     if (!topic.length()) {
         return;
     }
 
     auto status = _relayPayloadStatus(id);
 
-    auto mode = espurna::relay::settings::mqttTopicMode(id);
+    const auto mode = espurna::relay::settings::cached::mqttTopicMode(id);
     if (mode == RelayMqttTopicMode::Inverse) {
         status = _relayInvertStatus(status);
     }
@@ -2855,23 +3068,23 @@ void _relayMqttHandleConnect() {
     _relay_mqtt_timer.stop();
 }
 
-struct RelayMqttTopicHandler {
-    using Handler = bool(*)(size_t, espurna::StringView);
-    espurna::StringView topic;
-    Handler handler;
-};
+using RelayMqttPayloadHandler = bool(*)(size_t, espurna::StringView);
+
+// Every base topic is '<topic>/+', where wildcard is the relay ID
+template <RelayMqttPayloadHandler Handler>
+void _relayMqttRoute(const espurna::mqtt::Match& match, espurna::StringView payload) {
+    size_t id;
+    if (!_relayTryParseId(match[0], id)) {
+        return;
+    }
 
-PROGMEM_STRING(MqttTopicRelay, MQTT_TOPIC_RELAY);
-PROGMEM_STRING(MqttTopicPulse, MQTT_TOPIC_PULSE);
-PROGMEM_STRING(MqttTopicTimer, MQTT_TOPIC_TIMER);
-PROGMEM_STRING(MqttTopicLock, MQTT_TOPIC_LOCK);
+    Handler(id, payload);
+    _relays[id].report = mqttForward();
+}
 
-static constexpr RelayMqttTopicHandler RelayMqttTopicHandlers[] PROGMEM {
-    {MqttTopicRelay, _relayHandlePayload},
-    {MqttTopicPulse, _relayHandlePulsePayload},
-    {MqttTopicTimer, _relayHandleTimerPayload},
-    {MqttTopicLock, _relayHandleLockPayload},
-};
+void _relayMqttRouteMask(const espurna::mqtt::Match&, espurna::StringView payload) {
+    _relayHandleMaskPayload(payload);
+}
 
 } // namespace
 
@@ -2887,23 +3100,8 @@ void relayMQTTCallback(unsigned int type, espurna::StringView topic, espurna::St
         return;
     }
 
+    // Base topics are handled by the routes below
     if (type == MQTT_MESSAGE_EVENT) {
-        const auto t = mqttMagnitude(topic);
-
-        for (const auto pair: RelayMqttTopicHandlers) {
-            if (t.startsWith(pair.topic)) {
-                size_t id;
-                if (!_relayTryParseIdFromPath(t, id)) {
-                    return;
-                }
-
-                pair.handler(id, payload);
-                _relays[id].report = mqttForward();
-
-                return;
-            }
-        }
-
         _relayMqttHandleCustomTopic(topic, payload);
         return;
     }
@@ -2921,6 +3119,12 @@ void relayMQTTCallback(unsigned int type, espurna::StringView topic, espurna::St
 void relaySetupMQTT() {
     mqttHeartbeat(_relayMqttHeartbeat);
     mqttRegister(relayMQTTCallback);
+
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_RELAY "/+"), _relayMqttRoute<_relayHandlePayload>);
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_RELAYS), _relayMqttRouteMask);
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_PULSE "/+"), _relayMqttRoute<_relayHandlePulsePayload>);
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_TIMER "/+"), _relayMqttRoute<_relayHandleTimerPayload>);
+    mqttRoute(STRING_VIEW(MQTT_TOPIC_LOCK "/+"), _relayMqttRoute<_relayHandleLockPayload>);
 }
 
 #endif
@@ -3145,8 +3349,36 @@ static void _relayCommandUnlock(::terminal::CommandContext&& ctx) {
     terminalOK(ctx);
 }
 
+PROGMEM_STRING(MaskCommand, "RELAY.MASK");
+
+// Same payload as the 'relays' topic, status of every relay is printed back as a mask
+static void _relayCommandMask(::terminal::CommandContext&& ctx) {
+    if (ctx.argv.size() > 3) {
+        terminalError(ctx, F("RELAY.MASK [[<MASK>] <STATUS>]"));
+        return;
+    }
+
+    if (ctx.argv.size() > 1) {
+        String payload;
+        if (ctx.argv.size() == 3) {
+            payload += ctx.argv[1];
+            payload += ',';
+        }
+        payload += ctx.argv.back();
+
+        if (!_relayHandleMaskPayload(payload)) {
+            terminalError(ctx, F("Invalid mask or status"));
+            return;
+        }
+    }
+
+    ctx.output.printf_P(PSTR("%s\n"), _relayMaskTarget().toString().c_str());
+    terminalOK(ctx);
+}
+
 static constexpr ::terminal::Command RelayCommands[] PROGMEM {
     {RelayCommand, _relayCommand},
+    {MaskCommand, _relayCommandMask},
     {PulseCommand, _relayCommandPulse},
     {TimerCommand, _relayCommandTimer},
     {LockCommand, _relayCommandLock},
@@ -3183,32 +3415,71 @@ void _relayReport() {
 #endif
 }
 
+// Providers sharing the same id() receive their changes at the same time.
+// Group is moved to the front of the range without changing the relative order
+void _relayProviderChange(RelayProviderChange* begin, RelayProviderChange* end) {
+    while (begin != end) {
+        const auto id = (*begin).provider->id();
+
+        auto last = begin + 1;
+        for (auto it = last; it != end; ++it) {
+            if ((*it).provider->id() == id) {
+                std::rotate(last, it, it + 1);
+                ++last;
+            }
+        }
+
+        (*begin).provider->changeMany(begin, last);
+        begin = last;
+    }
+}
+
 /**
  * Walks the relay vector processing only those relays
  * that have to change to the requested mode
  * @bool mode Requested mode
+ * @RelayMaskHelper due Relays with expired deadlines
  */
-bool _relayProcess(bool mode) {
+bool _relayProcess(bool mode, const RelayMaskHelper& due) {
     const auto relays = _relays.size();
-    bool changed { false };
+
+    std::array<RelayProviderChange, RelaysMax> changes;
+    RelayMaskHelper mask;
+    size_t size { 0 };
 
     for (size_t id = 0; id < relays; ++id) {
         // Only process the relays:
         // - target mode in the one requested by the arg
         // - target status is different from the current one
-        // - change delay has expired
+        // - change delay has expired, and it was not re-scheduled while processing the other mode
         const bool target { _relays[id].target_status };
 
-        if ((target != _relays[id].current_status)
+        if (due[id]
+            && (target != _relays[id].current_status)
             && (target == mode)
-            && ((!_relays[id].change_delay.count())
-                || (Relay::TimeSource::now() - _relays[id].change_start > _relays[id].change_delay)))
+            && !_relay_deadlines.scheduled(id))
         {
             // delay will be reset back to the correct value via relayStatus
             _relays[id].change_delay = Relay::Delay::zero();
             _relays[id].current_status = target;
-            _relays[id].provider->change(target);
 
+            changes[size++] = RelayProviderChange{
+                .provider = _relays[id].provider,
+                .status = target,
+            };
+            mask.set(id, true);
+        }
+    }
+
+    if (!size) {
+        return false;
+    }
+
+    _relayProviderChange(changes.data(), changes.data() + size);
+
+    for (size_t id = 0; id < relays; ++id) {
+        if (mask[id]) {
+            const bool target { _relays[id].current_status };
             _relayReport(id, target);
 
             // try to immediately schedule 'normal' state
@@ -3216,13 +3487,12 @@ bool _relayProcess(bool mode) {
 
             // and make sure relay values are persisted in RAM and flash
             _relayScheduleSave(id);
-            changed = true;
 
             DEBUG_MSG_P(PSTR("[RELAY] #%u set to %s\n"), id, target ? PSTR("ON") : PSTR("OFF"));
         }
     }
 
-    return changed;
+    return true;
 }
 
 } // namespace
@@ -3233,16 +3503,21 @@ bool _relayProcess(bool mode) {
 
 namespace {
 
-void _relayLoop() {
-    const bool changed[] {
-        _relayProcess(false),
-        _relayProcess(true),
-    };
+// Nothing to check besides the earliest deadline, when relays are not changing
+void _relayProcessDeadlines() {
+    const auto changed = _relay_deadlines.process(
+        [](bool mode, RelayMaskHelper::IntegralType due) {
+            return _relayProcess(mode, RelayMaskHelper(due));
+        });
 
-    if (changed[0] || changed[1]) {
+    if (changed) {
         _relayRemoveCompletedPulse();
         _relayPrepareUnlock();
     }
+}
+
+void _relayLoop() {
+    _relayProcessDeadlines();
 
     _relayProcessUnlock();
 
@@ -3339,7 +3614,7 @@ std::unique_ptr<GpioProvider> _relayGpioProvider(size_t index, RelayType type) {
     }
 
     return std::make_unique<GpioProvider>(
-        type, std::move(main), std::move(reset));
+        base, type, std::move(main), std::move(reset));
 }
 
 RelayProviderBasePtr _relaySetupProvider(size_t index) {
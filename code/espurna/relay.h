@@ -18,6 +18,13 @@ Copyright (C) 2016-2019 by Xose Pérez <xose dot perez at gmail dot com>
 
 constexpr size_t RelaysMax { 32ul };
 
+class RelayProviderBase;
+
+struct RelayProviderChange {
+    RelayProviderBase* provider;
+    bool status;
+};
+
 class RelayProviderBase {
 public:
     RelayProviderBase() = default;
@@ -35,6 +42,11 @@ public:
     // when relay 'status' is changed from target to current
     virtual void change(bool status) = 0;
 
+    // when multiple relays are changed at the same time. called once for every
+    // group of providers sharing the same id(), including this one
+    // by default, same as calling change() for every provider in the group
+    virtual void changeMany(const RelayProviderChange* begin, const RelayProviderChange* end);
+
     // unique id of the provider
     virtual espurna::StringView id() const = 0;
 };
@@ -44,6 +56,11 @@ PayloadStatus relayParsePayload(espurna::StringView);
 bool relayStatus(size_t id, bool status, bool report, bool group_report);
 bool relayStatus(size_t id, bool status);
 
+// change every relay in the 'mask' to the matching bit of 'status' at the same time,
+// with sync mode and interlock evaluated once for the whole batch
+bool relayStatusMask(uint32_t mask, uint32_t status, bool report, bool group_report);
+bool relayStatusMask(uint32_t mask, uint32_t status);
+
 // gets either current or target status, where current is the status that we are
 // actually in and target is the status we would be, eventually, unless
 // relayStatus(id, relayStatus()) is called
@@ -0,0 +1,183 @@
+/*
+
+Part of the RELAY MODULE
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+namespace espurna {
+namespace relay {
+namespace {
+
+// Pending relay changes, ordered by the time they are due. Loop only needs to look at the earliest one,
+// so nothing else is checked while it is still in the future or when nothing is scheduled at all.
+// Every relay has at most one deadline, scheduling it again replaces the previous one.
+//
+// Time source is expected to wrap around. Deadlines are compared relative to each other and to the
+// current time, which works as long as they are less than half of the time range apart.
+// Same as 'now - start > delay', except that zero delay expires immediately
+template <typename TimeSource, size_t Size>
+class Deadlines {
+public:
+    static_assert(Size <= 32, "");
+
+    using Duration = typename TimeSource::duration;
+    using TimePoint = typename TimeSource::time_point;
+    using Mask = uint32_t;
+
+    void schedule(size_t id, TimePoint start, Duration delay) {
+        if (id >= Size) {
+            return;
+        }
+
+        _erase(id);
+
+        _entries[_size++] = Entry{
+            .due = delay.count()
+                ? (start + delay + Duration(1))
+                : start,
+            .id = static_cast<uint8_t>(id),
+        };
+        std::push_heap(_entries.begin(), _entries.begin() + _size, Later{});
+
+        _ids |= _bit(id);
+    }
+
+    void cancel(size_t id) {
+        if (id < Size) {
+            _erase(id);
+        }
+    }
+
+    // Deadline is only kept while the relay still has to change
+    void update(size_t id, bool changing, TimePoint start, Duration delay) {
+        if (changing) {
+            schedule(id, start, delay);
+        } else {
+            cancel(id);
+        }
+    }
+
+    bool scheduled(size_t id) const {
+        return (id < Size) && ((_ids & _bit(id)) != 0);
+    }
+
+    bool pending() const {
+        return _size != 0;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    // Only checks the earliest deadline
+    bool expired(TimePoint now) const {
+        return _size && _expired(_entries[0], now);
+    }
+
+    // Removes every expired deadline, returning their ids as a bitmask
+    Mask expire(TimePoint now) {
+        Mask out { 0 };
+
+        while (_size && _expired(_entries[0], now)) {
+            std::pop_heap(_entries.begin(), _entries.begin() + _size, Later{});
+            --_size;
+
+            const auto bit = _bit(_entries[_size].id);
+            _ids &= ~bit;
+            out |= bit;
+        }
+
+        return out;
+    }
+
+    void clear() {
+        _size = 0;
+        _ids = 0;
+    }
+
+    // Loop side of the deadlines, nothing besides the earliest one is checked until it expires
+    // Callback receives the mode and the expired ids, OFF changes are always processed before the ON ones
+    // Returns 'true' when callback reported any changes
+    template <typename T>
+    bool process(T&& callback) {
+        if (!_size) {
+            return false;
+        }
+
+        const auto now = TimeSource::now();
+        if (!expired(now)) {
+            return false;
+        }
+
+        const auto due = expire(now);
+
+        const bool changed[] {
+            callback(false, due),
+            callback(true, due),
+        };
+
+        return changed[0] || changed[1];
+    }
+
+private:
+    using Signed = typename std::make_signed<typename Duration::rep>::type;
+
+    struct Entry {
+        TimePoint due;
+        uint8_t id;
+    };
+
+    static constexpr Mask _bit(size_t id) {
+        return Mask{1} << id;
+    }
+
+    static Signed _difference(TimePoint lhs, TimePoint rhs) {
+        return static_cast<Signed>((lhs - rhs).count());
+    }
+
+    // std heap functions keep the 'largest' element at the front, so the order is reversed
+    struct Later {
+        bool operator()(const Entry& lhs, const Entry& rhs) const {
+            return _difference(lhs.due, rhs.due) > 0;
+        }
+    };
+
+    static bool _expired(const Entry& entry, TimePoint now) {
+        return _difference(now, entry.due) >= 0;
+    }
+
+    void _erase(size_t id) {
+        if ((_ids & _bit(id)) == 0) {
+            return;
+        }
+
+        const auto begin = _entries.begin();
+        const auto end = begin + _size;
+
+        const auto it = std::find_if(begin, end,
+            [&](const Entry& entry) {
+                return entry.id == id;
+            });
+
+        *it = *(end - 1);
+        --_size;
+        std::make_heap(begin, begin + _size, Later{});
+
+        _ids &= ~_bit(id);
+    }
+
+    std::array<Entry, Size> _entries{};
+    size_t _size { 0 };
+    Mask _ids { 0 };
+};
+
+} // namespace
+} // namespace relay
+} // namespace espurna
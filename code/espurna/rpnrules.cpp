@@ -825,6 +825,17 @@ void init(rpn_context& context) {
         ::lightChannel(id.toUint(), id.toInt());
         return 0;
     });
+
+    rpn_operator_set(context, "scene", 1, [](rpn_context& ctxt) -> rpn_error {
+        rpn_value id;
+        rpn_stack_pop(ctxt, id);
+
+        if (!::lightSceneRecall(id.toUint())) {
+            return rpn_operator_error::CannotContinue;
+        }
+
+        return 0;
+    });
 }
 
 } // namespace light
@@ -1103,18 +1114,46 @@ void init(rpn_context& context) {
 #if SENSOR_SUPPORT
 namespace sensor {
 
+String variableName(const espurna::sensor::Value& value) {
+    auto out = value.topic();
+    out.replace("/", "");
+
+    return out;
+}
+
 void updateVariables(const espurna::sensor::Value& value) {
     static_assert(std::is_same<decltype(value.value), rpn_float>::value, "");
 
-    auto topic = value.topic;
-    topic.replace("/", "");
-
     rpn_variable_set(internal::context,
-            topic, rpn_value(static_cast<rpn_float>(value.value)));
+            variableName(value), rpn_value(static_cast<rpn_float>(value.value)));
+}
+
+// Only track magnitudes that some rule might refer to
+bool filterVariables(const espurna::sensor::Value& value) {
+    const auto name = String('$') + variableName(value);
+
+    size_t index { 0 };
+    String rule;
+    for (;;) {
+        rule = settings::rule(index++);
+        if (!rule.length()) {
+            break;
+        }
+
+        if (rule.indexOf(name) >= 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void configure() {
+    sensorUpdateMagnitudeRead();
 }
 
 void init(rpn_context&) {
-    sensorOnMagnitudeRead(updateVariables);
+    sensorOnMagnitudeRead(updateVariables, filterVariables);
 }
 
 } // namespace sensor
@@ -1337,6 +1376,10 @@ void configure() {
     }
 #endif
     internal::run_delay = rpnrules::settings::delay();
+
+#if SENSOR_SUPPORT
+    sensor::configure();
+#endif
 }
 
 void setup() {
@@ -25,7 +25,7 @@ Copyright (C) 2019 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
 #define RTCMEM_BLOCKS 96u
 
 // Change this when modifying RtcmemData
-#define RTCMEM_MAGIC 0x46535076
+#define RTCMEM_MAGIC 0x46535077
 
 // XXX: All access must be 4-byte aligned and always at full length.
 //      Exactly like PROGMEM works. For example, using bitfields / inner structs / etc:
@@ -42,9 +42,12 @@ Copyright (C) 2019 by Maxim Prokhorov <prokhorov dot max at outlook dot com>
 // TODO replace with custom memory segment in ldscript?
 //      `magic` would need to be tracked differently
 
+// Checksum is expected to be updated with every write, any mismatch
+// means that value was only partially written and should not be used
 struct RtcmemEnergy {
     uint32_t kwh;
     uint32_t ws;
+    uint32_t checksum;
 };
 
 struct RtcmemData {
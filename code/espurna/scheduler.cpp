@@ -1621,6 +1621,17 @@ void action(SplitStringView split) {
     lightUpdate();
 }
 
+void scene(SplitStringView split) {
+    if (!split.next()) {
+        return;
+    }
+
+    size_t id;
+    if (tryParseId(split.current(), lightScenes(), id)) {
+        lightSceneRecall(id);
+    }
+}
+
 } // namespace light
 #endif
 
@@ -1667,6 +1678,11 @@ void parse_action(String action) {
         light::action(split);
         return;
     }
+
+    if (current == STRING_VIEW("scene")) {
+        light::scene(split);
+        return;
+    }
 #endif
 #if CURTAIN_SUPPORT
     if (current == STRING_VIEW("curtain")) {
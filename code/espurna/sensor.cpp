@@ -383,20 +383,29 @@ public:
     Magnitude(Magnitude&& other) noexcept = default;
     Magnitude& operator=(Magnitude&&) noexcept = default;
 
-    Magnitude(BaseSensorPtr, unsigned char slot, unsigned char type);
+    Magnitude(BaseSensorPtr, size_t index, unsigned char slot, unsigned char type);
 
     BaseSensorPtr sensor; // Sensor object, *cannot be empty*
     unsigned char slot; // Sensor slot # taken by the magnitude, used to access the measurement
     unsigned char type; // Type of measurement, returned by the BaseSensor::type(slot)
 
+    size_t index; // Position in the magnitudes list, also used to access the per-read state
     unsigned char index_global; // N'th magnitude of it's type, across all of the active sensors
 
     Unit units { Unit::None }; // Current units of measurement
     unsigned char decimals { 0u }; // Number of decimals in textual representation
 
+    duration::Seconds read_interval {}; // Sensor is read at the shortest interval of all of its magnitudes
+
     Filter filter_type; // Instead of using raw value, filter it through a filter object
     BaseFilterPtr filter; // *cannot be empty*, instance should be created based on the type above
+};
 
+// Everything that is accessed on every read is kept outside of the Magnitude,
+// in a separate list with the same order. Reading loop only walks through this one
+// instead of jumping over the rest of the (mostly unused at that point) Magnitude fields
+struct Reading {
+    Unit input { Unit::None }; // Units of the sensor slot value, expected to never change after begin()
     size_t read_count { 0 }; // Number of times 'last' was updated
 
     ValuePair last = DefaultValuePair; // Last 'read' value
@@ -410,6 +419,8 @@ public:
 
     double zero_threshold { Value::Unknown }; // Reset value to zero when equal or below threshold (applied when reading)
     double correction { 0.0 }; // Value correction (applied when reading)
+
+    uint32_t read_handlers { 0 }; // Read handlers interested in this magnitude, one bit per handler
 };
 
 static_assert(
@@ -422,10 +433,11 @@ static_assert(
     "std::vector<Magnitude> should only use move ctor"
 );
 
-Magnitude::Magnitude(BaseSensorPtr sensor, unsigned char slot, unsigned char type) :
+Magnitude::Magnitude(BaseSensorPtr sensor, size_t index, unsigned char slot, unsigned char type) :
     sensor(std::move(sensor)),
     slot(slot),
     type(type),
+    index(index),
     index_global(_counts[type])
 {
     ++_counts[type];
@@ -788,6 +800,10 @@ constexpr espurna::duration::Seconds readInterval() {
     return espurna::duration::Seconds(SENSOR_READ_INTERVAL);
 }
 
+constexpr espurna::duration::Milliseconds readBudget() {
+    return espurna::duration::Milliseconds(SENSOR_READ_BUDGET);
+}
+
 constexpr size_t ReportEveryMin PROGMEM { SENSOR_REPORT_MIN_EVERY };
 constexpr size_t ReportEveryMax PROGMEM { SENSOR_REPORT_MAX_EVERY };
 
@@ -799,6 +815,14 @@ constexpr size_t saveEvery() {
     return SENSOR_SAVE_EVERY;
 }
 
+constexpr espurna::duration::Seconds saveInterval() {
+    return espurna::duration::Seconds(SENSOR_SAVE_INTERVAL);
+}
+
+constexpr double saveDelta() {
+    return SENSOR_SAVE_DELTA;
+}
+
 constexpr bool realTimeValues() {
     return SENSOR_REAL_TIME_VALUES == 1;
 }
@@ -1003,14 +1027,19 @@ PROGMEM_STRING(Total, "Total");
 
 PROGMEM_STRING(Filter, "Filter");
 
+PROGMEM_STRING(ReadInterval, "ReadInterval");
+
 } // namespace suffix
 
 namespace keys {
 
 PROGMEM_STRING(ReadInterval, "snsRead");
+PROGMEM_STRING(ReadBudget, "snsBudget");
 PROGMEM_STRING(InitInterval, "snsInit");
 PROGMEM_STRING(ReportEvery, "snsReport");
 PROGMEM_STRING(SaveEvery, "snsSave");
+PROGMEM_STRING(SaveInterval, "snsSaveInterval");
+PROGMEM_STRING(SaveDelta, "snsSaveDelta");
 PROGMEM_STRING(RealTimeValues, "snsRealTime");
 
 espurna::settings::Key get(espurna::StringView prefix, espurna::StringView suffix, size_t index) {
@@ -1033,6 +1062,10 @@ espurna::duration::Seconds readInterval() {
             build::ReadIntervalMin, build::ReadIntervalMax);
 }
 
+espurna::duration::Milliseconds readBudget() {
+    return getSetting(FPSTR(keys::ReadBudget), build::readBudget());
+}
+
 espurna::duration::Seconds initInterval() {
     return std::clamp(getSetting(FPSTR(keys::InitInterval), build::initInterval()),
             build::ReadIntervalMin, build::ReadIntervalMax);
@@ -1047,6 +1080,14 @@ int saveEvery() {
     return getSetting(FPSTR(keys::SaveEvery), build::saveEvery());
 }
 
+espurna::duration::Seconds saveInterval() {
+    return getSetting(FPSTR(keys::SaveInterval), build::saveInterval());
+}
+
+double saveDelta() {
+    return std::max(getSetting(FPSTR(keys::SaveDelta), build::saveDelta()), 0.0);
+}
+
 bool realTimeValues() {
     return getSetting(FPSTR(keys::RealTimeValues), build::realTimeValues());
 }
@@ -1667,18 +1708,30 @@ ValuePair process(const Magnitude& magnitude, double value, Unit units) {
 }
 
 ValuePair process(const Magnitude& magnitude, ValuePair value) {
-    return process(magnitude, value.value,
-        magnitude.sensor->units(magnitude.slot));
+    return process(magnitude, value.value, value.units);
 }
 
 namespace internal {
 
 std::vector<Magnitude> magnitudes;
+std::vector<Reading> readings;
+
+// Topics depend on the number of magnitudes of the same type,
+// list is re-created after any magnitude is added
+std::vector<String> topics;
 bool real_time { sensor::build::realTimeValues() };
 
-using ReadHandlers = std::forward_list<MagnitudeReadHandler>;
-ReadHandlers read_handlers;
-ReadHandlers report_handlers;
+struct ReadHandler {
+    MagnitudeReadHandler handler;
+    MagnitudeReadFilter filter;
+};
+
+// Reading mask limits the number of read handlers
+constexpr size_t ReadHandlersMax { 32 };
+std::vector<ReadHandler> read_handlers;
+
+using ReportHandlers = std::forward_list<MagnitudeReadHandler>;
+ReportHandlers report_handlers;
 
 } // namespace internal
 
@@ -1691,7 +1744,8 @@ size_t count() {
 }
 
 Magnitude& add(BaseSensorPtr sensor, unsigned char slot, unsigned char type) {
-    internal::magnitudes.emplace_back(sensor, slot, type);
+    internal::magnitudes.emplace_back(sensor, internal::magnitudes.size(), slot, type);
+    internal::readings.emplace_back();
     return internal::magnitudes.back();
 }
 
@@ -1721,6 +1775,14 @@ Magnitude& get(size_t index) {
     return internal::magnitudes[index];
 }
 
+Reading& reading(size_t index) {
+    return internal::readings[index];
+}
+
+Reading& reading(const Magnitude& magnitude) {
+    return reading(magnitude.index);
+}
+
 template <typename T>
 void forEachInstance(T&& callback) {
     for (auto& magnitude : internal::magnitudes) {
@@ -1749,13 +1811,11 @@ bool forEachCountedCheck(T&& callback) {
     return false;
 }
 
-void onRead(MagnitudeReadHandler handler) {
-    internal::read_handlers.push_front(handler);
-}
-
-void read(const Value& value) {
-    for (auto& handler : internal::read_handlers) {
-        handler(value);
+void read(uint32_t mask, const Value& value) {
+    for (size_t index = 0; mask; ++index, mask >>= 1) {
+        if (mask & 1) {
+            internal::read_handlers[index].handler(value);
+        }
     }
 }
 
@@ -1769,13 +1829,25 @@ void report(const Value& report) {
     }
 }
 
+const String& cached_topic(const Magnitude& magnitude) {
+    if (internal::topics.size() != internal::magnitudes.size()) {
+        internal::topics.clear();
+        internal::topics.reserve(internal::magnitudes.size());
+        for (const auto& other : internal::magnitudes) {
+            internal::topics.push_back(topicWithIndex(other));
+        }
+    }
+
+    return internal::topics[magnitude.index];
+}
+
 Info info(const Magnitude& magnitude) {
     return Info{
         .type = magnitude.type,
         .index = magnitude.index_global,
         .units = magnitude.units,
         .decimals = magnitude.decimals,
-        .topic = topicWithIndex(magnitude),
+        .topic = cached_topic(magnitude),
     };
 }
 
@@ -1785,9 +1857,8 @@ Value value(const Magnitude& magnitude, double value, Unit units) {
         .index = magnitude.index_global,
         .units = units,
         .decimals = magnitude.decimals,
-        .topic = topicWithIndex(magnitude),
         .value = value,
-        .repr = format(magnitude, value),
+        .magnitude = magnitude.index,
     };
 }
 
@@ -1795,10 +1866,40 @@ Value value(const Magnitude& magnitude, ValuePair value) {
     return magnitude::value(magnitude, value.value, value.units);
 }
 
+// Filters are only checked here instead of on every read, topics and settings
+// are expected to be stable between sensor init() and module reloads
+void update_read_handlers() {
+    for (auto& magnitude : internal::magnitudes) {
+        const auto value = magnitude::value(magnitude, reading(magnitude).last);
+
+        uint32_t mask { 0 };
+        for (size_t index = 0; index < internal::read_handlers.size(); ++index) {
+            const auto& handler = internal::read_handlers[index];
+            if (!handler.filter || handler.filter(value)) {
+                mask |= uint32_t{ 1 } << index;
+            }
+        }
+
+        reading(magnitude).read_handlers = mask;
+    }
+}
+
+void onRead(MagnitudeReadHandler handler, MagnitudeReadFilter filter) {
+    if (internal::read_handlers.size() < internal::ReadHandlersMax) {
+        internal::read_handlers.push_back(
+            internal::ReadHandler{
+                .handler = handler,
+                .filter = filter,
+            });
+        update_read_handlers();
+    }
+}
+
 template <typename T>
 Value safe_value(size_t index, T&& retrieve) {
     Value out;
     out.value = Value::Unknown;
+    out.magnitude = Value::NoMagnitude;
 
     if (index < count()) {
         const auto& magnitude = get(index);
@@ -1820,7 +1921,7 @@ Value safe_value_last(size_t index) {
     return safe_value(
         index,
         [](const Magnitude& magnitude) {
-            return magnitude.last;
+            return reading(magnitude).last;
         });
 }
 
@@ -1828,7 +1929,7 @@ Value safe_value_reported(size_t index) {
     return safe_value(
         index,
         [](const Magnitude& magnitude) {
-            return magnitude.reported;
+            return reading(magnitude).reported;
         });
 }
 
@@ -1873,12 +1974,33 @@ void notify_now(NotifyCallback callback) {
 }
 
 namespace {
+
+// Every sensor is read independently, when its own interval expires.
+// Magnitudes of the sensor are always next to each other in the magnitudes list
+struct Schedule {
+    BaseSensor* sensor;
+
+    size_t magnitudes_begin;
+    size_t magnitudes_end;
+
+    duration::Seconds interval;
+    TimeSource::time_point last;
+
+    // Time spent in pre(), value retrieval and processing during the last reading
+    duration::Microseconds latency;
+};
+
 namespace internal {
 
 std::vector<BaseSensorPtr> sensors;
+std::vector<Schedule> schedules;
+
+// Slot values of the sensor that is currently being read
+std::vector<double> values;
 size_t report_every { build::reportEvery() };
 
 duration::Seconds read_interval { build::readInterval() };
+duration::Milliseconds read_budget { build::readBudget() };
 
 std::forward_list<PreInitPtr> pre_init;
 duration::Seconds init_interval { build::initInterval() };
@@ -1893,6 +2015,10 @@ duration::Seconds readInterval() {
     return internal::read_interval;
 }
 
+duration::Milliseconds readBudget() {
+    return internal::read_budget;
+}
+
 duration::Seconds initInterval() {
     return internal::init_interval;
 }
@@ -2809,35 +2935,20 @@ String format_with_units(const Magnitude& magnitude, const ValuePair& pair) {
 
 namespace energy {
 
-struct Persist {
-    Persist(size_t index, Energy energy) :
-        _index(index),
-        _energy(energy)
-    {}
-
-    void operator()() const {
-        setSetting({F("eneTotal"), _index}, _energy.asString());
-#if NTP_SUPPORT
-        if (ntpSynced()) {
-            setSetting({F("eneTime"), _index}, ntpDateTime());
-        }
-#endif
-    }
-
-private:
-    size_t _index;
-    Energy _energy;
-};
-
-struct Tracker {
+// Accumulated energy is always written into the RTC memory, which survives soft resets but not the power loss.
+// Flash is only updated once in a while, when the unsaved energy grows beyond the threshold or right before
+// the scheduled reset. Every tracked magnitude is written at the same time, and storage is committed once.
+struct Journal {
     using Reference = std::reference_wrapper<const Magnitude>;
+    using Duration = espurna::duration::Seconds;
 
-    struct Counter {
+    struct Entry {
         Reference magnitude;
-        int value;
+        Energy saved;
+        Energy current;
     };
 
-    using Counters = std::vector<Counter>;
+    using Entries = std::vector<Entry>;
 
     explicit operator bool() const {
         return _every > 0;
@@ -2847,39 +2958,131 @@ struct Tracker {
         return _every;
     }
 
-    void add(Reference magnitude) {
-        _count.push_back(Counter{
+    void every(int every) {
+        _every = every;
+    }
+
+    Duration interval() const {
+        return _interval;
+    }
+
+    void interval(Duration interval) {
+        _interval = interval;
+    }
+
+    // threshold, in Wh
+    double delta() const {
+        return _delta;
+    }
+
+    void delta(double delta) {
+        _delta = delta;
+    }
+
+    void add(Reference magnitude, Energy energy) {
+        _entries.push_back(Entry{
             .magnitude = magnitude,
-            .value = 0
+            .saved = energy,
+            .current = energy,
         });
     }
 
+    static bool same(const Energy& lhs, const Energy& rhs) {
+        const auto lhs_pair = lhs.pair();
+        const auto rhs_pair = rhs.pair();
+
+        return (lhs_pair.kwh.value == rhs_pair.kwh.value)
+            && (lhs_pair.ws.value == rhs_pair.ws.value);
+    }
+
     size_t size() const {
-        return _count.size();
+        return _entries.size();
     }
 
-    int count(size_t index) const {
-        return _count[index].value;
+    const Entry& entry(size_t index) const {
+        return _entries[index];
     }
 
-    template <typename Callback>
-    void tick(unsigned char index, Callback&& callback) {
-        _count[index].value = (_count[index].value + 1) % _every;
-        if (_count[index].value == 0) {
-            callback();
+    // storage was modified externally, nothing is considered unsaved
+    void reset(size_t index, Energy energy) {
+        _entries[index].saved = energy;
+        _entries[index].current = energy;
+    }
+
+    // energy that would be lost on power loss right now, in Wh
+    static double unsaved(const Entry& entry) {
+        return std::fabs(entry.current.asDouble() - entry.saved.asDouble()) * 1000.0;
+    }
+
+    double unsaved() const {
+        double out { 0.0 };
+        for (const auto& entry : _entries) {
+            out += unsaved(entry);
         }
+
+        return out;
     }
 
-    void every(int every) {
-        _every = every;
-        for (auto& count : _count) {
-            count.value = 0;
+    // returns true when storage needs to be updated
+    bool update(unsigned char index, Energy energy) {
+        auto it = std::find_if(_entries.begin(), _entries.end(),
+            [&](const Entry& entry) {
+                return entry.magnitude.get().index_global == index;
+            });
+        if (it == _entries.end()) {
+            return false;
+        }
+
+        auto& entry = *it;
+        entry.current = energy;
+
+        if ((_delta > 0.0) && (unsaved(entry) >= _delta)) {
+            return true;
+        }
+
+        return (_interval.count() > 0)
+            && (TimeSource::now() - _last >= _interval);
+    }
+
+    template <typename Callback>
+    void flush(Callback&& callback) {
+        _last = TimeSource::now();
+        _peak = std::max(_peak, unsaved());
+
+        espurna::settings::Transaction transaction;
+        for (auto& entry : _entries) {
+            if (same(entry.saved, entry.current)) {
+                continue;
+            }
+
+            callback(transaction, entry.magnitude.get().index_global, entry.current);
+            entry.saved = entry.current;
+        }
+
+        if (transaction.size() && transaction.commit()) {
+            ++_commits;
         }
     }
 
+    uint32_t commits() const {
+        return _commits;
+    }
+
+    // largest amount of unsaved energy seen right before writing it, in Wh
+    double peak() const {
+        return _peak;
+    }
+
 private:
-    Counters _count;
-    int _every;
+    Entries _entries;
+
+    int _every { 0 };
+    Duration _interval { 0 };
+    double _delta { 0.0 };
+
+    TimeSource::time_point _last { TimeSource::now() };
+    uint32_t _commits { 0 };
+    double _peak { 0.0 };
 };
 
 struct ParseResult {
@@ -2905,10 +3108,33 @@ private:
 
 namespace internal {
 
-Tracker tracker;
+Journal journal;
+uint32_t generation { espurna::settings::Generation::current() };
 
 } // namespace internal
 
+constexpr size_t RtcmemSize { sizeof(Rtcmem->energy) / sizeof(*Rtcmem->energy) };
+
+// FNV-1a of both values and the index, so stale or swapped entries are also rejected
+uint32_t rtcmem_checksum(unsigned char index, uint32_t kwh, uint32_t ws) {
+    uint32_t out { 2166136261ul };
+    for (const auto value : {uint32_t(index), kwh, ws}) {
+        for (size_t byte = 0; byte < sizeof(value); ++byte) {
+            out ^= (value >> (byte * 8)) & 0xff;
+            out *= 16777619ul;
+        }
+    }
+
+    return out;
+}
+
+bool rtcmem_valid(unsigned char index) {
+    return rtcmemStatus()
+        && (index < RtcmemSize)
+        && (Rtcmem->energy[index].checksum == rtcmem_checksum(
+                index, Rtcmem->energy[index].kwh, Rtcmem->energy[index].ws));
+}
+
 Energy get_rtcmem(unsigned char index) {
     return Energy {
         Energy::Pair {
@@ -2921,6 +3147,8 @@ void set_rtcmem(unsigned char index, const Energy& source) {
     const auto pair = source.pair();
     Rtcmem->energy[index].kwh = pair.kwh.value;
     Rtcmem->energy[index].ws = pair.ws.value;
+    Rtcmem->energy[index].checksum = rtcmem_checksum(
+        index, pair.kwh.value, pair.ws.value);
 }
 
 
@@ -3006,10 +3234,11 @@ void set(const Magnitude& magnitude, StringView payload) {
     set(magnitude, energy.value());
 }
 
+// RTC memory is preferred, unless the checksum does not match
 Energy get(unsigned char index) {
     Energy result;
 
-    if (rtcmemStatus() && (index < (sizeof(Rtcmem->energy) / sizeof(*Rtcmem->energy)))) {
+    if (rtcmem_valid(index)) {
         result = get_rtcmem(index);
     } else {
         result = get_settings(index);
@@ -3021,37 +3250,121 @@ Energy get(unsigned char index) {
 void reset(unsigned char index) {
     delSetting({F("eneTotal"), index});
     delSetting({F("eneTime"), index});
-    if (index < (sizeof(Rtcmem->energy) / sizeof(*Rtcmem->energy))) {
-        Rtcmem->energy[index].kwh = 0;
-        Rtcmem->energy[index].ws = 0;
+    if (index < RtcmemSize) {
+        set_rtcmem(index, Energy{});
     }
 }
 
 int every() {
-    return internal::tracker.every();
+    return internal::journal.every();
 }
 
 void every(int value) {
-    internal::tracker.every(value);
+    internal::journal.every(value);
+}
+
+void configure(int every, espurna::duration::Seconds interval, double delta) {
+    internal::journal.every(every);
+    internal::journal.interval(interval);
+    internal::journal.delta(delta);
 }
 
-void update(const Magnitude& magnitude, bool persistent) {
+// Every tracked magnitude is written in a single transaction
+void flush() {
+    if (!internal::journal) {
+        return;
+    }
+
+#if NTP_SUPPORT
+    const auto timestamp = ntpSynced()
+        ? ntpDateTime()
+        : String();
+#endif
+
+    internal::journal.flush(
+        [&](espurna::settings::Transaction& transaction, size_t index, const Energy& energy) {
+            using namespace settings;
+            transaction.set(
+                keys::get(prefix::get(MAGNITUDE_ENERGY), suffix::Total, index).value(),
+                energy.asString());
+#if NTP_SUPPORT
+            if (timestamp.length()) {
+                transaction.set(
+                    espurna::settings::Key(F("eneTime"), index).value(),
+                    timestamp);
+            }
+#endif
+        });
+}
+
+// Settings may be erased by resetSettings() or replaced by the restore, and journal would
+// write the old values back when flushing. Stored value is preferred when it is different
+void sync() {
+    const auto generation = espurna::settings::Generation::current();
+    if (internal::generation == generation) {
+        return;
+    }
+
+    internal::generation = generation;
+
+    for (size_t index = 0; index < internal::journal.size(); ++index) {
+        const auto& entry = internal::journal.entry(index);
+        const auto& magnitude = entry.magnitude.get();
+
+        const auto stored = get_settings(magnitude.index_global);
+        if (Journal::same(entry.saved, stored)) {
+            continue;
+        }
+
+        set(magnitude, stored);
+        if (magnitude.index_global < RtcmemSize) {
+            set_rtcmem(magnitude.index_global, stored);
+        }
+
+        internal::journal.reset(index, stored);
+    }
+}
+
+// Settings commit is usually delayed until the next loop, which would never happen
+void flush_before_reset(CustomResetReason reason) {
+    if (!internal::journal) {
+        return;
+    }
+
+    // Factory reset erases the stored energy, sync() also erases the RTC memory copy
+    sync();
+    if (reason == CustomResetReason::Factory) {
+        return;
+    }
+
+    const auto commits = internal::journal.commits();
+    flush();
+
+    if (commits != internal::journal.commits()) {
+        eepromForceCommit();
+    }
+}
+
+void update(const Magnitude& magnitude) {
     if (!isEmon(magnitude.sensor)) {
         return;
     }
 
+    if (internal::journal) {
+        sync();
+    }
+
     auto* sensor = static_cast<BaseEmonSensor*>(magnitude.sensor.get());
     const auto energy = sensor->totalEnergy(magnitude.slot);
 
     // Always save to RTCMEM
-    if (magnitude.index_global < (sizeof(Rtcmem->energy) / sizeof(*Rtcmem->energy))) {
+    if (magnitude.index_global < RtcmemSize) {
         set_rtcmem(magnitude.index_global, energy);
     }
 
-    // Save to EEPROM every '_sensor_save_every' readings
-    if (persistent && internal::tracker) {
-        internal::tracker.tick(magnitude.index_global,
-            Persist{magnitude.index_global, energy});
+    // Save to EEPROM when enough time has passed, or when the change is large enough
+    if (internal::journal && internal::journal.update(magnitude.index_global, energy)) {
+        flush();
     }
 }
 
@@ -3085,8 +3398,13 @@ void setup(const Magnitude& magnitude) {
     }
 
     auto* sensor = static_cast<BaseEmonSensor*>(magnitude.sensor.get());
-    sensor->initialEnergy(magnitude.slot, get(magnitude.index_global));
-    internal::tracker.add(magnitude);
+
+    const auto energy = get(magnitude.index_global);
+    sensor->initialEnergy(magnitude.slot, energy);
+
+    // In case RTC memory has something newer, make sure it is also saved
+    internal::journal.add(magnitude, get_settings(magnitude.index_global));
+    internal::journal.update(magnitude.index_global, energy);
 
     DEBUG_MSG_P(PSTR("[ENERGY] Tracking %s/%u for %s\n"),
             magnitude::topic(magnitude).c_str(),
@@ -3105,16 +3423,22 @@ String NAME () {\
 }
 
 EXACT_VALUE(readInterval, settings::readInterval);
+EXACT_VALUE(readBudget, settings::readBudget);
 EXACT_VALUE(initInterval, settings::initInterval);
 EXACT_VALUE(reportEvery, settings::reportEvery);
 EXACT_VALUE(saveEvery, settings::saveEvery);
+EXACT_VALUE(saveInterval, settings::saveInterval);
+EXACT_VALUE(saveDelta, settings::saveDelta);
 EXACT_VALUE(realTimeValues, settings::realTimeValues);
 
 static constexpr espurna::settings::query::Setting Settings[] {
     {keys::ReadInterval, readInterval},
+    {keys::ReadBudget, readBudget},
     {keys::InitInterval, initInterval},
     {keys::ReportEvery, reportEvery},
     {keys::SaveEvery, saveEvery},
+    {keys::SaveInterval, saveInterval},
+    {keys::SaveDelta, saveDelta},
     {keys::RealTimeValues, realTimeValues},
 };
 
@@ -3136,9 +3460,13 @@ struct Type {
     Get get;
 };
 
-EXACT_VALUE(correction)
+String correction(const Magnitude& magnitude) {
+    return espurna::settings::internal::serialize(magnitude::reading(magnitude).correction);
+}
+
 EXACT_VALUE(decimals)
 EXACT_VALUE(filter_type)
+EXACT_VALUE(read_interval)
 
 String ratio(const Magnitude& magnitude) {
     const auto ptr = reinterpret_cast<BaseEmonSensor*>(magnitude.sensor.get());
@@ -3149,11 +3477,12 @@ EXACT_VALUE(units)
 
 #undef EXACT_VALUE
 
-static constexpr std::array<Type, 5> List PROGMEM {{
+static constexpr std::array<Type, 6> List PROGMEM {{
     {suffix::Correction, magnitude::traits::correction_supported, correction},
     {suffix::Filter, nullptr, filter_type},
     {suffix::Precision, nullptr, decimals},
     {suffix::Ratio, magnitude::traits::ratio_supported, ratio},
+    {suffix::ReadInterval, nullptr, read_interval},
     {suffix::Units, nullptr, units},
 }};
 
@@ -3402,7 +3731,7 @@ void settings(JsonObject& root) {
         {{settings::suffix::Correction, [](JsonArray& out, size_t index) {
             const auto& magnitude = magnitude::get(index);
             if (magnitude::traits::correction_supported(magnitude.type)) {
-                out.add(magnitude.correction);
+                out.add(magnitude::reading(index).correction);
             } else {
                 out.add(NullSymbol);
             }
@@ -3416,22 +3745,22 @@ void settings(JsonObject& root) {
             }
         }},
         {settings::suffix::ZeroThreshold, [](JsonArray& out, size_t index) {
-            const auto threshold = magnitude::get(index).zero_threshold;
+            const auto threshold = magnitude::reading(index).zero_threshold;
             threshold_or_nan(out, threshold);
         }},
         {settings::suffix::MinThreshold, [](JsonArray& out, size_t index) {
-            const auto threshold = magnitude::get(index).min_threshold;
+            const auto threshold = magnitude::reading(index).min_threshold;
             threshold_or_nan(out, threshold);
         }},
         {settings::suffix::MaxThreshold, [](JsonArray& out, size_t index) {
-            const auto threshold = magnitude::get(index).max_threshold;
+            const auto threshold = magnitude::reading(index).max_threshold;
             threshold_or_nan(out, threshold);
         }},
         {settings::suffix::MinDelta, [](JsonArray& out, size_t index) {
-            out.add(magnitude::get(index).min_delta);
+            out.add(magnitude::reading(index).min_delta);
         }},
         {settings::suffix::MaxDelta, [](JsonArray& out, size_t index) {
-            out.add(magnitude::get(index).max_delta);
+            out.add(magnitude::reading(index).max_delta);
         }}
     });
 
@@ -3441,12 +3770,14 @@ void settings(JsonObject& root) {
     root[FPSTR(settings::keys::InitInterval)] = initInterval().count();
     root[FPSTR(settings::keys::ReportEvery)] = reportEvery();
 
-    root[FPSTR(settings::keys::SaveEvery)] = energy::internal::tracker.every();
+    root[FPSTR(settings::keys::SaveEvery)] = energy::internal::journal.every();
+    root[FPSTR(settings::keys::SaveInterval)] = energy::internal::journal.interval().count();
+    root[FPSTR(settings::keys::SaveDelta)] = energy::internal::journal.delta();
 }
 
 void energy(JsonObject& root) {
 #if NTP_SUPPORT
-    if (!energy::internal::tracker || !energy::internal::tracker.size()) {
+    if (!energy::internal::journal || !energy::internal::journal.size()) {
         return;
     }
 
@@ -3459,7 +3790,7 @@ void energy(JsonObject& root) {
             out.add(index);
         }},
         {STRING_VIEW("saved"), [](JsonArray& out, size_t index) {
-            if (energy::internal::tracker) {
+            if (energy::internal::journal) {
                 out.add(getSetting({F("eneTime"), magnitude::get(index).index_global}, F("(unknown)")));
             } else {
                 out.add("");
@@ -3474,11 +3805,10 @@ void magnitudes(JsonObject& root) {
     payload(STRING_VIEW("values"), magnitude::count(), {
         {STRING_VIEW("value"), [](JsonArray& out, size_t index) {
             const auto& magnitude = magnitude::get(index);
-            out.add(magnitude::format(magnitude, magnitude.last));
+            out.add(magnitude::format(magnitude, magnitude::reading(index).last));
         }},
         {STRING_VIEW("units"), [](JsonArray& out, size_t index) {
-            const auto& magnitude = magnitude::get(index);
-            out.add(static_cast<int>(magnitude.last.units));
+            out.add(static_cast<int>(magnitude::reading(index).last.units));
         }},
         {STRING_VIEW("error"), [](JsonArray& out, size_t index) {
             out.add(magnitude::error(index));
@@ -3621,9 +3951,10 @@ void setup() {
             JsonArray& magnitudes = root.createNestedArray("magnitudes");
             for (auto& magnitude : magnitude::internal::magnitudes) {
                 JsonArray& data = magnitudes.createNestedArray();
+                const auto& reading = magnitude::reading(magnitude);
                 data.add(sensor::magnitude::topicWithIndex(magnitude));
-                data.add(magnitude.last.value);
-                data.add(magnitude.reported.value);
+                data.add(reading.last.value);
+                data.add(reading.reported.value);
             }
             return true;
         },
@@ -3639,8 +3970,9 @@ void setup() {
         ApiBasicHandler get = [type](ApiRequest& request) {
             return tryHandle(request, type,
                 [&](const Magnitude& magnitude) {
+                    const auto& reading = magnitude::reading(magnitude);
                     request.send(magnitude::format(magnitude,
-                        magnitude::prefer_real_time_values() ? magnitude.last : magnitude.reported));
+                        magnitude::prefer_real_time_values() ? reading.last : reading.reported));
                     return true;
                 });
         };
@@ -3665,8 +3997,10 @@ void setup() {
 #if MQTT_SUPPORT
 namespace mqtt {
 
+// Published together with every other magnitude reported during the same loop()
 void report(const Value& report, const Magnitude& magnitude) {
-    mqttSend(report.topic.c_str(), report.repr.c_str());
+    const auto& topic = report.topic();
+    mqttBatchAdd(topic, report.repr());
 
 #if SENSOR_PUBLISH_ADDRESSES
     STRING_VIEW_INLINE(AddressTopic, SENSOR_ADDRESS_TOPIC);
@@ -3674,53 +4008,46 @@ void report(const Value& report, const Magnitude& magnitude) {
     const auto address = magnitude.sensor->address(magnitude.slot);
     if (address.length()) {
         String address_topic;
-        address_topic.reserve(1 + report.topic.length() + AddressTopic.length());
+        address_topic.reserve(1 + topic.length() + AddressTopic.length());
         address_topic.concat(AddressTopic.data(), AddressTopic.length());
         address_topic += '/';
-        address_topic += report.topic;
+        address_topic += topic;
 
-        mqttSend(address_topic.c_str(), address.c_str());
+        mqttBatchAdd(address_topic, address);
     }
 #endif
 }
 
-void callback(unsigned int type, StringView topic, StringView payload) {
+String energy_filter() {
+    return magnitude::topic(MAGNITUDE_ENERGY) + F("/+");
+}
+
+void callback(unsigned int type, StringView, StringView) {
     if (!magnitude::count(MAGNITUDE_ENERGY)) {
         return;
     }
 
-    static const auto base = magnitude::topic(MAGNITUDE_ENERGY);
-
-    switch (type) {
-    case MQTT_MESSAGE_EVENT:
-    {
-        auto t = mqttMagnitude(topic);
-        if (!t.startsWith(base)) {
-            break;
-        }
-
-        size_t index;
-        if (!tryParseIdPath(t, magnitude::count(MAGNITUDE_ENERGY), index)) {
-            break;
-        }
-
-        const auto* magnitude = magnitude::find(MAGNITUDE_ENERGY, index);
-        if (magnitude) {
-            energy::set(*magnitude, payload.toString());
-        }
-
-        break;
+    if (type == MQTT_CONNECT_EVENT) {
+        mqttSubscribe(energy_filter().c_str());
     }
+}
 
-    case MQTT_CONNECT_EVENT:
-        mqttSubscribe((base + F("/+")).c_str());
-        break;
+// '<energy>/+', where wildcard is the magnitude index
+void energy_route(const espurna::mqtt::Match& match, StringView payload) {
+    size_t index;
+    if (!tryParseId(match[0], magnitude::count(MAGNITUDE_ENERGY), index)) {
+        return;
+    }
 
+    const auto* magnitude = magnitude::find(MAGNITUDE_ENERGY, index);
+    if (magnitude) {
+        energy::set(*magnitude, payload.toString());
     }
 }
 
 void setup() {
     ::mqttRegister(callback);
+    ::mqttRoute(energy_filter(), energy_route);
 }
 
 } // namespace mqtt
@@ -3743,8 +4070,16 @@ void magnitudes(::terminal::CommandContext&& ctx) {
         ctx.output.printf_P(PSTR("%2zu * %s @ %s read %s reported %s\n"),
             index++, magnitude::topicWithIndex(magnitude).c_str(),
             magnitude::description(magnitude).c_str(),
-            magnitude::format_with_units(magnitude, magnitude.last).c_str(),
-            magnitude::format_with_units(magnitude, magnitude.reported).c_str());
+            magnitude::format_with_units(magnitude, magnitude::reading(magnitude).last).c_str(),
+            magnitude::format_with_units(magnitude, magnitude::reading(magnitude).reported).c_str());
+    }
+
+    for (const auto& schedule : sensor::internal::schedules) {
+        ctx.output.printf_P(PSTR("%s @ magnitudes %zu..%zu every %us, last read took %luus\n"),
+            schedule.sensor->description().c_str(),
+            schedule.magnitudes_begin, schedule.magnitudes_end - 1,
+            schedule.interval.count(),
+            static_cast<unsigned long>(schedule.latency.count()));
     }
 
     terminalOK(ctx);
@@ -3783,11 +4118,48 @@ void reset_ratios(::terminal::CommandContext&& ctx) {
 
 PROGMEM_STRING(Energy, "ENERGY");
 
+// Flash commits are extrapolated from the uptime. When the delta threshold is set, every magnitude
+// may lose at most that much energy after power loss. Otherwise, the peak observed value is the best guess
+void energy_journal(::terminal::CommandContext& ctx) {
+    const auto& journal = energy::internal::journal;
+    if (!journal) {
+        ctx.output.print(F("Energy is not saved to flash\n"));
+        return;
+    }
+
+    const auto commits = static_cast<unsigned long long>(journal.commits());
+    const auto uptime = std::max(static_cast<unsigned long long>(systemUptime().count()), 1ull);
+    ctx.output.printf_P(PSTR("Flash commits %lu, ~%lu per day\n"),
+        static_cast<unsigned long>(commits),
+        static_cast<unsigned long>((commits * 86400ull) / uptime));
+
+    for (size_t index = 0; index < journal.size(); ++index) {
+        const auto& entry = journal.entry(index);
+        ctx.output.printf_P(PSTR("%s unsaved %s Wh\n"),
+            magnitude::topicWithIndex(entry.magnitude).c_str(),
+            String(energy::Journal::unsaved(entry), 3).c_str());
+    }
+
+    const auto worst = (journal.delta() > 0.0)
+        ? (journal.delta() * journal.size())
+        : journal.peak();
+    ctx.output.printf_P(PSTR("Worst case lost after power cut %s Wh (saving every %lus or %s Wh)\n"),
+        String(worst, 3).c_str(),
+        static_cast<unsigned long>(journal.interval().count()),
+        String(journal.delta(), 3).c_str());
+}
+
 void energy(::terminal::CommandContext&& ctx) {
     using IndexType = decltype(Magnitude::index_global);
 
     if (ctx.argv.size() < 2) {
-        terminalError(ctx, F("ENERGY <ID> [<VALUE>]"));
+        if (!magnitude::count(MAGNITUDE_ENERGY)) {
+            terminalError(ctx, F("ENERGY <ID> [<VALUE>]"));
+            return;
+        }
+
+        energy_journal(ctx);
+        terminalOK(ctx);
         return;
     }
 
@@ -3802,7 +4174,7 @@ void energy(::terminal::CommandContext&& ctx) {
     if (ctx.argv.size() == 2) {
         ctx.output.printf_P(PSTR("%s => %s (%s)\n"),
             magnitude::topicWithIndex(*magnitude).c_str(),
-            magnitude::format(*magnitude, magnitude->reported.value).c_str(),
+            magnitude::format(*magnitude, magnitude::reading(*magnitude).reported.value).c_str(),
             units::name(*magnitude).c_str());
         terminalOK(ctx);
         return;
@@ -3844,12 +4216,11 @@ namespace internal {
 State state { State::None };
 std::unique_ptr<ReadyFlag> init_flag;
 
-ReadyFlag read_flag;
-
 } // namespace internal
 
 void configure_magnitude(Magnitude& magnitude) {
     // TODO: namespace and various helpers need some naming tweaks...
+    auto& reading = magnitude::reading(magnitude);
 
     // Only initialized once, notify about reset requirement?
     if (!magnitude.filter) {
@@ -3863,7 +4234,7 @@ void configure_magnitude(Magnitude& magnitude) {
     magnitude.filter->resize(reportEvery());
 
     // Reset internal readings counter as well.
-    magnitude.read_count = 0;
+    reading.read_count = 0;
 
     // process emon-specific settings first. ensure that settings use global index and we access sensor with the local one
     if (isEmon(magnitude.sensor) && magnitude::traits::ratio_supported(magnitude.type)) {
@@ -3885,15 +4256,16 @@ void configure_magnitude(Magnitude& magnitude) {
     }
 
     // adjust units based on magnitude's type
+    reading.input = magnitude.sensor->units(magnitude.slot);
     magnitude.units = units::filter(magnitude,
         getSetting(
             settings::keys::get(magnitude, settings::suffix::Units),
-            magnitude.sensor->units(magnitude.slot)));
+            reading.input));
 
     // adjust resulting value (simple plus or minus)
     // TODO: inject math or rpnlib expression?
     if (magnitude::traits::correction_supported(magnitude.type)) {
-        magnitude.correction = getSetting(
+        reading.correction = getSetting(
             settings::keys::get(magnitude, settings::suffix::Correction),
             magnitude::build::correction(magnitude.type));
     }
@@ -3909,27 +4281,34 @@ void configure_magnitude(Magnitude& magnitude) {
                     : magnitude::decimals(magnitude.units));
     }
 
+    // Per-magnitude read interval, global one is used by default. Sensor itself is read at the shortest of them
+    magnitude.read_interval = std::clamp(
+        getSetting(
+            settings::keys::get(magnitude, settings::suffix::ReadInterval),
+            settings::readInterval()),
+        build::ReadIntervalMin, build::ReadIntervalMax);
+
     // Per-magnitude min & max delta of the report value, may trigger reports independent of the read counter overflow
     // - ${prefix}MinDelta${index} for value change greater than or equal to the specified delta
     // - ${prefix}MaxDelta${index} for value change less than or equal to the specified delta
     // Both are 0. by default, meaning these checks are ignored when processing read data
-    magnitude.min_delta = getSetting(
+    reading.min_delta = getSetting(
         settings::keys::get(magnitude, settings::suffix::MinDelta),
         build::DefaultMinDelta);
-    magnitude.max_delta = getSetting(
+    reading.max_delta = getSetting(
         settings::keys::get(magnitude, settings::suffix::MaxDelta),
         build::DefaultMaxDelta);
 
     // Overwrite value with 0 when below a certain threshold. Happens when report is triggered, before any further checks
-    magnitude.zero_threshold = getSetting(
+    reading.zero_threshold = getSetting(
         settings::keys::get(magnitude, settings::suffix::ZeroThreshold),
         Value::Unknown);
 
     // Per-magnitude min & max checks of the report value
-    magnitude.min_threshold = getSetting(
+    reading.min_threshold = getSetting(
         settings::keys::get(magnitude, settings::suffix::MinThreshold),
         Value::Unknown);
-    magnitude.max_threshold = getSetting(
+    reading.max_threshold = getSetting(
         settings::keys::get(magnitude, settings::suffix::MaxThreshold),
         Value::Unknown);
 
@@ -3939,17 +4318,35 @@ void configure_magnitude(Magnitude& magnitude) {
     }
 }
 
+// Restart every sensor schedule, using the shortest interval of its magnitudes.
+// First reads are spread over the interval, so sensors do not wake up all at once
+void schedule_read() {
+    const auto now = TimeSource::now();
+    const auto count = internal::schedules.size();
+
+    for (size_t index = 0; index < count; ++index) {
+        auto& schedule = internal::schedules[index];
+
+        schedule.interval = build::ReadIntervalMax;
+        for (size_t other = schedule.magnitudes_begin; other < schedule.magnitudes_end; ++other) {
+            schedule.interval = std::min(schedule.interval, magnitude::get(other).read_interval);
+        }
+
+        const auto interval = std::chrono::duration_cast<TimeSource::duration>(schedule.interval);
+        schedule.last = now - (interval * index / count);
+    }
+}
+
 // Update magnitude config, filter sizes and reset energy if needed
 void configure_magnitudes() {
     for (auto& magnitude : magnitude::internal::magnitudes) {
         configure_magnitude(magnitude);
     }
-}
 
-void schedule_read() {
-    internal::read_flag.stop_wait(internal::read_interval);
+    schedule_read();
 }
 
+
 void suspend() {
     for (auto& sensor : internal::sensors) {
         sensor->suspend();
@@ -3961,7 +4358,7 @@ void resume() {
 
     magnitude::forEachInstance(
         [](sensor::Magnitude& instance) {
-            instance.read_count = 0;
+            magnitude::reading(instance).read_count = 0;
             instance.filter->reset();
         });
 
@@ -4012,6 +4409,8 @@ bool init() {
             break;
         }
 
+        const auto begin = magnitude::count();
+
         const auto slots = sensor->count();
         for (auto slot = 0; slot < slots; ++slot) {
             auto& result = magnitude::add(sensor, slot, sensor->type(slot));
@@ -4025,8 +4424,24 @@ bool init() {
             // Track both supported and currently used units
             units::setup(result.type);
         }
+
+        internal::schedules.push_back(
+            Schedule{
+                .sensor = sensor.get(),
+                .magnitudes_begin = begin,
+                .magnitudes_end = magnitude::count(),
+                .interval = {},
+                .last = {},
+                .latency = duration::Microseconds::zero(),
+            });
     }
 
+    // Topics of the already added magnitudes may change as well
+    magnitude::update_read_handlers();
+
+    // Interval and the initial read time are set for every sensor at once
+    schedule_read();
+
     if (out) {
         internal::state = State::Ready;
 
@@ -4093,98 +4508,229 @@ void tick() {
     }
 }
 
-void pre() {
-    for (auto sensor : internal::sensors) {
-        sensor->pre();
-    }
-}
-
-void post() {
-    for (auto sensor : internal::sensors) {
-        sensor->post();
-    }
-}
-
-void error() {
-#if DEBUG_SUPPORT
-    for (auto sensor : internal::sensors) {
-        if (SENSOR_ERROR_OK != sensor->error()) {
-            DEBUG_MSG_P(PSTR("[SENSOR] Could not read from %s - %s\n"),
-                    sensor->description().c_str(),
-                    error(sensor->error()).c_str());
-        }
-    }
-#endif
-}
-
-void reset_report(duration::Seconds read_interval, size_t report_every) {
+void reset_report(duration::Seconds read_interval, duration::Milliseconds read_budget, size_t report_every) {
     internal::read_interval = read_interval;
+    internal::read_budget = read_budget;
     internal::report_every = report_every;
-    internal::read_flag.stop_wait(read_interval);
 }
 
-bool ready_to_read() {
-    return internal::read_flag.wait(internal::read_interval);
-}
-
-bool ready_to_report(ValuePair& out, const ValuePair& processed, const Magnitude& magnitude, bool report) {
+bool ready_to_report(ValuePair& out, const ValuePair& processed, BaseFilter& filter, const Reading& reading, bool report) {
     // Ensure that reported value change is greater or equal to this delta value
-    const bool compare_min_delta { magnitude.min_delta > build::DefaultMinDelta };
+    const bool compare_min_delta { reading.min_delta > build::DefaultMinDelta };
     report = report || compare_min_delta;
 
     // Ensure that reported value change is less or equal to this delta value
-    const bool compare_max_delta { magnitude.max_delta > build::DefaultMaxDelta };
+    const bool compare_max_delta { reading.max_delta > build::DefaultMaxDelta };
     report = report || compare_max_delta;
 
     // Ensure that reported value is greater than or equal to this value
-    const bool check_min_threshold { !std::isnan(magnitude.min_threshold) };
+    const bool check_min_threshold { !std::isnan(reading.min_threshold) };
     report = report || check_min_threshold;
 
     // Ensure that reported value is less than or equal to this value
-    const bool check_max_threshold { !std::isnan(magnitude.max_threshold) };
+    const bool check_max_threshold { !std::isnan(reading.max_threshold) };
     report = report || check_max_threshold;
 
 
     if (report) {
-        if (magnitude.filter->ready()) {
+        if (filter.ready()) {
             out = ValuePair{
-                .value = magnitude.filter->value(),
+                .value = filter.value(),
                 .units = processed.units,
             };
-            magnitude.filter->restart();
+            filter.restart();
         } else {
             out = processed;
         }
 
         // Figure out whether report value should be zero or not
-        if (!std::isnan(magnitude.zero_threshold) && out.value < magnitude.zero_threshold) {
+        if (!std::isnan(reading.zero_threshold) && out.value < reading.zero_threshold) {
             out.value = 0.0;
         }
 
-        const bool previous_report { !std::isnan(magnitude.reported.value) };
+        const bool previous_report { !std::isnan(reading.reported.value) };
 
         if (report && previous_report && compare_min_delta) {
-            report = std::abs(out.value - magnitude.reported.value)
-                >= magnitude.min_delta;
+            report = std::abs(out.value - reading.reported.value)
+                >= reading.min_delta;
         }
 
         if (report && previous_report && compare_max_delta) {
-            report = std::abs(out.value - magnitude.reported.value)
-                <= magnitude.max_delta;
+            report = std::abs(out.value - reading.reported.value)
+                <= reading.max_delta;
         }
 
         if (report && check_min_threshold) {
-            report = out.value >= magnitude.min_threshold;
+            report = out.value >= reading.min_threshold;
         }
 
         if (report && check_max_threshold) {
-            report = out.value <= magnitude.max_threshold;
+            report = out.value <= reading.max_threshold;
         }
     }
 
     return report;
 }
 
+struct ReadContext {
+    size_t report_every { 0 };
+    bool relay_off { false };
+};
+
+// Process and (maybe) report every magnitude of the sensor
+void read_magnitudes(const Schedule& schedule, const ReadContext& context) {
+    // Current magnitude reading state
+    struct {
+        ValuePair raw;       // as the sensor returns it
+        ValuePair processed; // after applying units and decimals
+        ValuePair report;    // value to be reported (either processed, or filtered)
+    } state;
+
+    // Every slot value is retrieved at once
+    auto& values = internal::values;
+    values.resize(std::max<size_t>(values.size(), schedule.sensor->count()));
+    schedule.sensor->values(values.data());
+
+    const auto report_every = context.report_every;
+
+    for (size_t index = schedule.magnitudes_begin; index < schedule.magnitudes_end; ++index) {
+        auto& magnitude = magnitude::get(index);
+        auto& reading = magnitude::reading(index);
+
+        // Value from the sensor as-is
+        state.raw = make_value_pair(values[magnitude.slot], reading.input);
+
+        // Completely remove spurious values if relay is OFF
+#if RELAY_SUPPORT && SENSOR_POWER_CHECK_STATUS
+        switch (magnitude.type) {
+        case MAGNITUDE_POWER_ACTIVE:
+        case MAGNITUDE_POWER_REACTIVE:
+        case MAGNITUDE_POWER_APPARENT:
+        case MAGNITUDE_POWER_FACTOR:
+        case MAGNITUDE_CURRENT:
+        case MAGNITUDE_ENERGY_DELTA:
+            if (context.relay_off) {
+                state.raw.value = 0.0;
+            }
+            break;
+        default:
+            break;
+        }
+#endif
+
+        // Apply units and correct number of decimals (directly modifies the double value)
+        state.processed = magnitude::process(magnitude, state.raw);
+
+        // Absolute value correction. *Unconditional*, value is always offset by this amount
+        state.processed.value += reading.correction;
+
+        // In case units change occured, make sure filter receives the same unit type
+        if (reading.last.units != state.processed.units) {
+            magnitude.filter->reset();
+        }
+
+        magnitude.filter->update(state.processed.value);
+
+        // Making last reading available in API and for external listeners
+        reading.last = state.processed;
+        // Value is not created unless somebody actually expects it
+        if (reading.read_handlers) {
+            magnitude::read(reading.read_handlers, magnitude::value(magnitude, state.processed));
+        }
+
+        // At this point, we should decide whether this value should be reported.
+        // First, increment read counter and check for overflow.
+        const auto read_count = reading.read_count;
+        reading.read_count = (read_count + 1) % report_every;
+
+        bool report { 0 == reading.read_count };
+
+        // Special case for energy, save current readings to
+        // - RTC memory (always)
+        // - Internal flash (optionally, see energy::Journal)
+        if (MAGNITUDE_ENERGY == magnitude.type) {
+            energy::update(magnitude);
+        }
+
+        // Prepare and verify report value before proceeding
+        report = ready_to_report(
+            state.report, state.processed,
+            *magnitude.filter, reading, report);
+
+        // If flag was not reset by the checks above, continue and finally report the value
+        if (report) {
+            const auto value = magnitude::value(magnitude, state.report);
+
+            reading.reported = state.report;
+            magnitude::report(value);
+
+#if MQTT_SUPPORT
+            mqtt::report(value, magnitude);
+#endif
+#if THINGSPEAK_SUPPORT
+            tspkEnqueueMagnitude(index, value.repr());
+#endif
+#if DOMOTICZ_SUPPORT
+            domoticzSendMagnitude(index, value);
+#endif
+        }
+
+#if SENSOR_DEBUG
+        {
+            DEBUG_MSG_P(PSTR("[SENSOR] %s -> raw %s processed %s report %s\n"),
+                magnitude::topic(magnitude).c_str(),
+                magnitude::format_with_units(magnitude, state.raw).c_str(),
+                magnitude::format_with_units(magnitude, state.processed).c_str(),
+                magnitude::format_with_units(magnitude, state.report).c_str());
+        }
+#endif
+    }
+}
+
+// Read the sensor right now, remembering how long it took
+void read(Schedule& schedule, const ReadContext& context) {
+    const auto start = time::micros();
+
+    // Pre-read hook, called every reading
+    schedule.sensor->pre();
+
+    // Do not read anything from a failed sensor
+    const auto error = schedule.sensor->error();
+    if (SENSOR_ERROR_OK == error) {
+        read_magnitudes(schedule, context);
+    } else {
+        DEBUG_MSG_P(PSTR("[SENSOR] Could not read from %s - %s\n"),
+                schedule.sensor->description().c_str(),
+                sensor::error(error).c_str());
+    }
+
+    // Post-read hook, called every reading
+    schedule.sensor->post();
+
+    schedule.latency = time::micros() - start;
+}
+
+// Sensor that was due for the longest time, or nullptr when there are none
+Schedule* next_due(TimeSource::time_point now) {
+    Schedule* out { nullptr };
+    TimeSource::duration overdue { 0 };
+
+    for (auto& schedule : internal::schedules) {
+        const auto elapsed = now - schedule.last;
+        if (elapsed < schedule.interval) {
+            continue;
+        }
+
+        const auto current = elapsed - schedule.interval;
+        if (!out || (current > overdue)) {
+            out = &schedule;
+            overdue = current;
+        }
+    }
+
+    return out;
+}
+
 void loop() {
     // TODO: allow to do nothing
     if (internal::state == State::Idle) {
@@ -4221,137 +4767,62 @@ void loop() {
     // Tick hook, called every loop()
     sensor::tick();
 
-    if (ready_to_read()) {
-        // XXX: Filter out certain magnitude types when relay is turned OFF
-#if RELAY_SUPPORT && SENSOR_POWER_CHECK_STATUS
-        const bool relay_off = (relayCount() == 1) && (relayStatus(0) == 0);
-#endif
-
-        // Report every Nth reading
-        const auto report_every = reportEvery();
-
-        // Pre-read hook, called every reading
-        sensor::pre();
-
-        // Notify about sensor errors that may have been updated by pre()
-        sensor::error();
-
-        // Current magnitude reading state
-        struct {
-            ValuePair raw;       // as the sensor returns it
-            ValuePair processed; // after applying units and decimals
-            ValuePair report;    // value to be reported (either processed, or filtered)
-        } state;
+    // Due sensors are read in the order of their deadlines. Once the time budget
+    // is spent, the rest are postponed until the next loop()
+    ReadContext context;
+    context.report_every = reportEvery();
 
-        for (size_t index = 0; index < magnitude::count(); ++index) {
-            auto& magnitude = magnitude::get(index);
-
-            // Do not read anything from a failed sensor
-            if (SENSOR_ERROR_OK != magnitude.sensor->error()) {
-                continue;
-            }
-
-            // Value from the sensor as-is
-            state.raw = ValuePair{
-                .value = magnitude.sensor->value(magnitude.slot),
-                .units = magnitude.sensor->units(magnitude.slot),
-            };
-
-            // Completely remove spurious values if relay is OFF
+    // XXX: Filter out certain magnitude types when relay is turned OFF
 #if RELAY_SUPPORT && SENSOR_POWER_CHECK_STATUS
-            switch (magnitude.type) {
-            case MAGNITUDE_POWER_ACTIVE:
-            case MAGNITUDE_POWER_REACTIVE:
-            case MAGNITUDE_POWER_APPARENT:
-            case MAGNITUDE_POWER_FACTOR:
-            case MAGNITUDE_CURRENT:
-            case MAGNITUDE_ENERGY_DELTA:
-                if (relay_off) {
-                    state.raw.value = 0.0;
-                }
-                break;
-            default:
-                break;
-            }
+    context.relay_off = (relayCount() == 1) && (relayStatus(0) == 0);
 #endif
 
-            // Apply units and correct number of decimals (directly modifies the double value)
-            state.processed = magnitude::process(magnitude, state.raw);
+    const auto start = TimeSource::now();
+    const auto budget = readBudget();
 
-            // Absolute value correction. *Unconditional*, value is always offset by this amount
-            state.processed.value += magnitude.correction;
+    bool updated { false };
 
-            // In case units change occured, make sure filter receives the same unit type
-            if (magnitude.last.units != state.processed.units) {
-                magnitude.filter->reset();
-            }
-
-            magnitude.filter->update(state.processed.value);
-
-            // Making last reading available in API and for external listeners
-            magnitude.last = state.processed;
-            magnitude::read(magnitude::value(magnitude, state.processed));
-
-            // At this point, we should decide whether this value should be reported.
-            // First, increment read counter and check for overflow.
-            const auto read_count = magnitude.read_count;
-            magnitude.read_count = (read_count + 1) % report_every;
-
-            bool report { 0 == magnitude.read_count };
+#if MQTT_SUPPORT
+    mqttBatchBegin();
+#endif
 
-            // Special case for energy, save current readings to
-            // - RTC memory (always)
-            // - Internal flash (optionally, when reporting)
-            if (MAGNITUDE_ENERGY == magnitude.type) {
-                energy::update(magnitude, report);
-            }
+    for (;;) {
+        const auto now = TimeSource::now();
+        if (updated && (now - start >= budget)) {
+            break;
+        }
 
-            // Prepare and verify report value before proceeding
-            report = ready_to_report(
-                state.report, state.processed,
-                magnitude, report);
+        auto* schedule = next_due(now);
+        if (!schedule) {
+            break;
+        }
 
-            // If flag was not reset by the checks above, continue and finally report the value
-            if (report) {
-                const auto value = magnitude::value(magnitude, state.report);
+        // Keep the cadence, unless reading was delayed by more than the interval
+        schedule->last += schedule->interval;
+        if (now - schedule->last >= schedule->interval) {
+            schedule->last = now;
+        }
 
-                magnitude.reported = state.report;
-                magnitude::report(value);
+        read(*schedule, context);
+        updated = true;
+    }
 
 #if MQTT_SUPPORT
-                mqtt::report(value, magnitude);
+    mqttBatchEnd();
 #endif
-#if THINGSPEAK_SUPPORT
-                tspkEnqueueMagnitude(index, value.repr);
-#endif
-#if DOMOTICZ_SUPPORT
-                domoticzSendMagnitude(index, value);
-#endif
-            }
-
-#if SENSOR_DEBUG
-            {
-                DEBUG_MSG_P(PSTR("[SENSOR] %s -> raw %s processed %s report %s\n"),
-                    magnitude::topic(magnitude).c_str(),
-                    magnitude::format_with_units(magnitude, state.raw).c_str(),
-                    magnitude::format_with_units(magnitude, state.processed).c_str(),
-                    magnitude::format_with_units(magnitude, state.report).c_str());
-            }
-#endif
-        }
-
-        sensor::post();
 
 #if WEB_SUPPORT
+    if (updated) {
         wsPost(web::onData);
-#endif
     }
+#endif
 }
 
 void configure_base() {
     // Read counter is set for each magnitude, and equals to 0 right after this point
     reset_report(
         sensor::settings::readInterval(),
+        sensor::settings::readBudget(),
         sensor::settings::reportEvery());
 
     // Generic 'get magnitude value' API calls prefer latest values over the reported ones
@@ -4359,7 +4830,10 @@ void configure_base() {
 
     // TODO: something more generic? energy is an accumulating value, only allow for similar ones?
     // TODO: move to an external module?
-    energy::every(sensor::settings::saveEvery());
+    energy::configure(
+        sensor::settings::saveEvery(),
+        sensor::settings::saveInterval(),
+        sensor::settings::saveDelta());
 }
 
 void configure() {
@@ -4371,6 +4845,9 @@ void setup() {
     // Make sure settings stay up-to-date
     migrateVersion(settings::migrate);
 
+    // Unsaved energy is written before the scheduled reset, instead of being lost
+    systemBeforeReset(energy::flush_before_reset);
+
     // Load & initialize magnitudes from available sensors
     sensor::load();
     sensor::try_init();
@@ -4410,6 +4887,19 @@ void setup() {
 
 PreInit::~PreInit() = default;
 
+const String& Value::topic() const {
+    if (magnitude < magnitude::count()) {
+        return magnitude::cached_topic(magnitude::get(magnitude));
+    }
+
+    static const String empty;
+    return empty;
+}
+
+String Value::repr() const {
+    return magnitude::format(value, decimals);
+}
+
 bool ready() {
     return State::Reading == internal::state;
 }
@@ -4434,7 +4924,15 @@ void sensorWebSocketMagnitudes(JsonObject& root, espurna::StringView prefix, Sen
 #endif // WEB_SUPPORT
 
 void sensorOnMagnitudeRead(MagnitudeReadHandler handler) {
-    espurna::sensor::magnitude::onRead(handler);
+    espurna::sensor::magnitude::onRead(handler, nullptr);
+}
+
+void sensorOnMagnitudeRead(MagnitudeReadHandler handler, MagnitudeReadFilter filter) {
+    espurna::sensor::magnitude::onRead(handler, filter);
+}
+
+void sensorUpdateMagnitudeRead() {
+    espurna::sensor::magnitude::update_read_handlers();
 }
 
 void sensorOnMagnitudeReport(MagnitudeReadHandler handler) {
@@ -223,19 +223,31 @@ private:
 
 // '.value' is set to 'Value::Unknown' when index is out of bounds
 // '.value' is undefined when either reading or report hadn't happened yet
+// Lightweight view of the magnitude reading. Nothing is allocated when it is created,
+// topic is shared with the magnitude and textual representation is only made when requested
 struct Value {
     static constexpr double Unknown {
         std::numeric_limits<double>::quiet_NaN() };
 
+    static constexpr size_t NoMagnitude {
+        std::numeric_limits<size_t>::max() };
+
     unsigned char type;
     unsigned char index;
 
     Unit units;
     unsigned char decimals;
-    String topic;
 
     double value;
-    String repr;
+
+    // Position in the magnitudes list, or NoMagnitude when value is not attached to any
+    size_t magnitude;
+
+    // Same as magnitudeTopic(), but not copied. Empty string when not attached to any magnitude
+    const String& topic() const;
+
+    // Value formatted with the magnitude decimals
+    String repr() const;
 
     explicit operator bool() const;
 };
@@ -289,6 +301,14 @@ using MagnitudeReadHandler = void(*)(const espurna::sensor::Value&);
 // (depends on read interval and won't happen in case sensor returns an error)
 void sensorOnMagnitudeRead(MagnitudeReadHandler handler);
 
+// Same as above, but only for magnitudes accepted by the 'filter(value)'
+// Filter is not checked on every read, see sensorUpdateMagnitudeRead()
+using MagnitudeReadFilter = bool(*)(const espurna::sensor::Value&);
+void sensorOnMagnitudeRead(MagnitudeReadHandler handler, MagnitudeReadFilter filter);
+
+// Re-check read handler filters, e.g. when module settings change
+void sensorUpdateMagnitudeRead();
+
 // Executes 'handler(value)' every time sensor report happens
 // (depends on report counter of sensor reads and conditions like min / max delta)
 void sensorOnMagnitudeReport(MagnitudeReadHandler handler);
@@ -0,0 +1,219 @@
+/*
+
+Part of the SENSOR MODULE
+
+Fixed-memory history of the magnitude readings
+
+*/
+
+#include "espurna.h"
+
+#if SENSOR_SUPPORT && SENSOR_HISTORY_SUPPORT
+
+#include "sensor.h"
+#include "sensor_history.h"
+
+#if API_SUPPORT
+#include "api.h"
+#endif
+
+#if WEB_SUPPORT
+#include "ws.h"
+#endif
+
+#include <vector>
+
+namespace espurna {
+namespace sensor {
+namespace history {
+namespace {
+namespace build {
+
+constexpr size_t minutes() {
+    return SENSOR_HISTORY_MINUTES;
+}
+
+constexpr size_t quarters() {
+    return SENSOR_HISTORY_QUARTERS;
+}
+
+constexpr size_t hours() {
+    return SENSOR_HISTORY_HOURS;
+}
+
+} // namespace build
+
+struct Entry {
+    Unit units { Unit::None };
+    Series series;
+};
+
+namespace internal {
+
+// Same order as the magnitudes list, created on the first reading
+std::vector<Entry> entries;
+
+} // namespace internal
+
+std::vector<Series::Level> levels() {
+    return {
+        {60, build::minutes()},
+        {60 * 15, build::quarters()},
+        {60 * 60, build::hours()},
+    };
+}
+
+uint32_t now() {
+    return systemUptime().count();
+}
+
+// Series is reset when units are changed, stored values would no longer make sense
+void onRead(const Value& value) {
+    if (value.magnitude >= magnitudeCount()) {
+        return;
+    }
+
+    if (value.magnitude >= internal::entries.size()) {
+        internal::entries.resize(magnitudeCount());
+    }
+
+    auto& entry = internal::entries[value.magnitude];
+    if (!entry.series.levels() || (entry.units != value.units)) {
+        entry.units = value.units;
+        entry.series = Series(levels(), value.decimals);
+    }
+
+    entry.series.add(now(), value.value);
+}
+
+void add(JsonArray& out, const Summary& summary) {
+    if (!summary) {
+        out.add(static_cast<const char*>(nullptr));
+        return;
+    }
+
+    JsonArray& values = out.createNestedArray();
+    values.add(summary.min);
+    values.add(summary.avg);
+    values.add(summary.max);
+}
+
+// {
+//   "topic": "temperature/0",
+//   "units": "°C",
+//   "levels": [
+//     {"width": 60, "age": 17, "values": [[21.5, 21.6, 21.7], null, ...]},
+//     ...
+//   ]
+// }
+// Values are ordered from the oldest to the newest, 'age' is the number of seconds
+// since the newest one ended. Empty buckets (nothing was read during that time) are null
+bool serialize(JsonObject& root, size_t index) {
+    if (index >= internal::entries.size()) {
+        return false;
+    }
+
+    auto& entry = internal::entries[index];
+    if (!entry.series.levels()) {
+        return false;
+    }
+
+    const auto timestamp = now();
+    entry.series.advance(timestamp);
+
+    root["topic"] = magnitudeTopic(index);
+    root["units"] = magnitudeUnitsName(entry.units);
+
+    JsonArray& levels = root.createNestedArray("levels");
+    for (size_t level = 0; level < entry.series.levels(); ++level) {
+        JsonObject& out = levels.createNestedObject();
+        out["width"] = entry.series.width(level);
+        out["age"] = timestamp - entry.series.end(level);
+
+        JsonArray& values = out.createNestedArray("values");
+        entry.series.foreach(level,
+            [&](const Summary& summary) {
+                add(values, summary);
+            });
+    }
+
+    return true;
+}
+
+#if API_SUPPORT
+namespace api {
+
+// Magnitudes may be added after setup() and topics may change when they are,
+// so the whole 'history/<topic>' is only resolved when requested
+bool find(const String& topic, size_t& out) {
+    for (size_t index = 0; index < magnitudeCount(); ++index) {
+        if (magnitudeTopic(index) == topic) {
+            out = index;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void setup() {
+    apiRegister(F("history/#"),
+        [](ApiRequest& request, JsonObject& root) {
+            size_t index;
+            if (find(request.wildcard(0), index)) {
+                return serialize(root, index);
+            }
+
+            return false;
+        },
+        nullptr);
+}
+
+} // namespace api
+#endif
+
+#if WEB_SUPPORT
+namespace web {
+
+void onAction(uint32_t client_id, const char* action, JsonObject& data) {
+    if (STRING_VIEW("sns-history") == action) {
+        const auto index = data["id"].as<size_t>();
+        wsPost(client_id,
+            [index](JsonObject& root) {
+                JsonObject& out = root.createNestedObject("history");
+                out["id"] = index;
+                serialize(out, index);
+            });
+    }
+}
+
+void setup() {
+    wsRegister()
+        .onAction(onAction);
+}
+
+} // namespace web
+#endif
+
+void setup() {
+    sensorOnMagnitudeRead(onRead);
+
+#if API_SUPPORT
+    api::setup();
+#endif
+
+#if WEB_SUPPORT
+    web::setup();
+#endif
+}
+
+} // namespace
+} // namespace history
+} // namespace sensor
+} // namespace espurna
+
+void sensorHistorySetup() {
+    espurna::sensor::history::setup();
+}
+
+#endif
@@ -0,0 +1,314 @@
+/*
+
+Part of the SENSOR MODULE
+
+Fixed-memory history of the magnitude readings
+
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace espurna {
+namespace sensor {
+namespace history {
+
+// Minimum, average and maximum of the values received during some period of time
+// Everything is NaN when nothing was received
+struct Summary {
+    static constexpr double Unknown {
+        std::numeric_limits<double>::quiet_NaN() };
+
+    double min { Unknown };
+    double avg { Unknown };
+    double max { Unknown };
+
+    explicit operator bool() const {
+        return !std::isnan(avg);
+    }
+};
+
+// Values are split into several levels of resolution, e.g. 1 minute, 15 minutes and 1 hour.
+// Every level is a ring buffer of fixed size, with the oldest bucket replaced by the newest one.
+// When a bucket is closed, it is also merged into the currently open bucket of the next level.
+//
+// Buckets store min, avg and max as int16 deltas from the first received value, scaled by 10^decimals.
+// When value does not fit, decimals are reduced and every stored bucket is scaled down accordingly.
+class Series {
+public:
+    struct Level {
+        uint32_t width; // bucket period, in seconds. expected to be a multiple of the previous level width
+        size_t size; // number of buckets
+    };
+
+    Series() = default;
+
+    Series(const std::vector<Level>& levels, int decimals) :
+        _decimals(decimals)
+    {
+        _levels.reserve(levels.size());
+        for (const auto& level : levels) {
+            _levels.push_back(Ring(level));
+        }
+    }
+
+    void add(uint32_t now, double value) {
+        if (std::isnan(value) || std::isinf(value)) {
+            return;
+        }
+
+        if (!_started) {
+            _start(now, value);
+        }
+
+        advance(now);
+        _levels.front().current.add(value);
+    }
+
+    // Close every bucket that ended before 'now'
+    void advance(uint32_t now) {
+        if (!_started) {
+            return;
+        }
+
+        for (size_t level = 0; level < _levels.size(); ++level) {
+            auto& ring = _levels[level];
+
+            const auto index = now / ring.width;
+            if (index <= ring.index) {
+                continue;
+            }
+
+            _close(level, ring.current.summary());
+            ring.current = Accumulator();
+
+            // Nothing was received for the rest of the periods
+            const auto skipped = index - ring.index - 1;
+            for (size_t empty = 0; (empty < skipped) && (empty < ring.buckets.size()); ++empty) {
+                _close(level, Summary{});
+            }
+
+            ring.index = index;
+        }
+    }
+
+    size_t levels() const {
+        return _levels.size();
+    }
+
+    uint32_t width(size_t level) const {
+        return _levels[level].width;
+    }
+
+    size_t count(size_t level) const {
+        return _levels[level].count;
+    }
+
+    // Time when the newest bucket was closed, in seconds
+    uint32_t end(size_t level) const {
+        return _levels[level].index * _levels[level].width;
+    }
+
+    int decimals() const {
+        return _decimals;
+    }
+
+    // Summary of the currently open bucket
+    Summary current(size_t level) const {
+        return _levels[level].current.summary();
+    }
+
+    // Every closed bucket of the level, from the oldest to the newest
+    template <typename T>
+    void foreach(size_t level, T&& callback) const {
+        const auto& ring = _levels[level];
+        const auto size = ring.buckets.size();
+
+        for (size_t index = 0; index < ring.count; ++index) {
+            const auto& bucket = ring.buckets[(ring.head + size - ring.count + index) % size];
+            callback(_decode(bucket));
+        }
+    }
+
+private:
+    static constexpr int16_t Empty { std::numeric_limits<int16_t>::min() };
+    static constexpr int16_t Limit { std::numeric_limits<int16_t>::max() };
+
+    static constexpr int DecimalsMin { -4 };
+
+    struct Bucket {
+        int16_t min;
+        int16_t avg;
+        int16_t max;
+    };
+
+    // Lower levels are merged as an average of averages, every bucket has the same weight
+    struct Accumulator {
+        void add(double value) {
+            Summary summary;
+            summary.min = value;
+            summary.avg = value;
+            summary.max = value;
+            add(summary);
+        }
+
+        void add(const Summary& summary) {
+            if (!count || (summary.min < lowest)) {
+                lowest = summary.min;
+            }
+
+            if (!count || (summary.max > highest)) {
+                highest = summary.max;
+            }
+
+            sum += summary.avg;
+            ++count;
+        }
+
+        Summary summary() const {
+            Summary out;
+            if (count) {
+                out.min = lowest;
+                out.avg = sum / count;
+                out.max = highest;
+            }
+
+            return out;
+        }
+
+        double lowest { 0.0 };
+        double highest { 0.0 };
+        double sum { 0.0 };
+        size_t count { 0 };
+    };
+
+    struct Ring {
+        explicit Ring(const Level& level) :
+            width(level.width ? level.width : 1),
+            buckets(level.size ? level.size : 1)
+        {}
+
+        uint32_t width;
+        uint32_t index { 0 };
+
+        std::vector<Bucket> buckets;
+        size_t head { 0 };
+        size_t count { 0 };
+
+        Accumulator current;
+    };
+
+    void _start(uint32_t now, double value) {
+        _base = value;
+        _started = true;
+
+        for (auto& ring : _levels) {
+            ring.index = now / ring.width;
+        }
+    }
+
+    double _scale() const {
+        return std::pow(10.0, _decimals);
+    }
+
+    bool _fits(double value) const {
+        return std::fabs(std::round((value - _base) * _scale())) <= Limit;
+    }
+
+    static int16_t _rescale(int16_t value) {
+        if (value == Empty) {
+            return value;
+        }
+
+        return static_cast<int16_t>(std::lround(value / 10.0));
+    }
+
+    // Precision of every stored bucket is reduced, so the new value could fit
+    void _reduce() {
+        --_decimals;
+        for (auto& ring : _levels) {
+            for (auto& bucket : ring.buckets) {
+                bucket.min = _rescale(bucket.min);
+                bucket.avg = _rescale(bucket.avg);
+                bucket.max = _rescale(bucket.max);
+            }
+        }
+    }
+
+    int16_t _encode(double value) const {
+        auto out = std::round((value - _base) * _scale());
+        if (out > Limit) {
+            out = Limit;
+        } else if (out < -Limit) {
+            out = -Limit;
+        }
+
+        return static_cast<int16_t>(out);
+    }
+
+    double _decode(int16_t value) const {
+        return _base + (value / _scale());
+    }
+
+    Summary _decode(const Bucket& bucket) const {
+        Summary out;
+        if (bucket.avg != Empty) {
+            out.min = _decode(bucket.min);
+            out.avg = _decode(bucket.avg);
+            out.max = _decode(bucket.max);
+        }
+
+        return out;
+    }
+
+    Bucket _encode(const Summary& summary) {
+        if (!summary) {
+            return Bucket{Empty, Empty, Empty};
+        }
+
+        while ((_decimals > DecimalsMin)
+            && (!_fits(summary.min) || !_fits(summary.max)))
+        {
+            _reduce();
+        }
+
+        return Bucket{
+            _encode(summary.min),
+            _encode(summary.avg),
+            _encode(summary.max)};
+    }
+
+    void _close(size_t level, const Summary& summary) {
+        auto& ring = _levels[level];
+
+        ring.buckets[ring.head] = _encode(summary);
+        ring.head = (ring.head + 1) % ring.buckets.size();
+        if (ring.count < ring.buckets.size()) {
+            ++ring.count;
+        }
+
+        if (summary && ((level + 1) < _levels.size())) {
+            _levels[level + 1].current.add(summary);
+        }
+    }
+
+    std::vector<Ring> _levels;
+
+    double _base { 0.0 };
+    int _decimals { 0 };
+    bool _started { false };
+};
+
+} // namespace history
+} // namespace sensor
+} // namespace espurna
+
+#if SENSOR_SUPPORT && SENSOR_HISTORY_SUPPORT
+void sensorHistorySetup();
+#endif
@@ -12,6 +12,9 @@
 
 #include "../libs/fs_math.h"
 
+#include <cstdint>
+#include <limits>
+
 class BaseAnalogEmonSensor : public BaseEmonSensor {
 public:
     static const BaseSensor::ClassKind Kind;
@@ -22,6 +25,9 @@ public:
     using TimeSource = espurna::time::CoreClock;
     static constexpr auto MaxTime = TimeSource::duration { EMON_MAX_TIME };
 
+    using SampleTimeSource = espurna::time::SystemClock;
+    static constexpr auto TickTime = SampleTimeSource::duration { EMON_TICK_TIME };
+
     static constexpr double IRef { EMON_CURRENT_RATIO };
 
     // TODO: mask common magnitudes (...voltage), when there are multiple channels?
@@ -42,6 +48,11 @@ public:
 
     virtual unsigned int analogRead() = 0;
 
+    // Minimal time between analogRead() calls that would return a new value
+    virtual SampleTimeSource::duration sampleInterval() const {
+        return SampleTimeSource::duration::zero();
+    }
+
 	virtual void setVoltage(double) = 0;
 	virtual double getVoltage() const = 0;
 
@@ -63,7 +74,6 @@ public:
     }
 
     void setSamplesMax(size_t samples) {
-        _samples = samples;
         _samples_max = samples;
         _dirty = true;
     }
@@ -82,6 +92,7 @@ public:
         updateCurrent(0.0);
         setPivot(_adc_counts >> 1); // aka divide by 2
         calculateFactors();
+        _resetWindow();
 
         _ready = true;
         _dirty = false;
@@ -98,8 +109,28 @@ public:
 #endif
     }
 
+    // Samples are taken on every loop instead of all at once when reading. Only when the
+    // sample interval had elapsed since the last one, and for no longer than TickTime
+    void tick() override {
+        const auto start = SampleTimeSource::now();
+
+        auto now = start;
+        while ((_window.samples < _samples_max)
+            && (now >= _sample_next)
+            && (now - start < TickTime))
+        {
+            now = _sampleNext();
+        }
+
+#if SENSOR_DEBUG
+        _batch();
+#endif
+    }
+
     void pre() override {
-        updateCurrent(sampleCurrent());
+        if (_window.samples) {
+            updateCurrent(finalizeCurrent());
+        }
 
         const auto now = TimeSource::now();
         if (!_initial) {
@@ -136,41 +167,40 @@ public:
         return 0.0;
     }
 
-    double sampleCurrent() {
-        int max = 0;
-        int min = _adc_counts;
-        double sum = 0;
-
-        auto pivot = getPivot();
+    // Digital low pass filter extracts the VDC offset, and the rest
+    // is squared and accumulated for the root-mean-square method.
+    // Pivot is a fixed-point value with PivotShift fractional bits, filtered value
+    // is a fixed-point value with SampleShift fractional bits
+    void sample() {
+        const int32_t sample = this->analogRead();
+        if (sample > _window.max) _window.max = sample;
+        if (sample < _window.min) _window.min = sample;
 
-        const auto time_span = TimeSource::now();
-        for (size_t i = 0; i < _samples; i++) {
-            int sample;
-            double filtered;
+        _window.pivot += ((static_cast<int64_t>(sample) << PivotShift) - _window.pivot) / EMON_FILTER_SPEED;
 
-            sample = this->analogRead();
-            if (sample > max) max = sample;
-            if (sample < min) min = sample;
+        const auto filtered = static_cast<int64_t>(
+            ((static_cast<int64_t>(sample) << PivotShift) - _window.pivot) >> (PivotShift - SampleShift));
+        _window.sum += static_cast<uint64_t>(filtered * filtered);
 
-            // Digital low pass filter extracts the VDC offset
-            pivot = (pivot + (sample - pivot) / EMON_FILTER_SPEED);
-            filtered = sample - pivot;
-
-            // Root-mean-square method
-            sum += (filtered * filtered);
-        }
+        ++_window.samples;
+    }
 
-        const auto elapsed = TimeSource::now() - time_span;
+    // Calculate current from every sample taken since the last call, and start over
+    double finalizeCurrent() {
+        const auto samples = _window.samples;
 
         // Quick fix
-        if (pivot < min || max < pivot) {
-            pivot = (max + min) / 2.0;
+        auto pivot = static_cast<double>(_window.pivot) / static_cast<double>(PivotOne);
+        if (pivot < _window.min || _window.max < pivot) {
+            pivot = (_window.max + _window.min) / 2.0;
         }
 
         setPivot(pivot);
 
         // Calculate current
-        double rms = _samples > 0 ? fs_sqrt(sum / _samples) : 0;
+        double rms = samples > 0
+            ? fs_sqrt(static_cast<double>(_window.sum) / samples) / SampleOne
+            : 0;
         double current = _current_factor * rms;
 
         current = (double) (int(current * _multiplier) - 1) / _multiplier;
@@ -179,25 +209,45 @@ public:
         }
 
 #if SENSOR_DEBUG
-        DEBUG_MSG_P(PSTR("[EMON] Total samples: %d\n"), _samples);
-        DEBUG_MSG_P(PSTR("[EMON] Total time (ms): %u\n"), elapsed.count());
-        DEBUG_MSG_P(PSTR("[EMON] Sample frequency (Hz): %d\n"), int(1000 * _samples / elapsed.count()));
-        DEBUG_MSG_P(PSTR("[EMON] Max value: %d\n"), max);
-        DEBUG_MSG_P(PSTR("[EMON] Min value: %d\n"), min);
+        const auto elapsed = TimeSource::now() - _window.start;
+        const auto batches = std::max(_window.batches, static_cast<size_t>(1));
+        const auto average = _window.batch_total.count() / batches;
+
+        DEBUG_MSG_P(PSTR("[EMON] Total samples: %zu\n"), samples);
+        DEBUG_MSG_P(PSTR("[EMON] Total time (ms): %u\n"),
+            static_cast<unsigned int>(elapsed.count()));
+        DEBUG_MSG_P(PSTR("[EMON] Sample frequency (Hz): %u\n"),
+            static_cast<unsigned int>((1000 * samples) / std::max<TimeSource::rep>(elapsed.count(), 1)));
+        DEBUG_MSG_P(PSTR("[EMON] Batch interval (us): avg %u max %u jitter %u\n"),
+            static_cast<unsigned int>(average),
+            static_cast<unsigned int>(_window.batch_max.count()),
+            static_cast<unsigned int>(_window.batch_max.count() - average));
+        DEBUG_MSG_P(PSTR("[EMON] Max value: %d\n"), _window.max);
+        DEBUG_MSG_P(PSTR("[EMON] Min value: %d\n"), _window.min);
         DEBUG_MSG_P(PSTR("[EMON] Midpoint value: %d\n"), int(getPivot()));
         DEBUG_MSG_P(PSTR("[EMON] RMS value: %d\n"), int(rms));
         DEBUG_MSG_P(PSTR("[EMON] Current (mA): %d\n"), int(1000 * current));
 #endif
 
-        if ((elapsed > MaxTime)
-            || ((elapsed < MaxTime) && (_samples < _samples_max)))
-        {
-            _samples = (_samples * MaxTime.count()) / elapsed.count();
-        }
+        _resetWindow();
 
         return current;
     }
 
+    // Blocking version of the above, used when sensor is initialized
+    double sampleCurrent() {
+        _resetWindow();
+
+        const auto start = TimeSource::now();
+        while ((_window.samples < _samples_max) && (TimeSource::now() - start < MaxTime)) {
+            if (SampleTimeSource::now() >= _sample_next) {
+                _sampleNext();
+            }
+        }
+
+        return finalizeCurrent();
+    }
+
     void calculateFactors() {
         _current_factor = getRatio(0) * getReferenceVoltage() / _adc_counts;
         unsigned int s = 1;
@@ -214,14 +264,72 @@ public:
     }
 
 private:
+    static constexpr int PivotShift { 16 };
+    static constexpr int64_t PivotOne { static_cast<int64_t>(1) << PivotShift };
+
+    static constexpr int SampleShift { 8 };
+    static constexpr int64_t SampleOne { static_cast<int64_t>(1) << SampleShift };
+
+    struct Window {
+        int64_t pivot { 0 };
+        uint64_t sum { 0 };
+        size_t samples { 0 };
+
+        int32_t min { std::numeric_limits<int32_t>::max() };
+        int32_t max { std::numeric_limits<int32_t>::min() };
+
+        TimeSource::time_point start;
+#if SENSOR_DEBUG
+        // Time between tick() calls, should stay close to the loop() time
+        espurna::time::SystemClock::time_point batch_last;
+        espurna::duration::Microseconds batch_total { 0 };
+        espurna::duration::Microseconds batch_max { 0 };
+        size_t batches { 0 };
+#endif
+    };
+
+    // Next sample deadline is counted from the end of the current one,
+    // there is no catching up when loop() is slower than the interval
+    SampleTimeSource::time_point _sampleNext() {
+        sample();
+
+        const auto now = SampleTimeSource::now();
+        _sample_next = now + sampleInterval();
+
+        return now;
+    }
+
+    void _resetWindow() {
+        _window = Window{};
+        _window.pivot = static_cast<int64_t>(getPivot() * PivotOne);
+        _window.start = TimeSource::now();
+#if SENSOR_DEBUG
+        _window.batch_last = espurna::time::micros();
+#endif
+    }
+
+#if SENSOR_DEBUG
+    void _batch() {
+        const auto now = espurna::time::micros();
+        const auto interval = now - _window.batch_last;
+
+        _window.batch_last = now;
+        _window.batch_total += interval;
+        _window.batch_max = std::max(_window.batch_max, interval);
+        ++_window.batches;
+    }
+#endif
+
+    Window _window;
+    SampleTimeSource::time_point _sample_next{};
+
     TimeSource::time_point _last_reading;
     bool _initial { true };
 
     double _current_factor { 1.0 };                 // Calculated, reads (RMS) to current
     unsigned int _multiplier { 1 };                 // Calculated, error
 
-    size_t _samples_max { EMON_MAX_SAMPLES };       // Number of samples, will be adjusted at runtime
-    size_t _samples { _samples_max };               // based on the maximum value
+    size_t _samples_max { EMON_MAX_SAMPLES };       // Max number of samples between readings
 
     size_t _resolution { EMON_ANALOG_RESOLUTION };  // ADC resolution (in bits)
     size_t _adc_counts { static_cast<size_t>(1) << _resolution };       // Max count
@@ -260,6 +260,15 @@ public:
     // Current value for slot # index
     virtual double value(unsigned char index) = 0;
 
+    // Current values for every slot, out is expected to fit count() values
+    // Called once per reading, instead of value() for each slot
+    virtual void values(double* out) {
+        const auto slots = count();
+        for (unsigned char index = 0; index < slots; ++index) {
+            out[index] = value(index);
+        }
+    }
+
     // Return ready status (true if ready to be read)
     bool ready() const {
         return _ready;
@@ -44,6 +44,10 @@ public:
     // Cannot hammer analogRead() all the time:
     // https://github.com/esp8266/Arduino/issues/1634
 
+    SampleTimeSource::duration sampleInterval() const override {
+        return std::chrono::duration_cast<SampleTimeSource::duration>(_interval);
+    }
+
     unsigned int analogRead() override {
         auto now = TimeSource::now();
         if (now - _last > _interval) {
@@ -15,6 +15,7 @@ Copyright (C) 2016-2019 by Xose Pérez <xose dot perez at gmail dot com>
 #include <algorithm>
 #include <vector>
 #include <cstdlib>
+#include <cstring>
 
 #include <ArduinoJson.h>
 
@@ -37,6 +38,21 @@ static kvs_type kv_store(
     EepromSize
 );
 
+// Storage commit is deferred until the transaction is fully applied
+bool transaction_lock { false };
+
+// Staged keys use the same order as kvs_type::ReadResult::compare(), so they can be
+// searched with both the RAM copy of the key and the storage contents
+bool staged_less(StringView lhs, StringView rhs) {
+    const auto result = std::memcmp(lhs.begin(), rhs.begin(),
+        std::min(lhs.length(), rhs.length()));
+    if (result != 0) {
+        return result < 0;
+    }
+
+    return lhs.length() < rhs.length();
+}
+
 } // namespace
 
 namespace query {
@@ -169,18 +185,120 @@ ValueResult get(const String& key) {
     return kv_store.get(key);
 }
 
+ValueResult get(const Key& key) {
+    return kv_store.get(key.value());
+}
+
+ValueResult get(StringView key) {
+    return kv_store.get(key);
+}
+
 bool set(const String& key, const String& value) {
+    Revision::bump();
     return kv_store.set(key, value);
 }
 
 bool del(const String& key) {
+    Generation::bump();
+    Revision::bump();
     return kv_store.del(key);
 }
 
+void Transaction::stage(String key, String value, bool remove) {
+    auto it = std::lower_bound(_changes.begin(), _changes.end(), key,
+        [](const Change& change, const String& key) {
+            return staged_less(change.key, key);
+        });
+
+    if ((it != _changes.end()) && ((*it).key == key)) {
+        (*it).value = std::move(value);
+        (*it).remove = remove;
+        return;
+    }
+
+    _changes.insert(it, Change{
+        std::move(key), std::move(value), remove, false});
+}
+
+void Transaction::set(String key, String value) {
+    stage(std::move(key), std::move(value), false);
+}
+
+void Transaction::del(String key) {
+    stage(std::move(key), String(), true);
+}
+
+size_t Transaction::commit() {
+    size_t out = 0;
+    if (_changes.empty()) {
+        return out;
+    }
+
+    bool removed { false };
+
+    {
+        ReentryLock lock(transaction_lock);
+
+        // every staged key is removed at once, unless we'd be writing the same value again
+        kv_store.del_if(
+            [&](const kvs_type::KeyValueResult& kv) {
+                const auto it = std::lower_bound(_changes.begin(), _changes.end(), kv.key,
+                    [](const Change& change, const kvs_type::ReadResult& key) {
+                        return key.compare(change.key) > 0;
+                    });
+
+                if ((it == _changes.end()) || !kv.key.equals(it->key)) {
+                    return false;
+                }
+
+                auto& change = *it;
+                if (change.remove) {
+                    removed = true;
+                    ++out;
+                    return true;
+                }
+
+                change.unchanged = kv.value.equals(change.value);
+                return !change.unchanged;
+            });
+
+        for (const auto& change : _changes) {
+            if (change.remove || change.unchanged) {
+                continue;
+            }
+
+            if (kv_store.set(change.key, change.value)) {
+                ++out;
+            }
+        }
+    }
+
+    _changes.clear();
+
+    if (removed) {
+        Generation::bump();
+    }
+
+    if (out) {
+        Revision::bump();
+        autosaveSettings();
+    }
+
+    return out;
+}
+
 bool has(const String& key) {
     return kv_store.has(key);
 }
 
+bool has(const Key& key) {
+    return kv_store.has(key.value());
+}
+
+bool has(StringView key) {
+    return kv_store.has(key);
+}
+
 Keys keys() {
     Keys out;
     kv_store.foreach([&](kvs_type::KeyValueResult&& kv) {
@@ -198,32 +316,146 @@ size_t size() {
     return kv_store.size();
 }
 
+void index_reset() {
+    kv_store.index_reset();
+    Generation::bump();
+    Revision::bump();
+}
+
 void foreach(KeyValueResultCallback&& callback) {
     kv_store.foreach(callback);
 }
 
+// Key is only copied when it matches one of the prefixes
+// With the sorted index, every prefix only visits the matching range of keys
+// Otherwise, storage is scanned only once for all of the prefixes
 void foreach_prefix(PrefixResultCallback&& callback, query::StringViewIterator prefixes) {
+    if (kv_store.sorted_indexed()) {
+        for (auto it = prefixes.begin(); it != prefixes.end(); ++it) {
+            kv_store.foreach_prefix((*it), [&](kvs_type::KeyValueResult&& kv) {
+                callback((*it), kv.key.read(), kv.value);
+            });
+        }
+        return;
+    }
+
     kv_store.foreach([&](kvs_type::KeyValueResult&& kv) {
-        auto key = kv.key.read();
         for (auto it = prefixes.begin(); it != prefixes.end(); ++it) {
-            if (StringView{key}.startsWith(*it)) {
-                callback((*it), std::move(key), kv.value);
+            if (kv.key.startsWith(*it)) {
+                callback((*it), kv.key.read(), kv.value);
             }
         }
     });
 }
 
+uint16_t StorageSource::position() const {
+    return kv_store.position();
+}
+
+kvs_type::KeyValueResult StorageSource::next(uint16_t& position) const {
+    return kv_store.next(position);
+}
+
+// Note: we try to match what settingsRestoreJson() expects, {"app":"ESPURNA",...}
+BackupWriter backup_writer() {
+    const auto app = buildApp();
+
+    String header;
+    header += F("{\n");
+    backup::pair(header, F("app"), app.name.toString());
+    header += F(",\n");
+    backup::pair(header, F("version"), app.version.toString());
+    header += F(",\n");
+    backup::pair(header, F("backup"), F("1"));
+
+    return BackupWriter(StorageSource{}, std::move(header));
+}
+
+bool RestoreJson::_pair(String key, String value) {
+    // These three are just metadata, no need to actually store them
+    if (key.startsWith(F("app"))
+        || key.startsWith(F("version"))
+        || key.startsWith(F("backup")))
+    {
+        if (key.equals(F("app"))) {
+            _app = buildApp().name.equals(value);
+            if (!_app) {
+                DEBUG_MSG_P(PSTR("[SETTINGS] Invalid 'app' key\n"));
+                return false;
+            }
+        } else if (key.equals(F("backup"))) {
+            _backup = internal::convert<bool>(value);
+        }
+
+        return true;
+    }
+
+    // Nothing is written until finish(), but staged pairs never have to be larger than the storage itself
+    // (same as in the storage, every key and value is counted with its 2 length bytes)
+    _staged += key.length() + value.length() + 4;
+    if (_staged > kv_store.size()) {
+        DEBUG_MSG_P(PSTR("[SETTINGS] Backup is larger than the settings storage\n"));
+        return false;
+    }
+
+    _transaction.set(std::move(key), std::move(value));
+    return true;
+}
+
+bool RestoreJson::feed(const uint8_t* data, size_t size) {
+    const auto result = _parser.feed(data, size,
+        [&](String&& key, String&& value) {
+            return _pair(std::move(key), std::move(value));
+        });
+
+    if (!result) {
+        _transaction.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool RestoreJson::finish() {
+    if (!_parser.done()) {
+        DEBUG_MSG_P(PSTR("[SETTINGS] JSON parsing error\n"));
+        _transaction.clear();
+        return false;
+    }
+
+    if (!_app) {
+        DEBUG_MSG_P(PSTR("[SETTINGS] Missing 'app' key\n"));
+        _transaction.clear();
+        return false;
+    }
+
+    // Storage is only modified after the whole document was received
+    // .../config will add this key, but it is optional
+    if (_backup) {
+        resetSettings();
+    }
+
+    _count = _transaction.size();
+    _transaction.commit();
+    _transaction.clear();
+    saveSettings();
+
+    Generation::bump();
+
+    DEBUG_MSG_P(PSTR("[SETTINGS] Settings restored successfully\n"));
+    return true;
+}
+
 // --------------------------------------------------------------------------
 
-// TODO: UI needs this to avoid showing keys in storage order
+// UI needs this to avoid showing keys in storage order
 std::vector<String> sorted_keys() {
-    auto values = keys();
-    std::sort(values.begin(), values.end(),
-        [](const String& lhs, const String& rhs) -> bool {
-            return rhs.compareTo(lhs) > 0;
-        });
+    Keys out;
+    kv_store.foreach_sorted([&](kvs_type::KeyValueResult&& kv) {
+        out.push_back(kv.key.read());
+    });
 
-    return values;
+    return out;
 }
 
 #if TERMINAL_SUPPORT
@@ -541,11 +773,11 @@ String getSetting(const String& key) {
 }
 
 String getSetting(const __FlashStringHelper* key) {
-    return getSetting(espurna::settings::Key(key));
+    return std::move(espurna::settings::get(espurna::StringView(key))).get();
 }
 
 String getSetting(const char* key) {
-    return getSetting(espurna::settings::Key(key));
+    return std::move(espurna::settings::get(espurna::StringView(key))).get();
 }
 
 String getSetting(const espurna::settings::Key& key) {
@@ -561,7 +793,7 @@ String getSetting(const espurna::settings::Key& key, const __FlashStringHelper*
 }
 
 String getSetting(const espurna::settings::Key& key, const String& defaultValue) {
-    auto result = espurna::settings::get(key.value());
+    auto result = espurna::settings::get(key);
     if (result) {
         return std::move(result).get();
     }
@@ -572,7 +804,7 @@ String getSetting(const espurna::settings::Key& key, const String& defaultValue)
 String getSetting(const espurna::settings::Key& key, String&& defaultValue) {
     String out;
 
-    auto result = espurna::settings::get(key.value());
+    auto result = espurna::settings::get(key);
     if (result) {
         out = std::move(result).get();
     } else {
@@ -585,7 +817,7 @@ String getSetting(const espurna::settings::Key& key, String&& defaultValue) {
 String getSetting(const espurna::settings::Key& key, espurna::StringView defaultValue) {
     String out;
 
-    auto result = espurna::settings::get(key.value());
+    auto result = espurna::settings::get(key);
     if (result) {
         out = std::move(result).get();
     } else {
@@ -616,15 +848,15 @@ bool hasSetting(const String& key) {
 }
 
 bool hasSetting(const espurna::settings::Key& key) {
-    return hasSetting(key.value());
+    return espurna::settings::has(key);
 }
 
 bool hasSetting(const char* key) {
-    return hasSetting(String(key));
+    return espurna::settings::has(espurna::StringView(key));
 }
 
 bool hasSetting(const __FlashStringHelper* key) {
-    return hasSetting(String(key));
+    return espurna::settings::has(espurna::StringView(key));
 }
 
 void saveSettings() {
@@ -635,12 +867,15 @@ void saveSettings() {
 
 void autosaveSettings() {
 #if SETTINGS_AUTOSAVE
-    eepromCommit();
+    if (!espurna::settings::transaction_lock) {
+        eepromCommit();
+    }
 #endif
 }
 
 void resetSettings() {
     eepromClear();
+    espurna::settings::index_reset();
 }
 
 // -----------------------------------------------------------------------------
@@ -668,6 +903,7 @@ bool settingsRestoreJson(JsonObject& data) {
     }
 
     // These three are just metadata, no need to actually store them
+    espurna::settings::Transaction transaction;
     for (auto element : data) {
         auto key = String(element.key);
         if (key.startsWith(F("app"))
@@ -677,11 +913,14 @@ bool settingsRestoreJson(JsonObject& data) {
             continue;
         }
 
-        setSetting(std::move(key), String(element.value.as<String>()));
+        transaction.set(std::move(key), element.value.as<String>());
     }
 
+    transaction.commit();
     saveSettings();
 
+    espurna::settings::Generation::bump();
+
     DEBUG_MSG_P(PSTR("[SETTINGS] Settings restored successfully\n"));
     return true;
 }
@@ -734,6 +973,16 @@ void settingsDump(const ::terminal::CommandContext& ctx,
 #endif
 
 void settingsSetup() {
+#if SETTINGS_INDEX || SETTINGS_SORTED_INDEX
+    // storage is only accessible after eepromSetup(), index is built on the first lookup
+    // and dropped on reload in case something modified the storage behind our back
+    espurna::settings::kv_store.index(SETTINGS_INDEX);
+    espurna::settings::kv_store.sorted_index(SETTINGS_SORTED_INDEX);
+    espurnaRegisterReload(espurna::settings::index_reset);
+#else
+    // cached values are always fetched again after reload
+    espurnaRegisterReload(espurna::settings::Generation::bump);
+#endif
 #if TERMINAL_SUPPORT
     espurna::settings::terminal::setup();
 #endif
@@ -23,6 +23,7 @@ Copyright (C) 2020-2021 by Maxim Prokhorov <prokhorov dot max at outlook dot com
 #include "settings_convert.h"
 #include "settings_helpers.h"
 #include "settings_embedis.h"
+#include "settings_backup.h"
 #include "terminal.h"
 
 // --------------------------------------------------------------------------
@@ -34,10 +35,6 @@ void autosaveSettings();
 namespace espurna {
 namespace settings {
 
-// TODO: multi-byte access
-// {blob} read(size_t)
-// void write(size_t, {blob})
-
 class EepromStorage {
 public:
     uint8_t read(size_t pos) const {
@@ -48,6 +45,22 @@ public:
         eepromWrite(pos, value);
     }
 
+    void read(size_t pos, uint8_t* out, size_t size) const {
+        eepromRead(pos, out, size);
+    }
+
+    void write(size_t pos, const uint8_t* in, size_t size) const {
+        eepromWrite(pos, in, size);
+    }
+
+    void move(size_t to, size_t from, size_t size) const {
+        eepromMove(to, from, size);
+    }
+
+    void fill(size_t pos, uint8_t value, size_t size) const {
+        eepromFill(pos, value, size);
+    }
+
     void commit() const {
         autosaveSettings();
     }
@@ -68,14 +81,56 @@ using enable_if_not_arduino_string = std::enable_if<!is_arduino_string<T>::value
 
 } // namespace types
 
-// TODO: allow StringView as key and value
-// does not work right now because embedis api only works on things with char access
+// Lookups compare keys directly with the storage contents, without allocating anything
+// Only the value is copied into the result, and only when the key was found
+// TODO: allow StringView as value and as a key for set()
+// does not work right now because embedis write api expects data in RAM
 // (won't work on our flash strings, since those can only be accessed via aligned reads)
 
 ValueResult get(const String& key);
+ValueResult get(const Key& key);
+ValueResult get(StringView key);
+
 bool set(const String& key, const String& value);
 bool del(const String& key);
+
 bool has(const String& key);
+bool has(const Key& key);
+bool has(StringView key);
+
+// Stage multiple changes and apply them all at once. Existing keys are removed in
+// a single pass over the storage, new values are written afterwards and storage is committed once.
+// Staging the same key again replaces the previous change. Changes are kept sorted by key,
+// both staging and the storage pass use binary search instead of checking every change.
+class Transaction {
+public:
+    void set(String key, String value);
+    void del(String key);
+
+    // returns the amount of keys that were actually modified.
+    // values equal to the stored ones are not re-written
+    size_t commit();
+
+    size_t size() const {
+        return _changes.size();
+    }
+
+    void clear() {
+        _changes.clear();
+    }
+
+private:
+    struct Change {
+        String key;
+        String value;
+        bool remove;
+        bool unchanged;
+    };
+
+    void stage(String key, String value, bool remove);
+
+    std::vector<Change> _changes;
+};
 
 using Keys = std::vector<String>;
 Keys keys();
@@ -83,12 +138,59 @@ Keys keys();
 size_t available();
 size_t size();
 
+// lookup index is rebuilt on demand, only needed when storage is modified externally
+// (also invalidates every settings::Cached value)
+void index_reset();
+
 using KeyValueResultCallback = std::function<void(settings::kvs_type::KeyValueResult&&)>;
 void foreach(KeyValueResultCallback&&);
 
 using PrefixResultCallback = std::function<void(StringView prefix, String key, const kvs_type::ReadResult& value)>;
 void foreach_prefix(PrefixResultCallback&&, settings::query::StringViewIterator);
 
+// Resumable foreach() of the settings storage, see kvs_type::next()
+struct StorageSource {
+    uint16_t position() const;
+    kvs_type::KeyValueResult next(uint16_t& position) const;
+};
+
+// Backup JSON is produced on demand, one kv at a time. See backup::Writer
+using BackupWriter = backup::Writer<StorageSource>;
+BackupWriter backup_writer();
+
+// Streaming version of settingsRestoreJson(). Data can be provided in chunks of any size,
+// only the parsed key and value pairs are kept in memory instead of the whole document.
+// Nothing is reset or written until finish() sees the complete object, so truncated or
+// malformed upload does not modify the storage. Same as before, metadata keys are skipped
+// Staged pairs are limited by the storage size, feed() fails as soon as they no longer fit
+class RestoreJson {
+public:
+    // Both key and value are limited to this amount of bytes
+    explicit RestoreJson(size_t limit) :
+        _parser(limit)
+    {}
+
+    bool feed(const uint8_t* data, size_t size);
+
+    // Whether the whole document was parsed and applied
+    bool finish();
+
+    size_t count() const {
+        return _count;
+    }
+
+private:
+    bool _pair(String key, String value);
+
+    backup::Parser _parser;
+    Transaction _transaction;
+
+    size_t _count { 0 };
+    size_t _staged { 0 };
+    bool _app { false };
+    bool _backup { false };
+};
+
 // --------------------------------------------------------------------------
 
 namespace query {
@@ -127,7 +229,7 @@ String getSetting(const espurna::settings::Key& key, espurna::StringView default
 
 template <typename T, typename = typename espurna::settings::traits::enable_if_not_arduino_string<T>::type>
 T getSetting(const espurna::settings::Key& key, T defaultValue) {
-    auto result = espurna::settings::get(key.value());
+    auto result = espurna::settings::get(key);
     if (result) {
         return espurna::settings::internal::convert<T>(result.ref());
     }
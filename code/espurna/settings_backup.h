@@ -0,0 +1,513 @@
+/*
+
+Part of the SETTINGS module
+
+Streaming JSON backup and restore of the settings storage
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "settings_helpers.h"
+
+namespace espurna {
+namespace settings {
+namespace backup {
+
+// Backup is a flat JSON object, where every key and value is a string
+//
+// {
+// "app": "ESPURNA",
+// "version": "...",
+// "backup": "1",
+// "key": "value",
+// ...
+// }
+//
+// Both Writer and Parser only keep a single key and value in memory, data is expected
+// to be sent or received in chunks of some fixed size (e.g. TCP_MSS)
+
+inline void escape(String& out, const String& value) {
+    static constexpr char Hex[] = "0123456789abcdef";
+
+    for (auto it = value.begin(); it != value.end(); ++it) {
+        const auto c = static_cast<uint8_t>(*it);
+        switch (c) {
+        case '"':
+            out += F("\\\"");
+            break;
+        case '\\':
+            out += F("\\\\");
+            break;
+        case '\b':
+            out += F("\\b");
+            break;
+        case '\f':
+            out += F("\\f");
+            break;
+        case '\n':
+            out += F("\\n");
+            break;
+        case '\r':
+            out += F("\\r");
+            break;
+        case '\t':
+            out += F("\\t");
+            break;
+        default:
+            if (c < 0x20) {
+                out += F("\\u00");
+                out += Hex[(c >> 4) & 0xf];
+                out += Hex[c & 0xf];
+            } else {
+                out += static_cast<char>(c);
+            }
+            break;
+        }
+    }
+}
+
+inline void pair(String& out, const String& key, const String& value) {
+    out += '"';
+    escape(out, key);
+    out += F("\": \"");
+    escape(out, value);
+    out += '"';
+}
+
+// Source is expected to implement the resumable storage iteration
+// - uint16_t position()
+// - KeyValueResult next(uint16_t& position)
+// Output is interrupted when settings are modified in the middle of the backup,
+// since the position would no longer point to a valid kv. Instead of silently
+// truncating the object, a bare string is appended so the result never parses.
+// failed() tells the caller to also report the error, e.g. by not finishing the response
+template <typename Source>
+class Writer {
+public:
+    Writer(Source source, String header) :
+        _source(std::forward<Source>(source)),
+        _pending(std::move(header)),
+        _position(_source.position()),
+        _revision(Revision::current())
+    {}
+
+    // Fill the buffer with as much data as possible
+    // Zero means the end of output, done() tells whether it is complete
+    size_t read(uint8_t* out, size_t size) {
+        size_t written = 0;
+
+        while (written < size) {
+            if (_offset >= _pending.length()) {
+                _pending = String();
+                _offset = 0;
+                if (!_next()) {
+                    break;
+                }
+            }
+
+            const auto length = std::min(size - written, _pending.length() - _offset);
+            std::memcpy(out + written, _pending.c_str() + _offset, length);
+
+            _offset += length;
+            written += length;
+        }
+
+        return written;
+    }
+
+    bool done() const {
+        return _state == State::Done;
+    }
+
+    bool failed() const {
+        return _state == State::Error;
+    }
+
+private:
+    enum class State {
+        Settings,
+        Done,
+        Error,
+    };
+
+    bool _next() {
+        switch (_state) {
+        case State::Settings:
+            break;
+        case State::Done:
+        case State::Error:
+            return false;
+        }
+
+        if (_revision != Revision::current()) {
+            _pending = F("\n\"settings were modified, backup is incomplete\"");
+            _state = State::Error;
+            return true;
+        }
+
+        auto kv = _source.next(_position);
+        if (!kv) {
+            _pending = F("\n}");
+            _state = State::Done;
+            return true;
+        }
+
+        auto key = kv.key.read();
+        auto value = kv.value.read();
+
+        _pending.reserve(key.length() + value.length() + 8);
+        _pending += F(",\n");
+        pair(_pending, key, value);
+
+        return true;
+    }
+
+    Source _source;
+    String _pending;
+    size_t _offset { 0 };
+
+    uint16_t _position;
+    uint32_t _revision;
+    State _state { State::Settings };
+};
+
+// Incremental parser of the flat JSON object. Keys must be strings, values can be either
+// strings or bare literals (numbers, true, false), which are returned as-is. null values are ignored.
+// Callback receives every key and value as soon as they are parsed, and returns false to stop parsing
+class Parser {
+public:
+    Parser() = default;
+
+    // Both key and value are limited to this amount of bytes
+    explicit Parser(size_t limit) :
+        _limit(limit)
+    {}
+
+    template <typename Callback>
+    bool feed(const uint8_t* data, size_t size, Callback&& callback) {
+        for (auto it = data; it != data + size; ++it) {
+            if (!_feed(static_cast<char>(*it), callback)) {
+                _state = State::Error;
+                return false;
+            }
+        }
+
+        return _state != State::Error;
+    }
+
+    // Whether the object was closed, and nothing else besides whitespace followed it
+    bool done() const {
+        return _state == State::Done;
+    }
+
+    bool error() const {
+        return _state == State::Error;
+    }
+
+private:
+    enum class State {
+        Begin,
+        KeyOrEnd,
+        Key,
+        Colon,
+        Value,
+        String,
+        Literal,
+        CommaOrEnd,
+        Done,
+        Error,
+    };
+
+    static bool _whitespace(char c) {
+        return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+    }
+
+    static int _hex(char c) {
+        if ((c >= '0') && (c <= '9')) {
+            return c - '0';
+        }
+
+        if ((c >= 'a') && (c <= 'f')) {
+            return c - 'a' + 10;
+        }
+
+        if ((c >= 'A') && (c <= 'F')) {
+            return c - 'A' + 10;
+        }
+
+        return -1;
+    }
+
+    String& _current() {
+        return (_state == State::Key) ? _key : _value;
+    }
+
+    bool _append(char c) {
+        auto& out = _current();
+        if (out.length() >= _limit) {
+            return false;
+        }
+
+        out += c;
+        return true;
+    }
+
+    // \uXXXX is stored as UTF-8. Surrogate pairs are not combined
+    bool _append_unicode(uint16_t code) {
+        if (code == 0) {
+            return false;
+        }
+
+        if (code < 0x80) {
+            return _append(static_cast<char>(code));
+        }
+
+        if (code < 0x800) {
+            return _append(static_cast<char>(0xc0 | (code >> 6)))
+                && _append(static_cast<char>(0x80 | (code & 0x3f)));
+        }
+
+        return _append(static_cast<char>(0xe0 | (code >> 12)))
+            && _append(static_cast<char>(0x80 | ((code >> 6) & 0x3f)))
+            && _append(static_cast<char>(0x80 | (code & 0x3f)));
+    }
+
+    bool _string(char c) {
+        if (_unicode) {
+            const auto value = _hex(c);
+            if (value < 0) {
+                return false;
+            }
+
+            _code = (_code << 4) | value;
+            if (--_unicode == 0) {
+                return _append_unicode(_code);
+            }
+
+            return true;
+        }
+
+        if (_escape) {
+            _escape = false;
+            switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                return _append(c);
+            case 'b':
+                return _append('\b');
+            case 'f':
+                return _append('\f');
+            case 'n':
+                return _append('\n');
+            case 'r':
+                return _append('\r');
+            case 't':
+                return _append('\t');
+            case 'u':
+                _unicode = 4;
+                _code = 0;
+                return true;
+            }
+
+            return false;
+        }
+
+        switch (c) {
+        case '\\':
+            _escape = true;
+            return true;
+        case '"':
+            return false;
+        }
+
+        if (static_cast<uint8_t>(c) < 0x20) {
+            return false;
+        }
+
+        return _append(c);
+    }
+
+    template <typename Callback>
+    bool _emit(Callback& callback) {
+        auto key = std::move(_key);
+        auto value = std::move(_value);
+        _key = String();
+        _value = String();
+
+        _state = State::CommaOrEnd;
+
+        if (_null) {
+            _null = false;
+            return true;
+        }
+
+        return callback(std::move(key), std::move(value));
+    }
+
+    bool _literal_end() {
+        if (_value == F("null")) {
+            _null = true;
+            return true;
+        }
+
+        if ((_value == F("true")) || (_value == F("false"))) {
+            return true;
+        }
+
+        for (auto it = _value.begin(); it != _value.end(); ++it) {
+            const auto c = *it;
+            if (((c < '0') || (c > '9')) && (c != '-') && (c != '+')
+                && (c != '.') && (c != 'e') && (c != 'E'))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    template <typename Callback>
+    bool _feed(char c, Callback& callback) {
+        switch (_state) {
+        case State::Begin:
+            if (_whitespace(c)) {
+                return true;
+            }
+
+            if (c == '{') {
+                _state = State::KeyOrEnd;
+                return true;
+            }
+
+            return false;
+
+        case State::KeyOrEnd:
+            if (_whitespace(c)) {
+                return true;
+            }
+
+            if ((c == '}') && _empty) {
+                _state = State::Done;
+                return true;
+            }
+
+            if (c == '"') {
+                _state = State::Key;
+                return true;
+            }
+
+            return false;
+
+        case State::Key:
+            if ((c == '"') && !_escape && !_unicode) {
+                _state = State::Colon;
+                return true;
+            }
+
+            return _string(c);
+
+        case State::Colon:
+            if (_whitespace(c)) {
+                return true;
+            }
+
+            if (c == ':') {
+                _state = State::Value;
+                return true;
+            }
+
+            return false;
+
+        case State::Value:
+            if (_whitespace(c)) {
+                return true;
+            }
+
+            if (c == '"') {
+                _state = State::String;
+                return true;
+            }
+
+            if ((c == '{') || (c == '[') || (c == ',') || (c == '}')) {
+                return false;
+            }
+
+            _state = State::Literal;
+            return _append(c);
+
+        case State::String:
+            if ((c == '"') && !_escape && !_unicode) {
+                return _emit(callback);
+            }
+
+            return _string(c);
+
+        case State::Literal:
+            if (!_whitespace(c) && (c != ',') && (c != '}')) {
+                return _append(c);
+            }
+
+            if (!_literal_end()) {
+                return false;
+            }
+
+            if (!_emit(callback)) {
+                return false;
+            }
+
+            return _whitespace(c) || _feed(c, callback);
+
+        case State::CommaOrEnd:
+            if (_whitespace(c)) {
+                return true;
+            }
+
+            if (c == ',') {
+                _state = State::KeyOrEnd;
+                _empty = false;
+                return true;
+            }
+
+            if (c == '}') {
+                _state = State::Done;
+                return true;
+            }
+
+            return false;
+
+        case State::Done:
+            return _whitespace(c);
+
+        case State::Error:
+            break;
+        }
+
+        return false;
+    }
+
+    String _key;
+    String _value;
+
+    size_t _limit { 1024 };
+
+    uint16_t _code { 0 };
+    uint8_t _unicode { 0 };
+    bool _escape { false };
+    bool _null { false };
+    bool _empty { true };
+
+    State _state { State::Begin };
+};
+
+} // namespace backup
+} // namespace settings
+} // namespace espurna
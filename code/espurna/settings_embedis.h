@@ -14,6 +14,7 @@ Reimplementation of the Embedis storage format:
 #include <Arduino.h>
 
 #include <algorithm>
+#include <cstring>
 #include <memory>
 #include <vector>
 
@@ -36,6 +37,31 @@ inline size_t estimate(const String& key, const String& value) {
     return (4 + key.length() + value.length());
 }
 
+// FNV-1a of the key bytes, folded into 16 bits to keep the index entries small.
+// Index lookups always verify the key itself, collisions only cost an extra read.
+struct KeyHash {
+    void update(uint8_t value) {
+        _value = (_value ^ value) * 16777619u;
+    }
+
+    uint16_t value() const {
+        return static_cast<uint16_t>((_value >> 16) ^ (_value & 0xffff));
+    }
+
+private:
+    uint32_t _value { 2166136261u };
+};
+
+// Key could be located either in RAM or in flash, only aligned reads are allowed for the latter
+inline uint16_t hash(StringView key) {
+    KeyHash out;
+    for (auto it = key.begin(); it != key.end(); ++it) {
+        out.update(pgm_read_byte(it));
+    }
+
+    return out.value();
+}
+
 // Note:  KeyValueStore is templated to avoid having to provide RawStorageBase via virtual inheritance.
 
 template <typename RawStorageBase>
@@ -43,9 +69,7 @@ class KeyValueStore {
 private:
 
     // -----------------------------------------------------------------------------------
-    // TODO: storage access is one byte at a time. consider also having:
-    // - read(begin, end)
-    // - write(begin, end, input_begin, input_end)
+    // Storage is required to implement single byte access and commit() at the least
     // -----------------------------------------------------------------------------------
 
     template <typename T>
@@ -71,6 +95,117 @@ private:
         "Storage class must implement read(index), write(index, byte) and commit()"
     );
 
+    // -----------------------------------------------------------------------------------
+    // Optionally, storage could also implement block access methods. Either all of them or none:
+    // - read(index, output, size)
+    // - write(index, input, size)
+    // - move(to, from, size), ranges may overlap
+    // - fill(index, value, size)
+    // Otherwise, same operations are done one byte at a time
+    // -----------------------------------------------------------------------------------
+
+    template <typename T>
+    using storage_can_read_block_t = decltype(std::declval<T>().read(
+        std::declval<uint16_t>(), std::declval<uint8_t*>(), std::declval<uint16_t>()));
+    template <typename T>
+    using storage_can_read_block = is_detected<storage_can_read_block_t, T>;
+
+    template <typename T>
+    using storage_can_write_block_t = decltype(std::declval<T>().write(
+        std::declval<uint16_t>(), std::declval<const uint8_t*>(), std::declval<uint16_t>()));
+    template <typename T>
+    using storage_can_write_block = is_detected<storage_can_write_block_t, T>;
+
+    template <typename T>
+    using storage_can_move_t = decltype(std::declval<T>().move(
+        std::declval<uint16_t>(), std::declval<uint16_t>(), std::declval<uint16_t>()));
+    template <typename T>
+    using storage_can_move = is_detected<storage_can_move_t, T>;
+
+    template <typename T>
+    using storage_can_fill_t = decltype(std::declval<T>().fill(
+        std::declval<uint16_t>(), std::declval<uint8_t>(), std::declval<uint16_t>()));
+    template <typename T>
+    using storage_can_fill = is_detected<storage_can_fill_t, T>;
+
+    using storage_block_access = std::integral_constant<bool,
+        storage_can_read_block<RawStorageBase>{}
+        && storage_can_write_block<RawStorageBase>{}
+        && storage_can_move<RawStorageBase>{}
+        && storage_can_fill<RawStorageBase>{}>;
+
+    static_assert(
+        storage_block_access{}
+        || !(storage_can_read_block<RawStorageBase>{}
+            || storage_can_write_block<RawStorageBase>{}
+            || storage_can_move<RawStorageBase>{}
+            || storage_can_fill<RawStorageBase>{}),
+        "Storage class must implement all of block access methods"
+    );
+
+    static void _storage_read(const std::true_type&, RawStorageBase& storage, uint16_t index, uint8_t* out, uint16_t size) {
+        storage.read(index, out, size);
+    }
+
+    static void _storage_read(const std::false_type&, RawStorageBase& storage, uint16_t index, uint8_t* out, uint16_t size) {
+        for (uint16_t offset = 0; offset < size; ++offset) {
+            out[offset] = storage.read(index + offset);
+        }
+    }
+
+    static void _storage_read(RawStorageBase& storage, uint16_t index, uint8_t* out, uint16_t size) {
+        _storage_read(storage_block_access{}, storage, index, out, size);
+    }
+
+    static void _storage_write(const std::true_type&, RawStorageBase& storage, uint16_t index, const uint8_t* in, uint16_t size) {
+        storage.write(index, in, size);
+    }
+
+    static void _storage_write(const std::false_type&, RawStorageBase& storage, uint16_t index, const uint8_t* in, uint16_t size) {
+        for (uint16_t offset = 0; offset < size; ++offset) {
+            storage.write(index + offset, in[offset]);
+        }
+    }
+
+    static void _storage_write(RawStorageBase& storage, uint16_t index, const uint8_t* in, uint16_t size) {
+        _storage_write(storage_block_access{}, storage, index, in, size);
+    }
+
+    static void _storage_move(const std::true_type&, RawStorageBase& storage, uint16_t to, uint16_t from, uint16_t size) {
+        storage.move(to, from, size);
+    }
+
+    // when ranges overlap, copy from the side that won't overwrite the source
+    static void _storage_move(const std::false_type&, RawStorageBase& storage, uint16_t to, uint16_t from, uint16_t size) {
+        if (to > from) {
+            while (size--) {
+                storage.write(to + size, storage.read(from + size));
+            }
+        } else {
+            for (uint16_t offset = 0; offset < size; ++offset) {
+                storage.write(to + offset, storage.read(from + offset));
+            }
+        }
+    }
+
+    static void _storage_move(RawStorageBase& storage, uint16_t to, uint16_t from, uint16_t size) {
+        _storage_move(storage_block_access{}, storage, to, from, size);
+    }
+
+    static void _storage_fill(const std::true_type&, RawStorageBase& storage, uint16_t index, uint8_t value, uint16_t size) {
+        storage.fill(index, value, size);
+    }
+
+    static void _storage_fill(const std::false_type&, RawStorageBase& storage, uint16_t index, uint8_t value, uint16_t size) {
+        for (uint16_t offset = 0; offset < size; ++offset) {
+            storage.write(index + offset, value);
+        }
+    }
+
+    static void _storage_fill(RawStorageBase& storage, uint16_t index, uint8_t value, uint16_t size) {
+        _storage_fill(storage_block_access{}, storage, index, value, size);
+    }
+
     // -----------------------------------------------------------------------------------
 
     // Tracking state of the parser inside of _raw_read()
@@ -128,6 +263,11 @@ private:
             _storage.write(_position, value);
         }
 
+        // read 'size' bytes starting from the current position, does not move the cursor
+        void read(uint8_t* out, uint16_t size) const {
+            _storage_read(_storage, _position, out, size);
+        }
+
         Cursor& operator=(uint8_t value) {
             write(value);
             return *this;
@@ -210,6 +350,94 @@ private:
         uint16_t _position;
     };
 
+    // Optional lookup table of (key hash) -> (kv position), built from a single storage scan
+    // Position is the right boundary of the kv, exactly where set() started writing it.
+    // Entries are sorted by hash, entries with the same hash are kept in the storage scan order.
+    // Separately, can keep kv positions sorted by key, so prefix searches only need to look at the matching range.
+    // (and lookups can use binary search, when hash entries are disabled)
+    // Either one also tracks the left boundary of the used space, which otherwise requires a full scan.
+    // XXX: positions **will** break when the underlying storage changes outside of this class
+    struct Index {
+        struct Entry {
+            uint16_t hash;
+            uint16_t position;
+        };
+
+        using Positions = std::vector<uint16_t>;
+        using Entries = std::vector<Entry>;
+        using Iterator = typename Entries::const_iterator;
+        using Range = std::pair<Iterator, Iterator>;
+
+        static bool compare(const Entry& lhs, const Entry& rhs) {
+            return lhs.hash < rhs.hash;
+        }
+
+        Range equal_range(uint16_t hash) const {
+            return std::equal_range(
+                entries.cbegin(), entries.cend(), Entry{hash, 0}, compare);
+        }
+
+        void insert(uint16_t hash, uint16_t position) {
+            const auto entry = Entry{hash, position};
+            entries.insert(
+                std::upper_bound(entries.begin(), entries.end(), entry, compare),
+                entry);
+        }
+
+        void erase(uint16_t position) {
+            auto it = std::find_if(entries.begin(), entries.end(),
+                [&](const Entry& entry) {
+                    return entry.position == position;
+                });
+            if (it != entries.end()) {
+                entries.erase(it);
+            }
+
+            auto sorted_it = std::find(sorted.begin(), sorted.end(), position);
+            if (sorted_it != sorted.end()) {
+                sorted.erase(sorted_it);
+            }
+        }
+
+        // everything to the left of the boundary is moved to the right by the offset
+        void shift(uint16_t boundary, uint16_t offset) {
+            for (auto& entry : entries) {
+                if (entry.position <= boundary) {
+                    entry.position += offset;
+                }
+            }
+
+            for (auto& position : sorted) {
+                if (position <= boundary) {
+                    position += offset;
+                }
+            }
+        }
+
+        void reset() {
+            Entries{}.swap(entries);
+            Positions{}.swap(sorted);
+            tail = 0;
+            ready = false;
+        }
+
+        bool active() const {
+            return enabled || ordered;
+        }
+
+        // amount of indexed kvs, both lists have all of them
+        size_t size() const {
+            return enabled ? entries.size() : sorted.size();
+        }
+
+        Entries entries;
+        Positions sorted;
+        uint16_t tail { 0 };
+        bool enabled { false };
+        bool ordered { false };
+        bool ready { false };
+    };
+
 public:
 
     // Store value location in a more reasonable forward-iterator-style manner
@@ -265,14 +493,138 @@ public:
             }
 
             out.reserve(len);
-            for (auto cursor = _cursor; cursor.offset() < len; ++cursor) {
-                out += static_cast<char>(cursor.read());
-            }
+            _chunks([&](const uint8_t* data, uint16_t size) {
+                out.concat(reinterpret_cast<const char*>(data), size);
+                return true;
+            });
 
             return out;
         }
 
+        // Compare the stored data with the string without making a copy of it
+        bool equals(StringView other) const {
+            if (other.length() != length()) {
+                return false;
+            }
+
+            size_t offset = 0;
+            return _chunks([&](const uint8_t* data, uint16_t size) {
+                const auto chunk = StringView(reinterpret_cast<const char*>(data), size);
+                const auto result = chunk.equals(other.slice(offset, size));
+                offset += size;
+                return result;
+            });
+        }
+
+        // Lexicographic comparison of the stored data and the string, without making a copy of it
+        int compare(StringView other) const {
+            const auto result = _compare(other, std::min<size_t>(length(), other.length()));
+            if (result != 0) {
+                return result;
+            }
+
+            return (length() < other.length()) ? -1
+                : (length() > other.length()) ? 1
+                : 0;
+        }
+
+        // Same as above, but both sides are read from the storage one chunk at a time
+        int compare(const ReadResult& other) const {
+            const auto size = std::min(length(), other.length());
+
+            int result = 0;
+            auto cursor = other._cursor;
+            _chunks([&](const uint8_t* data, uint16_t chunk) {
+                chunk = std::min<uint16_t>(chunk, size - cursor.offset());
+                if (!chunk) {
+                    return false;
+                }
+
+                uint8_t buffer[ChunkSize];
+                cursor.read(buffer, chunk);
+                cursor += chunk;
+
+                result = std::memcmp(data, buffer, chunk);
+                return result == 0;
+            });
+
+            if (result != 0) {
+                return result;
+            }
+
+            return (length() < other.length()) ? -1
+                : (length() > other.length()) ? 1
+                : 0;
+        }
+
+        bool startsWith(StringView prefix) const {
+            if (length() < prefix.length()) {
+                return false;
+            }
+
+            return _compare(prefix, prefix.length()) == 0;
+        }
+
+        uint16_t hash() const {
+            KeyHash out;
+
+            _chunks([&](const uint8_t* data, uint16_t size) {
+                for (auto it = data; it != data + size; ++it) {
+                    out.update(*it);
+                }
+                return true;
+            });
+
+            return out.value();
+        }
+
     private:
+        // Data is read into a small stack buffer, one chunk at a time
+        // Callback returns 'false' when it no longer needs any more data
+        static constexpr uint16_t ChunkSize { 32 };
+
+        template <typename T>
+        bool _chunks(T&& callback) const {
+            uint8_t buffer[ChunkSize];
+
+            const auto len = length();
+            for (auto cursor = _cursor; cursor.offset() < len;) {
+                const auto size = std::min<uint16_t>(len - cursor.offset(), ChunkSize);
+                cursor.read(buffer, size);
+                if (!callback(&buffer[0], size)) {
+                    return false;
+                }
+
+                cursor += size;
+            }
+
+            return true;
+        }
+
+        // Compare up to 'size' bytes. Same as hash(), string could be located in flash
+        int _compare(StringView other, size_t size) const {
+            int result = 0;
+            size_t offset = 0;
+
+            _chunks([&](const uint8_t* data, uint16_t length) {
+                for (auto it = data; it != data + length; ++it, ++offset) {
+                    if (offset >= size) {
+                        return false;
+                    }
+
+                    result = static_cast<int>(*it)
+                        - static_cast<int>(pgm_read_byte(other.begin() + offset));
+                    if (result != 0) {
+                        return false;
+                    }
+                }
+
+                return true;
+            });
+
+            return result;
+        }
+
         Cursor _cursor;
         bool _result { false };
     };
@@ -313,14 +665,80 @@ public:
     // Try to find the matching key. Datastructure that we use does not specify
     // any value 'type' inside of it. We expect 'key' to be the first non-empty string,
     // 'value' can be empty.
-    ValueResult get(const String& key) {
+    ValueResult get(StringView key) {
         return _get(key, true);
     }
 
-    bool has(const String& key) {
+    bool has(StringView key) {
         return static_cast<bool>(_get(key, false));
     }
 
+    // Lookup index is built on demand, on the first operation that needs it.
+    // set() and del() keep it in sync, but it has to be reset when the
+    // storage contents are modified externally (e.g. erased or restored)
+    void index(bool value) {
+        _index.reset();
+        _index.enabled = value;
+    }
+
+    bool indexed() const {
+        return _index.enabled;
+    }
+
+    // Key order is kept independently of the hash lookups, and only costs a single position per kv
+    void sorted_index(bool value) {
+        _index.reset();
+        _index.ordered = value;
+    }
+
+    bool sorted_indexed() const {
+        return _index.ordered;
+    }
+
+    void index_reset() {
+        _index.reset();
+    }
+
+    size_t index_size() const {
+        return _index.size();
+    }
+
+    // Same as foreach(), but kvs are ordered by key. Callback should not modify the storage.
+    // Without the sorted index, positions are gathered and sorted on every call
+    template <typename CallbackType>
+    void foreach_sorted(CallbackType callback) {
+        if (_index_prepare() && _index.ordered) {
+            _foreach_position(_index.sorted.begin(), _index.sorted.end(), callback);
+            return;
+        }
+
+        auto positions = _sorted_positions();
+        _foreach_position(positions.begin(), positions.end(), callback);
+    }
+
+    // Only visit kvs with the key starting with the prefix. Callback should not modify the storage.
+    // With the sorted index, kvs are ordered by key and only the matching range is read
+    template <typename CallbackType>
+    void foreach_prefix(StringView prefix, CallbackType callback) {
+        if (_index_prepare() && _index.ordered) {
+            auto begin = _sorted_lower_bound(prefix);
+
+            auto end = begin;
+            while ((end != _index.sorted.end()) && _key_at(*end).startsWith(prefix)) {
+                ++end;
+            }
+
+            _foreach_position(begin, end, callback);
+            return;
+        }
+
+        foreach([&](KeyValueResult&& kv) {
+            if (kv.key.startsWith(prefix)) {
+                callback(std::move(kv));
+            }
+        });
+    }
+
     // We going be using this pattern all the time here, because we need 2 consecutive **valid** ranges
     // TODO: expose _read_kv() and _cursor_reset_end() so we can have 'break' here?
     //       perhaps as a wrapper object, allow something like next() and seekBegin()
@@ -336,6 +754,24 @@ public:
         } while (_state != State::End);
     }
 
+    // Resumable version of foreach(), when kvs can't be processed all at once.
+    // Starting with position(), every call returns kv at the position and moves it to the next one.
+    // Empty result means there are no more kvs. Position is no longer valid after storage is modified
+    uint16_t position() const {
+        return _cursor.end();
+    }
+
+    KeyValueResult next(uint16_t& position) {
+        _cursor_set_position(position);
+
+        auto kv = _read_kv();
+        if (kv) {
+            position = kv.value.begin();
+        }
+
+        return kv;
+    }
+
     // set or update key with value contents. ensure 'key' isn't empty, 'value' can be empty
     bool set(const String& key, const String& value) {
 
@@ -345,40 +781,31 @@ public:
             return false;
         }
 
-        auto key_len = key.length();
-        auto value_len = value.length();
-
         Cursor to_erase(_storage, 0, 0);
         bool need_erase = false;
 
         // we need the position at the 'end' of the free space
-        auto start_pos = _cursor_reset_end();
-
-        do {
-            auto kv = _read_kv();
-            if (!kv) {
-                break;
-            }
-
-            start_pos = kv.value.begin();
-
-            // in the very special case we can match the existing key, we either
-            if ((kv.key.length() == key_len) && (kv.key.read() == key)) {
-                if (kv.value.length() == value.length()) {
-                    // - do nothing, as the value is already set
-                    if (kv.value.read() == value) {
-                        return true;
-                    }
-                    // - overwrite the space again, with the new kv of the same length
-                    start_pos = kv.key.end();
-                    break;
+        uint16_t start_pos = 0;
+        auto kv = _find(key, start_pos);
+
+        // in the very special case we can match the existing key, we either
+        if (kv) {
+            if (kv.value.length() == value.length()) {
+                // - do nothing, as the value is already set
+                if (kv.value.equals(value)) {
+                    return true;
                 }
+                // - overwrite the value data in place. key and both lengths stay exactly the same
+                _storage_write(_storage, kv.value.begin(),
+                    reinterpret_cast<const uint8_t*>(value.c_str()), value.length());
+                _storage.commit();
+                return true;
+            } else {
                 // - or, erase the existing kv and place new kv at the end
                 to_erase.reset(kv.value.begin(), kv.key.end());
                 need_erase = true;
             }
-
-        } while (_state != State::End);
+        }
 
         if (need_erase) {
             if ((start_pos + to_erase.size()) < need) {
@@ -390,34 +817,32 @@ public:
 
         // we should only insert when possition is still within possible size
         if (start_pos && (start_pos >= need)) {
-            auto writer = Cursor::fromEnd(_storage, start_pos - need, start_pos);
-
             // put the length of the value as 2 bytes and then write the data
-            (--writer).write(key_len & 0xff);
-            (--writer).write((key_len >> 8) & 0xff);
-            while (key_len--) {
-                (--writer).write(key[key_len]);
-            }
-
-            (--writer).write(value_len & 0xff);
-            (--writer).write((value_len >> 8) & 0xff);
-
-            while (value_len--) {
-                (--writer).write(value[value_len]);
-            }
+            auto begin = _raw_write(start_pos, key);
+            begin = _raw_write(begin, value);
 
             // we also need to add an empty key *after* the value
             // but, only when we still have some space left
-            if (writer.begin() >= 2) {
-                _cursor_set_position(writer.begin());
+            if (begin >= 2) {
+                _cursor_set_position(begin);
                 auto next_kv = _read_kv();
                 if (!next_kv) {
-                    auto empty = Cursor::fromEnd(_storage, writer.begin() - 2, writer.begin());
-                    (--empty).write(0xff);
-                    (--empty).write(0xff);
+                    _storage_fill(_storage, begin - 2, 0xff, 2);
                 }
             }
 
+            if (_index.ready) {
+                if (_index.enabled) {
+                    _index.insert(hash(key), start_pos);
+                }
+
+                if (_index.ordered) {
+                    _sorted_insert(key, start_pos);
+                }
+
+                _index.tail = start_pos - need;
+            }
+
             _storage.commit();
 
             return true;
@@ -427,26 +852,18 @@ public:
     }
 
     // remove key from the storage. will check that 'key' argument isn't empty
-    bool del(const String& key) {
-        size_t key_len = key.length();
-        if (!key_len) {
+    bool del(StringView key) {
+        if (!key.length()) {
             return false;
         }
 
-        // we should only compare strings of equal length.
         // when matching, record { value ... key } range + 4 bytes for length
-        // continue searching for available keys and set start_pos and the 'end' of the free space
-        size_t start_pos = _cursor_reset_end();
-        auto to_erase = Cursor::fromEnd(_storage, _cursor.begin(), _cursor.end());
+        // and the 'end' of the free space, which is where the shifted data will be placed
+        uint16_t start_pos = 0;
+        auto kv = _find(key, start_pos);
 
-        foreach([&](KeyValueResult&& kv) {
-            start_pos = kv.value.begin();
-            if (!to_erase && (kv.key.length() == key_len) && (kv.key.read() == key)) {
-                to_erase.reset(kv.value.begin(), kv.key.end());
-            }
-        });
-
-        if (to_erase) {
+        if (kv) {
+            Cursor to_erase(_storage, kv.value.begin(), kv.key.end());
             _raw_erase(start_pos, to_erase);
             return true;
         }
@@ -454,8 +871,59 @@ public:
         return false;
     }
 
+    // remove every kv matching the predicate. unlike del(), remaining kvs are shifted
+    // at most once and storage is only committed once, regardless of the amount of removed keys
+    // predicate receives `const KeyValueResult&` and returns `true` when kv needs to be removed
+    template <typename Predicate>
+    size_t del_if(Predicate&& predicate) {
+        size_t removed = 0;
+
+        // kvs that are kept are placed at the 'end' of the storage, one after another
+        // since we are reading right-to-left, moved data never overwrites anything not yet read
+        uint16_t tail = _cursor_reset_end();
+        uint16_t end = tail;
+
+        do {
+            auto kv = _read_kv();
+            if (!kv) {
+                break;
+            }
+
+            const uint16_t kv_begin = kv.value.begin();
+            const uint16_t kv_end = kv.key.end();
+            tail = kv_begin;
+
+            if (predicate(static_cast<const KeyValueResult&>(kv))) {
+                ++removed;
+                continue;
+            }
+
+            const uint16_t size = kv_end - kv_begin;
+            if (end != kv_end) {
+                _storage_move(_storage, end - size, kv_begin, size);
+            }
+
+            end -= size;
+        } while (_state != State::End);
+
+        if (removed) {
+            _storage_fill(_storage, tail, 0xff, end - tail);
+            if (_index.ready) {
+                _index.reset();
+            }
+
+            _storage.commit();
+        }
+
+        return removed;
+    }
+
     // Simply count key-value pairs that we could parse
     size_t count() {
+        if (_index_prepare()) {
+            return _index.size();
+        }
+
         size_t result = 0;
         foreach([&result](KeyValueResult&&) {
             ++result;
@@ -467,6 +935,10 @@ public:
     // Do exactly the same thing as 'keys' does, but return the amount
     // of bytes to the left of the last kv
     size_t available() {
+        if (_index_prepare()) {
+            return _index.tail - _cursor.begin();
+        }
+
         size_t result = _cursor.size();
         foreach([&result](KeyValueResult&& kv) {
             result -= kv.key._cursor.size();
@@ -487,9 +959,21 @@ public:
     // any value 'type' inside of it. We expect 'key' to be the first non-empty string,
     // 'value' can be empty.
     // To implement has(), allow to skip reading the value
-    ValueResult _get(const String& key, bool read_value) {
+    ValueResult _get(StringView key, bool read_value) {
         ValueResult out;
-        auto len = key.length();
+
+        if (_index_prepare()) {
+            auto kv = _index_find(key);
+            if (kv) {
+                if (read_value) {
+                    out = kv.value.read();
+                } else {
+                    out = String();
+                }
+            }
+
+            return out;
+        }
 
         _cursor_reset_end();
 
@@ -499,14 +983,9 @@ public:
                 break;
             }
 
-            // no point in comparing keys when length does not match
+            // no point in reading the value when key does not match
             // (and we also don't want to allocate the string)
-            if (kv.key.length() != len) {
-                continue;
-            }
-
-            auto key_result = kv.key.read();
-            if (key_result == key) {
+            if (kv.key.equals(key)) {
                 if (read_value) {
                     out = kv.value.read();
                 } else {
@@ -520,6 +999,160 @@ public:
         return out;
     }
 
+    // Find the kv matching the key, and the left boundary of the used space.
+    // Without the index, both require us to go through the whole storage
+    KeyValueResult _find(StringView key, uint16_t& tail) {
+        if (_index_prepare()) {
+            tail = _index.tail;
+            return _index_find(key);
+        }
+
+        KeyValueResult out { _storage };
+
+        tail = _cursor_reset_end();
+
+        do {
+            auto kv = _read_kv();
+            if (!kv) {
+                break;
+            }
+
+            tail = kv.value.begin();
+
+            if (!out && kv.key.equals(key)) {
+                out.key.reset(kv.key.begin(), kv.key.end());
+                out.value.reset(kv.value.begin(), kv.value.end());
+            }
+        } while (_state != State::End);
+
+        return out;
+    }
+
+    // Hash collisions are expected, always check the key stored at the position
+    // Without hash entries, sorted positions are searched instead
+    KeyValueResult _index_find(StringView key) {
+        if (!_index.enabled) {
+            const auto it = _sorted_lower_bound(key);
+            if ((it != _index.sorted.end()) && _key_at(*it).equals(key)) {
+                _cursor_set_position(*it);
+                return _read_kv();
+            }
+
+            return KeyValueResult { _storage };
+        }
+
+        const auto range = _index.equal_range(hash(key));
+
+        for (auto it = range.first; it != range.second; ++it) {
+            _cursor_set_position((*it).position);
+
+            auto kv = _read_kv();
+            if (kv && kv.key.equals(key)) {
+                return kv;
+            }
+        }
+
+        return KeyValueResult { _storage };
+    }
+
+    bool _index_prepare() {
+        if (!_index.active()) {
+            return false;
+        }
+
+        if (!_index.ready) {
+            _index_build();
+        }
+
+        return true;
+    }
+
+    void _index_build() {
+        _index.entries.clear();
+        _index.tail = _cursor_reset_end();
+
+        do {
+            auto kv = _read_kv();
+            if (!kv) {
+                break;
+            }
+
+            _index.tail = kv.value.begin();
+            if (_index.enabled) {
+                _index.entries.push_back(
+                    typename Index::Entry{kv.key.hash(), kv.key.end()});
+            }
+
+            if (_index.ordered) {
+                _index.sorted.push_back(kv.key.end());
+            }
+        } while (_state != State::End);
+
+        // both lists are gathered as-is and sorted only once, instead of inserting every entry in order
+        std::sort(_index.entries.begin(), _index.entries.end(), Index::compare);
+        _sort_positions(_index.sorted);
+
+        _index.entries.shrink_to_fit();
+        _index.sorted.shrink_to_fit();
+        _index.ready = true;
+    }
+
+    // Key is located right before the position, does not use the main cursor
+    ReadResult _key_at(uint16_t position) {
+        uint8_t length_bytes[2];
+        _storage_read(_storage, position - 2, &length_bytes[0], 2);
+
+        const uint16_t length = (length_bytes[0] << 8) | length_bytes[1];
+
+        ReadResult out { _storage };
+        out.reset(position - 2 - length, position);
+
+        return out;
+    }
+
+    typename Index::Positions::iterator _sorted_lower_bound(StringView key) {
+        return std::lower_bound(_index.sorted.begin(), _index.sorted.end(), key,
+            [&](uint16_t lhs, StringView key) {
+                return _key_at(lhs).compare(key) < 0;
+            });
+    }
+
+    void _sorted_insert(StringView key, uint16_t position) {
+        _index.sorted.insert(_sorted_lower_bound(key), position);
+    }
+
+    // Keys are compared directly in the storage, nothing is copied
+    void _sort_positions(typename Index::Positions& positions) {
+        std::sort(positions.begin(), positions.end(),
+            [&](uint16_t lhs, uint16_t rhs) {
+                return _key_at(lhs).compare(_key_at(rhs)) < 0;
+            });
+    }
+
+    typename Index::Positions _sorted_positions() {
+        typename Index::Positions out;
+        foreach([&](KeyValueResult&& kv) {
+            out.push_back(kv.key.end());
+        });
+
+        _sort_positions(out);
+
+        return out;
+    }
+
+    template <typename Iterator, typename CallbackType>
+    void _foreach_position(Iterator begin, Iterator end, CallbackType& callback) {
+        for (auto it = begin; it != end; ++it) {
+            _cursor_set_position(*it);
+            auto kv = _read_kv();
+            if (!kv) {
+                break;
+            }
+
+            callback(std::move(kv));
+        }
+    }
+
     // Place cursor at the `end` and resets the parser to expect length byte
     uint16_t _cursor_reset_end() {
         _cursor.position(_cursor.end());
@@ -544,34 +1177,45 @@ public:
         return KeyValueResult { _storage };
     };
 
-    void _raw_erase(size_t start_pos, Cursor& to_erase) {
-        // we either end up to the left or to the right of the boundary
+    // Writes data and its length as 2 bytes (big-endian), right-to-left starting from the 'end'
+    // Returns the position where data begins, which is also the 'end' of the next write
+    uint16_t _raw_write(uint16_t end, const String& data) {
+        const uint16_t length = data.length();
 
-        size_t new_pos = (start_pos < to_erase.begin())
-            ? (start_pos + to_erase.size())
-            : (to_erase.end());
+        const uint8_t length_bytes[2] {
+            static_cast<uint8_t>((length >> 8) & 0xff),
+            static_cast<uint8_t>(length & 0xff),
+        };
 
-        if (start_pos < to_erase.begin()) {
-            // shift storage to the right, overwriting over the now empty space
-            auto from = Cursor::fromEnd(_storage, start_pos, to_erase.begin());
-            auto to = Cursor::fromEnd(_storage, start_pos + to_erase.size(), to_erase.end());
+        end -= 2;
+        _storage_write(_storage, end, &length_bytes[0], 2);
 
-            while (--from && --to) {
-                to.write(from.read());
-                from.write(0xff);
-            }
-        } else {
-            // overwrite the now empty space with 0xff
-            to_erase.position(to_erase.end());
-            while (--to_erase) {
-                to_erase.write(0xff);
-            }
+        end -= length;
+        _storage_write(_storage, end,
+            reinterpret_cast<const uint8_t*>(data.c_str()), length);
+
+        return end;
+    }
+
+    void _raw_erase(size_t start_pos, Cursor& to_erase) {
+        // shift storage to the right, overwriting the erased kv
+        // (unless it is the last one, and there is nothing to shift)
+        if (start_pos < to_erase.begin()) {
+            _storage_move(_storage,
+                start_pos + to_erase.size(), start_pos,
+                to_erase.begin() - start_pos);
         }
 
-        // same as set(), add empty key as padding
-        auto empty = Cursor::fromEnd(_storage, new_pos - 2, new_pos);
-        (--empty).write(0xff);
-        (--empty).write(0xff);
+        // overwrite the now empty space with 0xff
+        // same as set(), this also adds an empty key as padding
+        _storage_fill(_storage, start_pos, 0xff, to_erase.size());
+
+        // everything that was shifted is now one kv closer to the end
+        if (_index.ready) {
+            _index.erase(to_erase.end());
+            _index.shift(to_erase.begin(), to_erase.size());
+            _index.tail = start_pos + to_erase.size();
+        }
 
         _storage.commit();
     }
@@ -657,6 +1301,7 @@ return_result:
     RawStorageBase _storage;
     Cursor _cursor;
     State _state { State::Begin };
+    Index _index;
 };
 
 } // namespace embedis
@@ -13,6 +13,7 @@ Copyright (C) 2020-2023 by Maxim Prokhorov <prokhorov dot max at outlook dot com
 
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "types.h"
 
@@ -219,6 +220,122 @@ private:
     size_t _step { 1 };
 };
 
+// Incremented every time settings are deleted, restored or reloaded
+// Allows to skip reading and converting the value again when nothing could've changed
+// Same as the module configuration, values written with set() are only picked up after the reload
+// (otherwise, any module writing settings from its loop would invalidate every cached value)
+struct Generation {
+    static uint32_t current() {
+        return value();
+    }
+
+    static void bump() {
+        ++value();
+    }
+
+private:
+    static uint32_t& value() {
+        static uint32_t out { 0 };
+        return out;
+    }
+};
+
+// Incremented every time the storage contents change, including every set()
+// Allows to notice that the storage positions are no longer valid in the middle of a long read
+struct Revision {
+    static uint32_t current() {
+        return value();
+    }
+
+    static void bump() {
+        ++value();
+    }
+
+private:
+    static uint32_t& value() {
+        static uint32_t out { 0 };
+        return out;
+    }
+};
+
+// Typed value that is only fetched again when the settings generation changes
+// Getter is expected to be the usual settings function, e.g. the one returning getSetting(key, default)
+template <typename T>
+struct Cached {
+    using Getter = T(*)();
+
+    Cached() = delete;
+    explicit Cached(Getter getter) :
+        _getter(getter)
+    {}
+
+    const T& get() {
+        const auto generation = Generation::current();
+        if (!_ready || (_generation != generation)) {
+            _value = _getter();
+            _generation = generation;
+            _ready = true;
+        }
+
+        return _value;
+    }
+
+    const T& operator()() {
+        return get();
+    }
+
+private:
+    Getter _getter;
+    T _value{};
+    uint32_t _generation { 0 };
+    bool _ready { false };
+};
+
+// Same as above, but for indexed settings. Entries are created on demand
+template <typename T>
+struct CachedIndexed {
+    using Getter = T(*)(size_t);
+
+    CachedIndexed() = delete;
+    explicit CachedIndexed(Getter getter) :
+        _getter(getter)
+    {}
+
+    const T& get(size_t index) {
+        const auto generation = Generation::current();
+        if (_generation != generation) {
+            _entries.clear();
+            _generation = generation;
+        }
+
+        if (index >= _entries.size()) {
+            _entries.resize(index + 1);
+        }
+
+        auto& entry = _entries[index];
+        if (!entry.ready) {
+            entry.value = _getter(index);
+            entry.ready = true;
+        }
+
+        return entry.value;
+    }
+
+    const T& operator()(size_t index) {
+        return get(index);
+    }
+
+private:
+    struct Entry {
+        T value{};
+        bool ready { false };
+    };
+
+    Getter _getter;
+    std::vector<Entry> _entries;
+    uint32_t _generation { 0 };
+};
+
 namespace options {
 
 struct EnumerationNumericHelper {
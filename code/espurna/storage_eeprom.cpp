@@ -9,11 +9,42 @@ EEPROM MODULE
 #include <EEPROM_Rotate.h>
 EEPROM_Rotate EEPROMr;
 
+uint32_t eepromBufferWrites = 0;
+EepromDirtyRange eepromDirtyRange { EepromSize, 0 };
+
+#if EEPROM_BACKEND == EEPROM_BACKEND_JOURNAL
+#include "storage_journal.h"
+#endif
+
 namespace {
 
+#if EEPROM_BACKEND == EEPROM_BACKEND_JOURNAL
+// Journal uses the same sectors as EEPROM_Rotate, which are counted down from the base one
+struct EepromFlash {
+    bool erase(size_t sector) {
+        return ESP.flashEraseSector(address(sector) / SPI_FLASH_SEC_SIZE);
+    }
+
+    bool read(size_t sector, size_t offset, uint32_t* out, size_t size) {
+        return ESP.flashRead(address(sector) + offset, out, size);
+    }
+
+    bool write(size_t sector, size_t offset, const uint32_t* in, size_t size) {
+        return ESP.flashWrite(address(sector) + offset, const_cast<uint32_t*>(in), size);
+    }
+
+    static uint32_t address(size_t sector) {
+        return (EEPROMr.base() - sector) * SPI_FLASH_SEC_SIZE;
+    }
+};
+
+espurna::storage::journal::Journal<EepromFlash> _eeprom_journal{EepromFlash{}};
+#endif
+
 bool _eeprom_commit = false;
 
 uint32_t _eeprom_commit_count = 0;
+uint32_t _eeprom_commit_requests = 0;
 bool _eeprom_last_commit_result = false;
 bool _eeprom_ready = false;
 
@@ -24,6 +55,15 @@ bool eepromReady() {
 }
 
 void eepromRotate(bool value) {
+#if EEPROM_BACKEND == EEPROM_BACKEND_JOURNAL
+    // Same as below, only the base sector is used while rotation is disabled
+    // Next commit moves the journal there, unless it is already in the base sector
+    if (EEPROMr.size() > EEPROMr.reserved()) {
+        DEBUG_MSG_P(PSTR("[EEPROM] %s EEPROM rotation\n"), value ? "Enabling" : "Disabling");
+        _eeprom_journal.sectors(value ? EEPROMr.size() : 1);
+        eepromCommit();
+    }
+#else
     // Enable/disable EEPROM rotation only if we are using more sectors than the
     // reserved by the memory layout
     if (EEPROMr.size() > EEPROMr.reserved()) {
@@ -32,10 +72,15 @@ void eepromRotate(bool value) {
         EEPROMr.rotate(value);
         eepromCommit();
     }
+#endif
 }
 
 uint32_t eepromCurrent() {
+#if EEPROM_BACKEND == EEPROM_BACKEND_JOURNAL
+    return EepromFlash::address(_eeprom_journal.current()) / SPI_FLASH_SEC_SIZE;
+#else
     return EEPROMr.current();
+#endif
 }
 
 String eepromSectors() {
@@ -54,7 +99,17 @@ void eepromSectorsDebug() {
 
 bool _eepromCommit() {
     _eeprom_commit_count++;
+#if EEPROM_BACKEND == EEPROM_BACKEND_JOURNAL
+    _eeprom_last_commit_result = _eeprom_journal.commit(
+        EEPROMr.getConstDataPtr(), EepromSize,
+        eepromDirtyRange.begin, eepromDirtyRange.end);
+#else
     _eeprom_last_commit_result = EEPROMr.commit();
+#endif
+    if (_eeprom_last_commit_result) {
+        eepromDirtyRange = EepromDirtyRange{EepromSize, 0};
+    }
+
     return _eeprom_last_commit_result;
 }
 
@@ -63,11 +118,18 @@ void eepromForceCommit() {
 }
 
 void eepromCommit() {
+    ++_eeprom_commit_requests;
     _eeprom_commit = true;
 }
 
 void eepromBackup(uint32_t index){
+#if EEPROM_BACKEND == EEPROM_BACKEND_JOURNAL
+    // Journal is always written into the base sector while rotation is disabled
+    _eeprom_journal.compact();
+    _eepromCommit();
+#else
     EEPROMr.backup(index);
+#endif
 }
 
 #if TERMINAL_SUPPORT
@@ -80,6 +142,12 @@ static void _eepromCommand(::terminal::CommandContext&& ctx) {
         ctx.output.printf_P(PSTR("Commits done: %lu, last: %s\n"),
             _eeprom_commit_count, _eeprom_last_commit_result ? "OK" : "ERROR");
     }
+    ctx.output.printf_P(PSTR("Commit requests: %lu, buffer writes: %lu (bytes)\n"),
+        _eeprom_commit_requests, eepromBufferWrites);
+#if EEPROM_BACKEND == EEPROM_BACKEND_JOURNAL
+    ctx.output.printf_P(PSTR("Journal position: %u, sequence: %u, erases: %u\n"),
+        _eeprom_journal.position(), _eeprom_journal.sequence(), _eeprom_journal.erases());
+#endif
     terminalOK(ctx);
 }
 
@@ -153,6 +221,16 @@ void eepromSetup() {
     EEPROMr.offset(EepromRotateOffset);
     EEPROMr.begin(EepromSize);
 
+#if EEPROM_BACKEND == EEPROM_BACKEND_JOURNAL
+    // When journal is not found, keep the data loaded by EEPROM_Rotate
+    // Next commit writes all of it into the journal
+    // Otherwise, buffer contains raw journal sector and is replaced with the replayed data
+    _eeprom_journal.sectors(EEPROMr.size());
+    if (!_eeprom_journal.load(EEPROMr.getDataPtr(), EepromSize, EepromReservedSize)) {
+        _eeprom_journal.compact();
+    }
+#endif
+
 #if TERMINAL_SUPPORT
     _eepromCommandsSetup();
 #endif
@@ -9,6 +9,9 @@ EEPROM MODULE
 #include <Arduino.h>
 #include <EEPROM_Rotate.h>
 
+#include <algorithm>
+#include <cstring>
+
 // "The library uses 3 bytes to track last valid sector, so there must be at least 3"
 // Reserve addresses 11, 12 and 13 for EEPROM_Rotate
 constexpr int EepromRotateOffset = 11;
@@ -47,14 +50,34 @@ void eepromSetup();
 
 extern EEPROM_Rotate EEPROMr;
 
+// Amount of bytes modified in the data buffer since boot, regardless of whether they were committed
+// Compared with the amount of commits, gives an idea of how much flash writes cost us
+extern uint32_t eepromBufferWrites;
+
+// Range of the data buffer modified since the last commit
+// (only used by the journal backend, which does not write anything outside of it)
+struct EepromDirtyRange {
+    size_t begin;
+    size_t end;
+};
+
+extern EepromDirtyRange eepromDirtyRange;
+
+inline void eepromDirty(int address, size_t size) {
+    eepromBufferWrites += size;
+    eepromDirtyRange.begin = std::min(eepromDirtyRange.begin, static_cast<size_t>(address));
+    eepromDirtyRange.end = std::max(eepromDirtyRange.end, static_cast<size_t>(address) + size);
+}
+
 inline unsigned long eepromSpace() {
     return EEPROMr.size() * SPI_FLASH_SEC_SIZE;
 }
 
 inline void eepromClear() {
     auto* ptr = EEPROMr.getDataPtr();
+    eepromDirty(EepromReservedSize, EepromSize - EepromReservedSize);
     std::fill(ptr + EepromReservedSize, ptr + EepromSize, 0xFF);
-    EEPROMr.commit();
+    eepromForceCommit();
 }
 
 inline uint8_t eepromRead(int address) {
@@ -62,9 +85,48 @@ inline uint8_t eepromRead(int address) {
 }
 
 inline void eepromWrite(int address, unsigned char value) {
+    eepromDirty(address, 1);
     EEPROMr.write(address, value);
 }
 
+// Block access works directly with the EEPROM data buffer
+// Note that the data pointer is only available after EEPROMr.begin()
+
+inline bool eepromRange(int address, size_t size) {
+    return (address >= 0) && ((static_cast<size_t>(address) + size) <= EEPROMr.length());
+}
+
+inline void eepromRead(int address, uint8_t* out, size_t size) {
+    if (eepromRange(address, size)) {
+        std::memcpy(out, EEPROMr.getConstDataPtr() + address, size);
+    } else {
+        std::fill(out, out + size, 0);
+    }
+}
+
+inline void eepromWrite(int address, const uint8_t* in, size_t size) {
+    if (eepromRange(address, size)) {
+        eepromDirty(address, size);
+        std::memcpy(EEPROMr.getDataPtr() + address, in, size);
+    }
+}
+
+inline void eepromMove(int to, int from, size_t size) {
+    if (eepromRange(to, size) && eepromRange(from, size)) {
+        eepromDirty(to, size);
+        auto* ptr = EEPROMr.getDataPtr();
+        std::memmove(ptr + to, ptr + from, size);
+    }
+}
+
+inline void eepromFill(int address, uint8_t value, size_t size) {
+    if (eepromRange(address, size)) {
+        eepromDirty(address, size);
+        auto* ptr = EEPROMr.getDataPtr() + address;
+        std::fill(ptr, ptr + size, value);
+    }
+}
+
 inline void eepromGet(int address, unsigned char& value) {
     EEPROMr.get(address, value);
 }
@@ -82,17 +144,21 @@ inline void eepromGet(int address, unsigned long& value) {
 }
 
 inline void eepromPut(int address, unsigned char value) {
+    eepromDirty(address, sizeof(value));
     EEPROMr.put(address, value);
 }
 
 inline void eepromPut(int address, unsigned short value) {
+    eepromDirty(address, sizeof(value));
     EEPROMr.put(address, value);
 }
 
 inline void eepromPut(int address, unsigned int value) {
+    eepromDirty(address, sizeof(value));
     EEPROMr.put(address, value);
 }
 
 inline void eepromPut(int address, unsigned long value) {
+    eepromDirty(address, sizeof(value));
     EEPROMr.put(address, value);
 }
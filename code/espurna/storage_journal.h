@@ -0,0 +1,411 @@
+/*
+
+Part of the EEPROM MODULE
+
+Append-only storage for the EEPROM data buffer
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace espurna {
+namespace storage {
+namespace journal {
+
+// Instead of erasing and writing the whole sector on every commit, only the modified range
+// of the data buffer is appended to the current sector as a new record.
+// Data buffer is restored on boot by replaying every record in the order they were written.
+// When the sector is full, non-empty parts of the data buffer are written into the next sector.
+//
+// Sector layout is a header, followed by any number of records and their data
+// - header is written last, sector without the valid header is ignored
+// - record data is written first, record without the valid checksum ends the replay
+// - flash is written in 4 byte words, record offsets and lengths are always aligned to that
+//
+// Flash object is expected to implement the following (sector is the index inside of the pool)
+// - bool erase(size_t sector)
+// - bool read(size_t sector, size_t offset, uint32_t* out, size_t size)
+// - bool write(size_t sector, size_t offset, const uint32_t* in, size_t size)
+
+struct Header {
+    uint32_t magic;
+    uint32_t sequence;
+};
+
+struct Record {
+    uint16_t offset;
+    uint16_t length;
+    uint32_t checksum;
+};
+
+static_assert(sizeof(Header) == 8, "");
+static_assert(sizeof(Record) == 8, "");
+
+static constexpr uint32_t Magic { 0x4a524e4c };
+static constexpr uint32_t Empty { 0xffffffff };
+
+// FNV-1a of the record range and its data
+struct Checksum {
+    explicit Checksum(const Record& record) {
+        update(record.offset);
+        update(record.length);
+    }
+
+    void update(const uint8_t* data, size_t size) {
+        for (auto it = data; it != data + size; ++it) {
+            _value = (_value ^ (*it)) * 16777619u;
+        }
+    }
+
+    void update(uint16_t value) {
+        const uint8_t bytes[2] {
+            static_cast<uint8_t>((value >> 8) & 0xff),
+            static_cast<uint8_t>(value & 0xff),
+        };
+        update(&bytes[0], 2);
+    }
+
+    uint32_t value() const {
+        return _value;
+    }
+
+private:
+    uint32_t _value { 2166136261u };
+};
+
+template <typename Flash>
+class Journal {
+public:
+    static constexpr size_t SectorSize { SPI_FLASH_SEC_SIZE };
+    static constexpr size_t Invalid { std::numeric_limits<size_t>::max() };
+
+    // Empty space between non-empty parts of the data that is still worth a separate record
+    static constexpr size_t Gap { sizeof(Record) };
+
+    explicit Journal(Flash flash) :
+        _flash(std::move(flash))
+    {}
+
+    // Amount of sectors we are allowed to use, starting from the first one in the pool
+    // Sector that is no longer in the pool will be replaced on the next commit
+    void sectors(size_t value) {
+        _sectors = std::max<size_t>(value, 1);
+        if ((_current != Invalid) && (_current >= _sectors)) {
+            _compact = true;
+        }
+    }
+
+    size_t sectors() const {
+        return _sectors;
+    }
+
+    // Next commit will write the whole data buffer into the next sector
+    void compact() {
+        _compact = true;
+    }
+
+    // Find the latest sector and replay its records into the data buffer
+    // Buffer is not modified when no valid sector was found. Otherwise, everything after the
+    // reserved bytes is erased first, since records never contain the empty parts of the data
+    bool load(uint8_t* data, size_t size, size_t reserved = 0) {
+        _reset();
+
+        Header header;
+        for (size_t sector = 0; sector < _sectors; ++sector) {
+            if (!_read(sector, 0, &header, sizeof(header))) {
+                continue;
+            }
+
+            if (header.magic != Magic) {
+                continue;
+            }
+
+            if ((_current == Invalid) || (header.sequence > _sequence)) {
+                _current = sector;
+                _sequence = header.sequence;
+            }
+        }
+
+        if (_current == Invalid) {
+            return false;
+        }
+
+        if (reserved < size) {
+            std::fill(data + reserved, data + size, 0xff);
+        }
+
+        _position = sizeof(Header);
+
+        Record record;
+        while (_position + sizeof(Record) <= SectorSize) {
+            if (!_read(_current, _position, &record, sizeof(record))) {
+                _compact = true;
+                break;
+            }
+
+            if (_empty(record)) {
+                break;
+            }
+
+            if (!_valid(record, size) || !_verify(record)) {
+                _compact = true;
+                break;
+            }
+
+            _read(_current, _position + sizeof(Record),
+                data + record.offset, record.length);
+            _position += sizeof(Record) + record.length;
+        }
+
+        // anything that is not erased cannot be written again
+        // (e.g. when data was written, but record itself was not)
+        if (!_compact && !_erased(_current, _position)) {
+            _compact = true;
+        }
+
+        return true;
+    }
+
+    // Append modified [begin, end) range of the data buffer to the current sector
+    // When nothing was modified and sector does not need replacing, nothing is written
+    bool commit(const uint8_t* data, size_t size, size_t begin, size_t end) {
+        if (!_compact && (_current != Invalid) && (begin < end)) {
+            begin = begin & ~static_cast<size_t>(3);
+            end = std::min(size, (end + 3) & ~static_cast<size_t>(3));
+
+            if (_position + sizeof(Record) + (end - begin) <= SectorSize) {
+                if (_append(data, begin, end)) {
+                    return true;
+                }
+            }
+
+            _compact = true;
+        }
+
+        if (_compact || (_current == Invalid)) {
+            return _write_all(data, size);
+        }
+
+        return true;
+    }
+
+    size_t current() const {
+        return _current;
+    }
+
+    size_t position() const {
+        return _position;
+    }
+
+    uint32_t sequence() const {
+        return _sequence;
+    }
+
+    size_t erases() const {
+        return _erases;
+    }
+
+    Flash& flash() {
+        return _flash;
+    }
+
+private:
+    void _reset() {
+        _current = Invalid;
+        _position = 0;
+        _sequence = 0;
+        _compact = false;
+    }
+
+    static bool _empty(const Record& record) {
+        return (record.offset == 0xffff)
+            && (record.length == 0xffff)
+            && (record.checksum == Empty);
+    }
+
+    static bool _valid(const Record& record, size_t size) {
+        return (record.length > 0)
+            && ((record.offset % 4) == 0)
+            && ((record.length % 4) == 0)
+            && ((static_cast<size_t>(record.offset) + record.length) <= size);
+    }
+
+    template <typename T>
+    bool _read(size_t sector, size_t offset, T* out, size_t size) {
+        return _flash.read(sector, offset, reinterpret_cast<uint32_t*>(out), size);
+    }
+
+    template <typename T>
+    bool _write(size_t sector, size_t offset, const T* in, size_t size) {
+        return _flash.write(sector, offset, reinterpret_cast<const uint32_t*>(in), size);
+    }
+
+    // Flash data is read in small chunks, data buffer is not touched until the checksum matches
+    template <typename T>
+    bool _chunks(size_t sector, size_t offset, size_t size, T&& callback) {
+        uint32_t buffer[16];
+
+        while (size) {
+            const auto length = std::min(size, sizeof(buffer));
+            if (!_read(sector, offset, &buffer[0], length)) {
+                return false;
+            }
+
+            if (!callback(reinterpret_cast<const uint8_t*>(&buffer[0]), length)) {
+                return false;
+            }
+
+            offset += length;
+            size -= length;
+        }
+
+        return true;
+    }
+
+    bool _verify(const Record& record) {
+        if (_position + sizeof(Record) + record.length > SectorSize) {
+            return false;
+        }
+
+        Checksum checksum(record);
+        _chunks(_current, _position + sizeof(Record), record.length,
+            [&](const uint8_t* data, size_t size) {
+                checksum.update(data, size);
+                return true;
+            });
+
+        return checksum.value() == record.checksum;
+    }
+
+    bool _erased(size_t sector, size_t offset) {
+        return _chunks(sector, offset, SectorSize - offset,
+            [](const uint8_t* data, size_t size) {
+                return std::all_of(data, data + size,
+                    [](uint8_t value) {
+                        return value == 0xff;
+                    });
+            });
+    }
+
+    // Record data is written first, so the record is only visible after everything else is in place
+    bool _write_record(size_t sector, size_t position, const uint8_t* data, size_t begin, size_t end) {
+        Record record;
+        record.offset = begin;
+        record.length = end - begin;
+
+        Checksum checksum(record);
+        checksum.update(data + begin, end - begin);
+        record.checksum = checksum.value();
+
+        return _write(sector, position + sizeof(Record), data + begin, end - begin)
+            && _write(sector, position, &record, sizeof(record));
+    }
+
+    bool _append(const uint8_t* data, size_t begin, size_t end) {
+        if (!_write_record(_current, _position, data, begin, end)) {
+            return false;
+        }
+
+        _position += sizeof(Record) + (end - begin);
+        return true;
+    }
+
+    // Every non-empty range of 4 byte words. Empty words are included when the gap is too small
+    // to be worth a separate record
+    template <typename T>
+    static void _ranges(const uint8_t* data, size_t size, T&& callback) {
+        size_t begin = Invalid;
+        size_t last = 0;
+
+        for (size_t offset = 0; offset + 4 <= size; offset += 4) {
+            uint32_t word;
+            std::memcpy(&word, data + offset, sizeof(word));
+            if (word == Empty) {
+                continue;
+            }
+
+            if ((begin != Invalid) && ((offset - last) > Gap)) {
+                callback(begin, last);
+                begin = Invalid;
+            }
+
+            if (begin == Invalid) {
+                begin = offset;
+            }
+
+            last = offset + 4;
+        }
+
+        if (begin != Invalid) {
+            callback(begin, last);
+        }
+    }
+
+    size_t _next() const {
+        if ((_current == Invalid) || (_current + 1 >= _sectors)) {
+            return 0;
+        }
+
+        return _current + 1;
+    }
+
+    bool _write_all(const uint8_t* data, size_t size) {
+        size_t need = sizeof(Header);
+        _ranges(data, size, [&](size_t begin, size_t end) {
+            need += sizeof(Record) + (end - begin);
+        });
+
+        if (need > SectorSize) {
+            return false;
+        }
+
+        const auto sector = _next();
+
+        ++_erases;
+        if (!_flash.erase(sector)) {
+            return false;
+        }
+
+        bool result = true;
+        size_t position = sizeof(Header);
+
+        _ranges(data, size, [&](size_t begin, size_t end) {
+            if (result) {
+                result = _write_record(sector, position, data, begin, end);
+                position += sizeof(Record) + (end - begin);
+            }
+        });
+
+        const Header header { Magic, _sequence + 1 };
+        if (!result || !_write(sector, 0, &header, sizeof(header))) {
+            return false;
+        }
+
+        _current = sector;
+        _sequence = header.sequence;
+        _position = position;
+        _compact = false;
+
+        return true;
+    }
+
+    Flash _flash;
+
+    size_t _sectors { 1 };
+    size_t _current { Invalid };
+    size_t _position { 0 };
+    uint32_t _sequence { 0 };
+    size_t _erases { 0 };
+    bool _compact { false };
+};
+
+} // namespace journal
+} // namespace storage
+} // namespace espurna
@@ -1227,7 +1227,8 @@ constexpr Mask value() {
         | (Report::Interval * (HEARTBEAT_REPORT_INTERVAL))
         | (Report::Range * (HEARTBEAT_REPORT_RANGE))
         | (Report::RemoteTemp * (HEARTBEAT_REPORT_REMOTE_TEMP))
-        | (Report::Bssid * (HEARTBEAT_REPORT_BSSID));
+        | (Report::Bssid * (HEARTBEAT_REPORT_BSSID))
+        | (Report::Queue * (HEARTBEAT_REPORT_QUEUE));
 }
 
 } // namespace build
@@ -1490,6 +1491,8 @@ namespace internal {
 timer::SystemTimer reset_timer;
 auto reset_reason = CustomResetReason::None;
 
+std::forward_list<ResetCallback> before_reset;
+
 void reset(CustomResetReason reason) {
     ::espurna::boot::customReason(reason);
     reset_reason = reason;
@@ -1513,10 +1516,17 @@ void reset(CustomResetReason reason) {
 // always needs a reason, so it can be displayed in logs and / or trigger some actions on boot
 void pending_reset_loop() {
     if (internal::reset_reason != CustomResetReason::None) {
+        for (auto& callback : internal::before_reset) {
+            callback(internal::reset_reason);
+        }
         reset();
     }
 }
 
+void before_reset(ResetCallback callback) {
+    internal::before_reset.push_front(callback);
+}
+
 static constexpr espurna::duration::Milliseconds ShortDelayForReset { 500 };
 
 void deferredReset(duration::Milliseconds delay, CustomResetReason reason) {
@@ -1651,6 +1661,10 @@ bool pendingDeferredReset() {
     return espurna::internal::reset_reason != CustomResetReason::None;
 }
 
+void systemBeforeReset(ResetCallback callback) {
+    espurna::before_reset(callback);
+}
+
 uint32_t systemResetReason() {
     return espurna::boot::system_reason();
 }
@@ -233,7 +233,8 @@ enum class Report : Mask {
     Description = 1 << 18,
     Range = 1 << 19,
     RemoteTemp = 1 << 20,
-    Bssid = 1 << 21
+    Bssid = 1 << 21,
+    Queue = 1 << 22
 };
 
 constexpr Mask operator*(Report lhs, Mask rhs) {
@@ -328,6 +329,10 @@ void deferredReset(espurna::duration::Milliseconds, CustomResetReason);
 void prepareReset(CustomResetReason);
 bool pendingDeferredReset();
 
+// Called from the main loop right before the deferred reset happens
+using ResetCallback = void (*)(CustomResetReason);
+void systemBeforeReset(ResetCallback);
+
 bool wakeupModemForcedSleep();
 bool prepareModemForcedSleep();
 
@@ -406,7 +406,7 @@ double _getLocalValue(const char* description, unsigned char type) {
         if (magnitudeType(index) == type) {
             const auto value = magnitudeValue(index);
             DEBUG_MSG_P(PSTR("[THERMOSTAT] %s: %s\n"),
-                    description, value.repr.c_str());
+                    description, value.repr().c_str());
             return value.value;
         }
     }
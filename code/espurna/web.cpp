@@ -210,13 +210,18 @@ size_t RequestPrint::write(const uint8_t* data, size_t size) {
 namespace {
 
 PROGMEM_STRING(LastModified, __DATE__ " " __TIME__ " GMT");
-static constexpr size_t WebConfigBufferMax { 4096 };
+
+// restored key or value can't be larger than a single packet
+static constexpr size_t WebConfigValueMax { TCP_MSS };
+
+// restore is aborted instead of using up the rest of the heap
+static constexpr size_t WebConfigHeapMin { 8192 };
 
 // server instance can't (yet) be static, port is the ctor argument :/
 AsyncWebServer* _server;
 
 // XXX shared between requests!
-std::vector<uint8_t>* _webConfigBuffer;
+std::unique_ptr<espurna::settings::RestoreJson> _webConfigRestore;
 bool _webConfigSuccess = false;
 
 // TODO server may not cache the full body
@@ -324,48 +329,22 @@ void _onGetConfig(AsyncWebServerRequest *request) {
         return;
     }
 
-    auto out = std::make_shared<String>();
-    out->reserve(TCP_MSS);
-
-    const auto app = buildApp();
-
-    char buffer[256];
-    int prefix_len = snprintf_P(buffer, sizeof(buffer),
-            PSTR("{\n\"app\": \"%s\",\n\"version\": \"%s\",\n\"backup\": \"1\""),
-            app.name.c_str(), app.version.c_str());
-    if (prefix_len <= 0) {
-        request->send(500);
-        return;
-    }
-    out->concat(buffer, prefix_len);
-
-    espurna::settings::foreach([&](espurna::settings::kvs_type::KeyValueResult&& kv) {
-        auto key = kv.key.read();
-        auto value = kv.value.read();
-
-        int len = snprintf_P(buffer, sizeof(buffer), PSTR("\"%s\": \"%s\""), key.c_str(), value.c_str());
-        if (len > 0) {
-            *out += ",\n";
-            out->concat(buffer, len);
-        }
-    });
-    *out += "\n}";
+    // settings are read one kv at a time, only when the response needs more data
+    auto writer = std::make_shared<espurna::settings::BackupWriter>(
+        espurna::settings::backup_writer());
 
     AsyncWebServerResponse* response = request->beginChunkedResponse(
         F("application/json"),
-        [out](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
-            auto len = out->length();
-            if (index == len) {
-                return 0;
-            }
-
-            auto* ptr = out->c_str() + index;
-            size_t have = std::min(len - index, maxLen);
-            if (have) {
-                std::copy(ptr, ptr + have, buffer);
+        [writer, request](uint8_t* buffer, size_t maxLen, size_t) -> size_t {
+            const auto out = writer->read(buffer, maxLen);
+            if (!out && writer->failed()) {
+                // status was already sent, so the final chunk is never written instead. connection is closed
+                // on the next poll, and the client sees an incomplete transfer rather than a complete file
+                request->client()->close();
+                return RESPONSE_TRY_AGAIN;
             }
 
-            return have;
+            return out;
         });
 
     auto get_timestamp = []() -> String {
@@ -377,6 +356,7 @@ void _onGetConfig(AsyncWebServerRequest *request) {
         return String(espurna::time::millis().time_since_epoch().count(), 10);
     };
 
+    char buffer[256];
     int written = snprintf_P(buffer, sizeof(buffer),
         PSTR("attachment; filename=\"%s %s backup.json\""),
         systemHostname().c_str(), get_timestamp().c_str());
@@ -390,6 +370,7 @@ void _onGetConfig(AsyncWebServerRequest *request) {
         return;
     }
 
+    delete response;
     request->send(500);
 }
 
@@ -401,49 +382,35 @@ void _onPostConfig(AsyncWebServerRequest *request) {
     request->send(_webConfigSuccess ? 200 : 400);
 }
 
+// File is parsed while it is being received, only the parsed key and value pairs are kept until
+// the upload is complete and the whole object was parsed successfully. Staged pairs are limited
+// by the settings storage size, and the upload is also aborted when the heap is running low
 void _onPostConfigFile(AsyncWebServerRequest *request, String, size_t index, uint8_t *data, size_t len, bool final) {
-
     if (!_authenticateRequest(request)) {
         _webRequestAuth(request);
         return;
     }
 
-    // No buffer
-    if (final && (index == 0)) {
-        _webConfigSuccess = settingsRestoreJson((char*) data);
-        return;
+    // Upload start => reset
+    if (index == 0) {
+        _webConfigRestore.reset(new espurna::settings::RestoreJson(WebConfigValueMax));
+        _webConfigSuccess = false;
     }
 
-    // Buffer start => reset
-    if (index == 0) if (_webConfigBuffer) delete _webConfigBuffer;
-
-    // init buffer if it doesn't exist
-    if (!_webConfigBuffer) {
-        _webConfigBuffer = new std::vector<uint8_t>();
-        _webConfigSuccess = false;
+    // Already failed
+    if (!_webConfigRestore) {
+        return;
     }
 
-    // Copy
-    if (len > 0) {
-        if ((_webConfigBuffer->size() + len) > std::min(WebConfigBufferMax, systemFreeHeap() - sizeof(std::vector<uint8_t>))) {
-            delete _webConfigBuffer;
-            _webConfigBuffer = nullptr;
-            request->send(500);
-            return;
-        }
-        _webConfigBuffer->reserve(_webConfigBuffer->size() + len);
-        _webConfigBuffer->insert(_webConfigBuffer->end(), data, data + len);
+    if (len && ((systemFreeHeap() < WebConfigHeapMin) || !_webConfigRestore->feed(data, len))) {
+        _webConfigRestore.reset(nullptr);
+        return;
     }
 
-    // Ending
     if (final) {
-
-        _webConfigBuffer->push_back(0);
-        _webConfigSuccess = settingsRestoreJson((char*) _webConfigBuffer->data());
-        delete _webConfigBuffer;
-
+        _webConfigSuccess = _webConfigRestore->finish();
+        _webConfigRestore.reset(nullptr);
     }
-
 }
 
 #if WIFI_AP_CAPTIVE_SUPPORT
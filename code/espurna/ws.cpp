@@ -493,17 +493,6 @@ bool wsDebugSend(const char* prefix, const char* message) {
 
 namespace {
 
-// Check the existing setting before saving it
-// (we only care about the settings storage, don't mind the build values)
-bool _wsStore(String key, const String& value) {
-    const auto current = espurna::settings::get(key);
-    if (!current || (current.ref() != value)) {
-        return espurna::settings::set(key, value);
-    }
-
-    return false;
-}
-
 // TODO: generate "accepted" keys in the initial phase of the connection?
 // TODO: is value ever used... by anything?
 bool _wsCheckKey(const String& key, const JsonVariant& value) {
@@ -631,25 +620,27 @@ void _wsParse(AsyncWebSocketClient* client, uint8_t* payload, size_t length) {
         return;
     }
 
-    bool save { false };
     bool reload { false };
 
+    // Every change is applied at once, existing values are not re-written
+    // (we only care about the settings storage, don't mind the build values)
+    espurna::settings::Transaction transaction;
+
     JsonArray& toDelete = settings["del"];
     for (const auto& value : toDelete) {
-        delSetting(value.as<String>());
+        transaction.del(value.as<String>());
     }
 
     // TODO: pass key as string, we always attempt to use it as such
     JsonObject& toAssign = settings["set"];
     for (auto& kv : toAssign) {
-        const String key = kv.key;
+        String key = kv.key;
         if (_wsCheckKey(key, kv.value)) {
-            if (_wsStore(key, kv.value.as<String>())) {
-                save = true;
-            }
+            transaction.set(std::move(key), kv.value.as<String>());
         }
     }
 
+    const bool save = transaction.commit() > 0;
     _wsPostParse(client_id, save, reload);
 }
 
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <unity.h>
+
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+
+namespace espurna {
+namespace benchmark {
+
+// Host timings are only informational, they are printed next to the test results and never
+// fail the test. Numbers only compare the measured code paths between each other.
+
+using Clock = std::chrono::steady_clock;
+using Nanoseconds = std::chrono::duration<double, std::nano>;
+using Microseconds = std::chrono::duration<double, std::micro>;
+
+// Average time of a single operation, out of the total time spent
+inline double nanoseconds(Clock::duration elapsed, size_t count) {
+    return Nanoseconds(elapsed).count() / static_cast<double>(count);
+}
+
+inline double microseconds(Clock::duration elapsed, size_t count) {
+    return Microseconds(elapsed).count() / static_cast<double>(count);
+}
+
+struct Stopwatch {
+    Stopwatch() :
+        _start(Clock::now())
+    {}
+
+    void restart() {
+        _start = Clock::now();
+    }
+
+    Clock::duration elapsed() const {
+        return Clock::now() - _start;
+    }
+
+    double nanoseconds(size_t count) const {
+        return benchmark::nanoseconds(elapsed(), count);
+    }
+
+    double microseconds(size_t count) const {
+        return benchmark::microseconds(elapsed(), count);
+    }
+
+private:
+    Clock::time_point _start;
+};
+
+// Total time spent in the callback
+template <typename T>
+Clock::duration measure(T&& callback) {
+    const Stopwatch stopwatch;
+    callback();
+    return stopwatch.elapsed();
+}
+
+[[gnu::format(printf, 1, 2)]]
+inline void message(const char* format, ...) {
+    char buffer[512];
+
+    va_list args;
+    va_start(args, format);
+    std::vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    TEST_MESSAGE(buffer);
+}
+
+} // namespace benchmark
+} // namespace espurna
@@ -9,12 +9,15 @@
 
 #include <espurna/settings_embedis.h>
 
+#include "benchmark.h"
+
 #include <algorithm>
 #include <array>
 #include <numeric>
 #include <random>
 
 #include <cstdio>
+#include <cstring>
 
 namespace espurna {
 namespace settings {
@@ -48,16 +51,47 @@ struct StaticArrayStorage {
     const size_t _size;
 };
 
+// same as above, but also allow kvs to access the blob in blocks
+template <typename T>
+struct StaticArrayBlockStorage : public StaticArrayStorage<T> {
+    using Base = StaticArrayStorage<T>;
+
+    using Base::Base;
+    using Base::read;
+    using Base::write;
+
+    void read(size_t index, uint8_t* out, size_t size) const {
+        TEST_ASSERT_LESS_OR_EQUAL(Base::_size, index + size);
+        std::copy(Base::_blob.begin() + index, Base::_blob.begin() + index + size, out);
+    }
+
+    void write(size_t index, const uint8_t* in, size_t size) {
+        TEST_ASSERT_LESS_OR_EQUAL(Base::_size, index + size);
+        std::copy(in, in + size, Base::_blob.begin() + index);
+    }
+
+    void move(size_t to, size_t from, size_t size) {
+        TEST_ASSERT_LESS_OR_EQUAL(Base::_size, to + size);
+        TEST_ASSERT_LESS_OR_EQUAL(Base::_size, from + size);
+        std::memmove(Base::_blob.data() + to, Base::_blob.data() + from, size);
+    }
+
+    void fill(size_t index, uint8_t value, size_t size) {
+        TEST_ASSERT_LESS_OR_EQUAL(Base::_size, index + size);
+        std::fill(Base::_blob.begin() + index, Base::_blob.begin() + index + size, value);
+    }
+};
+
 namespace test {
 
 using espurna::settings::embedis::StaticArrayStorage;
 using espurna::settings::embedis::KeyValueStore;
 
-template <size_t Size>
+template <size_t Size, template <typename> class Storage = StaticArrayStorage>
 struct StorageHandler {
 
     using array_type = std::array<uint8_t, Size>;
-    using storage_type = StaticArrayStorage<array_type>;
+    using storage_type = Storage<array_type>;
     using kvs_type = KeyValueStore<storage_type>;
 
     StorageHandler() :
@@ -583,6 +617,416 @@ err:
     assert_keys();
 }
 
+// keys are compared in-place, make sure chunked comparison works with any length
+void test_key_equals() {
+    StorageHandler<8192> instance;
+
+    String key;
+    for (size_t length = 1; length < 100; ++length) {
+        key += static_cast<char>('a' + (length % 26));
+        TEST_ASSERT(instance.kvs.set(key, String(length, 10)));
+    }
+
+    using kvs_type = decltype(instance)::kvs_type;
+
+    String expected;
+    instance.kvs.foreach([&](kvs_type::KeyValueResult&& kv) {
+        expected += static_cast<char>('a' + (kv.key.length() % 26));
+        TEST_ASSERT(kv.key.equals(expected));
+        TEST_ASSERT_FALSE(kv.key.equals(expected + "a"));
+
+        String modified(expected);
+        modified[modified.length() - 1] = '_';
+        TEST_ASSERT_FALSE(kv.key.equals(modified));
+
+        TEST_ASSERT(kv.value.equals(String(kv.key.length(), 10)));
+    });
+
+    TEST_ASSERT_EQUAL(99, expected.length());
+
+    const char view_key[] = "abc";
+    TEST_ASSERT_FALSE(static_cast<bool>(instance.kvs.get(StringView(view_key))));
+    TEST_ASSERT_FALSE(instance.kvs.has(StringView(view_key, 2)));
+    TEST_ASSERT(instance.kvs.has(StringView(view_key + 1, 2)));
+
+    const auto result = instance.kvs.get(StringView(view_key + 1, 1));
+    TEST_ASSERT(static_cast<bool>(result));
+    TEST_ASSERT_EQUAL_STRING("1", result.c_str());
+
+    TEST_ASSERT(instance.kvs.del(StringView(view_key + 1, 1)));
+    TEST_ASSERT_FALSE(instance.kvs.has(StringView(view_key + 1, 1)));
+}
+
+// index is expected to be transparent, both storage contents and lookup results
+// should always be the same as the ones produced by the default full scan
+void test_index_runner(bool hashed, bool sorted) {
+    constexpr size_t Size = 512;
+
+    StorageHandler<Size> plain;
+    StorageHandler<Size> indexed;
+    indexed.kvs.index(hashed);
+    indexed.kvs.sorted_index(sorted);
+
+    TEST_ASSERT_FALSE(plain.kvs.indexed());
+    TEST_ASSERT_FALSE(plain.kvs.sorted_indexed());
+    TEST_ASSERT_EQUAL(hashed, indexed.kvs.indexed());
+    TEST_ASSERT_EQUAL(sorted, indexed.kvs.sorted_indexed());
+
+    std::mt19937 generator(Size);
+    std::uniform_int_distribution<> keys(0, 31);
+    std::uniform_int_distribution<> lengths(0, 12);
+    std::uniform_int_distribution<> actions(0, 3);
+
+    auto genkey = [&]() {
+        return String("key") + String(keys(generator), 10);
+    };
+
+    auto genvalue = [&]() {
+        String out;
+
+        auto length = lengths(generator);
+        while (length--) {
+            out += 'v';
+        }
+
+        return out;
+    };
+
+    for (size_t it = 0; it < 4096; ++it) {
+        const auto key = genkey();
+
+        switch (actions(generator)) {
+        case 0:
+            TEST_ASSERT_EQUAL(plain.kvs.del(key), indexed.kvs.del(key));
+            break;
+        default: {
+            const auto value = genvalue();
+            TEST_ASSERT_EQUAL(plain.kvs.set(key, value), indexed.kvs.set(key, value));
+            break;
+        }
+        }
+
+        TEST_ASSERT(plain.blob == indexed.blob);
+        TEST_ASSERT_EQUAL(plain.kvs.count(), indexed.kvs.count());
+        TEST_ASSERT_EQUAL(indexed.kvs.count(), indexed.kvs.index_size());
+        TEST_ASSERT_EQUAL(plain.kvs.available(), indexed.kvs.available());
+
+        const auto lookup = genkey();
+        const auto expected = plain.kvs.get(lookup);
+        const auto result = indexed.kvs.get(lookup);
+        TEST_ASSERT_EQUAL(static_cast<bool>(expected), static_cast<bool>(result));
+        TEST_ASSERT_EQUAL_STRING(expected.c_str(), result.c_str());
+        TEST_ASSERT_EQUAL(plain.kvs.has(lookup), indexed.kvs.has(lookup));
+    }
+
+    // storage modified externally, index must be rebuilt
+    indexed.blob = plain.blob;
+    indexed.kvs.index_reset();
+    TEST_ASSERT_EQUAL(0, indexed.kvs.index_size());
+    TEST_ASSERT_EQUAL(plain.kvs.count(), indexed.kvs.count());
+    TEST_ASSERT_EQUAL(indexed.kvs.count(), indexed.kvs.index_size());
+}
+
+void test_index() {
+    test_index_runner(true, false);
+    test_index_runner(false, true);
+    test_index_runner(true, true);
+}
+
+// sorted and prefix iteration should visit the same keys with and without the index
+void test_sorted_prefix() {
+    constexpr size_t Size = 1024;
+
+    StorageHandler<Size> plain;
+    StorageHandler<Size> indexed;
+    indexed.kvs.sorted_index(true);
+
+    std::mt19937 generator(Size);
+    std::uniform_int_distribution<> keys(0, 63);
+    std::uniform_int_distribution<> lengths(0, 8);
+    std::uniform_int_distribution<> actions(0, 3);
+
+    const char* const prefixes[] {
+        "", "k", "key", "key1", "key12", "key3", "other", "keyz",
+    };
+
+    auto genkey = [&]() {
+        const auto id = keys(generator);
+        return String((id % 3) ? "key" : "other") + String(id, 10);
+    };
+
+    auto genvalue = [&]() {
+        String out;
+
+        auto length = lengths(generator);
+        while (length--) {
+            out += 'v';
+        }
+
+        return out;
+    };
+
+    using Keys = std::vector<String>;
+    auto collect_sorted = [](StorageHandler<Size>& handler) {
+        Keys out;
+        handler.kvs.foreach_sorted([&](decltype(handler.kvs)::KeyValueResult&& kv) {
+            out.push_back(kv.key.read());
+        });
+        return out;
+    };
+
+    auto collect_prefix = [](StorageHandler<Size>& handler, StringView prefix) {
+        Keys out;
+        handler.kvs.foreach_prefix(prefix, [&](decltype(handler.kvs)::KeyValueResult&& kv) {
+            TEST_ASSERT(kv.key.startsWith(prefix));
+            out.push_back(kv.key.read());
+        });
+        std::sort(out.begin(), out.end());
+        return out;
+    };
+
+    for (size_t it = 0; it < 1024; ++it) {
+        const auto key = genkey();
+
+        switch (actions(generator)) {
+        case 0:
+            TEST_ASSERT_EQUAL(plain.kvs.del(key), indexed.kvs.del(key));
+            break;
+        default: {
+            const auto value = genvalue();
+            TEST_ASSERT_EQUAL(plain.kvs.set(key, value), indexed.kvs.set(key, value));
+            break;
+        }
+        }
+
+        Keys expected;
+        plain.kvs.foreach([&](decltype(plain.kvs)::KeyValueResult&& kv) {
+            expected.push_back(kv.key.read());
+        });
+        std::sort(expected.begin(), expected.end());
+
+        const auto plain_sorted = collect_sorted(plain);
+        const auto indexed_sorted = collect_sorted(indexed);
+        TEST_ASSERT(expected == plain_sorted);
+        TEST_ASSERT(expected == indexed_sorted);
+
+        for (const auto* prefix : prefixes) {
+            Keys matching;
+            for (const auto& key : expected) {
+                if (key.startsWith(prefix)) {
+                    matching.push_back(key);
+                }
+            }
+
+            TEST_ASSERT(matching == collect_prefix(plain, prefix));
+            TEST_ASSERT(matching == collect_prefix(indexed, prefix));
+        }
+    }
+}
+
+// keys are compared with each other in the storage, chunk by chunk
+void test_sorted_long_keys() {
+    constexpr size_t Size = 2048;
+
+    StorageHandler<Size> handler;
+    handler.kvs.sorted_index(true);
+
+    const String common(String("longkeyprefix") + String("0123456789abcdefghijklmnopqrstuvwxyz"));
+
+    std::vector<String> keys;
+    for (int index = 15; index >= 0; --index) {
+        auto key = common;
+        for (int repeat = 0; repeat < index; ++repeat) {
+            key += char('a' + (index % 3));
+        }
+
+        TEST_ASSERT(handler.kvs.set(key, String(index, 10)));
+        keys.push_back(key);
+    }
+
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<String> sorted;
+    handler.kvs.foreach_sorted([&](decltype(handler.kvs)::KeyValueResult&& kv) {
+        sorted.push_back(kv.key.read());
+    });
+    TEST_ASSERT(keys == sorted);
+
+    // rebuilt index sorts everything at once
+    handler.kvs.index_reset();
+    sorted.clear();
+    handler.kvs.foreach_sorted([&](decltype(handler.kvs)::KeyValueResult&& kv) {
+        sorted.push_back(kv.key.read());
+    });
+    TEST_ASSERT(keys == sorted);
+
+    for (const auto& key : keys) {
+        TEST_ASSERT(handler.kvs.has(key));
+    }
+}
+
+// removing multiple keys at once should produce exactly the same storage contents
+// as removing them one by one, while only shifting remaining kvs once
+template <template <typename> class Storage>
+void test_del_if_runner() {
+    constexpr size_t Size = 1024;
+
+    using Handler = StorageHandler<Size, Storage>;
+    using KeyValueResult = typename Handler::kvs_type::KeyValueResult;
+
+    Handler single;
+    Handler batch;
+    batch.kvs.index(true);
+    batch.kvs.sorted_index(true);
+
+    std::mt19937 generator(Size);
+    std::uniform_int_distribution<> removed(0, 2);
+
+    for (size_t round = 0; round < 16; ++round) {
+        std::vector<String> keys;
+        for (int index = 0; index < 48; ++index) {
+            const auto key = String("key") + String(index, 10);
+            const auto value = String(round * index, 10);
+            TEST_ASSERT(single.kvs.set(key, value));
+            TEST_ASSERT(batch.kvs.set(key, value));
+            if (!removed(generator)) {
+                keys.push_back(key);
+            }
+        }
+
+        TEST_ASSERT(single.blob == batch.blob);
+
+        for (const auto& key : keys) {
+            TEST_ASSERT(single.kvs.del(key));
+        }
+
+        const auto result = batch.kvs.del_if(
+            [&](const KeyValueResult& kv) {
+                for (const auto& key : keys) {
+                    if (kv.key.equals(key)) {
+                        return true;
+                    }
+                }
+
+                return false;
+            });
+
+        TEST_ASSERT_EQUAL(keys.size(), result);
+        TEST_ASSERT(single.blob == batch.blob);
+        TEST_ASSERT_EQUAL(single.kvs.count(), batch.kvs.count());
+        TEST_ASSERT_EQUAL(single.kvs.available(), batch.kvs.available());
+
+        for (const auto& key : keys) {
+            TEST_ASSERT_FALSE(batch.kvs.has(key));
+        }
+    }
+
+    const auto none = batch.kvs.del_if(
+        [](const KeyValueResult&) {
+            return false;
+        });
+    TEST_ASSERT_EQUAL(0, none);
+    TEST_ASSERT(single.blob == batch.blob);
+}
+
+void test_del_if() {
+    test_del_if_runner<StaticArrayStorage>();
+    test_del_if_runner<StaticArrayBlockStorage>();
+}
+
+// block access should produce exactly the same storage contents
+// report the time spent by both for every kind of operation
+struct BlockBenchmark {
+    static constexpr size_t Size = 4096;
+    static constexpr size_t Rounds = 10;
+
+    using Duration = espurna::benchmark::Clock::duration;
+
+    struct Result {
+        Duration set{};
+        Duration get{};
+        Duration del{};
+    };
+
+    BlockBenchmark() {
+        TestSequentialKvGenerator generator;
+        kvs = generator.make(Size / 8);
+    }
+
+    template <typename T>
+    Result run(T& instance) {
+        Result out;
+
+        for (size_t round = 0; round < Rounds; ++round) {
+            inserted = 0;
+
+            out.set += espurna::benchmark::measure([&]() {
+                for (const auto& kv : kvs) {
+                    if (!instance.kvs.set(kv.first, kv.second)) {
+                        break;
+                    }
+                    ++inserted;
+                }
+            });
+
+            // store should be full at this point
+            TEST_ASSERT_GREATER_THAN(0, inserted);
+            TEST_ASSERT_LESS_THAN(kvs.size(), inserted);
+            TEST_ASSERT_LESS_THAN(estimate(kvs[inserted].first, kvs[inserted].second), instance.kvs.available());
+
+            out.get += espurna::benchmark::measure([&]() {
+                for (size_t index = 0; index < inserted; ++index) {
+                    TEST_ASSERT(static_cast<bool>(instance.kvs.get(kvs[index].first)));
+                }
+            });
+
+            blob.assign(instance.blob.begin(), instance.blob.end());
+
+            // oldest kv is erased first, causing the whole storage to shift every time
+            out.del += espurna::benchmark::measure([&]() {
+                for (size_t index = 0; index < inserted; ++index) {
+                    TEST_ASSERT(instance.kvs.del(kvs[index].first));
+                }
+            });
+
+            TEST_ASSERT_EQUAL(0, instance.kvs.count());
+        }
+
+        return out;
+    }
+
+    std::vector<TestSequentialKvGenerator::kv> kvs;
+    std::vector<uint8_t> blob;
+    size_t inserted { 0 };
+};
+
+void test_block_benchmark() {
+    StorageHandler<BlockBenchmark::Size> bytes;
+    BlockBenchmark bytes_benchmark;
+    const auto bytes_result = bytes_benchmark.run(bytes);
+
+    StorageHandler<BlockBenchmark::Size, StaticArrayBlockStorage> blocks;
+    BlockBenchmark blocks_benchmark;
+    const auto blocks_result = blocks_benchmark.run(blocks);
+
+    TEST_ASSERT_EQUAL(bytes_benchmark.inserted, blocks_benchmark.inserted);
+    TEST_ASSERT(bytes_benchmark.blob == blocks_benchmark.blob);
+    TEST_ASSERT(bytes.blob == blocks.blob);
+
+    auto per_op = [&](BlockBenchmark::Duration duration) {
+        return espurna::benchmark::microseconds(duration,
+            BlockBenchmark::Rounds * bytes_benchmark.inserted);
+    };
+
+    espurna::benchmark::message(
+        "- keys: %zu, rounds: %zu, us per operation\n"
+        "- bytes: set %.3f, get %.3f, del %.3f\n"
+        "- blocks: set %.3f, get %.3f, del %.3f",
+        bytes_benchmark.inserted, BlockBenchmark::Rounds,
+        per_op(bytes_result.set), per_op(bytes_result.get), per_op(bytes_result.del),
+        per_op(blocks_result.set), per_op(blocks_result.get), per_op(blocks_result.del));
+}
+
 } // namespace test
 
 } // namespace
@@ -596,6 +1040,11 @@ int main(int, char**) {
     UNITY_BEGIN();
 
     RUN_TEST(test_basic);
+    RUN_TEST(test_index);
+    RUN_TEST(test_del_if);
+    RUN_TEST(test_sorted_prefix);
+    RUN_TEST(test_sorted_long_keys);
+    RUN_TEST(test_key_equals);
     RUN_TEST(test_keys_iterator);
     RUN_TEST(test_longkey);
     RUN_TEST(test_overflow);
@@ -605,6 +1054,7 @@ int main(int, char**) {
     RUN_TEST(test_small_gaps);
     RUN_TEST(test_storage);
     RUN_TEST(test_varying_values);
+    RUN_TEST(test_block_benchmark);
 
     return UNITY_END();
 }
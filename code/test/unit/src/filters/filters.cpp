@@ -11,7 +11,13 @@
 #include <espurna/filters/MovingAverageFilter.h>
 #include <espurna/filters/SumFilter.h>
 
+#include "benchmark.h"
+
 #include <algorithm>
+#include <deque>
+#include <numeric>
+#include <random>
+#include <vector>
 
 namespace espurna {
 namespace test {
@@ -355,6 +361,209 @@ void test_sum() {
     TEST_ASSERT_EQUAL_DOUBLE(14.0, filter.value());
 }
 
+// Straightforward implementation of the window, compared with the actual filters
+struct ReferenceWindow {
+    void resize(size_t size) {
+        _size = size;
+        while (_values.size() > _size) {
+            _values.pop_front();
+        }
+    }
+
+    void update(double value) {
+        if (!_size) {
+            return;
+        }
+
+        if (_values.size() == _size) {
+            _values.pop_front();
+        }
+
+        _values.push_back(value);
+    }
+
+    double median() const {
+        std::vector<double> sorted(_values.begin(), _values.end());
+        std::sort(sorted.begin(), sorted.end());
+
+        const auto size = sorted.size();
+        if (0 == (size % 2)) {
+            return (sorted[(size / 2) - 1] + sorted[size / 2]) / 2.0;
+        }
+
+        return sorted[size / 2];
+    }
+
+    double average() const {
+        return std::accumulate(_values.begin(), _values.end(), 0.0) / _values.size();
+    }
+
+    size_t count() const {
+        return _values.size();
+    }
+
+private:
+    std::deque<double> _values;
+    size_t _size { 0 };
+};
+
+void test_median_reference() {
+    std::mt19937 random(12345);
+    std::uniform_int_distribution<int> distribution(-500, 500);
+
+    for (size_t size : {1, 2, 3, 4, 7, 16, 33, 100}) {
+        auto filter = MedianFilter();
+        filter.resize(size);
+
+        ReferenceWindow reference;
+        reference.resize(size);
+
+        // only a small range of values, so that there are a lot of duplicates
+        for (size_t sample = 0; sample < size * 10; ++sample) {
+            const auto value = distribution(random) / 10.0;
+            filter.update(value);
+            reference.update(value);
+
+            TEST_ASSERT(filter.available());
+            TEST_ASSERT_EQUAL(reference.count() == size, filter.ready());
+            TEST_ASSERT_EQUAL_DOUBLE(reference.median(), filter.value());
+
+            // resizing in the middle should preserve latest values
+            if (sample == (size * 5)) {
+                filter.resize(size * 2);
+                reference.resize(size * 2);
+                TEST_ASSERT_EQUAL_DOUBLE(reference.median(), filter.value());
+
+                filter.resize(size);
+                reference.resize(size);
+                TEST_ASSERT_EQUAL_DOUBLE(reference.median(), filter.value());
+            }
+        }
+
+        filter.reset();
+        TEST_ASSERT(!filter.available());
+
+        filter.update(1.0);
+        TEST_ASSERT_EQUAL_DOUBLE(1.0, filter.value());
+    }
+}
+
+void test_moving_average_reference() {
+    std::mt19937 random(54321);
+    std::uniform_real_distribution<double> distribution(-1000.0, 1000.0);
+
+    for (size_t size : {1, 2, 5, 16, 100}) {
+        auto filter = MovingAverageFilter();
+        filter.resize(size);
+
+        ReferenceWindow reference;
+        reference.resize(size);
+
+        for (size_t sample = 0; sample < size * 50; ++sample) {
+            const auto value = distribution(random);
+            filter.update(value);
+            reference.update(value);
+
+            TEST_ASSERT_EQUAL(reference.count() == size, filter.ready());
+            TEST_ASSERT_DOUBLE_WITHIN(1e-6, reference.average(), filter.value());
+
+            if (sample == (size * 25)) {
+                filter.resize(size + 3);
+                reference.resize(size + 3);
+                TEST_ASSERT_DOUBLE_WITHIN(1e-6, reference.average(), filter.value());
+
+                filter.resize(size);
+                reference.resize(size);
+                TEST_ASSERT_DOUBLE_WITHIN(1e-6, reference.average(), filter.value());
+            }
+        }
+    }
+}
+
+// Previous median implementation, sorted vector with every value also tracking its input index
+struct SortedMedian {
+    struct Value {
+        double value;
+        size_t index;
+    };
+
+    void resize(size_t size) {
+        _size = size;
+        _values.reserve(size);
+    }
+
+    void update(double value) {
+        auto pending = Value{value, _values.size()};
+
+        if (_values.size() == _size) {
+            const auto it = std::find_if(_values.begin(), _values.end(),
+                [](const Value& value) {
+                    return value.index == 0;
+                });
+            _values.erase(it);
+            for (auto& entry : _values) {
+                --entry.index;
+            }
+
+            pending.index -= 1;
+        }
+
+        const auto upper = std::upper_bound(
+            _values.begin(), _values.end(), pending,
+            [](const Value& lhs, const Value& rhs) {
+                return lhs.value < rhs.value;
+            });
+        _values.insert(upper, pending);
+    }
+
+    double value() const {
+        return _values[_values.size() / 2].value;
+    }
+
+private:
+    std::vector<Value> _values;
+    size_t _size { 0 };
+};
+
+template <typename T>
+double benchmark_update(size_t size, const std::vector<double>& samples) {
+    T filter;
+    filter.resize(size);
+
+    double out = 0.0;
+
+    const auto elapsed = espurna::benchmark::measure([&]() {
+        for (const auto& sample : samples) {
+            filter.update(sample);
+            out += filter.value();
+        }
+    });
+
+    TEST_ASSERT(!std::isnan(out));
+
+    return espurna::benchmark::nanoseconds(elapsed, samples.size());
+}
+
+void test_benchmark() {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> distribution(400.0, 2000.0);
+
+    std::vector<double> samples;
+    samples.reserve(20000);
+    for (size_t index = 0; index < samples.capacity(); ++index) {
+        samples.push_back(distribution(random));
+    }
+
+    for (size_t size : {5, 50, 500, 2000}) {
+        espurna::benchmark::message(
+            "- window %zu: median sorted %.1f ns, median heaps %.1f ns, moving average %.1f ns per update",
+            size,
+            benchmark_update<SortedMedian>(size, samples),
+            benchmark_update<MedianFilter>(size, samples),
+            benchmark_update<MovingAverageFilter>(size, samples));
+    }
+}
+
 } // namespace
 } // namespace test
 } // namespace espurna
@@ -368,6 +577,9 @@ int main(int, char**) {
     RUN_TEST(test_min);
     RUN_TEST(test_moving_average);
     RUN_TEST(test_sum);
+    RUN_TEST(test_median_reference);
+    RUN_TEST(test_moving_average_reference);
+    RUN_TEST(test_benchmark);
     return UNITY_END();
 }
 
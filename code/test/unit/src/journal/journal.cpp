@@ -0,0 +1,462 @@
+#include <unity.h>
+#include <Arduino.h>
+
+#include <espurna/settings_embedis.h>
+#include <espurna/storage_journal.h>
+
+#include "benchmark.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace espurna {
+namespace storage {
+namespace journal {
+namespace test {
+namespace {
+
+constexpr size_t SectorSize = SPI_FLASH_SEC_SIZE;
+constexpr size_t ImageSize = SPI_FLASH_SEC_SIZE;
+
+using Sector = std::array<uint8_t, SectorSize>;
+using Image = std::array<uint8_t, ImageSize>;
+
+// NOR flash, erase sets every bit of the sector and writes can only clear them
+// Every access is expected to be aligned to 4 bytes, same as the SDK flash functions
+struct SimulatedFlash {
+    explicit SimulatedFlash(size_t size) :
+        sectors(size),
+        erases(size, 0)
+    {
+        for (auto& sector : sectors) {
+            sector.fill(0xff);
+        }
+    }
+
+    bool erase(size_t sector) {
+        TEST_ASSERT_LESS_THAN(sectors.size(), sector);
+        sectors[sector].fill(0xff);
+        ++erases[sector];
+        return true;
+    }
+
+    bool read(size_t sector, size_t offset, uint32_t* out, size_t size) {
+        TEST_ASSERT_LESS_THAN(sectors.size(), sector);
+        TEST_ASSERT_EQUAL(0, offset % 4);
+        TEST_ASSERT_EQUAL(0, size % 4);
+        TEST_ASSERT_LESS_OR_EQUAL(SectorSize, offset + size);
+        std::memcpy(out, sectors[sector].data() + offset, size);
+        return true;
+    }
+
+    bool write(size_t sector, size_t offset, const uint32_t* in, size_t size) {
+        TEST_ASSERT_LESS_THAN(sectors.size(), sector);
+        TEST_ASSERT_EQUAL(0, offset % 4);
+        TEST_ASSERT_EQUAL(0, size % 4);
+        TEST_ASSERT_LESS_OR_EQUAL(SectorSize, offset + size);
+
+        const auto* data = reinterpret_cast<const uint8_t*>(in);
+        auto* ptr = sectors[sector].data() + offset;
+        for (size_t index = 0; index < size; ++index) {
+            ptr[index] &= data[index];
+        }
+
+        written += size;
+        return true;
+    }
+
+    size_t total_erases() const {
+        size_t out = 0;
+        for (const auto& value : erases) {
+            out += value;
+        }
+
+        return out;
+    }
+
+    std::vector<Sector> sectors;
+    std::vector<size_t> erases;
+    size_t written { 0 };
+};
+
+// Journal only has a reference to the flash, so it could be shared with another instance
+struct FlashRef {
+    bool erase(size_t sector) {
+        return flash.erase(sector);
+    }
+
+    bool read(size_t sector, size_t offset, uint32_t* out, size_t size) {
+        return flash.read(sector, offset, out, size);
+    }
+
+    bool write(size_t sector, size_t offset, const uint32_t* in, size_t size) {
+        return flash.write(sector, offset, in, size);
+    }
+
+    SimulatedFlash& flash;
+};
+
+// What EEPROM_Rotate does on commit(), whole buffer is written into the next sector
+struct RotateBackend {
+    explicit RotateBackend(SimulatedFlash& flash) :
+        _flash(flash)
+    {}
+
+    bool commit(const uint8_t* data, size_t size, size_t, size_t) {
+        _sector = (_sector + 1) % _flash.sectors.size();
+        return _flash.erase(_sector)
+            && _flash.write(_sector, 0, reinterpret_cast<const uint32_t*>(data), size);
+    }
+
+private:
+    SimulatedFlash& _flash;
+    size_t _sector { 0 };
+};
+
+using JournalBackend = Journal<FlashRef>;
+
+// Settings storage on top of the image, tracking the modified range same as storage_eeprom.h
+struct ImageStorage {
+    explicit ImageStorage(Image& image) :
+        _image(image)
+    {}
+
+    uint8_t read(size_t index) const {
+        return _image[index];
+    }
+
+    void write(size_t index, uint8_t value) {
+        dirty(index, 1);
+        _image[index] = value;
+    }
+
+    void read(size_t index, uint8_t* out, size_t size) const {
+        std::memcpy(out, _image.data() + index, size);
+    }
+
+    void write(size_t index, const uint8_t* in, size_t size) {
+        dirty(index, size);
+        std::memcpy(_image.data() + index, in, size);
+    }
+
+    void move(size_t to, size_t from, size_t size) {
+        dirty(to, size);
+        std::memmove(_image.data() + to, _image.data() + from, size);
+    }
+
+    void fill(size_t index, uint8_t value, size_t size) {
+        dirty(index, size);
+        std::fill(_image.begin() + index, _image.begin() + index + size, value);
+    }
+
+    void commit() {
+    }
+
+    void dirty(size_t index, size_t size) {
+        begin = std::min(begin, index);
+        end = std::max(end, index + size);
+    }
+
+    Image& _image;
+
+    static size_t begin;
+    static size_t end;
+};
+
+size_t ImageStorage::begin = ImageSize;
+size_t ImageStorage::end = 0;
+
+using KeyValueStore = settings::embedis::KeyValueStore<ImageStorage>;
+
+struct Device {
+    Device() :
+        kvs(ImageStorage{image}, 16, ImageSize)
+    {
+        image.fill(0xff);
+        ImageStorage::begin = ImageSize;
+        ImageStorage::end = 0;
+    }
+
+    template <typename Backend>
+    bool commit(Backend& backend) {
+        const auto result = backend.commit(image.data(), image.size(),
+            ImageStorage::begin, ImageStorage::end);
+        if (result) {
+            ImageStorage::begin = ImageSize;
+            ImageStorage::end = 0;
+        }
+
+        return result;
+    }
+
+    alignas(4) Image image;
+    KeyValueStore kvs;
+};
+
+// Typical configuration, wifi / mqtt / relays / sensors
+void populate(KeyValueStore& kvs) {
+    char key[32];
+    char value[64];
+
+    for (int index = 0; index < 48; ++index) {
+        std::snprintf(key, sizeof(key), "setting%d", index);
+        std::snprintf(value, sizeof(value), "value-of-the-setting-number-%d", index);
+        TEST_ASSERT(kvs.set(key, value));
+    }
+
+    TEST_ASSERT(kvs.set("relayBootMask", "0"));
+}
+
+void check_load(SimulatedFlash& flash, const Image& expected) {
+    JournalBackend journal{FlashRef{flash}};
+    journal.sectors(flash.sectors.size());
+
+    alignas(4) Image image;
+    image.fill(0xff);
+
+    TEST_ASSERT(journal.load(image.data(), image.size()));
+    TEST_ASSERT(expected == image);
+}
+
+void test_empty() {
+    SimulatedFlash flash(2);
+
+    JournalBackend journal{FlashRef{flash}};
+    journal.sectors(2);
+
+    alignas(4) Image image;
+    image.fill(0x55);
+
+    TEST_ASSERT_FALSE(journal.load(image.data(), image.size()));
+    TEST_ASSERT_EQUAL(JournalBackend::Invalid, journal.current());
+    TEST_ASSERT(std::all_of(image.begin(), image.end(),
+        [](uint8_t value) {
+            return value == 0x55;
+        }));
+
+    // non-empty data has to fit into a single sector, together with the header and the record
+    TEST_ASSERT_FALSE(journal.commit(image.data(), image.size(), 0, 0));
+    TEST_ASSERT_EQUAL(JournalBackend::Invalid, journal.current());
+    TEST_ASSERT_EQUAL(0, flash.total_erases());
+
+    // first commit always writes everything
+    std::fill(image.begin() + 64, image.end() - 64, 0xff);
+    TEST_ASSERT(journal.commit(image.data(), image.size(), 0, 0));
+    TEST_ASSERT_EQUAL(0, journal.current());
+    TEST_ASSERT_EQUAL(1, flash.total_erases());
+
+    check_load(flash, image);
+}
+
+// Data buffer is expected to contain whatever was in the flash sector, not just the empty space
+void test_load_dirty_buffer() {
+    SimulatedFlash flash(2);
+
+    JournalBackend journal{FlashRef{flash}};
+    journal.sectors(2);
+
+    Device device;
+    populate(device.kvs);
+    TEST_ASSERT(device.commit(journal));
+
+    TEST_ASSERT(device.kvs.del("setting10"));
+    TEST_ASSERT(device.kvs.set("relayBootMask", "1"));
+    TEST_ASSERT(device.commit(journal));
+
+    constexpr size_t Reserved { 14 };
+
+    JournalBackend restored{FlashRef{flash}};
+    restored.sectors(2);
+
+    alignas(4) Image image;
+    std::copy(flash.sectors[journal.current()].begin(),
+        flash.sectors[journal.current()].end(), image.begin());
+    std::fill(image.begin(), image.begin() + Reserved, 0x55);
+
+    TEST_ASSERT(restored.load(image.data(), image.size(), Reserved));
+    TEST_ASSERT(std::all_of(image.begin(), image.begin() + Reserved,
+        [](uint8_t value) {
+            return value == 0x55;
+        }));
+    TEST_ASSERT(std::equal(image.begin() + Reserved, image.end(),
+        device.image.begin() + Reserved));
+
+    // same for the garbage that just looks like data
+    image.fill(0x55);
+    TEST_ASSERT(restored.load(image.data(), image.size()));
+    TEST_ASSERT(device.image == image);
+}
+
+void test_replay() {
+    SimulatedFlash flash(4);
+
+    JournalBackend journal{FlashRef{flash}};
+    journal.sectors(4);
+
+    Device device;
+
+    std::mt19937 generator(1234);
+    std::uniform_int_distribution<> keys(0, 31);
+    std::uniform_int_distribution<> lengths(0, 32);
+    std::uniform_int_distribution<> actions(0, 3);
+
+    for (size_t it = 0; it < 2048; ++it) {
+        const auto key = String("key") + String(keys(generator), 10);
+
+        switch (actions(generator)) {
+        case 0:
+            device.kvs.del(key);
+            break;
+        default: {
+            String value;
+            auto length = lengths(generator);
+            while (length--) {
+                value += 'v';
+            }
+            device.kvs.set(key, value);
+            break;
+        }
+        }
+
+        TEST_ASSERT(device.commit(journal));
+        if ((it % 64) == 0) {
+            check_load(flash, device.image);
+        }
+    }
+
+    check_load(flash, device.image);
+    TEST_ASSERT_GREATER_THAN(1, journal.sequence());
+}
+
+void test_torn_record() {
+    SimulatedFlash flash(2);
+
+    JournalBackend journal{FlashRef{flash}};
+    journal.sectors(2);
+
+    Device device;
+    populate(device.kvs);
+    TEST_ASSERT(device.commit(journal));
+
+    const auto expected = device.image;
+    const auto position = journal.position();
+    const auto sector = journal.current();
+
+    TEST_ASSERT(device.kvs.set("relayBootMask", "1"));
+    TEST_ASSERT(device.commit(journal));
+    TEST_ASSERT_GREATER_THAN(position, journal.position());
+
+    // record data was written, but the record itself was not
+    auto& data = flash.sectors[sector];
+    std::fill(data.begin() + position, data.begin() + position + sizeof(Record), 0xff);
+
+    JournalBackend restored{FlashRef{flash}};
+    restored.sectors(2);
+
+    alignas(4) Image image;
+    image.fill(0xff);
+
+    TEST_ASSERT(restored.load(image.data(), image.size()));
+    TEST_ASSERT(expected == image);
+    TEST_ASSERT_EQUAL(position, restored.position());
+
+    // since the data can't be written again, next commit moves to the other sector
+    const auto erases = flash.total_erases();
+    TEST_ASSERT(restored.commit(image.data(), image.size(), 0, 0));
+    TEST_ASSERT_EQUAL(erases + 1, flash.total_erases());
+    TEST_ASSERT_NOT_EQUAL(sector, restored.current());
+
+    check_load(flash, expected);
+}
+
+void test_sectors() {
+    SimulatedFlash flash(4);
+
+    JournalBackend journal{FlashRef{flash}};
+    journal.sectors(4);
+
+    Device device;
+    populate(device.kvs);
+
+    // fill up the first sector
+    TEST_ASSERT(device.commit(journal));
+    TEST_ASSERT_EQUAL(0, journal.current());
+
+    String value("0");
+    while (journal.current() == 0) {
+        value = (value == "0") ? "1" : "0";
+        TEST_ASSERT(device.kvs.set("relayBootMask", value));
+        TEST_ASSERT(device.commit(journal));
+    }
+
+    TEST_ASSERT_EQUAL(1, journal.current());
+
+    // e.g. OTA wants to use everything but the base sector
+    journal.sectors(1);
+    TEST_ASSERT(device.commit(journal));
+    TEST_ASSERT_EQUAL(0, journal.current());
+
+    check_load(flash, device.image);
+}
+
+// Relay state is saved on every toggle. Same length value is overwritten in place,
+// so the journal only needs to append a small record for every commit
+template <typename Backend>
+size_t relay_toggle_erases(SimulatedFlash& flash, Backend& backend, size_t toggles) {
+    Device device;
+    populate(device.kvs);
+    TEST_ASSERT(device.commit(backend));
+
+    for (size_t toggle = 0; toggle < toggles; ++toggle) {
+        TEST_ASSERT(device.kvs.set("relayBootMask", (toggle % 2) ? "0" : "1"));
+        TEST_ASSERT(device.commit(backend));
+    }
+
+    return flash.total_erases();
+}
+
+void test_relay_toggle_erases() {
+    constexpr size_t Toggles = 10000;
+    constexpr size_t Sectors = 2;
+
+    SimulatedFlash rotate_flash(Sectors);
+    RotateBackend rotate(rotate_flash);
+    const auto rotate_erases = relay_toggle_erases(rotate_flash, rotate, Toggles);
+
+    SimulatedFlash journal_flash(Sectors);
+    JournalBackend journal{FlashRef{journal_flash}};
+    journal.sectors(Sectors);
+    const auto journal_erases = relay_toggle_erases(journal_flash, journal, Toggles);
+
+    TEST_ASSERT_EQUAL(Toggles + 1, rotate_erases);
+    TEST_ASSERT_LESS_THAN(rotate_erases / 100, journal_erases);
+
+    espurna::benchmark::message(
+        "- toggles: %zu, erases: rotate %zu, journal %zu",
+        Toggles, rotate_erases, journal_erases);
+    espurna::benchmark::message(
+        "- bytes written: rotate %zu, journal %zu",
+        rotate_flash.written, journal_flash.written);
+}
+
+} // namespace
+} // namespace test
+} // namespace journal
+} // namespace storage
+} // namespace espurna
+
+int main(int, char**) {
+    UNITY_BEGIN();
+    using namespace espurna::storage::journal::test;
+    RUN_TEST(test_empty);
+    RUN_TEST(test_replay);
+    RUN_TEST(test_load_dirty_buffer);
+    RUN_TEST(test_torn_record);
+    RUN_TEST(test_sectors);
+    RUN_TEST(test_relay_toggle_erases);
+    return UNITY_END();
+}
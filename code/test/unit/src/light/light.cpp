@@ -0,0 +1,300 @@
+#include <unity.h>
+
+#include <Arduino.h>
+
+#include <espurna/types.h>
+#include <espurna/light_transition.ipp>
+
+#include "benchmark.h"
+
+#include <array>
+#include <cmath>
+#include <vector>
+
+namespace espurna {
+namespace light {
+namespace test {
+namespace {
+
+using Duration = espurna::duration::Milliseconds;
+using Engine = transition::Engine<Duration>;
+
+constexpr long OutputMin { 0 };
+constexpr long OutputMax { 0xffff };
+
+constexpr std::array<Easing, 3> Easings {{
+    Easing::Linear,
+    Easing::InOut,
+    Easing::Perceptual,
+}};
+
+// Every ms of the transition, plus a bit after the end
+std::vector<long> outputs(long from, long to, Duration duration, Easing easing) {
+    long value { from };
+
+    Engine engine(OutputMin, OutputMax);
+    engine.push(value, to, duration, easing);
+
+    std::vector<long> out;
+    for (auto elapsed = Duration::zero(); elapsed <= duration + Duration(10); ++elapsed) {
+        engine.run(elapsed,
+            [&](size_t, long value) {
+                out.push_back(value);
+            });
+    }
+
+    TEST_ASSERT_EQUAL(to, value);
+
+    return out;
+}
+
+void test_progress() {
+    using transition::Scale;
+    using transition::progress;
+
+    TEST_ASSERT_EQUAL(0, progress(0, 1000));
+    TEST_ASSERT_EQUAL(Scale / 2, progress(500, 1000));
+    TEST_ASSERT_EQUAL(Scale, progress(1000, 1000));
+    TEST_ASSERT_EQUAL(Scale, progress(5000, 1000));
+    TEST_ASSERT_EQUAL(Scale, progress(0, 0));
+
+    // does not overflow with the longest transition time
+    TEST_ASSERT_EQUAL(Scale - 1, progress((1ul << 24ul) - 1, 1ul << 24ul));
+}
+
+void test_curves() {
+    using transition::Scale;
+
+    TEST_ASSERT_EQUAL(0, transition::ease_in_out(0));
+    TEST_ASSERT_EQUAL(Scale / 2, transition::ease_in_out(Scale / 2));
+    TEST_ASSERT_EQUAL(Scale, transition::ease_in_out(Scale));
+
+    TEST_ASSERT_EQUAL(0, transition::root(OutputMin, OutputMin, OutputMax));
+    TEST_ASSERT_EQUAL(Scale, transition::root(OutputMax, OutputMin, OutputMax));
+    TEST_ASSERT_EQUAL(Scale / 2, transition::root(OutputMax / 8 + 1, OutputMin, OutputMax));
+
+    for (long value = OutputMin; value <= OutputMax; value += 97) {
+        const auto root = transition::root(value, OutputMin, OutputMax);
+        const auto expected = std::lround(std::cbrt(double(value) / double(OutputMax)) * Scale);
+        TEST_ASSERT_LESS_OR_EQUAL(1, std::abs(expected - long(root)));
+
+        const auto cube = transition::cube(root, OutputMin, OutputMax);
+        TEST_ASSERT_LESS_OR_EQUAL(value, cube);
+        TEST_ASSERT_LESS_OR_EQUAL(7, value - cube);
+    }
+}
+
+void test_monotonic() {
+    const std::array<std::pair<long, long>, 6> ranges {{
+        {OutputMin, OutputMax},
+        {OutputMax, OutputMin},
+        {100, 200},
+        {40000, 39990},
+        {1, 3},
+        {OutputMin, 1},
+    }};
+
+    for (const auto& easing : Easings) {
+        for (const auto& range : ranges) {
+            const auto values = outputs(range.first, range.second, Duration(1000), easing);
+            TEST_ASSERT_GREATER_THAN(0, values.size());
+            TEST_ASSERT_EQUAL(range.second, values.back());
+
+            const bool increasing = range.first < range.second;
+            long last = range.first;
+            for (const auto& value : values) {
+                if (increasing) {
+                    TEST_ASSERT_GREATER_OR_EQUAL(last, value);
+                    TEST_ASSERT_LESS_OR_EQUAL(range.second, value);
+                } else {
+                    TEST_ASSERT_LESS_OR_EQUAL(last, value);
+                    TEST_ASSERT_GREATER_OR_EQUAL(range.second, value);
+                }
+
+                last = value;
+            }
+        }
+    }
+}
+
+// Linear full range transition should not have any sudden jumps
+void test_glitch_free() {
+    for (const auto& easing : Easings) {
+        const auto values = outputs(OutputMin, OutputMax, Duration(10000), easing);
+
+        long last = OutputMin;
+        long largest { 0 };
+        for (const auto& value : values) {
+            largest = std::max(largest, value - last);
+            last = value;
+        }
+
+        // average step is ~6.5, curves are allowed to be a few times steeper than that
+        TEST_ASSERT_LESS_THAN(32, largest);
+    }
+}
+
+void test_immediate() {
+    long value { 1234 };
+
+    Engine engine(OutputMin, OutputMax);
+    engine.push(value, 4321, Duration::zero(), Easing::Linear);
+    TEST_ASSERT_FALSE(engine.gradual());
+
+    size_t calls { 0 };
+    TEST_ASSERT_FALSE(engine.run(Duration::zero(),
+        [&](size_t index, long output) {
+            TEST_ASSERT_EQUAL(0, index);
+            TEST_ASSERT_EQUAL(4321, output);
+            ++calls;
+        }));
+
+    TEST_ASSERT_EQUAL(1, calls);
+    TEST_ASSERT_EQUAL(4321, value);
+
+    // nothing else to do after reaching the target
+    TEST_ASSERT_FALSE(engine.run(Duration(100),
+        [&](size_t, long) {
+            ++calls;
+        }));
+    TEST_ASSERT_EQUAL(1, calls);
+}
+
+void test_durations() {
+    std::array<long, 3> values {{0, 0, 0}};
+
+    Engine engine(OutputMin, OutputMax);
+    engine.push(values[0], 1000, Duration(100), Easing::Linear);
+    engine.push(values[1], 1000, Duration(200), Easing::Linear);
+    engine.push(values[2], 1000, Duration::zero(), Easing::Linear);
+    TEST_ASSERT_TRUE(engine.gradual());
+
+    const auto noop = [](size_t, long) {
+    };
+
+    TEST_ASSERT_TRUE(engine.run(Duration(50), noop));
+    TEST_ASSERT_EQUAL(500, values[0]);
+    TEST_ASSERT_EQUAL(250, values[1]);
+    TEST_ASSERT_EQUAL(1000, values[2]);
+
+    // late run does not stretch the transition, values only depend on the elapsed time
+    TEST_ASSERT_TRUE(engine.run(Duration(150), noop));
+    TEST_ASSERT_EQUAL(1000, values[0]);
+    TEST_ASSERT_EQUAL(750, values[1]);
+
+    TEST_ASSERT_FALSE(engine.run(Duration(250), noop));
+    TEST_ASSERT_EQUAL(1000, values[1]);
+}
+
+// Previous implementation, float step added to the value every run
+struct FloatStep {
+    float value;
+    long target;
+    float step;
+    size_t count;
+
+    FloatStep(long from, long to, Duration time, Duration step_time) :
+        value(from),
+        target(to)
+    {
+        const auto total = static_cast<float>(time.count());
+        const auto every = static_cast<float>(step_time.count());
+
+        const float diff { static_cast<float>(to - from) };
+        const float Every { total / std::abs(diff) };
+
+        step = (diff > 0.0f) ? 1.0f : -1.0f;
+        if (Every < every) {
+            step *= (every / Every);
+        }
+
+        count = static_cast<size_t>(std::floor(std::abs(diff) / std::abs(step)));
+    }
+
+    bool run() {
+        if (!count) {
+            return false;
+        }
+
+        if (--count) {
+            value += step;
+        } else {
+            value = target;
+        }
+
+        return count != 0;
+    }
+};
+
+void test_benchmark() {
+    constexpr size_t Channels { 5 };
+    constexpr auto Time = Duration(60000);
+    constexpr auto Step = Duration(10);
+
+    volatile long sink { 0 };
+
+    espurna::benchmark::Stopwatch stopwatch;
+    size_t float_runs { 0 };
+    {
+        std::vector<FloatStep> steps;
+        for (size_t index = 0; index < Channels; ++index) {
+            steps.emplace_back(OutputMin, OutputMax - index, Time, Step);
+        }
+
+        bool next { true };
+        while (next) {
+            next = false;
+            for (auto& step : steps) {
+                next = step.run() || next;
+                sink = std::lround(step.value);
+            }
+            ++float_runs;
+        }
+    }
+    const auto float_time = stopwatch.nanoseconds(float_runs);
+
+    static_assert(Easings.size() == 3, "");
+    std::array<double, Easings.size()> times{};
+    for (size_t easing = 0; easing < Easings.size(); ++easing) {
+        std::array<long, Channels> values{};
+
+        Engine engine(OutputMin, OutputMax);
+        for (size_t index = 0; index < Channels; ++index) {
+            engine.push(values[index], OutputMax - index, Time, Easings[easing]);
+        }
+
+        stopwatch.restart();
+
+        size_t runs { 0 };
+        for (auto elapsed = Duration::zero(); engine.run(elapsed, [&](size_t, long value) { sink = value; }); elapsed += Step) {
+            ++runs;
+        }
+
+        times[easing] = stopwatch.nanoseconds(runs);
+    }
+
+    espurna::benchmark::message(
+        "float: %.1fns, linear: %.1fns, in-out: %.1fns, perceptual: %.1fns per run of %zu channels",
+        float_time, times[0], times[1], times[2], Channels);
+}
+
+} // namespace
+} // namespace test
+} // namespace light
+} // namespace espurna
+
+int main(int, char**) {
+    UNITY_BEGIN();
+
+    using namespace espurna::light::test;
+
+    RUN_TEST(test_progress);
+    RUN_TEST(test_curves);
+    RUN_TEST(test_monotonic);
+    RUN_TEST(test_glitch_free);
+    RUN_TEST(test_immediate);
+    RUN_TEST(test_durations);
+    RUN_TEST(test_benchmark);
+
+    return UNITY_END();
+}
@@ -3,6 +3,44 @@
 #include <Arduino.h>
 
 #include <espurna/mqtt_common.ipp>
+#include <espurna/mqtt_batch.ipp>
+#include <espurna/mqtt_json.ipp>
+#include <espurna/mqtt_queue.ipp>
+#include <espurna/mqtt_topics.ipp>
+#include <espurna/mqtt_router.h>
+
+#include "benchmark.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <vector>
+
+// Heap churn is measured by counting every allocation made through the global operator new
+namespace {
+
+size_t allocations { 0 };
+
+} // namespace
+
+void* operator new(size_t size) {
+    ++allocations;
+    if (void* out = std::malloc(size ? size : 1)) {
+        return out;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
 
 namespace espurna {
 namespace mqtt {
@@ -225,6 +263,665 @@ void test_invalid_match_wildcard() {
      TEST_INVALID_MATCH_WILDCARD("device/+/set", "device/relay/0/set");
 }
 
+void test_batch_topics() {
+    Batch batch;
+    batch.pattern("home/#", "/get");
+
+    batch.add("temperature/0", "21.5");
+    batch.add("humidity/0", "40");
+    TEST_ASSERT_EQUAL(2, batch.size());
+
+    std::vector<String> out;
+    batch.flush([&](const char* topic, const char* payload) {
+        out.push_back(topic);
+        out.push_back(payload);
+    });
+
+    TEST_ASSERT_EQUAL(0, batch.size());
+    TEST_ASSERT_EQUAL(4, out.size());
+    TEST_ASSERT_EQUAL_STRING("home/temperature/0/get", out[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("21.5", out[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("home/humidity/0/get", out[2].c_str());
+    TEST_ASSERT_EQUAL_STRING("40", out[3].c_str());
+
+    out.clear();
+    batch.pattern("#/device", "");
+    batch.add("relay/1", "");
+    batch.flush([&](const char* topic, const char* payload) {
+        out.push_back(topic);
+        out.push_back(payload);
+    });
+
+    TEST_ASSERT_EQUAL(2, out.size());
+    TEST_ASSERT_EQUAL_STRING("relay/1/device", out[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("", out[1].c_str());
+}
+
+// Encodes PUBLISH packets like the client library would, QoS 0 and without the remaining length varint
+struct MockClient {
+    MockClient() {
+        buffer.reserve(1024);
+    }
+
+    void publish(const char* topic, const char* payload) {
+        const auto topic_len = std::strlen(topic);
+        const auto payload_len = std::strlen(payload);
+
+        buffer.push_back(0x30);
+        buffer.push_back((topic_len >> 8) & 0xff);
+        buffer.push_back(topic_len & 0xff);
+        buffer.insert(buffer.end(), topic, topic + topic_len);
+        buffer.insert(buffer.end(), payload, payload + payload_len);
+
+        bytes += buffer.size();
+        buffer.clear();
+        ++packets;
+    }
+
+    std::vector<char> buffer;
+    size_t packets { 0 };
+    size_t bytes { 0 };
+};
+
+struct BenchmarkResult {
+    double packets_per_second;
+    double allocations_per_cycle;
+};
+
+constexpr size_t BenchmarkCycles { 2000 };
+
+template <typename T>
+BenchmarkResult benchmark_publish(T&& cycle) {
+    using Seconds = std::chrono::duration<double>;
+
+    MockClient client;
+
+    // warm-up, buffers are expected to be allocated only once
+    cycle(client);
+
+    const auto before = allocations;
+    const auto packets = client.packets;
+
+    const auto elapsed = espurna::benchmark::measure([&]() {
+        for (size_t index = 0; index < BenchmarkCycles; ++index) {
+            cycle(client);
+        }
+    });
+
+    return BenchmarkResult{
+        .packets_per_second = (client.packets - packets) / Seconds(elapsed).count(),
+        .allocations_per_cycle = double(allocations - before) / BenchmarkCycles,
+    };
+}
+
+void test_batch_benchmark() {
+    const String root("espurna-123456/#");
+    const String getter("");
+
+    std::vector<String> magnitudes;
+    std::vector<String> payloads;
+    for (size_t index = 0; index < 16; ++index) {
+        String magnitude("magnitude/");
+        magnitude += String(static_cast<unsigned long>(index), 10);
+        magnitudes.push_back(std::move(magnitude));
+        payloads.push_back(String(index * 10.5, 1));
+    }
+
+    // same as mqttSend(topic, payload), topic is re-created for every message
+    const auto single = benchmark_publish(
+        [&](MockClient& client) {
+            for (size_t index = 0; index < magnitudes.size(); ++index) {
+                String topic;
+                topic.reserve(magnitudes[index].length() + root.length() + getter.length());
+                topic += root;
+                topic += getter;
+                topic.replace(String("#"), magnitudes[index]);
+
+                client.publish(topic.c_str(), payloads[index].c_str());
+            }
+        });
+
+    Batch batch;
+    batch.pattern(root, getter);
+
+    const auto batched = benchmark_publish(
+        [&](MockClient& client) {
+            for (size_t index = 0; index < magnitudes.size(); ++index) {
+                batch.add(magnitudes[index], payloads[index]);
+            }
+
+            batch.flush([&](const char* topic, const char* payload) {
+                client.publish(topic, payload);
+            });
+        });
+
+    TEST_ASSERT_EQUAL(0, batched.allocations_per_cycle);
+
+    espurna::benchmark::message(
+        "- single: %.0f packets/s, %.1f allocations per cycle",
+        single.packets_per_second, single.allocations_per_cycle);
+    espurna::benchmark::message(
+        "- batch: %.0f packets/s, %.1f allocations per cycle",
+        batched.packets_per_second, batched.allocations_per_cycle);
+}
+
+String serialize(const JsonAggregator& aggregator) {
+    JsonLength length;
+    JsonWriter<JsonLength> measure(length);
+    measure.begin();
+    aggregator.serialize(measure);
+    measure.end();
+
+    String out;
+    out.reserve(length.size);
+
+    const auto before = allocations;
+
+    JsonString string{out};
+    JsonWriter<JsonString> writer(string);
+    writer.begin();
+    aggregator.serialize(writer);
+    writer.end();
+
+    TEST_ASSERT_EQUAL(before, allocations);
+    TEST_ASSERT_EQUAL(length.size, out.length());
+
+    return out;
+}
+
+void test_json_aggregator() {
+    JsonAggregator aggregator(4, 1024);
+    TEST_ASSERT(aggregator.empty());
+    TEST_ASSERT_EQUAL_STRING("{}", serialize(aggregator).c_str());
+
+    TEST_ASSERT(aggregator.add("temperature/0", "21.5", true));
+    TEST_ASSERT(aggregator.add("relay/0", "1", true));
+    TEST_ASSERT(aggregator.add("status", "on", false));
+    TEST_ASSERT_EQUAL(3, aggregator.size());
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"temperature/0\":21.5,\"relay/0\":1,\"status\":\"on\"}",
+        serialize(aggregator).c_str());
+
+    // latest payload replaces the previous one, both shorter and longer ones
+    TEST_ASSERT(aggregator.add("relay/0", "0", true));
+    TEST_ASSERT(aggregator.add("temperature/0", "9.25", true));
+    TEST_ASSERT(aggregator.add("status", "offline", false));
+    TEST_ASSERT(aggregator.add("temperature/0", "8", true));
+    TEST_ASSERT_EQUAL(3, aggregator.size());
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"temperature/0\":8,\"relay/0\":0,\"status\":\"offline\"}",
+        serialize(aggregator).c_str());
+
+    // every member length is counted with a separator, minus the one that is not there
+    TEST_ASSERT_EQUAL(serialize(aggregator).length(), aggregator.length() - 1 + 2);
+
+    TEST_ASSERT(aggregator.add("quote", "\"a\\b\"\n\x01", false));
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"temperature/0\":8,\"relay/0\":0,\"status\":\"offline\","
+        "\"quote\":\"\\\"a\\\\b\\\"\\n\\u0001\"}",
+        serialize(aggregator).c_str());
+
+    // no more topics can be added, but existing ones can be updated
+    TEST_ASSERT_FALSE(aggregator.fits("other", "1", true));
+    TEST_ASSERT_FALSE(aggregator.add("other", "1", true));
+    TEST_ASSERT(aggregator.fits("relay/0", "1", true));
+    TEST_ASSERT(aggregator.add("relay/0", "1", true));
+
+    aggregator.clear();
+    TEST_ASSERT(aggregator.empty());
+    TEST_ASSERT_EQUAL(0, aggregator.length());
+    TEST_ASSERT_EQUAL_STRING("{}", serialize(aggregator).c_str());
+
+    TEST_ASSERT(aggregator.add("other", "1", true));
+    TEST_ASSERT_EQUAL_STRING("{\"other\":1}", serialize(aggregator).c_str());
+}
+
+void test_json_budget() {
+    JsonAggregator aggregator(255, 64);
+
+    String topic;
+    size_t added { 0 };
+    for (;;) {
+        topic = "magnitude/";
+        topic += String(added, 10);
+        if (!aggregator.fits(topic, "12345", true)) {
+            break;
+        }
+
+        TEST_ASSERT(aggregator.add(topic, "12345", true));
+        ++added;
+    }
+
+    // "magnitude/N":12345, => 20 bytes for every member
+    TEST_ASSERT_EQUAL(3, added);
+    TEST_ASSERT(serialize(aggregator).length() <= 64);
+
+    // growing the payload in-place does not leave anything behind in the buffer
+    TEST_ASSERT(aggregator.fits("magnitude/2", "123456", true));
+    TEST_ASSERT(aggregator.add("magnitude/2", "123456", true));
+    TEST_ASSERT_FALSE(aggregator.fits("magnitude/0", "1234567890", true));
+
+    // nothing is allocated once the buffers are large enough
+    aggregator.clear();
+
+    const auto before = allocations;
+    TEST_ASSERT(aggregator.add("magnitude/0", "12345", true));
+    TEST_ASSERT(aggregator.add("magnitude/1", "12345", true));
+    TEST_ASSERT(aggregator.add("magnitude/1", "1", true));
+    TEST_ASSERT_EQUAL(before, allocations);
+}
+
+std::vector<String> drain(OfflineQueue& queue, size_t count) {
+    std::vector<String> out;
+    queue.drain(count,
+        [&](const OfflineQueue::Message& message) {
+            String entry(message.topic);
+            entry += "=>";
+            entry += message.payload;
+            out.push_back(std::move(entry));
+            return true;
+        });
+
+    return out;
+}
+
+void test_offline_queue() {
+    OfflineQueue queue(4, 64);
+    TEST_ASSERT(queue.empty());
+
+    // retained state is replaced, the latest one goes to the end
+    TEST_ASSERT(queue.push("relay/0", "1", true, 0));
+    TEST_ASSERT(queue.push("button/0", "1", false, 0));
+    TEST_ASSERT(queue.push("button/0", "2", false, 0));
+    TEST_ASSERT(queue.push("relay/0", "0", true, 0));
+    TEST_ASSERT_EQUAL(3, queue.size());
+    TEST_ASSERT_EQUAL(0, queue.drops());
+    TEST_ASSERT_EQUAL(
+        std::strlen("button/01") * 2 + std::strlen("relay/00"),
+        queue.bytes());
+
+    auto out = drain(queue, 2);
+    TEST_ASSERT_EQUAL(2, out.size());
+    TEST_ASSERT_EQUAL_STRING("button/0=>1", out[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("button/0=>2", out[1].c_str());
+
+    out = drain(queue, 2);
+    TEST_ASSERT_EQUAL(1, out.size());
+    TEST_ASSERT_EQUAL_STRING("relay/0=>0", out[0].c_str());
+    TEST_ASSERT(queue.empty());
+    TEST_ASSERT_EQUAL(0, queue.bytes());
+
+    // oldest QoS 0 message is dropped first
+    TEST_ASSERT(queue.push("a", "1", false, 1));
+    TEST_ASSERT(queue.push("b", "1", false, 0));
+    TEST_ASSERT(queue.push("c", "1", false, 2));
+    TEST_ASSERT(queue.push("d", "1", false, 0));
+    TEST_ASSERT(queue.push("e", "1", false, 1));
+    TEST_ASSERT_EQUAL(1, queue.drops());
+    TEST_ASSERT(queue.push("f", "1", false, 0));
+    TEST_ASSERT_EQUAL(2, queue.drops());
+
+    out = drain(queue, 10);
+    TEST_ASSERT_EQUAL(4, out.size());
+    TEST_ASSERT_EQUAL_STRING("a=>1", out[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("c=>1", out[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("e=>1", out[2].c_str());
+    TEST_ASSERT_EQUAL_STRING("f=>1", out[3].c_str());
+
+    // new QoS 0 message is dropped instead of the ones with a higher QoS
+    for (auto topic : {"a", "b", "c", "d"}) {
+        TEST_ASSERT(queue.push(topic, "1", false, 1));
+    }
+
+    TEST_ASSERT_FALSE(queue.push("e", "1", false, 0));
+    TEST_ASSERT_EQUAL(3, queue.drops());
+    TEST_ASSERT(queue.push("e", "1", false, 1));
+    TEST_ASSERT_EQUAL(4, queue.drops());
+    TEST_ASSERT_EQUAL_STRING("b=>1", drain(queue, 1)[0].c_str());
+
+    // byte limit
+    queue.clear();
+    const String payload(std::string(30, 'x').c_str());
+    TEST_ASSERT(queue.push("a", payload, false, 0));
+    TEST_ASSERT(queue.push("b", payload, false, 0));
+    TEST_ASSERT(queue.push("c", payload, false, 0));
+    TEST_ASSERT_EQUAL(2, queue.size());
+    TEST_ASSERT_EQUAL(5, queue.drops());
+    TEST_ASSERT_FALSE(queue.push("d", String(std::string(64, 'x').c_str()), false, 1));
+    TEST_ASSERT_EQUAL(6, queue.drops());
+    TEST_ASSERT_EQUAL(2, queue.size());
+
+    // drain stops on the first message that could not be sent
+    size_t sent { 0 };
+    TEST_ASSERT_EQUAL(1, queue.drain(10,
+        [&](const OfflineQueue::Message&) {
+            return (sent++) == 0;
+        }));
+    TEST_ASSERT_EQUAL(1, queue.size());
+    TEST_ASSERT_EQUAL(31, queue.bytes());
+
+    // only the retained message is outdated by the newer one
+    queue.clear();
+    TEST_ASSERT(queue.push("relay/0", "1", false, 0));
+    TEST_ASSERT(queue.push("relay/0", "0", true, 0));
+    TEST_ASSERT(queue.contains("relay/0"));
+    TEST_ASSERT(queue.erase("relay/0"));
+    TEST_ASSERT_FALSE(queue.erase("relay/0"));
+    TEST_ASSERT_EQUAL(1, queue.size());
+    TEST_ASSERT(queue.contains("relay/0"));
+    TEST_ASSERT_FALSE(queue.contains("relay/1"));
+    TEST_ASSERT_EQUAL_STRING("relay/0=>1", drain(queue, 1)[0].c_str());
+
+    // disabled queue drops everything
+    OfflineQueue disabled(0, 64);
+    TEST_ASSERT_FALSE(disabled.push("a", "1", true, 1));
+    TEST_ASSERT_EQUAL(1, disabled.drops());
+}
+
+void test_topic_cache() {
+    TopicCache cache(4);
+    cache.pattern("home/#/device", "", "/set");
+
+    TEST_ASSERT_EQUAL_STRING("home/relay/device", cache.getter("relay").c_str());
+    TEST_ASSERT_EQUAL_STRING("home/relay/0/device", cache.getter("relay", 0).c_str());
+    TEST_ASSERT_EQUAL_STRING("home/relay/0/device/set", cache.setter("relay", 0).c_str());
+    TEST_ASSERT_EQUAL_STRING("home/relay/1/device/set", cache.setter("relay", 1).c_str());
+    TEST_ASSERT_EQUAL(4, cache.size());
+
+    // existing topic is returned as-is
+    TEST_ASSERT_EQUAL_STRING("home/relay/0/device", cache.getter("relay", 0).c_str());
+    TEST_ASSERT_EQUAL(4, cache.size());
+
+    // no more space, the oldest entries are replaced
+    const auto light = cache.getter("light");
+    const auto mired = cache.setter("mired");
+    TEST_ASSERT_EQUAL_STRING("home/light/device", light.c_str());
+    TEST_ASSERT_EQUAL_STRING("home/mired/device/set", mired.c_str());
+    TEST_ASSERT_EQUAL(4, cache.size());
+
+    TEST_ASSERT_EQUAL_STRING("home/relay/0/device/set", cache.setter("relay", 0).c_str());
+    TEST_ASSERT_EQUAL_STRING("home/light/device", cache.getter("light").c_str());
+    TEST_ASSERT_EQUAL(4, cache.size());
+
+    // returned copy stays the same after the entry is replaced
+    TEST_ASSERT_EQUAL_STRING("home/relay/device", cache.getter("relay").c_str());
+    TEST_ASSERT_EQUAL_STRING("home/relay/1/device/set", cache.setter("relay", 1).c_str());
+    TEST_ASSERT_EQUAL(4, cache.size());
+    TEST_ASSERT_EQUAL_STRING("home/light/device", light.c_str());
+    TEST_ASSERT_EQUAL_STRING("home/mired/device/set", mired.c_str());
+
+    cache.pattern("device/#", "/status", "/set");
+    TEST_ASSERT_EQUAL(0, cache.size());
+    TEST_ASSERT_EQUAL_STRING("device/relay/0/status", cache.getter("relay", 0).c_str());
+    TEST_ASSERT_EQUAL_STRING("device/relay/set", cache.setter("relay").c_str());
+
+    // nothing is kept, but topics are still created
+    TopicCache disabled(0);
+    disabled.pattern("device/#", "", "/set");
+    TEST_ASSERT_EQUAL_STRING("device/relay/0/set", disabled.setter("relay", 0).c_str());
+    TEST_ASSERT_EQUAL(0, disabled.size());
+}
+
+// Same as the previous mqttTopic(), where topic is re-created on every call
+String benchmark_topic(const String& root, const String& suffix, const String& magnitude, size_t index) {
+    String topic(magnitude);
+    topic += '/';
+    topic += String(index, 10);
+
+    String out;
+    out.reserve(topic.length() + root.length() + suffix.length());
+
+    out += root;
+    out += suffix;
+    out.replace(String("#"), topic);
+
+    return out;
+}
+
+void test_topic_cache_benchmark() {
+    const String root("home/espurna-123456/#");
+    const String getter("");
+    const String setter("/set");
+
+    constexpr const char* const Magnitudes[] {
+        "relay", "pulse", "lock", "timer", "temperature",
+        "humidity", "power", "energy", "button", "led",
+    };
+
+    constexpr size_t Iterations { 1000 };
+    constexpr size_t Indexes { 2 };
+
+    size_t length { 0 };
+    size_t before { allocations };
+
+    espurna::benchmark::Stopwatch stopwatch;
+    for (size_t iteration = 0; iteration < Iterations; ++iteration) {
+        for (const auto* magnitude : Magnitudes) {
+            for (size_t index = 0; index < Indexes; ++index) {
+                length += benchmark_topic(root, getter, magnitude, index).length();
+            }
+        }
+    }
+
+    const auto calls = Iterations * std::size(Magnitudes) * Indexes;
+
+    const auto rebuild_time = stopwatch.nanoseconds(calls);
+    const auto rebuild_allocations = double(allocations - before) / calls;
+
+    TopicCache cache(32);
+    cache.pattern(root, getter, setter);
+
+    size_t cached { 0 };
+    before = allocations;
+
+    stopwatch.restart();
+    for (size_t iteration = 0; iteration < Iterations; ++iteration) {
+        for (const auto* magnitude : Magnitudes) {
+            for (size_t index = 0; index < Indexes; ++index) {
+                cached += cache.getter(magnitude, index).length();
+            }
+        }
+    }
+
+    const auto cache_time = stopwatch.nanoseconds(calls);
+    const auto cache_allocations = double(allocations - before) / calls;
+
+    TEST_ASSERT_EQUAL(length, cached);
+
+    espurna::benchmark::message(
+        "- %zu topics: re-created %.1f ns (%.2f allocations), cached %.1f ns (%.2f allocations) per call",
+        std::size(Magnitudes) * Indexes,
+        rebuild_time, rebuild_allocations, cache_time, cache_allocations);
+}
+
+using TestRouter = Router<size_t>;
+
+struct RouterResult {
+    std::vector<size_t> handlers;
+    std::vector<String> values;
+};
+
+RouterResult route(const TestRouter& router, StringView topic) {
+    RouterResult out;
+    router.match(topic,
+        [&](size_t handler, const Match& match) {
+            out.handlers.push_back(handler);
+            for (size_t index = 0; index < match.size; ++index) {
+                out.values.push_back(match[index].toString());
+            }
+        });
+
+    return out;
+}
+
+void test_router_match() {
+    TestRouter router;
+    TEST_ASSERT(router.add("relay/+", 0));
+    TEST_ASSERT(router.add("light", 1));
+    TEST_ASSERT(router.add("light/#", 2));
+    TEST_ASSERT(router.add("+/+", 3));
+    TEST_ASSERT(router.add("#", 4));
+    TEST_ASSERT(router.add("relay/+", 5));
+    TEST_ASSERT(router.add("a/+/c/+/e", 6));
+    TEST_ASSERT_EQUAL(7, router.size());
+
+    auto result = route(router, "relay/0");
+    TEST_ASSERT_EQUAL(4, result.handlers.size());
+    TEST_ASSERT_EQUAL(4, result.handlers[0]);
+    TEST_ASSERT_EQUAL(0, result.handlers[1]);
+    TEST_ASSERT_EQUAL(5, result.handlers[2]);
+    TEST_ASSERT_EQUAL(3, result.handlers[3]);
+    TEST_ASSERT_EQUAL(5, result.values.size());
+    TEST_ASSERT_EQUAL_STRING("relay/0", result.values[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("0", result.values[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("0", result.values[2].c_str());
+    TEST_ASSERT_EQUAL_STRING("relay", result.values[3].c_str());
+    TEST_ASSERT_EQUAL_STRING("0", result.values[4].c_str());
+
+    // '#' also matches the parent level
+    result = route(router, "light");
+    TEST_ASSERT_EQUAL(3, result.handlers.size());
+    TEST_ASSERT_EQUAL(4, result.handlers[0]);
+    TEST_ASSERT_EQUAL(2, result.handlers[1]);
+    TEST_ASSERT_EQUAL(1, result.handlers[2]);
+    TEST_ASSERT_EQUAL_STRING("", result.values[1].c_str());
+
+    result = route(router, "light/color/rgb");
+    TEST_ASSERT_EQUAL(2, result.handlers.size());
+    TEST_ASSERT_EQUAL(2, result.handlers[1]);
+    TEST_ASSERT_EQUAL_STRING("color/rgb", result.values[1].c_str());
+
+    result = route(router, "a/b/c/d/e");
+    TEST_ASSERT_EQUAL(2, result.handlers.size());
+    TEST_ASSERT_EQUAL(6, result.handlers[1]);
+    TEST_ASSERT_EQUAL_STRING("b", result.values[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("d", result.values[2].c_str());
+
+    result = route(router, "relay/0/1");
+    TEST_ASSERT_EQUAL(1, result.handlers.size());
+    TEST_ASSERT_EQUAL(4, result.handlers[0]);
+
+    result = route(router, "");
+    TEST_ASSERT_EQUAL(0, result.handlers.size());
+}
+
+void test_router_invalid() {
+    TestRouter router;
+    TEST_ASSERT_FALSE(router.add("", 0));
+    TEST_ASSERT_FALSE(router.add("#/foo", 0));
+    TEST_ASSERT_FALSE(router.add("foo+/bar", 0));
+    TEST_ASSERT_FALSE(router.add("foo/ba#", 0));
+    TEST_ASSERT_FALSE(router.add("+/+/+/+/+", 0));
+    TEST_ASSERT_EQUAL(0, router.size());
+
+    TEST_ASSERT(router.add("foo/bar", 0));
+    TEST_ASSERT_EQUAL(0, route(router, "foo").handlers.size());
+    TEST_ASSERT_EQUAL(0, route(router, "foo/bar/baz").handlers.size());
+    TEST_ASSERT_EQUAL(0, route(router, "foo/baz").handlers.size());
+    TEST_ASSERT_EQUAL(1, route(router, "foo/bar").handlers.size());
+}
+
+// Filters similar to the ones used by the modules, relative to the root topic
+constexpr const char* const BenchmarkFilters[] {
+    "relay/+", "pulse/+", "timer/+", "lock/+",
+    "light", "brightness", "channel/+", "mired", "kelvin",
+    "rgb", "hsv", "transition", "energy/+", "action",
+    "led/+", "curtain", "button/+", "rfout", "ir", "garland/#",
+};
+
+// Every registered callback receives every message, and finds its magnitude on its own
+// (same as mqttMagnitude(), filter is re-created on every call)
+size_t benchmark_callbacks(const String& root, const String& setter, const std::vector<String>& topics) {
+    size_t out { 0 };
+
+    for (const auto& topic : topics) {
+        for (const auto* filter : BenchmarkFilters) {
+            const auto magnitude = match_wildcard(root + setter, topic, '#');
+            if (!magnitude.length()) {
+                continue;
+            }
+
+            const auto view = StringView(filter);
+            const auto end = view.end() - 2;
+            if (view.endsWith("/+") || view.endsWith("/#")) {
+                const auto prefix = StringView(view.begin(), end);
+                if (magnitude.startsWith(prefix)
+                    && (magnitude.length() > prefix.length())
+                    && (magnitude[prefix.length()] == '/'))
+                {
+                    ++out;
+                }
+            } else if (magnitude.equals(view)) {
+                ++out;
+            }
+        }
+    }
+
+    return out;
+}
+
+// Magnitude is found once, and the router only calls matching handlers
+size_t benchmark_router(const TestRouter& router, const String& filter, const std::vector<String>& topics) {
+    size_t out { 0 };
+
+    for (const auto& topic : topics) {
+        const auto magnitude = match_wildcard(filter, topic, '#');
+        if (!magnitude.length()) {
+            continue;
+        }
+
+        router.match(magnitude,
+            [&](size_t, const Match&) {
+                ++out;
+            });
+    }
+
+    return out;
+}
+
+void test_router_benchmark() {
+    const String root("home/espurna-123456/#");
+    const String setter("/set");
+    const String filter = root + setter;
+
+    constexpr const char* const Magnitudes[] {
+        "relay/0", "relay/1", "pulse/0", "lock/1", "light", "brightness",
+        "channel/2", "mired", "energy/0", "action", "led/0", "garland/scene/1",
+        "unknown", "temperature/0",
+    };
+
+    std::mt19937 random(1);
+    std::uniform_int_distribution<size_t> distribution(0, std::size(Magnitudes) - 1);
+
+    std::vector<String> topics;
+    topics.reserve(10000);
+    for (size_t index = 0; index < topics.capacity(); ++index) {
+        String topic("home/espurna-123456/");
+        topic += Magnitudes[distribution(random)];
+        topic += setter;
+        topics.push_back(std::move(topic));
+    }
+
+    TestRouter router;
+    for (size_t index = 0; index < std::size(BenchmarkFilters); ++index) {
+        TEST_ASSERT(router.add(BenchmarkFilters[index], index));
+    }
+
+    espurna::benchmark::Stopwatch stopwatch;
+    const auto callbacks = benchmark_callbacks(root, setter, topics);
+    const auto callbacks_time = stopwatch.nanoseconds(topics.size());
+
+    stopwatch.restart();
+    const auto routed = benchmark_router(router, filter, topics);
+    const auto router_time = stopwatch.nanoseconds(topics.size());
+
+    TEST_ASSERT_EQUAL(callbacks, routed);
+
+    espurna::benchmark::message(
+        "- %zu messages, %zu handlers: callbacks %.1f ns, router %.1f ns per message",
+        topics.size(), std::size(BenchmarkFilters), callbacks_time, router_time);
+}
+
 } // namespace test
 
 } // namespace
@@ -251,5 +948,20 @@ int main(int, char**) {
     RUN_TEST(test_valid_match_wildcard);
     RUN_TEST(test_invalid_match_wildcard);
 
+    RUN_TEST(test_batch_topics);
+    RUN_TEST(test_batch_benchmark);
+
+    RUN_TEST(test_json_aggregator);
+    RUN_TEST(test_json_budget);
+
+    RUN_TEST(test_offline_queue);
+
+    RUN_TEST(test_topic_cache);
+    RUN_TEST(test_topic_cache_benchmark);
+
+    RUN_TEST(test_router_match);
+    RUN_TEST(test_router_invalid);
+    RUN_TEST(test_router_benchmark);
+
     return UNITY_END();
 }
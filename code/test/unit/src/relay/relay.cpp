@@ -0,0 +1,253 @@
+#include <unity.h>
+
+#include <Arduino.h>
+
+#include <espurna/types.h>
+#include <espurna/relay_deadlines.ipp>
+
+#include "benchmark.h"
+
+#include <chrono>
+#include <vector>
+
+namespace espurna {
+namespace relay {
+namespace test {
+namespace {
+
+struct MockClock {
+    using duration = espurna::duration::Milliseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<MockClock, duration>;
+
+    static constexpr bool is_steady { true };
+
+    static time_point now() noexcept {
+        return time_point(duration(current));
+    }
+
+    static rep current;
+};
+
+MockClock::rep MockClock::current { 0 };
+
+constexpr size_t Relays { 16 };
+
+using TestDeadlines = Deadlines<MockClock, Relays>;
+
+MockClock::time_point at(MockClock::rep value) {
+    return MockClock::time_point(MockClock::duration(value));
+}
+
+MockClock::duration delay(MockClock::rep value) {
+    return MockClock::duration(value);
+}
+
+std::vector<size_t> ids(TestDeadlines::Mask mask) {
+    std::vector<size_t> out;
+    for (size_t id = 0; id < Relays; ++id) {
+        if (mask & (1u << id)) {
+            out.push_back(id);
+        }
+    }
+
+    return out;
+}
+
+void test_deadlines_order() {
+    TestDeadlines deadlines;
+    TEST_ASSERT_FALSE(deadlines.pending());
+    TEST_ASSERT_FALSE(deadlines.expired(at(0)));
+
+    deadlines.schedule(3, at(100), delay(50));
+    deadlines.schedule(1, at(100), delay(10));
+    deadlines.schedule(7, at(120), delay(100));
+    TEST_ASSERT_EQUAL(3, deadlines.size());
+
+    // same as 'now - start > delay'
+    TEST_ASSERT_FALSE(deadlines.expired(at(110)));
+    TEST_ASSERT_TRUE(deadlines.expired(at(111)));
+
+    TEST_ASSERT_EQUAL(1u << 1, deadlines.expire(at(111)));
+    TEST_ASSERT_EQUAL(0, deadlines.expire(at(111)));
+    TEST_ASSERT_FALSE(deadlines.scheduled(1));
+    TEST_ASSERT_TRUE(deadlines.scheduled(3));
+
+    TEST_ASSERT_EQUAL((1u << 3) | (1u << 7), deadlines.expire(at(500)));
+    TEST_ASSERT_FALSE(deadlines.pending());
+}
+
+void test_deadlines_replace() {
+    TestDeadlines deadlines;
+
+    // zero delay expires right away
+    deadlines.schedule(0, at(1000), delay(0));
+    TEST_ASSERT_TRUE(deadlines.expired(at(1000)));
+
+    // relay has only one deadline at a time
+    deadlines.schedule(0, at(1000), delay(500));
+    TEST_ASSERT_EQUAL(1, deadlines.size());
+    TEST_ASSERT_FALSE(deadlines.expired(at(1000)));
+
+    deadlines.schedule(5, at(1000), delay(100));
+    deadlines.schedule(9, at(1000), delay(200));
+    deadlines.cancel(5);
+    deadlines.cancel(15);
+    TEST_ASSERT_EQUAL(2, deadlines.size());
+
+    TEST_ASSERT_EQUAL(0, deadlines.expire(at(1150)));
+    TEST_ASSERT_EQUAL(1u << 9, deadlines.expire(at(1201)));
+    TEST_ASSERT_EQUAL(1u << 0, deadlines.expire(at(1501)));
+
+    // out-of-range ids are ignored
+    deadlines.schedule(Relays, at(0), delay(0));
+    TEST_ASSERT_FALSE(deadlines.pending());
+}
+
+void test_deadlines_wraparound() {
+    TestDeadlines deadlines;
+
+    const auto start = at(UINT32_MAX - 10);
+    deadlines.schedule(2, start, delay(100));
+    deadlines.schedule(4, start, delay(5));
+    deadlines.schedule(6, start, delay(30));
+
+    TEST_ASSERT_FALSE(deadlines.expired(at(UINT32_MAX - 6)));
+    TEST_ASSERT_EQUAL(1u << 4, deadlines.expire(at(UINT32_MAX)));
+
+    const auto expired = deadlines.expire(at(25));
+    TEST_ASSERT_EQUAL(1, ids(expired).size());
+    TEST_ASSERT_EQUAL(6, ids(expired)[0]);
+
+    TEST_ASSERT_FALSE(deadlines.expired(at(89)));
+    TEST_ASSERT_EQUAL(1u << 2, deadlines.expire(at(90)));
+}
+
+void test_deadlines_process() {
+    TestDeadlines deadlines;
+
+    size_t calls { 0 };
+    const auto callback = [&](bool mode, TestDeadlines::Mask due) {
+        TEST_ASSERT_EQUAL((calls++ % 2) != 0, mode);
+        TEST_ASSERT_EQUAL(1u << 3, due);
+        return mode;
+    };
+
+    // nothing is scheduled or nothing has expired yet
+    MockClock::current = 0;
+    TEST_ASSERT_FALSE(deadlines.process(callback));
+
+    deadlines.update(3, true, MockClock::now(), delay(10));
+    deadlines.update(4, true, MockClock::now(), delay(10));
+    deadlines.update(4, false, MockClock::now(), delay(10));
+    TEST_ASSERT_EQUAL(1, deadlines.size());
+
+    MockClock::current = 10;
+    TEST_ASSERT_FALSE(deadlines.process(callback));
+    TEST_ASSERT_EQUAL(0, calls);
+
+    // OFF is always before ON
+    MockClock::current = 11;
+    TEST_ASSERT_TRUE(deadlines.process(callback));
+    TEST_ASSERT_EQUAL(2, calls);
+    TEST_ASSERT_FALSE(deadlines.pending());
+}
+
+void test_deadlines_update() {
+    TestDeadlines deadlines;
+
+    size_t calls { 0 };
+    const auto callback = [&](bool, TestDeadlines::Mask) {
+        ++calls;
+        return true;
+    };
+
+    // relay reached its target before the delay expired
+    MockClock::current = 0;
+    deadlines.update(0, true, MockClock::now(), delay(50));
+    deadlines.update(1, true, MockClock::now(), delay(0));
+
+    MockClock::current = 20;
+    deadlines.update(0, false, MockClock::now(), delay(0));
+    TEST_ASSERT_TRUE(deadlines.process(callback));
+    TEST_ASSERT_EQUAL(2, calls);
+
+    MockClock::current = 100;
+    TEST_ASSERT_FALSE(deadlines.process(callback));
+    TEST_ASSERT_EQUAL(2, calls);
+}
+
+// Same Deadlines::update() and Deadlines::process() calls as the relay loop, callback only counts the changes
+// Most loops do not have any relay changes, some relays change once in a while with a short delay
+double benchmark_deadlines(TestDeadlines& deadlines, size_t loops, bool schedule, size_t& changes) {
+    const auto callback = [&](bool mode, TestDeadlines::Mask due) {
+        if (mode) {
+            changes += __builtin_popcount(due);
+        }
+
+        return mode;
+    };
+
+    const espurna::benchmark::Stopwatch stopwatch;
+    for (size_t loop = 0; loop < loops; ++loop) {
+        if ((loop % 10) == 0) {
+            ++MockClock::current;
+        }
+
+        if (schedule && ((loop % 5000) == 0)) {
+            const auto id = (loop / 5000) % Relays;
+            deadlines.update(id, true, MockClock::now(), delay(id * 10));
+        }
+
+        deadlines.process(callback);
+    }
+
+    return stopwatch.nanoseconds(loops);
+}
+
+void test_deadlines_benchmark() {
+    constexpr size_t Loops { 1000000 };
+
+    MockClock::current = 0;
+
+    TestDeadlines changing;
+    size_t changes { 0 };
+    const auto changing_time = benchmark_deadlines(changing, Loops, true, changes);
+    TEST_ASSERT_EQUAL(Loops / 5000, changes);
+
+    // every relay is waiting, but only the earliest deadline is checked
+    TestDeadlines waiting;
+    for (size_t id = 0; id < Relays; ++id) {
+        waiting.update(id, true, MockClock::now(), delay(1ul << 30));
+    }
+
+    size_t expired { 0 };
+    const auto waiting_time = benchmark_deadlines(waiting, Loops, false, expired);
+    TEST_ASSERT_EQUAL(0, expired);
+    TEST_ASSERT_EQUAL(Relays, waiting.size());
+
+    espurna::benchmark::message(
+        "%zu relays - %zu changes: %.1fns, %zu waiting: %.1fns per loop",
+        Relays, changes, changing_time, waiting.size(), waiting_time);
+}
+
+} // namespace
+} // namespace test
+} // namespace relay
+} // namespace espurna
+
+int main(int, char**) {
+    UNITY_BEGIN();
+
+    using namespace espurna::relay::test;
+
+    RUN_TEST(test_deadlines_order);
+    RUN_TEST(test_deadlines_replace);
+    RUN_TEST(test_deadlines_wraparound);
+    RUN_TEST(test_deadlines_process);
+    RUN_TEST(test_deadlines_update);
+    RUN_TEST(test_deadlines_benchmark);
+
+    return UNITY_END();
+}
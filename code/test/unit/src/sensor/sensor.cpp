@@ -23,6 +23,12 @@
 #include <espurna/sensors/CSE7766Sensor.h>
 #include <espurna/sensors/A02YYUSensor.h>
 
+#include <espurna/filters/MedianFilter.h>
+#include <espurna/sensor_history.h>
+
+#include "benchmark.h"
+
+#include <cmath>
 #include <memory>
 #include <vector>
 
@@ -193,6 +199,444 @@ void test_a02yyu_data() {
     TEST_ASSERT_EQUAL_DOUBLE(1.953, ptr->value(0));
 }
 
+// Reading, filtering and reporting values of 64 magnitudes, modelled after the sensor loop
+// Both runs are standalone copies and do not call into sensor.cpp. They only compare the data
+// layouts, where everything is inside of the Magnitude object and sensor is accessed separately
+// for every slot, with hot / cold split and batched slot reads
+namespace magnitude_loop {
+
+using espurna::sensor::Unit;
+
+constexpr size_t Sensors { 8 };
+constexpr size_t Slots { 8 };
+constexpr size_t ReportEvery { 5 };
+
+struct ValuePair {
+    double value;
+    Unit units;
+};
+
+struct Sensor : public BaseSensor {
+    unsigned char id() const override {
+        return 0;
+    }
+
+    unsigned char count() const override {
+        return Slots;
+    }
+
+    String description() const override {
+        return "BenchmarkSensor";
+    }
+
+    unsigned char type(unsigned char) const override {
+        return MAGNITUDE_TEMPERATURE;
+    }
+
+    void pre() override {
+        for (auto& value : _values) {
+            value += 0.125;
+            if (value > 40.0) {
+                value = 0.0;
+            }
+        }
+    }
+
+    double value(unsigned char index) override {
+        return _values[index];
+    }
+
+    void values(double* out) override {
+        std::copy(std::begin(_values), std::end(_values), out);
+    }
+
+private:
+    double _values[Slots] {};
+};
+
+ValuePair process(double value, Unit units, unsigned char decimals, double correction) {
+    return ValuePair{
+        .value = roundTo(value, decimals) + correction,
+        .units = units,
+    };
+}
+
+struct Report {
+    double min_delta;
+    double max_delta;
+    double min_threshold;
+    double max_threshold;
+    double zero_threshold;
+    ValuePair& reported;
+};
+
+bool ready_to_report(ValuePair& out, const ValuePair& processed, BaseFilter& filter, const Report& report, bool ready) {
+    ready = ready
+        || (report.min_delta > 0.0)
+        || (report.max_delta > 0.0)
+        || !std::isnan(report.min_threshold)
+        || !std::isnan(report.max_threshold);
+
+    if (ready) {
+        out = processed;
+        if (filter.ready()) {
+            out.value = filter.value();
+            filter.restart();
+        }
+
+        if (!std::isnan(report.zero_threshold) && (out.value < report.zero_threshold)) {
+            out.value = 0.0;
+        }
+
+        if (!std::isnan(report.reported.value) && (report.min_delta > 0.0)) {
+            ready = std::abs(out.value - report.reported.value) >= report.min_delta;
+        }
+    }
+
+    return ready;
+}
+
+struct Result {
+    size_t reports;
+    benchmark::Clock::duration elapsed;
+};
+
+namespace before {
+
+struct Magnitude {
+    BaseSensor* sensor;
+    unsigned char slot;
+    unsigned char type;
+    unsigned char index_global;
+
+    Unit units { Unit::Celcius };
+    unsigned char decimals { 1 };
+
+    std::unique_ptr<BaseFilter> filter;
+
+    size_t read_count { 0 };
+
+    ValuePair last { NAN, Unit::None };
+    ValuePair reported { NAN, Unit::None };
+
+    double min_delta { 0.0 };
+    double max_delta { 0.0 };
+
+    double min_threshold { NAN };
+    double max_threshold { NAN };
+
+    double zero_threshold { NAN };
+    double correction { 0.0 };
+};
+
+Result run(std::vector<std::unique_ptr<Sensor>>& sensors, size_t rounds) {
+    std::vector<Magnitude> magnitudes;
+    for (auto& sensor : sensors) {
+        for (unsigned char slot = 0; slot < sensor->count(); ++slot) {
+            Magnitude magnitude;
+            magnitude.sensor = sensor.get();
+            magnitude.slot = slot;
+            magnitude.type = sensor->type(slot);
+            magnitude.index_global = magnitudes.size();
+            magnitude.filter = std::make_unique<MedianFilter>();
+            magnitude.filter->resize(ReportEvery);
+            magnitudes.push_back(std::move(magnitude));
+        }
+    }
+
+    size_t reports = 0;
+    String repr;
+
+    const benchmark::Stopwatch stopwatch;
+    for (size_t round = 0; round < rounds; ++round) {
+        for (auto& sensor : sensors) {
+            sensor->pre();
+        }
+
+        for (auto& magnitude : magnitudes) {
+            if (SENSOR_ERROR_OK != magnitude.sensor->error()) {
+                continue;
+            }
+
+            const ValuePair raw {
+                .value = magnitude.sensor->value(magnitude.slot),
+                .units = magnitude.sensor->units(magnitude.slot),
+            };
+
+            // process() used to request units once again
+            const auto processed = process(raw.value,
+                magnitude.sensor->units(magnitude.slot),
+                magnitude.decimals, magnitude.correction);
+
+            if (magnitude.last.units != processed.units) {
+                magnitude.filter->reset();
+            }
+
+            magnitude.filter->update(processed.value);
+            magnitude.last = processed;
+
+            // read value was always formatted, even without any handlers
+            repr = String(processed.value, magnitude.decimals);
+
+            magnitude.read_count = (magnitude.read_count + 1) % ReportEvery;
+
+            ValuePair out;
+            if (ready_to_report(out, processed, *magnitude.filter,
+                Report{
+                    magnitude.min_delta, magnitude.max_delta,
+                    magnitude.min_threshold, magnitude.max_threshold,
+                    magnitude.zero_threshold, magnitude.reported},
+                0 == magnitude.read_count))
+            {
+                magnitude.reported = out;
+                ++reports;
+            }
+        }
+    }
+
+    return Result{
+        .reports = reports,
+        .elapsed = stopwatch.elapsed(),
+    };
+}
+
+} // namespace before
+
+namespace after {
+
+struct Magnitude {
+    BaseSensor* sensor;
+    unsigned char slot;
+    unsigned char type;
+    unsigned char index_global;
+
+    Unit units { Unit::Celcius };
+    unsigned char decimals { 1 };
+
+    std::unique_ptr<BaseFilter> filter;
+};
+
+struct Reading {
+    Unit input { Unit::None };
+    size_t read_count { 0 };
+
+    ValuePair last { NAN, Unit::None };
+    ValuePair reported { NAN, Unit::None };
+
+    double min_delta { 0.0 };
+    double max_delta { 0.0 };
+
+    double min_threshold { NAN };
+    double max_threshold { NAN };
+
+    double zero_threshold { NAN };
+    double correction { 0.0 };
+};
+
+Result run(std::vector<std::unique_ptr<Sensor>>& sensors, size_t rounds) {
+    std::vector<Magnitude> magnitudes;
+    std::vector<Reading> readings;
+
+    for (auto& sensor : sensors) {
+        for (unsigned char slot = 0; slot < sensor->count(); ++slot) {
+            Magnitude magnitude;
+            magnitude.sensor = sensor.get();
+            magnitude.slot = slot;
+            magnitude.type = sensor->type(slot);
+            magnitude.index_global = magnitudes.size();
+            magnitude.filter = std::make_unique<MedianFilter>();
+            magnitude.filter->resize(ReportEvery);
+            magnitudes.push_back(std::move(magnitude));
+
+            Reading reading;
+            reading.input = sensor->units(slot);
+            readings.push_back(reading);
+        }
+    }
+
+    std::vector<double> values;
+    size_t reports = 0;
+
+    const benchmark::Stopwatch stopwatch;
+    for (size_t round = 0; round < rounds; ++round) {
+        for (auto& sensor : sensors) {
+            sensor->pre();
+        }
+
+        BaseSensor* current { nullptr };
+        for (size_t index = 0; index < magnitudes.size(); ++index) {
+            auto& magnitude = magnitudes[index];
+            auto& reading = readings[index];
+
+            if (SENSOR_ERROR_OK != magnitude.sensor->error()) {
+                continue;
+            }
+
+            if (current != magnitude.sensor) {
+                current = magnitude.sensor;
+                values.resize(std::max<size_t>(values.size(), current->count()));
+                current->values(values.data());
+            }
+
+            const auto processed = process(values[magnitude.slot],
+                reading.input, magnitude.decimals, reading.correction);
+
+            if (reading.last.units != processed.units) {
+                magnitude.filter->reset();
+            }
+
+            magnitude.filter->update(processed.value);
+            reading.last = processed;
+
+            reading.read_count = (reading.read_count + 1) % ReportEvery;
+
+            ValuePair out;
+            if (ready_to_report(out, processed, *magnitude.filter,
+                Report{
+                    reading.min_delta, reading.max_delta,
+                    reading.min_threshold, reading.max_threshold,
+                    reading.zero_threshold, reading.reported},
+                0 == reading.read_count))
+            {
+                reading.reported = out;
+                ++reports;
+            }
+        }
+    }
+
+    return Result{
+        .reports = reports,
+        .elapsed = stopwatch.elapsed(),
+    };
+}
+
+} // namespace after
+
+void run() {
+    constexpr size_t Rounds { 2000 };
+
+    const auto make_sensors = []() {
+        std::vector<std::unique_ptr<Sensor>> out;
+        for (size_t index = 0; index < Sensors; ++index) {
+            out.push_back(std::make_unique<Sensor>());
+        }
+
+        return out;
+    };
+
+    auto before_sensors = make_sensors();
+    const auto before_result = before::run(before_sensors, Rounds);
+
+    auto after_sensors = make_sensors();
+    const auto after_result = after::run(after_sensors, Rounds);
+
+    TEST_ASSERT_EQUAL(before_result.reports, after_result.reports);
+    TEST_ASSERT_EQUAL(Rounds * Sensors * Slots / ReportEvery, after_result.reports);
+
+    const auto reads = Rounds * Sensors * Slots;
+    benchmark::message(
+        "- magnitudes: %zu, reads: %zu\n"
+        "- before: %.1f ns per magnitude\n"
+        "- after: %.1f ns per magnitude",
+        Sensors * Slots, reads,
+        benchmark::nanoseconds(before_result.elapsed, reads),
+        benchmark::nanoseconds(after_result.elapsed, reads));
+}
+
+} // namespace magnitude_loop
+
+void test_magnitude_loop_benchmark() {
+    magnitude_loop::run();
+}
+
+using sensor::history::Series;
+using sensor::history::Summary;
+
+std::vector<Summary> history_values(const Series& series, size_t level) {
+    std::vector<Summary> out;
+    series.foreach(level,
+        [&](const Summary& summary) {
+            out.push_back(summary);
+        });
+
+    return out;
+}
+
+void test_history_levels() {
+    Series series({{60, 5}, {300, 3}}, 2);
+
+    // 10 minutes, value is increased once every 10 seconds
+    uint32_t now = 600;
+    for (size_t index = 0; index < 60; ++index) {
+        series.add(now, 20.0 + (index / 10.0));
+        now += 10;
+    }
+
+    series.advance(now);
+
+    TEST_ASSERT_EQUAL(5, series.count(0));
+    TEST_ASSERT_EQUAL(2, series.count(1));
+    TEST_ASSERT_EQUAL(now, series.end(0));
+    TEST_ASSERT_EQUAL(now, series.end(1));
+
+    // only the latest 5 minutes are kept
+    const auto minutes = history_values(series, 0);
+    TEST_ASSERT_EQUAL(5, minutes.size());
+    for (size_t index = 0; index < minutes.size(); ++index) {
+        const double first = 20.0 + ((index + 5) * 6) / 10.0;
+        TEST_ASSERT_DOUBLE_WITHIN(0.01, first, minutes[index].min);
+        TEST_ASSERT_DOUBLE_WITHIN(0.01, first + 0.25, minutes[index].avg);
+        TEST_ASSERT_DOUBLE_WITHIN(0.01, first + 0.5, minutes[index].max);
+    }
+
+    const auto five_minutes = history_values(series, 1);
+    TEST_ASSERT_EQUAL(2, five_minutes.size());
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 20.0, five_minutes[0].min);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 21.45, five_minutes[0].avg);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 22.9, five_minutes[0].max);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 23.0, five_minutes[1].min);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 25.9, five_minutes[1].max);
+
+    // nothing was received for 2 minutes
+    now += 120;
+    series.add(now, 30.0);
+    series.advance(now + 60);
+
+    const auto gap = history_values(series, 0);
+    TEST_ASSERT_EQUAL(5, gap.size());
+    TEST_ASSERT(static_cast<bool>(gap[1]));
+    TEST_ASSERT(!static_cast<bool>(gap[2]));
+    TEST_ASSERT(!static_cast<bool>(gap[3]));
+    TEST_ASSERT_EQUAL_DOUBLE(30.0, gap[4].avg);
+}
+
+void test_history_rescale() {
+    Series series({{60, 4}}, 2);
+
+    series.add(0, 1.0);
+    series.add(60, 2.5);
+    TEST_ASSERT_EQUAL(2, series.decimals());
+
+    // does not fit into int16 with 2 decimals, stored values are scaled down
+    series.add(120, 5000.0);
+    series.add(180, -50.0);
+    series.advance(240);
+
+    TEST_ASSERT_EQUAL(0, series.decimals());
+
+    const auto values = history_values(series, 0);
+    TEST_ASSERT_EQUAL(4, values.size());
+    TEST_ASSERT_DOUBLE_WITHIN(0.5, 1.0, values[0].avg);
+    TEST_ASSERT_DOUBLE_WITHIN(0.5, 2.5, values[1].avg);
+    TEST_ASSERT_DOUBLE_WITHIN(0.5, 5000.0, values[2].avg);
+    TEST_ASSERT_DOUBLE_WITHIN(0.5, -50.0, values[3].avg);
+
+    // NaN and infinity are not stored
+    series.add(240, NAN);
+    series.add(240, INFINITY);
+    TEST_ASSERT(!static_cast<bool>(series.current(0)));
+}
+
 } // namespace
 } // namespace test
 } // namespace espurna
@@ -202,5 +646,8 @@ int main(int, char**) {
     using namespace espurna::test;
     RUN_TEST(test_cse7766_data);
     RUN_TEST(test_a02yyu_data);
+    RUN_TEST(test_magnitude_loop_benchmark);
+    RUN_TEST(test_history_levels);
+    RUN_TEST(test_history_rescale);
     return UNITY_END();
 }
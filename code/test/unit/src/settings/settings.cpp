@@ -2,6 +2,15 @@
 #include <Arduino.h>
 
 #include <espurna/settings_convert.h>
+#include <espurna/settings_embedis.h>
+#include <espurna/settings_helpers.h>
+#include <espurna/settings_backup.h>
+
+#include "benchmark.h"
+
+#include <array>
+#include <chrono>
+#include <vector>
 
 namespace espurna {
 namespace settings {
@@ -179,6 +188,415 @@ void test_parse_duration_spec() {
             parse("5m", std::milli{}).value.seconds);
 }
 
+// storage reads are the most expensive part on the device, count them
+// in addition to the host timings (which are only useful for relative comparison)
+struct CountingStorage {
+    using Blob = std::array<uint8_t, 4096>;
+
+    CountingStorage(Blob& blob, size_t& reads) :
+        _blob(blob),
+        _reads(reads)
+    {}
+
+    uint8_t read(size_t index) const {
+        ++_reads;
+        return _blob[index];
+    }
+
+    void write(size_t index, uint8_t value) {
+        _blob[index] = value;
+    }
+
+    void commit() {
+    }
+
+private:
+    Blob& _blob;
+    size_t& _reads;
+};
+
+struct LookupBenchmark {
+    using Store = embedis::KeyValueStore<CountingStorage>;
+
+    explicit LookupBenchmark(bool indexed) :
+        store(CountingStorage(blob, reads), 0, blob.size())
+    {
+        blob.fill(0xff);
+        store.index(indexed);
+    }
+
+    // relay, sensor, button and led settings make up the most of the keys
+    void fill() {
+        static constexpr const char* Prefixes[] {
+            "relayName", "relayBoot", "relayTime", "relayPulse",
+            "btnClick", "btnDblClick", "btnLngClick", "ledMode",
+            "pwrRatioC", "tmpCorrection",
+        };
+
+        for (size_t index = 0; index < 24; ++index) {
+            for (const auto& prefix : Prefixes) {
+                auto key = String(prefix) + String(index, 10);
+                if (!store.set(key, String(index, 10))) {
+                    return;
+                }
+
+                keys.push_back(std::move(key));
+            }
+        }
+    }
+
+    struct Result {
+        size_t reads;
+        espurna::benchmark::Clock::duration elapsed;
+    };
+
+    Result run(size_t rounds) {
+        reads = 0;
+
+        const espurna::benchmark::Stopwatch stopwatch;
+        for (size_t round = 0; round < rounds; ++round) {
+            for (const auto& key : keys) {
+                TEST_ASSERT(static_cast<bool>(store.get(key)));
+            }
+
+            TEST_ASSERT_FALSE(store.has("missingKey"));
+        }
+
+        return Result{
+            .reads = reads,
+            .elapsed = stopwatch.elapsed(),
+        };
+    }
+
+    CountingStorage::Blob blob;
+    size_t reads { 0 };
+
+    Store store;
+    std::vector<String> keys;
+};
+
+void test_lookup_benchmark() {
+    constexpr size_t Rounds { 10 };
+
+    LookupBenchmark scan(false);
+    scan.fill();
+
+    LookupBenchmark indexed(true);
+    indexed.fill();
+
+    TEST_ASSERT(scan.blob == indexed.blob);
+    TEST_ASSERT_EQUAL(scan.keys.size(), indexed.keys.size());
+    TEST_ASSERT_EQUAL(scan.store.count(), indexed.store.count());
+
+    const auto scan_result = scan.run(Rounds);
+    const auto indexed_result = indexed.run(Rounds);
+
+    const auto lookups = Rounds * (scan.keys.size() + 1);
+    espurna::benchmark::message(
+        "- keys: %zu, lookups: %zu\n"
+        "- scan: %zu reads, %.3f us per lookup\n"
+        "- index: %zu reads, %.3f us per lookup",
+        scan.keys.size(), lookups,
+        scan_result.reads,
+        espurna::benchmark::microseconds(scan_result.elapsed, lookups),
+        indexed_result.reads,
+        espurna::benchmark::microseconds(indexed_result.elapsed, lookups));
+
+    TEST_ASSERT_LESS_THAN(scan_result.reads, indexed_result.reads);
+}
+
+// converter calls are the part we want to avoid, count them
+size_t converted { 0 };
+
+template <typename T>
+T counted_convert(const String& value) {
+    ++converted;
+    return internal::convert<T>(value);
+}
+
+uint32_t cached_seconds() {
+    return counted_convert<uint32_t>("15");
+}
+
+bool cached_flag(size_t index) {
+    return counted_convert<bool>((index % 2) ? "on" : "off");
+}
+
+void test_cached() {
+    converted = 0;
+
+    Cached<uint32_t> seconds(cached_seconds);
+    TEST_ASSERT_EQUAL(0, converted);
+
+    TEST_ASSERT_EQUAL(15, seconds());
+    TEST_ASSERT_EQUAL(15, seconds());
+    TEST_ASSERT_EQUAL(1, converted);
+
+    Generation::bump();
+    TEST_ASSERT_EQUAL(15, seconds.get());
+    TEST_ASSERT_EQUAL(2, converted);
+
+    CachedIndexed<bool> flag(cached_flag);
+    TEST_ASSERT_FALSE(flag(0));
+    TEST_ASSERT(flag(5));
+    TEST_ASSERT(flag(5));
+    TEST_ASSERT_FALSE(flag(0));
+    TEST_ASSERT_EQUAL(4, converted);
+
+    Generation::bump();
+    TEST_ASSERT(flag(5));
+    TEST_ASSERT_EQUAL(5, converted);
+    TEST_ASSERT_EQUAL(15, seconds());
+    TEST_ASSERT_EQUAL(6, converted);
+}
+
+// simulate relay-like module, where every status change reads a couple of indexed settings
+// configure() happens after every settings change, and is followed by some amount of status changes
+constexpr size_t BenchmarkEntries { 8 };
+
+uint32_t benchmark_time(size_t index) {
+    return counted_convert<uint32_t>(String(index * 1000, 10));
+}
+
+String benchmark_topic(size_t index) {
+    ++converted;
+    return "relay/" + String(index, 10);
+}
+
+void test_cached_benchmark() {
+    constexpr size_t Configures { 10 };
+    constexpr size_t Changes { 100 };
+
+    struct Result {
+        size_t converted;
+        espurna::benchmark::Clock::duration elapsed;
+    };
+
+    const auto run = [](bool cached) {
+        CachedIndexed<uint32_t> time(benchmark_time);
+        CachedIndexed<String> topic(benchmark_topic);
+
+        converted = 0;
+        size_t length = 0;
+
+        const espurna::benchmark::Stopwatch stopwatch;
+        for (size_t configure = 0; configure < Configures; ++configure) {
+            Generation::bump();
+            for (size_t change = 0; change < Changes; ++change) {
+                for (size_t index = 0; index < BenchmarkEntries; ++index) {
+                    if (cached) {
+                        length += time(index) + topic(index).length();
+                    } else {
+                        length += benchmark_time(index) + benchmark_topic(index).length();
+                    }
+                }
+            }
+        }
+
+        TEST_ASSERT_NOT_EQUAL(0, length);
+
+        return Result{
+            .converted = converted,
+            .elapsed = stopwatch.elapsed(),
+        };
+    };
+
+    const auto plain = run(false);
+    const auto cached = run(true);
+
+    const auto reads = Configures * Changes * BenchmarkEntries * 2;
+
+    espurna::benchmark::message(
+        "- configure cycles: %zu, reads: %zu\n"
+        "- plain: %zu conversions, %.3f us per read\n"
+        "- cached: %zu conversions, %.3f us per read",
+        Configures, reads,
+        plain.converted,
+        espurna::benchmark::microseconds(plain.elapsed, reads),
+        cached.converted,
+        espurna::benchmark::microseconds(cached.elapsed, reads));
+
+    TEST_ASSERT_EQUAL(reads, plain.converted);
+    TEST_ASSERT_EQUAL(Configures * BenchmarkEntries * 2, cached.converted);
+}
+
+struct BackupStore {
+    using Store = embedis::KeyValueStore<CountingStorage>;
+
+    BackupStore() :
+        store(CountingStorage(blob, reads), 0, blob.size())
+    {
+        blob.fill(0xff);
+    }
+
+    CountingStorage::Blob blob;
+    size_t reads { 0 };
+
+    Store store;
+};
+
+using Pairs = std::vector<std::pair<String, String>>;
+
+// parse in chunks of the specified size, simulating the network
+bool parse_backup(const String& data, size_t chunk, size_t limit, Pairs& out) {
+    backup::Parser parser(limit);
+
+    const auto* ptr = reinterpret_cast<const uint8_t*>(data.c_str());
+    for (size_t offset = 0; offset < data.length(); offset += chunk) {
+        const auto size = std::min(chunk, data.length() - offset);
+        const auto result = parser.feed(ptr + offset, size,
+            [&](String&& key, String&& value) {
+                out.emplace_back(std::move(key), std::move(value));
+                return true;
+            });
+        if (!result) {
+            return false;
+        }
+    }
+
+    return parser.done();
+}
+
+void test_backup_roundtrip() {
+    BackupStore backup;
+
+    Pairs expected {
+        {"hostname", "espurna-test"},
+        {"quoted", "\"value\" with \\ slashes"},
+        {"control", "line\nbreak\tand\x01"},
+        {"empty", ""},
+        {"long", String()},
+    };
+
+    auto& long_value = expected.back().second;
+    for (size_t index = 0; index < 300; ++index) {
+        long_value += 'x';
+    }
+
+    for (const auto& pair : expected) {
+        TEST_ASSERT(backup.store.set(pair.first, pair.second));
+    }
+
+    backup::Writer<BackupStore::Store&> writer(backup.store, "{\n\"app\": \"TEST\"");
+
+    // response buffer is usually a lot smaller than the whole output
+    String out;
+    uint8_t buffer[17];
+    for (;;) {
+        const auto size = writer.read(buffer, sizeof(buffer));
+        if (!size) {
+            break;
+        }
+
+        TEST_ASSERT_LESS_OR_EQUAL(sizeof(buffer), size);
+        out.concat(reinterpret_cast<const char*>(&buffer[0]), size);
+    }
+
+    TEST_ASSERT(writer.done());
+    TEST_ASSERT_FALSE(writer.failed());
+    TEST_ASSERT(out.startsWith("{\n\"app\": \"TEST\",\n"));
+    TEST_ASSERT(out.endsWith("\n}"));
+
+    for (size_t chunk : {1, 7, 64, 1460}) {
+        Pairs parsed;
+        TEST_ASSERT(parse_backup(out, chunk, 1024, parsed));
+        TEST_ASSERT_EQUAL(expected.size() + 1, parsed.size());
+
+        TEST_ASSERT_EQUAL_STRING("app", parsed[0].first.c_str());
+        TEST_ASSERT_EQUAL_STRING("TEST", parsed[0].second.c_str());
+
+        // storage order is reversed, newest kv comes first
+        for (const auto& pair : expected) {
+            auto it = std::find_if(parsed.begin(), parsed.end(),
+                [&](const std::pair<String, String>& parsed) {
+                    return parsed.first == pair.first;
+                });
+            TEST_ASSERT(it != parsed.end());
+            TEST_ASSERT(pair.second == (*it).second);
+        }
+    }
+}
+
+void test_backup_interrupted() {
+    BackupStore backup;
+    TEST_ASSERT(backup.store.set("first", "value"));
+    TEST_ASSERT(backup.store.set("second", "value"));
+
+    backup::Writer<BackupStore::Store&> writer(backup.store, "{");
+
+    String out;
+    uint8_t buffer[4];
+    TEST_ASSERT_EQUAL(sizeof(buffer), writer.read(buffer, sizeof(buffer)));
+    out.concat(reinterpret_cast<const char*>(&buffer[0]), sizeof(buffer));
+
+    // cached values are invalidated, but the storage is still the same
+    Generation::bump();
+    TEST_ASSERT_EQUAL(sizeof(buffer), writer.read(buffer, sizeof(buffer)));
+    out.concat(reinterpret_cast<const char*>(&buffer[0]), sizeof(buffer));
+
+    // position is no longer valid, output stops
+    Revision::bump();
+    size_t reads = 0;
+    for (;;) {
+        const auto size = writer.read(buffer, sizeof(buffer));
+        if (!size) {
+            break;
+        }
+
+        out.concat(reinterpret_cast<const char*>(&buffer[0]), size);
+        ++reads;
+        TEST_ASSERT_LESS_THAN(32, reads);
+    }
+
+    TEST_ASSERT_FALSE(writer.done());
+    TEST_ASSERT(writer.failed());
+
+    // truncated output must not be accepted, even when the object is closed
+    Pairs parsed;
+    TEST_ASSERT_FALSE(parse_backup(out, 1, 1024, parsed));
+    TEST_ASSERT_FALSE(parse_backup(out + "\n}", 1, 1024, parsed));
+}
+
+void test_backup_parser() {
+    {
+        Pairs parsed;
+        TEST_ASSERT(parse_backup(" {} ", 1, 16, parsed));
+        TEST_ASSERT_EQUAL(0, parsed.size());
+    }
+
+    {
+        Pairs parsed;
+        TEST_ASSERT(parse_backup(
+            "{\"number\": 12.5, \"flag\":true,\"nothing\":null,"
+            "\"unicode\": \"\\u00e9\\/\"}", 3, 16, parsed));
+        TEST_ASSERT_EQUAL(3, parsed.size());
+        TEST_ASSERT_EQUAL_STRING("12.5", parsed[0].second.c_str());
+        TEST_ASSERT_EQUAL_STRING("true", parsed[1].second.c_str());
+        TEST_ASSERT_EQUAL_STRING("unicode", parsed[2].first.c_str());
+        TEST_ASSERT_EQUAL_STRING("\xc3\xa9/", parsed[2].second.c_str());
+    }
+
+    const char* invalid[] {
+        "",
+        "[]",
+        "{\"key\"}",
+        "{\"key\": \"value\",}",
+        "{\"key\": \"value\"",
+        "{\"key\": {}}",
+        "{\"key\": [1]}",
+        "{\"key\": unquoted}",
+        "{\"key\": \"\\x\"}",
+        "{\"key\": \"\\u00\"}",
+        "{\"key\": \"value\"} trailing",
+        "{\"too-long-for-the-limit\": \"\"}",
+    };
+
+    for (const auto& text : invalid) {
+        Pairs parsed;
+        TEST_ASSERT_FALSE_MESSAGE(parse_backup(text, 5, 16, parsed), text);
+    }
+}
+
 } // namespace
 } // namespace test
 } // namespace settings
@@ -197,5 +615,14 @@ int main(int, char**) {
     RUN_TEST(test_parse_duration);
     RUN_TEST(test_parse_duration_spec);
 
+    RUN_TEST(test_lookup_benchmark);
+
+    RUN_TEST(test_cached);
+    RUN_TEST(test_cached_benchmark);
+
+    RUN_TEST(test_backup_roundtrip);
+    RUN_TEST(test_backup_interrupted);
+    RUN_TEST(test_backup_parser);
+
     return UNITY_END();
 }